@@ -51,6 +51,15 @@ bplus_tree::bplus_tree(const char *p, bool force_empty)
         init_from_empty();
         close_file();
     }
+
+    // keep the file open, instead of opening it on every block read
+    open_file();
+}
+
+bplus_tree::~bplus_tree()
+{
+    if (fp_level > 0 && fp != NULL)
+        fclose(fp);
 }
 
 int bplus_tree::search(const key_t& key, value_t *value) const
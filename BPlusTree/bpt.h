@@ -72,6 +72,7 @@ struct leaf_node_t {
 class bplus_tree {
 public:
     bplus_tree(const char *path, bool force_empty = false);
+    ~bplus_tree();
 
     /* abstract operations */
     int search(const key_t& key, value_t *value) const;
@@ -92,6 +93,12 @@ public:
     char path[512];
     meta_t meta;
 
+    /* the file stays open while the tree exists, so it can't be copied.
+     * the meta is read only when the tree is opened: one tree instance owns
+     * the file, other instances may read it but must not write to it */
+    bplus_tree(const bplus_tree &);
+    bplus_tree &operator=(const bplus_tree &);
+
     /* init empty tree */
     void init_from_empty();
 
@@ -220,6 +227,8 @@ public:
         open_file();
         fseek(fp, offset, SEEK_SET);
         size_t wd = fwrite(block, size, 1, fp);
+        // the file stays open, so the block is flushed for the other readers of the file
+        fflush(fp);
         close_file();
 
         return wd - 1;
@@ -6,23 +6,23 @@
 namespace bpt {
 
 /* predefined B+ info */
-#define BP_ORDER 20
+#define BP_ORDER 100 /* a node takes about 4 KB */
 
 /* key/value type */
-typedef int value_t;
+typedef long long value_t; /* the registry position, the data files may have more than 2 GB */
 struct key_t {
-    char k[16];
+    char k[32];
 
     key_t(const char *str = "")
     {
         bzero(k, sizeof(k));
-        strcpy(k, str);
+        strncpy(k, str, sizeof(k));
     }
 };
 
+/* the keys are compared as bytes, so binary keys (e.g. big endian numbers) keep their order */
 inline int keycmp(const key_t &a, const key_t &b) {
-    int x = strlen(a.k) - strlen(b.k);
-    return x == 0 ? strcmp(a.k, b.k) : x;
+    return memcmp(a.k, b.k, sizeof(a.k));
 }
 
 #define OPERATOR_KEYCMP(type) \
@@ -0,0 +1,631 @@
+#ifndef BLOOMFILTER_H
+#define BLOOMFILTER_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <math.h>
+#include <string.h>
+#include <stdio.h>
+#include "schema.h"
+#include "rowview.h"
+#include "zonemap.h"
+
+using namespace std;
+
+/**
+ * A Bloom filter with a fixed capacity. The bits of a value are all set on
+ * the same 512 bits block (one cache line), so a lookup misses the cache
+ * only once. The values are added and looked up by their 64 bits hash.
+ * A lookup never fails for a value that was added, but it may succeed for
+ * a value that was not (false positive).
+ */
+class BloomFilter {
+private:
+    static const unsigned BLOCK_BITS = 512;
+    
+    vector<unsigned long long> words;
+    unsigned number_of_hashes;
+    long long capacity;
+    long long number_of_values;
+    
+    /**
+     * @return the first word of the block used by the hash
+     */
+    size_t getBlockStart(unsigned long long hash) const;
+    
+public:
+    static const unsigned DEFAULT_BITS_PER_VALUE = 10; // about 1% of false positives
+    
+    /**
+     * @param capacity the number of values added before the filter is full
+     * @constructor
+     */
+    BloomFilter(long long capacity = 0, unsigned bits_per_value = DEFAULT_BITS_PER_VALUE);
+    
+    void add(unsigned long long hash);
+    
+    /**
+     * @return false if the value was never added
+     */
+    bool mayContain(unsigned long long hash) const;
+    
+    long long getCapacity();
+    long long getNumberOfValues();
+    
+    /**
+     * @return true if the filter has its capacity of values
+     */
+    bool isFull();
+    
+    /**
+     * @return the size of the bits, in bytes
+     */
+    size_t getSize();
+    
+    /**
+     * @return the expected false positive rate for the values added so far,
+     *         (1 - e^(-k * n / m))^k
+     */
+    double getEstimatedFalsePositiveRate();
+    
+    /**
+     * Write and read the filter at the current position of the file
+     * e.g.: | CAPACITY | NUMBER_OF_VALUES | NUMBER_OF_HASHES | NUMBER_OF_WORDS | WORDS |
+     */
+    void write(ostream & file);
+    bool read(istream & file);
+};
+
+/**
+ * The Bloom filters of a table column, used to answer that a value is not on
+ * the column without reading the data file. There is a filter for the whole
+ * column, which grows by adding filters of twice the capacity of the last one,
+ * and a filter for every zone map block, so the blocks that don't have the
+ * value are skipped.
+ * The values are hashed by their type, so the columns of the same type share
+ * the hashes: the integer columns hash a long long, the real columns a
+ * double and the string columns their characters.
+ * The filters are persisted next to the table, when the table is closed or
+ * checkpointed. The filter of a table that was not closed is rebuilt:
+ * e.g.: for the table person, the filter of the column city is person_city_b.dat
+ * | NUMBER_OF_ROWS | NUMBER_OF_STAGES | STAGE_1 | ... | NUMBER_OF_BLOCKS | BLOCK_0 | ...
+ * @see BloomFilter
+ */
+class ColumnBloomFilter {
+private:
+    string path;
+    vector<BloomFilter> stages; // the column filters, only the last one is not full
+    vector<BloomFilter> blocks; // one per ZoneMap::ROWS_PER_BLOCK rows
+    long long number_of_rows;
+    
+    // Lookup statistics, since the filter was opened
+    long long number_of_probes;
+    long long number_of_negatives;
+    long long number_of_false_positives;
+    
+    bool modified; // the filters changed since the last save
+    
+    /**
+     * Scramble the bits of the value, so every bit of the hash depends on all of them
+     */
+    static unsigned long long mix(unsigned long long value);
+    
+public:
+    static const long long INITIAL_CAPACITY = 64 * 1024;
+    
+    /**
+     * Loads the filter file, if any
+     * @constructor
+     */
+    ColumnBloomFilter(const string & path);
+    
+    /**
+     * Add the value of a row. The rows are added in the table order, a row
+     * that was already added (an update) only gets the new value
+     * @param row_index the row order on the table
+     */
+    void add(long long row_index, unsigned long long hash);
+    
+    /**
+     * Look up a value on the whole column, counting the lookup on the statistics
+     * @return false if no row has the value
+     */
+    bool mayContain(unsigned long long hash);
+    
+    /**
+     * @return false if no row of the block has the value. The blocks without
+     *         a filter may have any value
+     */
+    bool mayContainInBlock(long long block, unsigned long long hash);
+    
+    /**
+     * Count a lookup that passed the filter but didn't find any row
+     */
+    void recordFalsePositive();
+    
+    long long getNumberOfRows();
+    long long getNumberOfProbes();
+    long long getNumberOfNegatives();
+    long long getNumberOfFalsePositives();
+    
+    /**
+     * @return the false positives over the lookups of absent values, as
+     *         measured by the lookups made since the filter was opened
+     */
+    double getFalsePositiveRate();
+    
+    /**
+     * @return the false positive rate expected from the column filters
+     */
+    double getEstimatedFalsePositiveRate();
+    
+    /**
+     * @return the size of all the filters, in bytes
+     */
+    size_t getSize();
+    
+    string getPath();
+    
+    /**
+     * Remove all the values
+     */
+    void clear();
+    
+    /**
+     * Keep only the first rows. The values of the dropped rows stay on the
+     * column filters, where they are false positives
+     */
+    void truncate(long long number_of_rows);
+    
+    /**
+     * Write the filters to the file, if they changed
+     */
+    void save();
+    
+    /**
+     * Delete the filter file and the values
+     */
+    void drop();
+    
+    /**
+     * Hash a value the same way for every column of its type
+     */
+    static unsigned long long hashKey(long long value);
+    static unsigned long long hashKey(double value);
+    static unsigned long long hashKey(const char * value, size_t length);
+    static unsigned long long hashKey(const string & value);
+    
+    /**
+     * Hash the value of a column of the row
+     */
+    static unsigned long long hashValue(RowView & row, int column_position);
+    
+    /**
+     * Hash a value stored on the binary format. The VARCHAR and the dictionary
+     * encoded values must be hashed by their characters
+     * @see Table::convertAndSave
+     */
+    static unsigned long long hashValue(const char * value_ptr, SchemaCol & schema_col);
+    
+    /**
+     * Open the filter of each column of the table that has a filter file. The
+     * other columns get NULL
+     */
+    static void openAll(const string & table_name, Schema & schema, vector<ColumnBloomFilter *> & bloom_filters);
+    
+    /**
+     * Save and delete the filters
+     */
+    static void closeAll(vector<ColumnBloomFilter *> & bloom_filters);
+    
+    /**
+     * Write the filters that are not NULL on their files
+     */
+    static void saveAll(vector<ColumnBloomFilter *> & bloom_filters);
+    
+    /**
+     * Remove all the values of the filters that are not NULL
+     */
+    static void clearAll(vector<ColumnBloomFilter *> & bloom_filters);
+    
+    /**
+     * Delete the files of the filters that are not NULL
+     */
+    static void dropAll(vector<ColumnBloomFilter *> & bloom_filters);
+};
+
+const unsigned BloomFilter::BLOCK_BITS;
+const unsigned BloomFilter::DEFAULT_BITS_PER_VALUE;
+const long long ColumnBloomFilter::INITIAL_CAPACITY;
+
+BloomFilter::BloomFilter(long long capacity, unsigned bits_per_value) {
+    this->capacity = capacity;
+    this->number_of_values = 0;
+    
+    // k = ln(2) * m / n minimizes the false positives
+    this->number_of_hashes = max(1, (int) round(bits_per_value * 0.693));
+    
+    long long number_of_blocks = max(1LL, (capacity * bits_per_value + BLOCK_BITS - 1) / BLOCK_BITS);
+    this->words.assign(number_of_blocks * BLOCK_BITS / 64, 0);
+}
+
+size_t BloomFilter::getBlockStart(unsigned long long hash) const {
+    unsigned long long number_of_blocks = words.size() / (BLOCK_BITS / 64);
+    return ((hash >> 32) * number_of_blocks >> 32) * (BLOCK_BITS / 64);
+}
+
+void BloomFilter::add(unsigned long long hash) {
+    size_t block_start = getBlockStart(hash);
+    
+    // Double hashing inside the block
+    unsigned bit = (unsigned) hash;
+    unsigned step = (unsigned) (hash >> 23) | 1;
+    for (unsigned i = 0; i < number_of_hashes; i++) {
+        unsigned block_bit = bit % BLOCK_BITS;
+        words[block_start + block_bit / 64] |= 1ULL << (block_bit % 64);
+        bit += step;
+    }
+    number_of_values ++;
+}
+
+bool BloomFilter::mayContain(unsigned long long hash) const {
+    size_t block_start = getBlockStart(hash);
+    
+    unsigned bit = (unsigned) hash;
+    unsigned step = (unsigned) (hash >> 23) | 1;
+    for (unsigned i = 0; i < number_of_hashes; i++) {
+        unsigned block_bit = bit % BLOCK_BITS;
+        if ((words[block_start + block_bit / 64] & (1ULL << (block_bit % 64))) == 0) {
+            return false;
+        }
+        bit += step;
+    }
+    return true;
+}
+
+long long BloomFilter::getCapacity() {
+    return capacity;
+}
+
+long long BloomFilter::getNumberOfValues() {
+    return number_of_values;
+}
+
+bool BloomFilter::isFull() {
+    return number_of_values >= capacity;
+}
+
+size_t BloomFilter::getSize() {
+    return words.size() * sizeof(unsigned long long);
+}
+
+double BloomFilter::getEstimatedFalsePositiveRate() {
+    double number_of_bits = words.size() * 64.0;
+    return pow(1 - exp(-(double) number_of_hashes * number_of_values / number_of_bits), number_of_hashes);
+}
+
+void BloomFilter::write(ostream & file) {
+    unsigned long long number_of_words = words.size();
+    file.write(reinterpret_cast<const char *> (&capacity), sizeof(capacity));
+    file.write(reinterpret_cast<const char *> (&number_of_values), sizeof(number_of_values));
+    file.write(reinterpret_cast<const char *> (&number_of_hashes), sizeof(number_of_hashes));
+    file.write(reinterpret_cast<const char *> (&number_of_words), sizeof(number_of_words));
+    file.write(reinterpret_cast<const char *> (&words[0]), number_of_words * sizeof(unsigned long long));
+}
+
+bool BloomFilter::read(istream & file) {
+    unsigned long long number_of_words;
+    if (!file.read(reinterpret_cast<char *> (&capacity), sizeof(capacity)) ||
+        !file.read(reinterpret_cast<char *> (&number_of_values), sizeof(number_of_values)) ||
+        !file.read(reinterpret_cast<char *> (&number_of_hashes), sizeof(number_of_hashes)) ||
+        !file.read(reinterpret_cast<char *> (&number_of_words), sizeof(number_of_words)) ||
+        number_of_words == 0 || number_of_words % (BLOCK_BITS / 64) != 0) {
+        return false;
+    }
+    words.resize(number_of_words);
+    return (bool) file.read(reinterpret_cast<char *> (&words[0]), number_of_words * sizeof(unsigned long long));
+}
+
+ColumnBloomFilter::ColumnBloomFilter(const string & path) {
+    this->path = path;
+    this->number_of_rows = 0;
+    this->number_of_probes = 0;
+    this->number_of_negatives = 0;
+    this->number_of_false_positives = 0;
+    this->modified = false;
+    
+    ifstream file;
+    file.open(path.c_str(), ios::binary);
+    
+    long long stored_rows;
+    unsigned number_of_stages;
+    if (!file.read(reinterpret_cast<char *> (&stored_rows), sizeof(stored_rows)) ||
+        !file.read(reinterpret_cast<char *> (&number_of_stages), sizeof(number_of_stages))) {
+        return;
+    }
+    
+    stages.resize(number_of_stages);
+    for (unsigned i = 0; i < number_of_stages; i++) {
+        if (!stages[i].read(file)) {
+            clear();
+            return;
+        }
+    }
+    
+    unsigned long long number_of_blocks;
+    if (!file.read(reinterpret_cast<char *> (&number_of_blocks), sizeof(number_of_blocks)) ||
+        number_of_blocks != (unsigned long long) ((stored_rows + ZoneMap::ROWS_PER_BLOCK - 1) / ZoneMap::ROWS_PER_BLOCK)) {
+        clear();
+        return;
+    }
+    blocks.resize(number_of_blocks);
+    for (unsigned long long i = 0; i < number_of_blocks; i++) {
+        if (!blocks[i].read(file)) {
+            clear();
+            return;
+        }
+    }
+    
+    number_of_rows = stored_rows;
+    file.close();
+}
+
+unsigned long long ColumnBloomFilter::mix(unsigned long long value) {
+    // splitmix64 finalizer
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
+
+void ColumnBloomFilter::add(long long row_index, unsigned long long hash) {
+    if (stages.empty() || stages.back().isFull()) {
+        long long capacity = stages.empty() ? INITIAL_CAPACITY : stages.back().getCapacity() * 2;
+        stages.push_back(BloomFilter(capacity));
+    }
+    stages.back().add(hash);
+    
+    long long block = row_index / ZoneMap::ROWS_PER_BLOCK;
+    while (block >= (long long) blocks.size()) {
+        blocks.push_back(BloomFilter(ZoneMap::ROWS_PER_BLOCK));
+    }
+    blocks[block].add(hash);
+    
+    number_of_rows = max(number_of_rows, row_index + 1);
+    modified = true;
+}
+
+bool ColumnBloomFilter::mayContain(unsigned long long hash) {
+    number_of_probes ++;
+    for (size_t i = 0; i < stages.size(); i++) {
+        if (stages[i].mayContain(hash)) {
+            return true;
+        }
+    }
+    number_of_negatives ++;
+    return false;
+}
+
+bool ColumnBloomFilter::mayContainInBlock(long long block, unsigned long long hash) {
+    if (block < 0 || block >= (long long) blocks.size()) {
+        return true;
+    }
+    return blocks[block].mayContain(hash);
+}
+
+void ColumnBloomFilter::recordFalsePositive() {
+    number_of_false_positives ++;
+}
+
+long long ColumnBloomFilter::getNumberOfRows() {
+    return number_of_rows;
+}
+
+long long ColumnBloomFilter::getNumberOfProbes() {
+    return number_of_probes;
+}
+
+long long ColumnBloomFilter::getNumberOfNegatives() {
+    return number_of_negatives;
+}
+
+long long ColumnBloomFilter::getNumberOfFalsePositives() {
+    return number_of_false_positives;
+}
+
+double ColumnBloomFilter::getFalsePositiveRate() {
+    long long absent_values = number_of_negatives + number_of_false_positives;
+    if (absent_values == 0) {
+        return 0;
+    }
+    return (double) number_of_false_positives / absent_values;
+}
+
+double ColumnBloomFilter::getEstimatedFalsePositiveRate() {
+    // A value is a false positive if any stage has it
+    double true_negative_rate = 1;
+    for (size_t i = 0; i < stages.size(); i++) {
+        true_negative_rate *= 1 - stages[i].getEstimatedFalsePositiveRate();
+    }
+    return 1 - true_negative_rate;
+}
+
+size_t ColumnBloomFilter::getSize() {
+    size_t size = 0;
+    for (size_t i = 0; i < stages.size(); i++) {
+        size += stages[i].getSize();
+    }
+    for (size_t i = 0; i < blocks.size(); i++) {
+        size += blocks[i].getSize();
+    }
+    return size;
+}
+
+string ColumnBloomFilter::getPath() {
+    return path;
+}
+
+void ColumnBloomFilter::clear() {
+    stages.clear();
+    blocks.clear();
+    number_of_rows = 0;
+    modified = true;
+}
+
+void ColumnBloomFilter::truncate(long long number_of_rows) {
+    if (number_of_rows >= this->number_of_rows) {
+        return;
+    }
+    blocks.resize((number_of_rows + ZoneMap::ROWS_PER_BLOCK - 1) / ZoneMap::ROWS_PER_BLOCK);
+    this->number_of_rows = number_of_rows;
+    modified = true;
+}
+
+void ColumnBloomFilter::save() {
+    if (!modified) {
+        return;
+    }
+    
+    ofstream file;
+    file.open(path.c_str(), ios::binary | ios::trunc);
+    if (!file.is_open()) {
+        cout << "Unable to open file - " << path << endl;
+        return;
+    }
+    
+    unsigned number_of_stages = stages.size();
+    file.write(reinterpret_cast<const char *> (&number_of_rows), sizeof(number_of_rows));
+    file.write(reinterpret_cast<const char *> (&number_of_stages), sizeof(number_of_stages));
+    for (size_t i = 0; i < stages.size(); i++) {
+        stages[i].write(file);
+    }
+    
+    unsigned long long number_of_blocks = blocks.size();
+    file.write(reinterpret_cast<const char *> (&number_of_blocks), sizeof(number_of_blocks));
+    for (size_t i = 0; i < blocks.size(); i++) {
+        blocks[i].write(file);
+    }
+    file.close();
+    modified = false;
+}
+
+void ColumnBloomFilter::drop() {
+    remove(path.c_str());
+    clear();
+    modified = false;
+}
+
+unsigned long long ColumnBloomFilter::hashKey(long long value) {
+    return mix((unsigned long long) value);
+}
+
+unsigned long long ColumnBloomFilter::hashKey(double value) {
+    // -0.0 and 0.0 are the same key
+    if (value == 0) {
+        value = 0;
+    }
+    unsigned long long bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return mix(bits ^ 0x9e3779b97f4a7c15ULL);
+}
+
+unsigned long long ColumnBloomFilter::hashKey(const char * value, size_t length) {
+    // FNV-1a
+    unsigned long long hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char) value[i];
+        hash *= 1099511628211ULL;
+    }
+    return mix(hash);
+}
+
+unsigned long long ColumnBloomFilter::hashKey(const string & value) {
+    return hashKey(value.data(), value.size());
+}
+
+unsigned long long ColumnBloomFilter::hashValue(RowView & row, int column_position) {
+    SchemaCol & schema_col = row.getSchema()->getCols()->at(column_position);
+    if (schema_col.isInteger()) {
+        return hashKey(row.getInteger(column_position));
+    } else if (schema_col.isReal()) {
+        return hashKey(row.getReal(column_position));
+    }
+    return hashKey(row.getChars(column_position), row.getCharsLength(column_position));
+}
+
+unsigned long long ColumnBloomFilter::hashValue(const char * value_ptr, SchemaCol & schema_col) {
+    if (schema_col.type == INT32) {
+        int value;
+        memcpy(&value, value_ptr, sizeof(value));
+        return hashKey((long long) value);
+    } else if (schema_col.isInteger()) {
+        long long value;
+        memcpy(&value, value_ptr, sizeof(value));
+        return hashKey(value);
+    } else if (schema_col.type == FLOAT) {
+        float value;
+        memcpy(&value, value_ptr, sizeof(value));
+        return hashKey((double) value);
+    } else if (schema_col.type == DOUBLE) {
+        double value;
+        memcpy(&value, value_ptr, sizeof(value));
+        return hashKey(value);
+    }
+    return hashKey(value_ptr, strnlen(value_ptr, schema_col.getSize()));
+}
+
+void ColumnBloomFilter::openAll(const string & table_name, Schema & schema, vector<ColumnBloomFilter *> & bloom_filters) {
+    closeAll(bloom_filters);
+    
+    vector<SchemaCol> * schema_cols = schema.getCols();
+    for (vector<SchemaCol>::iterator it = schema_cols->begin(); it != schema_cols->end(); it++) {
+        string path = table_name + "_" + (*it).key + "_b.dat";
+        ifstream file;
+        file.open(path.c_str(), ios::binary);
+        if (file.is_open()) {
+            file.close();
+            bloom_filters.push_back(new ColumnBloomFilter(path));
+        } else {
+            bloom_filters.push_back(NULL);
+        }
+    }
+}
+
+void ColumnBloomFilter::closeAll(vector<ColumnBloomFilter *> & bloom_filters) {
+    for (vector<ColumnBloomFilter *>::iterator it = bloom_filters.begin(); it != bloom_filters.end(); it++) {
+        if (*it != NULL) {
+            (*it)->save();
+            delete *it;
+        }
+    }
+    bloom_filters.clear();
+}
+
+void ColumnBloomFilter::saveAll(vector<ColumnBloomFilter *> & bloom_filters) {
+    for (vector<ColumnBloomFilter *>::iterator it = bloom_filters.begin(); it != bloom_filters.end(); it++) {
+        if (*it != NULL) {
+            (*it)->save();
+        }
+    }
+}
+
+void ColumnBloomFilter::clearAll(vector<ColumnBloomFilter *> & bloom_filters) {
+    for (vector<ColumnBloomFilter *>::iterator it = bloom_filters.begin(); it != bloom_filters.end(); it++) {
+        if (*it != NULL) {
+            (*it)->clear();
+        }
+    }
+}
+
+void ColumnBloomFilter::dropAll(vector<ColumnBloomFilter *> & bloom_filters) {
+    for (vector<ColumnBloomFilter *>::iterator it = bloom_filters.begin(); it != bloom_filters.end(); it++) {
+        if (*it != NULL) {
+            (*it)->drop();
+        }
+    }
+}
+
+#endif //BLOOMFILTER_H
@@ -0,0 +1,501 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+/**
+ * A cache of fixed-size file pages shared by the tables. The reads and writes
+ * are made on the cached pages and the modified (dirty) pages are written back
+ * to the file when they are evicted or flushed. When the memory budget is full,
+ * the page to be evicted is chosen by the clock algorithm, skipping the
+ * pinned pages.
+ * e.g.:
+ * BufferPool pool(64 * 1024 * 1024);
+ * table.setBufferPool(&pool);
+ * ...
+ * cout << pool.getHits() << " hits, " << pool.getMisses() << " misses" << endl;
+ */
+class BufferPool {
+public:
+    static const size_t PAGE_BYTES = 4096;
+    static const size_t DEFAULT_MEMORY_BUDGET = 64 * 1024 * 1024;
+    
+private:
+    struct Frame {
+        int file_id;
+        long long page_number;
+        vector<char> data;
+        int pin_count;
+        bool dirty;
+        bool referenced; // set when the page is used, cleared by the clock hand
+    };
+    
+    struct PoolFile {
+        string path;
+        int fd;
+        long long size; // the file size, including the bytes not written back yet
+    };
+    
+    vector<Frame> frames;
+    unordered_map<long long, int> page_table; // page key -> frame index
+    size_t max_frames;
+    size_t clock_hand;
+    
+    vector<PoolFile> files;
+    map<string, int> file_ids;
+    
+    long long hits;
+    long long misses;
+    long long evictions;
+    long long write_backs;
+    
+    recursive_mutex pool_mutex;
+    
+    BufferPool(const BufferPool &);
+    BufferPool & operator=(const BufferPool &);
+    
+    static long long getPageKey(int file_id, long long page_number);
+    
+    /**
+     * Find a frame for a new page, evicting a page if the budget is full
+     * @return the frame index or -1 if all the frames are pinned
+     */
+    int getFreeFrame();
+    
+    /**
+     * Write the frame to the file if it's dirty
+     */
+    void writeBack(Frame & frame);
+    
+public:
+    /**
+     * @param memory_budget the maximum amount of bytes used by the pages
+     * @constructor
+     */
+    BufferPool(size_t memory_budget = DEFAULT_MEMORY_BUDGET);
+    
+    /**
+     * Flushes the dirty pages and closes the files
+     * @destructor
+     */
+    ~BufferPool();
+    
+    /**
+     * @return the pool shared by all the tables
+     */
+    static BufferPool * getShared();
+    
+    /**
+     * Open a file to be used by the pool. Opening the same path twice
+     * returns the same id
+     * @return the file id or -1 if the file could not be opened
+     */
+    int openFile(const string & path);
+    
+    /**
+     * Flush the file pages, drop them from the pool and close the file
+     */
+    void closeFile(int file_id);
+    
+    /**
+     * Drop the file pages without writing them back. Must be called if the file
+     * was modified without using the pool
+     */
+    void invalidate(int file_id);
+    
+    /**
+     * Get a page, reading it from the file if it's not on the pool. The page
+     * is not evicted until it's unpinned
+     * @return the PAGE_BYTES bytes of the page or NULL if all the frames are pinned
+     */
+    char * pin(int file_id, long long page_number);
+    
+    /**
+     * Release a pinned page
+     * @param dirty true if the page was modified
+     */
+    void unpin(int file_id, long long page_number, bool dirty);
+    
+    /**
+     * Copy a range of the file to the buffer, page by page
+     * @return false if the range is beyond the end of the file
+     */
+    bool read(int file_id, long long offset, char * buffer, size_t size);
+    
+    /**
+     * Copy the buffer to a range of the file, growing it if needed. The pages
+     * are only written to the file when evicted or flushed
+     */
+    bool write(int file_id, long long offset, const char * buffer, size_t size);
+    
+    /**
+     * @return the file size, including the bytes not written back yet
+     */
+    long long getFileSize(int file_id);
+    
+    /**
+     * Write back the dirty pages of a file
+     */
+    void flush(int file_id);
+    void flushAll();
+    
+    /**
+     * Change the memory budget, evicting pages if needed
+     */
+    void setMemoryBudget(size_t memory_budget);
+    size_t getMemoryBudget();
+    
+    /**
+     * Statistics used to size the pool for the working set
+     */
+    long long getHits();
+    long long getMisses();
+    long long getEvictions();
+    long long getWriteBacks();
+    double getHitRatio();
+    void resetStatistics();
+};
+
+BufferPool::BufferPool(size_t memory_budget) {
+    max_frames = memory_budget / PAGE_BYTES;
+    if (max_frames == 0) {
+        max_frames = 1;
+    }
+    clock_hand = 0;
+    resetStatistics();
+}
+
+BufferPool::~BufferPool() {
+    flushAll();
+    for (vector<PoolFile>::iterator it = files.begin(); it != files.end(); it++) {
+        if ((*it).fd >= 0) {
+            close((*it).fd);
+        }
+    }
+}
+
+BufferPool * BufferPool::getShared() {
+    static BufferPool shared_pool;
+    return &shared_pool;
+}
+
+long long BufferPool::getPageKey(int file_id, long long page_number) {
+    return ((long long) file_id << 48) | page_number;
+}
+
+int BufferPool::openFile(const string & path) {
+    lock_guard<recursive_mutex> lock(pool_mutex);
+    
+    map<string, int>::iterator it = file_ids.find(path);
+    if (it != file_ids.end()) {
+        return it->second;
+    }
+    
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    struct stat file_stat;
+    PoolFile file;
+    file.path = path;
+    file.fd = fd;
+    file.size = fstat(fd, &file_stat) == 0 ? file_stat.st_size : 0;
+    
+    files.push_back(file);
+    file_ids[path] = files.size() - 1;
+    return files.size() - 1;
+}
+
+void BufferPool::closeFile(int file_id) {
+    lock_guard<recursive_mutex> lock(pool_mutex);
+    if (file_id < 0 || file_id >= (int) files.size() || files[file_id].fd < 0) {
+        return;
+    }
+    
+    flush(file_id);
+    invalidate(file_id);
+    close(files[file_id].fd);
+    files[file_id].fd = -1;
+    file_ids.erase(files[file_id].path);
+}
+
+void BufferPool::invalidate(int file_id) {
+    lock_guard<recursive_mutex> lock(pool_mutex);
+    
+    for (size_t i = 0; i < frames.size(); i++) {
+        Frame & frame = frames[i];
+        if (frame.file_id == file_id) {
+            page_table.erase(getPageKey(frame.file_id, frame.page_number));
+            frame.file_id = -1;
+            frame.pin_count = 0;
+            frame.dirty = false;
+            frame.referenced = false;
+        }
+    }
+    
+    // The file may have changed, so the size is read again
+    if (file_id >= 0 && file_id < (int) files.size() && files[file_id].fd >= 0) {
+        struct stat file_stat;
+        files[file_id].size = fstat(files[file_id].fd, &file_stat) == 0 ? file_stat.st_size : 0;
+    }
+}
+
+void BufferPool::writeBack(Frame & frame) {
+    if (!frame.dirty || frame.file_id < 0) {
+        return;
+    }
+    
+    // Only the bytes inside the file are written, so the file doesn't
+    // grow to the page boundary
+    PoolFile & file = files[frame.file_id];
+    long long page_offset = frame.page_number * PAGE_BYTES;
+    long long valid_bytes = file.size - page_offset;
+    if (valid_bytes > (long long) PAGE_BYTES) {
+        valid_bytes = PAGE_BYTES;
+    }
+    if (valid_bytes > 0) {
+        pwrite(file.fd, &frame.data[0], valid_bytes, page_offset);
+    }
+    
+    frame.dirty = false;
+    write_backs ++;
+}
+
+int BufferPool::getFreeFrame() {
+    if (frames.size() < max_frames) {
+        Frame frame;
+        frame.file_id = -1;
+        frame.page_number = -1;
+        frame.data.resize(PAGE_BYTES);
+        frame.pin_count = 0;
+        frame.dirty = false;
+        frame.referenced = false;
+        frames.push_back(frame);
+        return frames.size() - 1;
+    }
+    
+    // Clock: the hand gives a second chance to the referenced pages. Two turns
+    // are enough to find an unpinned page, if there is one
+    for (size_t step = 0; step < 2 * frames.size(); step++) {
+        int frame_index = clock_hand;
+        Frame & frame = frames[frame_index];
+        clock_hand = (clock_hand + 1) % frames.size();
+        
+        if (frame.pin_count > 0) {
+            continue;
+        }
+        if (frame.referenced) {
+            frame.referenced = false;
+            continue;
+        }
+        
+        if (frame.file_id >= 0) {
+            writeBack(frame);
+            page_table.erase(getPageKey(frame.file_id, frame.page_number));
+            evictions ++;
+        }
+        frame.file_id = -1;
+        return frame_index;
+    }
+    
+    return -1;
+}
+
+char * BufferPool::pin(int file_id, long long page_number) {
+    lock_guard<recursive_mutex> lock(pool_mutex);
+    
+    unordered_map<long long, int>::iterator it = page_table.find(getPageKey(file_id, page_number));
+    if (it != page_table.end()) {
+        Frame & frame = frames[it->second];
+        frame.pin_count ++;
+        frame.referenced = true;
+        hits ++;
+        return &frame.data[0];
+    }
+    
+    misses ++;
+    int frame_index = getFreeFrame();
+    if (frame_index < 0) {
+        return NULL;
+    }
+    
+    Frame & frame = frames[frame_index];
+    frame.file_id = file_id;
+    frame.page_number = page_number;
+    frame.pin_count = 1;
+    frame.dirty = false;
+    frame.referenced = true;
+    
+    // The bytes after the end of the file are zeroed
+    ssize_t read_bytes = pread(files[file_id].fd, &frame.data[0], PAGE_BYTES, page_number * PAGE_BYTES);
+    if (read_bytes < 0) {
+        read_bytes = 0;
+    }
+    memset(&frame.data[read_bytes], 0, PAGE_BYTES - read_bytes);
+    
+    page_table[getPageKey(file_id, page_number)] = frame_index;
+    return &frame.data[0];
+}
+
+void BufferPool::unpin(int file_id, long long page_number, bool dirty) {
+    lock_guard<recursive_mutex> lock(pool_mutex);
+    
+    unordered_map<long long, int>::iterator it = page_table.find(getPageKey(file_id, page_number));
+    if (it != page_table.end()) {
+        Frame & frame = frames[it->second];
+        if (frame.pin_count > 0) {
+            frame.pin_count --;
+        }
+        frame.dirty = frame.dirty || dirty;
+    }
+}
+
+bool BufferPool::read(int file_id, long long offset, char * buffer, size_t size) {
+    lock_guard<recursive_mutex> lock(pool_mutex);
+    if (file_id < 0 || file_id >= (int) files.size() || offset + (long long) size > files[file_id].size) {
+        return false;
+    }
+    
+    while (size > 0) {
+        long long page_number = offset / PAGE_BYTES;
+        size_t page_offset = offset % PAGE_BYTES;
+        size_t length = min(size, PAGE_BYTES - page_offset);
+        
+        char * page = pin(file_id, page_number);
+        if (page == NULL) {
+            return false;
+        }
+        memcpy(buffer, page + page_offset, length);
+        unpin(file_id, page_number, false);
+        
+        buffer += length;
+        offset += length;
+        size -= length;
+    }
+    
+    return true;
+}
+
+bool BufferPool::write(int file_id, long long offset, const char * buffer, size_t size) {
+    lock_guard<recursive_mutex> lock(pool_mutex);
+    if (file_id < 0 || file_id >= (int) files.size()) {
+        return false;
+    }
+    
+    if (offset + (long long) size > files[file_id].size) {
+        files[file_id].size = offset + size;
+    }
+    
+    while (size > 0) {
+        long long page_number = offset / PAGE_BYTES;
+        size_t page_offset = offset % PAGE_BYTES;
+        size_t length = min(size, PAGE_BYTES - page_offset);
+        
+        char * page = pin(file_id, page_number);
+        if (page == NULL) {
+            return false;
+        }
+        memcpy(page + page_offset, buffer, length);
+        unpin(file_id, page_number, true);
+        
+        buffer += length;
+        offset += length;
+        size -= length;
+    }
+    
+    return true;
+}
+
+long long BufferPool::getFileSize(int file_id) {
+    lock_guard<recursive_mutex> lock(pool_mutex);
+    if (file_id < 0 || file_id >= (int) files.size()) {
+        return 0;
+    }
+    return files[file_id].size;
+}
+
+void BufferPool::flush(int file_id) {
+    lock_guard<recursive_mutex> lock(pool_mutex);
+    
+    for (vector<Frame>::iterator it = frames.begin(); it != frames.end(); it++) {
+        if ((*it).file_id == file_id) {
+            writeBack(*it);
+        }
+    }
+}
+
+void BufferPool::flushAll() {
+    lock_guard<recursive_mutex> lock(pool_mutex);
+    
+    for (vector<Frame>::iterator it = frames.begin(); it != frames.end(); it++) {
+        writeBack(*it);
+    }
+}
+
+void BufferPool::setMemoryBudget(size_t memory_budget) {
+    lock_guard<recursive_mutex> lock(pool_mutex);
+    
+    max_frames = memory_budget / PAGE_BYTES;
+    if (max_frames == 0) {
+        max_frames = 1;
+    }
+    
+    // Drop the frames above the budget, keeping the pinned ones
+    while (frames.size() > max_frames && frames.back().pin_count == 0) {
+        Frame & frame = frames.back();
+        if (frame.file_id >= 0) {
+            writeBack(frame);
+            page_table.erase(getPageKey(frame.file_id, frame.page_number));
+            evictions ++;
+        }
+        frames.pop_back();
+    }
+    clock_hand = 0;
+}
+
+size_t BufferPool::getMemoryBudget() {
+    return max_frames * PAGE_BYTES;
+}
+
+long long BufferPool::getHits() {
+    return hits;
+}
+
+long long BufferPool::getMisses() {
+    return misses;
+}
+
+long long BufferPool::getEvictions() {
+    return evictions;
+}
+
+long long BufferPool::getWriteBacks() {
+    return write_backs;
+}
+
+double BufferPool::getHitRatio() {
+    if (hits + misses == 0) {
+        return 0;
+    }
+    return (double) hits / (hits + misses);
+}
+
+void BufferPool::resetStatistics() {
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+    write_backs = 0;
+}
+
+#endif //BUFFERPOOL_H
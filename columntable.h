@@ -0,0 +1,504 @@
+#ifndef COLUMNTABLE_H
+#define COLUMNTABLE_H
+
+#include "table.h"
+#include "mappedfile.h"
+
+/**
+ * A table that stores each column on its own file, as a fixed-width array.
+ * It can be used instead of the Table when the queries touch only a few
+ * columns, because reading a column doesn't read the other ones.
+ * e.g.: for the schema | _id:int64 | name:char:255 | age:int32 | the files are
+ * person__id.col  | ID_0 | ID_1 | ID_2 | ...
+ * person_name.col | NAME_0 | NAME_1 | NAME_2 | ...
+ * person_age.col  | AGE_0 | AGE_1 | AGE_2 | ...
+ *
+ * The registry position of a row is its index on the column arrays, so the
+ * value of a column is at registry_position * column_size on the column file.
+ * The choice between the storages is made when the table is created:
+ * Table person("person");       -> one file with all the rows
+ * ColumnTable person("person"); -> one file per column
+ */
+class ColumnTable : public Queryable {
+private:
+    Schema schema;
+    string name;
+    header_t * header; // _id, registry_position
+    
+    vector<MappedFile *> column_files;
+    VarcharHeap varchar_heap; // the VARCHAR values that don't fit on the column
+    vector<Dictionary *> dictionaries; // one per column, NULL if not dictionary encoded
+    vector<const char *> row_columns; // the column pointers of the last RowView
+    
+    /**
+     * @return the path of the file that stores the column
+     */
+    string getColumnPath(int column_position);
+    
+    /**
+     * Create the column maps for the current schema
+     */
+    void loadColumnFiles();
+    
+    /**
+     * Load the table header from the _id column file
+     */
+    void loadHeader();
+    
+    /**
+     * Get the stored value of a column, growing the column map if needed
+     * @return the value or NULL if it's not on the file
+     */
+    const char * getColumnValue(long long registry_position, int column_position);
+    
+public:
+
+    /**
+     * The constructor loads the table header from the memory, if any
+     * @constructor
+     */
+    ColumnTable(string name);
+    
+    /**
+     * @destructor
+     */
+    ~ColumnTable();
+    
+    /**
+     * Import the schema using the Schema standard method
+     */
+    void importSchema(const string & path);
+    
+    /**
+     * Set the schema to be used
+     * @see Schema
+     */
+    void setSchema(Schema schema);
+    
+    Schema getSchema();
+    header_t * getHeader();
+    
+    /*****************************************
+     ************* QUERY METHODS *************
+     *****************************************/
+    
+    /**
+     * Insert a row at the end of the table
+     * @see Table::insert
+     * @return the _id of the inserted item (used as primary key)
+     */
+    long long insert(vector<string> row);
+    
+    /**
+     * Insert many rows at the end of the table. Each column file is opened
+     * only once and written in a single block
+     * @return the _id of the first inserted item
+     */
+    long long insertBatch(vector<vector<string> > & rows);
+    
+    /**
+     * Get a row from the column files, given the registry position
+     * @return a vector containing the _id and the row content
+     */
+    vector<string> getRow(long long registry_position);
+    
+    /**
+     * Get a typed view of a row. The view points to each column file, so only
+     * the columns that are read are touched
+     * @see RowView
+     */
+    RowView getRowView(long long registry_position);
+    
+    /**
+     * Get a row from the column files, given the specified _id
+     */
+    vector<string> getRowById(long long _id);
+    
+    Join join(string this_column, Queryable* other_table, string other_column, JoinType join_type);
+    
+    /**
+     * Get the registry positions where min <= value <= max. Only the column
+     * file is read
+     * @param column_name the name of an INT32, INT64, FOREIGN_KEY, FLOAT or DOUBLE column
+     */
+    vector<long long> * filterRange(string column_name, double min, double max);
+    vector<long long> * filterRange(int column_position, double min, double max);
+    
+    /**
+     * Deletes the table and all its associated files
+     */
+    void drop();
+    
+    /*****************************************
+     ********** CONVENIENCE METHODS **********
+     *****************************************/
+    
+    /**
+     * Read a CSV file, convert and export it to the column files
+     */
+    void convertFromCSV(const string & path);
+    
+    /**
+     * Print the table (for debugging only)
+     * @param number_of_values the number of values to print. If set to -1
+     *        all the table wil be printed
+     */
+    void print(int number_of_values = -1);
+    
+    /**
+     * Gets a column based on the column name, reading only the column file.
+     * The return value contains a vector of "column value" and "registry position" tuples.
+     */
+    vector<pair<string, long long>> *getColumn(string column_name);
+    vector<pair<string, long long>> *getColumn(int column_position);
+    
+    /**
+     * Get the string value of an element of the table
+     */
+    string getValue(long long _id, int column_position);
+    
+    /**
+     * @return the number of rows
+     */
+    int getNumberOfRows();
+    
+    /**
+     * @return the registry position of the row at the index
+     */
+    long long getRegistryPosition(long long index);
+    
+    /**
+     * @return the dictionary of the column or NULL if the column is not
+     *         dictionary encoded
+     */
+    Dictionary * getDictionary(int column_position);
+};
+
+ColumnTable::ColumnTable(string name) {
+    this->name = name;
+    this->header = new header_t();
+    this->varchar_heap.setPath(name + "_v.col");
+    loadColumnFiles();
+    loadHeader();
+}
+
+ColumnTable::~ColumnTable() {
+    Dictionary::closeAll(dictionaries);
+    for (vector<MappedFile *>::iterator it = column_files.begin(); it != column_files.end(); it++) {
+        delete *it;
+    }
+    delete this->header;
+}
+
+string ColumnTable::getColumnPath(int column_position) {
+    return name + "_" + schema.getCols()->at(column_position).key + ".col";
+}
+
+void ColumnTable::loadColumnFiles() {
+    for (vector<MappedFile *>::iterator it = column_files.begin(); it != column_files.end(); it++) {
+        delete *it;
+    }
+    column_files.clear();
+    
+    for (int i = 0; i < schema.getNumberOfCols(); i++) {
+        column_files.push_back(new MappedFile(getColumnPath(i)));
+    }
+    row_columns.resize(schema.getNumberOfCols());
+    Dictionary::openAll(name, schema, dictionaries);
+}
+
+void ColumnTable::loadHeader() {
+    header->clear();
+    
+    // The _id is always the first column
+    ifstream file;
+    file.open(getColumnPath(0).c_str(), ios::binary);
+    
+    long long _id;
+    long long registry_position = 0;
+    while (file.read(reinterpret_cast<char *> (&_id), sizeof(_id))) {
+        header->push_back(pair<long long, long long> (_id, registry_position));
+        registry_position ++;
+    }
+    
+    file.close();
+}
+
+void ColumnTable::importSchema(const string & path) {
+    schema.import(path);
+    loadColumnFiles();
+}
+
+void ColumnTable::setSchema(Schema schema) {
+    this->schema = schema;
+    loadColumnFiles();
+}
+
+Schema ColumnTable::getSchema() {
+    return schema;
+}
+
+header_t * ColumnTable::getHeader() {
+    return header;
+}
+
+long long ColumnTable::insert(vector<string> row) {
+    vector<vector<string> > rows;
+    rows.push_back(row);
+    return insertBatch(rows);
+}
+
+long long ColumnTable::insertBatch(vector<vector<string> > & rows) {
+    vector<SchemaCol>* schema_cols = schema.getCols();
+    long long first_id = header->size();
+    vector<char> buffer;
+    
+    for (int column_position = 0; column_position < (int) schema_cols->size(); column_position++) {
+        SchemaCol * schema_col = &schema_cols->at(column_position);
+        unsigned column_size = schema_col->getSize();
+        
+        //Encode the whole column before writing it
+        buffer.assign(rows.size() * column_size, 0);
+        for (size_t i = 0; i < rows.size(); i++) {
+            char * value = &buffer[i * column_size];
+            if (column_position == 0) {
+                long long _id = first_id + i;
+                memcpy(value, &_id, sizeof(_id));
+            } else if (column_position - 1 < (int) rows.at(i).size()) {
+                Table::convertAndSave(value, &rows.at(i).at(column_position - 1), schema_col,
+                    &varchar_heap, getDictionary(column_position));
+            }
+        }
+        
+        // The new codes are saved before the column refers to them
+        if (getDictionary(column_position) != NULL) {
+            getDictionary(column_position)->save();
+        }
+        
+        ofstream file;
+        file.open(getColumnPath(column_position).c_str(), ios::binary | ios::app);
+        if (!buffer.empty()) {
+            file.write(&buffer[0], buffer.size());
+        }
+        file.close();
+    }
+    varchar_heap.flush();
+    
+    for (size_t i = 0; i < rows.size(); i++) {
+        header->push_back(pair<long long, long long> (first_id + i, first_id + i));
+    }
+    
+    return first_id;
+}
+
+const char * ColumnTable::getColumnValue(long long registry_position, int column_position) {
+    unsigned column_size = schema.getCols()->at(column_position).getSize();
+    MappedFile * column_file = column_files.at(column_position);
+    
+    // Grow the mapping if the value was appended after the last map
+    if (!column_file->map((registry_position + 1) * column_size)) {
+        return NULL;
+    }
+    return column_file->getData() + registry_position * column_size;
+}
+
+vector<string> ColumnTable::getRow(long long registry_position) {
+    vector<SchemaCol>* schema_cols = schema.getCols();
+    vector<string> row;
+    
+    for (int column_position = 0; column_position < (int) schema_cols->size(); column_position++) {
+        const char * value = getColumnValue(registry_position, column_position);
+        if (value == NULL) {
+            row.clear();
+            break;
+        }
+        row.push_back(Table::convertToString(value, &schema_cols->at(column_position), &varchar_heap,
+            getDictionary(column_position)));
+    }
+    
+    return row;
+}
+
+RowView ColumnTable::getRowView(long long registry_position) {
+    for (int column_position = 0; column_position < (int) row_columns.size(); column_position++) {
+        row_columns[column_position] = getColumnValue(registry_position, column_position);
+        if (row_columns[column_position] == NULL) {
+            return RowView();
+        }
+    }
+    
+    return RowView(&schema, &row_columns[0], &varchar_heap, dictionaries.empty() ? NULL : &dictionaries[0]);
+}
+
+vector<string> ColumnTable::getRowById(long long _id) {
+    vector<string> row;
+    long long idx = header->find(_id);
+    if (idx >= 0) {
+        row = getRow(header->getPosition(idx));
+    }
+    return row;
+}
+
+Join ColumnTable::join(string this_column_name, Queryable* other_table, string other_column_name, JoinType join_type) {
+    return Join(this, this_column_name, other_table, other_column_name, join_type);
+}
+
+vector<long long> * ColumnTable::filterRange(string column_name, double min, double max) {
+    return filterRange(schema.getColPosition(column_name), min, max);
+}
+
+vector<long long> * ColumnTable::filterRange(int column_position, double min, double max) {
+    if (column_position < 0) return NULL;
+    
+    vector<long long> * positions = new vector<long long>;
+    SchemaCol & schema_col = schema.getCols()->at(column_position);
+    unsigned column_size = schema_col.getSize();
+    
+    MappedFile * column_file = column_files.at(column_position);
+    long long number_of_rows = header->size();
+    if (number_of_rows == 0 || !column_file->map(number_of_rows * column_size)) {
+        return positions;
+    }
+    
+    //Scan the column array
+    const char * value_ptr = column_file->getData();
+    for (long long registry_position = 0; registry_position < number_of_rows; registry_position++) {
+        double value;
+        if (schema_col.type == INT32) {
+            int int_value;
+            memcpy(&int_value, value_ptr, sizeof(int_value));
+            value = int_value;
+        } else if (schema_col.type == FLOAT) {
+            float float_value;
+            memcpy(&float_value, value_ptr, sizeof(float_value));
+            value = float_value;
+        } else if (schema_col.type == DOUBLE) {
+            memcpy(&value, value_ptr, sizeof(value));
+        } else {
+            long long long_value;
+            memcpy(&long_value, value_ptr, sizeof(long_value));
+            value = long_value;
+        }
+        
+        if (value >= min && value <= max) {
+            positions->push_back(registry_position);
+        }
+        value_ptr += column_size;
+    }
+    
+    return positions;
+}
+
+void ColumnTable::drop() {
+    for (int column_position = 0; column_position < (int) column_files.size(); column_position++) {
+        column_files.at(column_position)->unmap();
+        remove(getColumnPath(column_position).c_str());
+    }
+    varchar_heap.drop();
+    for (vector<Dictionary *>::iterator it = dictionaries.begin(); it != dictionaries.end(); it++) {
+        if (*it != NULL) {
+            (*it)->drop();
+        }
+    }
+    header->clear();
+}
+
+void ColumnTable::convertFromCSV(const string & path) {
+    // Number of rows converted before writing to the column files
+    const int BATCH_SIZE = 65536;
+    string line;
+    
+    ifstream file;
+    file.open(path.c_str());
+    
+    if (file.is_open()) {
+        //Header
+        getline(file, line);
+        
+        //Lines
+        vector<vector<string> > rows;
+        while (getline(file, line)) {
+            rows.push_back(split(line, ','));
+            
+            if (rows.size() == BATCH_SIZE) {
+                insertBatch(rows);
+                rows.clear();
+            }
+        }
+        insertBatch(rows);
+        file.close();
+    } else {
+        cout << "Unable to open file - " << path << endl;
+    }
+}
+
+void ColumnTable::print(int number_of_values) {
+    cout << "Printing " << name << " table" << endl;
+    int counter = 0;
+    while (counter != number_of_values && counter != (int) header->size()) {
+        vector<string> row = getRow(header->at(counter).second);
+        
+        //print the line
+        for (vector<string>::iterator it = row.begin(); it != row.end(); it++) {
+            cout << (*it) << " | ";
+        }
+        
+        counter ++;
+        cout << endl;
+    }
+    cout << endl;
+}
+
+vector<pair<string, long long>> *ColumnTable::getColumn(string column_name) {
+    return getColumn(schema.getColPosition(column_name));
+}
+
+vector<pair<string, long long>> *ColumnTable::getColumn(int column_position) {
+    if (column_position < 0) return NULL;
+    
+    vector<pair<string, long long>> *column = new vector<pair<string, long long>>;
+    SchemaCol * schema_col = &schema.getCols()->at(column_position);
+    
+    for (header_t::iterator it = header->begin(); it != header->end(); it++) {
+        const char * value = getColumnValue(it->second, column_position);
+        if (value != NULL) {
+            column->push_back(make_pair(Table::convertToString(value, schema_col, &varchar_heap, getDictionary(column_position)), it->second));
+        }
+    }
+    
+    return column;
+}
+
+string ColumnTable::getValue(long long _id, int column_position) {
+    string value = "";
+    if (column_position < 0 || column_position >= schema.getNumberOfCols()) {
+        return value;
+    }
+    
+    long long idx = header->find(_id);
+    if (idx >= 0) {
+        const char * stored_value = getColumnValue(header->getPosition(idx), column_position);
+        if (stored_value != NULL) {
+            value = Table::convertToString(stored_value, &schema.getCols()->at(column_position), &varchar_heap,
+                getDictionary(column_position));
+        }
+    }
+    return value;
+}
+
+int ColumnTable::getNumberOfRows() {
+    return header->size();
+}
+
+long long ColumnTable::getRegistryPosition(long long index) {
+    return header->getPosition(index);
+}
+
+Dictionary * ColumnTable::getDictionary(int column_position) {
+    if (column_position < 0 || column_position >= (int) dictionaries.size()) {
+        return NULL;
+    }
+    return dictionaries.at(column_position);
+}
+
+#endif //COLUMNTABLE_H
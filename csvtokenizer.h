@@ -0,0 +1,214 @@
+#ifndef CSVTOKENIZER_H
+#define CSVTOKENIZER_H
+
+#include <string>
+#include <vector>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+/**
+ * A field of a CSV record. The span points to the tokenized buffer, so no
+ * string is created until the value is copied
+ */
+struct FieldSpan {
+    const char * data;
+    size_t length;
+    bool escaped; // the field was quoted and has "" escaped quotes
+    
+    /**
+     * Copy the value to the string, replacing the escaped quotes. The string
+     * capacity is reused, so no memory is allocated for the smaller values
+     */
+    void copyTo(string * value) const;
+};
+
+/**
+ * Splits a whole buffer into records and fields without copying it. The
+ * delimiters and the newlines are found by comparing 32 (AVX2) or 16 (SSE2)
+ * bytes at once, with a scalar fallback.
+ * The quoted fields may contain delimiters, newlines and escaped quotes:
+ * e.g.: 1,"Smith, John","He said ""hi"""\n -> | 1 | Smith, John | He said "hi" |
+ * The carriage return of the CRLF line endings is removed from the last field.
+ * e.g.:
+ * CSVTokenizer tokenizer(buffer, size);
+ * vector<FieldSpan> fields;
+ * while (tokenizer.nextRecord(fields)) { ... }
+ */
+class CSVTokenizer {
+private:
+    const char * position;
+    const char * end;
+    char delimiter;
+    
+    /**
+     * @return the first byte equal to one of the characters or end if there is none
+     */
+    static const char * findAny(const char * begin, const char * end, char first, char second);
+
+public:
+    /**
+     * @param data the buffer, which must be valid while the fields are used
+     * @constructor
+     */
+    CSVTokenizer(const char * data, size_t size, char delimiter = ',');
+    
+    /**
+     * Read the fields of the next record. The vector capacity is reused
+     * @return false if there are no more records
+     */
+    bool nextRecord(vector<FieldSpan> & fields);
+    
+    /**
+     * Get the end of the last complete record, skipping the newlines that are
+     * inside quoted fields. The buffer must start at the beginning of a record
+     * and, as on RFC 4180, the quotes may only be used by the quoted fields
+     * @return the position after the last record newline or string::npos if
+     *         the buffer has no complete record
+     */
+    static size_t findLastRecordEnd(const char * data, size_t size);
+};
+
+void FieldSpan::copyTo(string * value) const {
+    if (!escaped) {
+        value->assign(data, length);
+        return;
+    }
+    
+    value->clear();
+    for (size_t i = 0; i < length; i++) {
+        value->push_back(data[i]);
+        if (data[i] == '"' && i + 1 < length && data[i + 1] == '"') {
+            i++;
+        }
+    }
+}
+
+CSVTokenizer::CSVTokenizer(const char * data, size_t size, char delimiter) {
+    this->position = data;
+    this->end = data + size;
+    this->delimiter = delimiter;
+}
+
+const char * CSVTokenizer::findAny(const char * begin, const char * end, char first, char second) {
+#if defined(__AVX2__)
+    const __m256i first_block = _mm256_set1_epi8(first);
+    const __m256i second_block = _mm256_set1_epi8(second);
+    while (end - begin >= 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *> (begin));
+        unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_cmpeq_epi8(block, first_block), _mm256_cmpeq_epi8(block, second_block)));
+        if (mask != 0) {
+            return begin + __builtin_ctz(mask);
+        }
+        begin += 32;
+    }
+#elif defined(__SSE2__)
+    const __m128i first_block = _mm_set1_epi8(first);
+    const __m128i second_block = _mm_set1_epi8(second);
+    while (end - begin >= 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *> (begin));
+        unsigned mask = _mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi8(block, first_block), _mm_cmpeq_epi8(block, second_block)));
+        if (mask != 0) {
+            return begin + __builtin_ctz(mask);
+        }
+        begin += 16;
+    }
+#endif
+    while (begin < end && *begin != first && *begin != second) {
+        begin++;
+    }
+    return begin;
+}
+
+bool CSVTokenizer::nextRecord(vector<FieldSpan> & fields) {
+    fields.clear();
+    if (position >= end) {
+        return false;
+    }
+    
+    while (true) {
+        FieldSpan field;
+        field.escaped = false;
+    
+        if (*position == '"') {
+            // Quoted field, ends on a quote that is not followed by another one
+            field.data = position + 1;
+            const char * quote = field.data;
+            while (true) {
+                quote = (const char *) memchr(quote, '"', end - quote);
+                if (quote == NULL) {
+                    quote = end;
+                    break;
+                }
+                if (quote + 1 < end && quote[1] == '"') {
+                    field.escaped = true;
+                    quote += 2;
+                    continue;
+                }
+                break;
+            }
+            field.length = quote - field.data;
+    
+            // Anything between the closing quote and the delimiter is ignored
+            position = quote < end ? findAny(quote + 1, end, delimiter, '\n') : end;
+        } else {
+            const char * field_end = findAny(position, end, delimiter, '\n');
+            field.data = position;
+            field.length = field_end - position;
+            if ((field_end == end || *field_end == '\n') && field.length > 0 && field_end[-1] == '\r') {
+                field.length--;
+            }
+            position = field_end;
+        }
+        fields.push_back(field);
+    
+        if (position >= end) {
+            return true;
+        }
+        if (*position == '\n') {
+            position++;
+            return true;
+        }
+    
+        // Delimiter, a field follows it even if the buffer ends
+        position++;
+        if (position >= end) {
+            field.data = position;
+            field.length = 0;
+            field.escaped = false;
+            fields.push_back(field);
+            return true;
+        }
+    }
+}
+
+size_t CSVTokenizer::findLastRecordEnd(const char * data, size_t size) {
+    const char * end = data + size;
+    const char * position = data;
+    const char * record_end = NULL;
+    bool quoted = false;
+    
+    while (true) {
+        position = findAny(position, end, '"', '\n');
+        if (position == end) {
+            break;
+        }
+        if (*position == '"') {
+            // An escaped quote toggles twice
+            quoted = !quoted;
+        } else if (!quoted) {
+            record_end = position + 1;
+        }
+        position++;
+    }
+    
+    return record_end == NULL ? string::npos : record_end - data;
+}
+
+#endif //CSVTOKENIZER_H
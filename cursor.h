@@ -3,24 +3,273 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 
-#include "schema.h"
+#include "rowview.h"
 
 using namespace std;
 
+/**
+ * Produces the rows of a query one at a time, so the result is never
+ * materialized. Each source keeps only the buffer of its current rows.
+ * @see TableScan
+ */
+class RowSource {
+public:
+    virtual ~RowSource() {}
+    
+    /**
+     * Move to the next row of the result
+     * @return false if there are no more rows
+     */
+    virtual bool next() =0;
+    
+    /**
+     * Restart the result from its first row, next() must be called after it
+     */
+    virtual void reset() =0;
+    
+    /**
+     * @return the current row, valid until the next call of next()
+     */
+    virtual RowView & getRowView() =0;
+    
+    /**
+     * @return the value of a column of the current row on the text format
+     */
+    virtual string getString(int column_position) =0;
+    
+    /**
+     * Stop producing rows and release the buffers
+     */
+    virtual void close() =0;
+};
+
+/**
+ * Iterates over the rows of a query result, pulling them from the source
+ * on demand: the rows are read when the cursor moves and only the current
+ * one is kept. The values are read on the binary format by the typed getters
+ * and converted only by getString. The columns are the selected ones, in the
+ * order of the SELECT clause. The copies of a cursor share its source, so
+ * only one of them should be moved.
+ * e.g.:
+ * Cursor cursor = table.query("SELECT name, age WHERE age > 10");
+ * while (cursor.moveToNext()) {
+ *     cout << cursor.getString("name") << " " << cursor.getInteger(1) << endl;
+ * }
+ * cursor.close();
+ */
 class Cursor {
 private:
-    vector<vector <string> >::iterator it;
-    vector<vector <string> > data;
-    Schema schema;
+    shared_ptr<RowSource> source; // NULL for an empty result
+    vector<string> columns;
+    vector<int> column_positions; // the position of every selected column on the row
+    bool started;
+    bool valid; // there is a current row
+    
+    /**
+     * @return the position of the column on the row or -1 if it's not selected
+     *         or there is no current row
+     */
+    int getColumnPosition(int column_index);
     
 public:
-    Cursor(Schema schema, vector<vector <string> > data){};
-    void moveToFirst(){};
-    void moveToNext(){};
-    string getString(string column_name){};
-    string getString(int column_index){};
-    int getColumnIndex(string column_name){};
+    /**
+     * Creates an empty result
+     * @constructor
+     */
+    Cursor();
+    
+    /**
+     * @param source the rows, deleted by the cursor
+     * @param columns the names of the selected columns
+     * @param column_positions the position of each selected column on the rows
+     * @constructor
+     */
+    Cursor(RowSource * source, const vector<string> & columns, const vector<int> & column_positions);
+    
+    /**
+     * Move to the first row, running the query again if it was started
+     * @return false if there are no rows
+     */
+    bool moveToFirst();
+    
+    /**
+     * Move to the next row. The first call moves to the first row
+     * @return false if there are no more rows
+     */
+    bool moveToNext();
+    
+    /**
+     * @return true if the cursor is past the last row
+     */
+    bool isAfterLast();
+    
+    /**
+     * Stop the query before its end, the remaining rows are not read
+     */
+    void close();
+    
+    /**
+     * Count the rows by running the query to its end. The cursor is moved
+     * back to the beginning, so this costs a full query
+     * @return the number of rows
+     */
+    long long getCount();
+    
+    /**
+     * Get a value of the current row
+     * @return the value or an empty string if the column is not selected
+     */
+    string getString(string column_name);
+    string getString(int column_index);
+    
+    /**
+     * Get a value of an integer column of the current row, without converting it
+     * @return the value or 0 if the column is not selected
+     */
+    long long getInteger(string column_name);
+    long long getInteger(int column_index);
+    
+    /**
+     * Get a value of a real column of the current row, without converting it
+     * @return the value or 0 if the column is not selected
+     */
+    double getReal(string column_name);
+    double getReal(int column_index);
+    
+    /**
+     * @return the selected values of the current row
+     */
+    vector<string> getRow();
+    
+    /**
+     * @return the index of the column on the result or -1 if it's not selected
+     */
+    int getColumnIndex(string column_name);
+    
+    /**
+     * @return the names of the selected columns
+     */
+    vector<string> getColumnNames();
 };
 
-#endif //CURSOR_H
\ No newline at end of file
+Cursor::Cursor() {
+    this->started = false;
+    this->valid = false;
+}
+
+Cursor::Cursor(RowSource * source, const vector<string> & columns, const vector<int> & column_positions) {
+    this->source.reset(source);
+    this->columns = columns;
+    this->column_positions = column_positions;
+    this->started = false;
+    this->valid = false;
+}
+
+bool Cursor::moveToFirst() {
+    if (source == NULL) {
+        started = true;
+        return false;
+    }
+    if (started) {
+        source->reset();
+    }
+    started = true;
+    valid = source->next();
+    return valid;
+}
+
+bool Cursor::moveToNext() {
+    if (!started) {
+        return moveToFirst();
+    }
+    if (valid) {
+        valid = source->next();
+    }
+    return valid;
+}
+
+bool Cursor::isAfterLast() {
+    return started && !valid;
+}
+
+void Cursor::close() {
+    if (source != NULL) {
+        source->close();
+    }
+    started = true;
+    valid = false;
+}
+
+long long Cursor::getCount() {
+    long long count = 0;
+    for (bool has_row = moveToFirst(); has_row; has_row = moveToNext()) {
+        count++;
+    }
+    if (source != NULL) {
+        source->reset();
+    }
+    started = false;
+    return count;
+}
+
+int Cursor::getColumnPosition(int column_index) {
+    if (!valid || column_index < 0 || column_index >= (int) column_positions.size()) {
+        return -1;
+    }
+    return column_positions[column_index];
+}
+
+string Cursor::getString(string column_name) {
+    return getString(getColumnIndex(column_name));
+}
+
+string Cursor::getString(int column_index) {
+    int column_position = getColumnPosition(column_index);
+    return column_position < 0 ? "" : source->getString(column_position);
+}
+
+long long Cursor::getInteger(string column_name) {
+    return getInteger(getColumnIndex(column_name));
+}
+
+long long Cursor::getInteger(int column_index) {
+    int column_position = getColumnPosition(column_index);
+    return column_position < 0 ? 0 : source->getRowView().getInteger(column_position);
+}
+
+double Cursor::getReal(string column_name) {
+    return getReal(getColumnIndex(column_name));
+}
+
+double Cursor::getReal(int column_index) {
+    int column_position = getColumnPosition(column_index);
+    return column_position < 0 ? 0 : source->getRowView().getReal(column_position);
+}
+
+vector<string> Cursor::getRow() {
+    vector<string> row;
+    if (valid) {
+        row.reserve(column_positions.size());
+        for (size_t i = 0; i < column_positions.size(); i++) {
+            row.push_back(source->getString(column_positions[i]));
+        }
+    }
+    return row;
+}
+
+int Cursor::getColumnIndex(string column_name) {
+    for (int i = 0; i < (int) columns.size(); i++) {
+        if (columns[i] == column_name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+vector<string> Cursor::getColumnNames() {
+    return columns;
+}
+
+#endif //CURSOR_H
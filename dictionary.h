@@ -0,0 +1,185 @@
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <unordered_map>
+#include <stdio.h>
+#include "schema.h"
+
+using namespace std;
+
+/**
+ * Maps the distinct values of a dictionary encoded column to small integer codes.
+ * The registry stores the code instead of the value, and the dictionary is
+ * persisted next to the table, one value per code:
+ * e.g.: | LENGTH_0 | VALUE_0 | LENGTH_1 | VALUE_1 | ...
+ * The code of a value is its order on the file, so the codes never change and
+ * new values are only appended.
+ * @see SchemaCol::dictionary
+ */
+class Dictionary {
+private:
+    string path;
+    vector<string> values; // code -> value
+    unordered_map<string, int> codes; // value -> code
+    size_t saved_values; // the number of values already on the file
+    
+public:
+    /**
+     * Loads the dictionary file, if any
+     * @constructor
+     */
+    Dictionary(const string & path);
+    
+    /**
+     * Get the code of a value, adding the value if it's new
+     */
+    int encode(const string & value);
+    
+    /**
+     * @return the code of the value or -1 if the value is not on the dictionary
+     */
+    int lookup(const string & value);
+    
+    /**
+     * @return the value of the code or an empty string if the code is invalid
+     */
+    const string & decode(int code);
+    
+    /**
+     * @return the number of distinct values
+     */
+    int getSize();
+    
+    string getPath();
+    
+    /**
+     * Append the new values to the dictionary file
+     */
+    void save();
+    
+    /**
+     * Delete the dictionary file and the values
+     */
+    void drop();
+    
+    /**
+     * Create a dictionary for each dictionary encoded column of the schema. The
+     * other columns get NULL
+     * e.g.: for the table person, the dictionary of the column city is person_city_d.dat
+     */
+    static void openAll(const string & table_name, Schema & schema, vector<Dictionary *> & dictionaries);
+    
+    /**
+     * Save and delete the dictionaries
+     */
+    static void closeAll(vector<Dictionary *> & dictionaries);
+};
+
+Dictionary::Dictionary(const string & path) {
+    this->path = path;
+    
+    ifstream file;
+    file.open(path.c_str(), ios::binary);
+    
+    unsigned length;
+    string value;
+    while (file.read(reinterpret_cast<char *> (&length), sizeof(length))) {
+        value.resize(length);
+        if (length > 0 && !file.read(&value[0], length)) {
+            break;
+        }
+        codes[value] = values.size();
+        values.push_back(value);
+    }
+    saved_values = values.size();
+    
+    file.close();
+}
+
+int Dictionary::encode(const string & value) {
+    unordered_map<string, int>::iterator it = codes.find(value);
+    if (it != codes.end()) {
+        return it->second;
+    }
+    
+    int code = values.size();
+    codes[value] = code;
+    values.push_back(value);
+    return code;
+}
+
+int Dictionary::lookup(const string & value) {
+    unordered_map<string, int>::iterator it = codes.find(value);
+    if (it != codes.end()) {
+        return it->second;
+    }
+    return -1;
+}
+
+const string & Dictionary::decode(int code) {
+    static const string invalid_code = "";
+    if (code < 0 || code >= (int) values.size()) {
+        return invalid_code;
+    }
+    return values[code];
+}
+
+int Dictionary::getSize() {
+    return values.size();
+}
+
+string Dictionary::getPath() {
+    return path;
+}
+
+void Dictionary::save() {
+    if (saved_values == values.size()) {
+        return;
+    }
+    
+    ofstream file;
+    file.open(path.c_str(), ios::binary | ios::app);
+    for (size_t code = saved_values; code < values.size(); code++) {
+        unsigned length = values[code].size();
+        file.write(reinterpret_cast<char *> (&length), sizeof(length));
+        file.write(values[code].c_str(), length);
+    }
+    file.close();
+    
+    saved_values = values.size();
+}
+
+void Dictionary::drop() {
+    remove(path.c_str());
+    values.clear();
+    codes.clear();
+    saved_values = 0;
+}
+
+void Dictionary::openAll(const string & table_name, Schema & schema, vector<Dictionary *> & dictionaries) {
+    closeAll(dictionaries);
+    
+    vector<SchemaCol> * schema_cols = schema.getCols();
+    for (vector<SchemaCol>::iterator it = schema_cols->begin(); it != schema_cols->end(); it++) {
+        if ((*it).dictionary) {
+            dictionaries.push_back(new Dictionary(table_name + "_" + (*it).key + "_d.dat"));
+        } else {
+            dictionaries.push_back(NULL);
+        }
+    }
+}
+
+void Dictionary::closeAll(vector<Dictionary *> & dictionaries) {
+    for (vector<Dictionary *>::iterator it = dictionaries.begin(); it != dictionaries.end(); it++) {
+        if (*it != NULL) {
+            (*it)->save();
+            delete *it;
+        }
+    }
+    dictionaries.clear();
+}
+
+#endif //DICTIONARY_H
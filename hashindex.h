@@ -0,0 +1,457 @@
+#ifndef HASHINDEX_H
+#define HASHINDEX_H
+
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+#define HASH_INDEX_MAGIC "HASHIDX"
+
+/**
+ * An on-disk hash index from a long long key (e.g. the _id) to a long long
+ * value (e.g. the registry position), using extendible hashing. The keys are
+ * kept on buckets of one page, addressed by a directory with the last
+ * GLOBAL_DEPTH bits of the key hash. A full bucket is split in two, moving
+ * only its own keys, and the directory is doubled when the bucket was
+ * addressed by all its bits, so the index grows without rehashing.
+ * The file is mapped on memory and read and written through the map, so
+ * opening it doesn't read the keys and a lookup touches two pages: the
+ * directory entry and the bucket.
+ * e.g.: | HEADER PAGE | BUCKET | BUCKET | DIRECTORY | BUCKET | ... | DIRECTORY |
+ * Only the last directory is used, the older ones are left on the file.
+ * The empty buckets are not merged when the keys are removed
+ */
+class HashIndex {
+public:
+    static const size_t PAGE_SIZE = 4096;
+    static const int MAX_DEPTH = 24; // a directory of 128 MB
+    
+private:
+    struct IndexHeader {
+        char magic[8];
+        int global_depth;
+        int reserved;
+        long long number_of_pages; // the pages used, the file may be larger
+        long long number_of_keys;
+        long long directory_page; // the first page of the directory
+    };
+    
+    struct Entry {
+        long long key;
+        long long value;
+    };
+    
+    struct Bucket {
+        int local_depth; // the number of hash bits shared by the keys
+        int number_of_entries;
+        Entry entries[(PAGE_SIZE - 2 * sizeof(int)) / sizeof(Entry)];
+    };
+    
+    static const int BUCKET_CAPACITY = (PAGE_SIZE - 2 * sizeof(int)) / sizeof(Entry);
+    
+    string path;
+    int fd;
+    char * data;
+    size_t size; // the number of mapped bytes
+    
+    HashIndex(const HashIndex &);
+    HashIndex & operator=(const HashIndex &);
+    
+    /**
+     * Scramble the bits of the key, so the last bits depend on all of them
+     */
+    static unsigned long long hash(long long key);
+    
+    /**
+     * Map the file, growing it to the number of pages if it's smaller
+     * @return false if the file can't be grown or mapped
+     */
+    bool map(long long number_of_pages);
+    
+    void unmap();
+    
+    /**
+     * Write an empty index on the file: the header, one bucket and a
+     * directory with its only entry
+     */
+    void initialize();
+    
+    /**
+     * Reserve pages at the end of the file. The pointers to the map are not
+     * valid after the call
+     * @return the first page or -1 if the file can't be grown
+     */
+    long long allocatePages(long long number_of_pages);
+    
+    IndexHeader * getHeader();
+    long long * getDirectory();
+    Bucket * getBucket(long long page);
+    
+    /**
+     * @return the page of the bucket of the hash
+     */
+    long long findBucketPage(unsigned long long key_hash);
+    
+    /**
+     * Double the directory, each bucket gets twice the entries
+     */
+    bool doubleDirectory();
+    
+    /**
+     * Move the keys of the bucket whose next hash bit is set to a new bucket
+     */
+    bool splitBucket(long long page, unsigned long long key_hash);
+    
+public:
+    /**
+     * Maps the index file, creating it if it doesn't exist
+     * @constructor
+     */
+    HashIndex(const string & path);
+    
+    /**
+     * Unmaps the file
+     * @destructor
+     */
+    ~HashIndex();
+    
+    /**
+     * Add the key or replace its value
+     * @return false if the file can't be grown
+     */
+    bool insert(long long key, long long value);
+    
+    /**
+     * @return false if the key is not on the index
+     */
+    bool find(long long key, long long * value);
+    
+    /**
+     * @return false if the key is not on the index
+     */
+    bool remove(long long key);
+    
+    long long getNumberOfKeys();
+    long long getNumberOfBuckets();
+    int getGlobalDepth();
+    
+    /**
+     * @return the bytes used on the file
+     */
+    long long getSize();
+    
+    string getPath();
+    
+    /**
+     * Remove all the keys and shrink the file
+     */
+    void clear();
+    
+    /**
+     * Write the changed pages to the disk
+     */
+    void sync();
+    
+    /**
+     * Delete the index file
+     */
+    void drop();
+};
+
+const size_t HashIndex::PAGE_SIZE;
+const int HashIndex::MAX_DEPTH;
+const int HashIndex::BUCKET_CAPACITY;
+
+HashIndex::HashIndex(const string & path) {
+    this->path = path;
+    this->data = NULL;
+    this->size = 0;
+    
+    fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        cout << "Unable to open file - " << path << endl;
+        return;
+    }
+    
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size < (off_t) PAGE_SIZE || !map(file_stat.st_size / PAGE_SIZE) ||
+        strncmp(getHeader()->magic, HASH_INDEX_MAGIC, sizeof(getHeader()->magic)) != 0) {
+        initialize();
+    }
+}
+
+HashIndex::~HashIndex() {
+    unmap();
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+unsigned long long HashIndex::hash(long long key) {
+    // splitmix64 finalizer
+    unsigned long long value = (unsigned long long) key;
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
+
+bool HashIndex::map(long long number_of_pages) {
+    size_t new_size = number_of_pages * PAGE_SIZE;
+    if (data != NULL && size >= new_size) {
+        return true;
+    }
+    
+    struct stat file_stat;
+    if (fd < 0 || fstat(fd, &file_stat) != 0) {
+        return false;
+    }
+    if ((size_t) file_stat.st_size < new_size && ftruncate(fd, new_size) != 0) {
+        return false;
+    }
+    new_size = max(new_size, (size_t) file_stat.st_size);
+    
+    unmap();
+    void * mapped_data = mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped_data == MAP_FAILED) {
+        return false;
+    }
+    data = static_cast<char *> (mapped_data);
+    size = new_size;
+    return true;
+}
+
+void HashIndex::unmap() {
+    if (data != NULL) {
+        munmap(data, size);
+        data = NULL;
+        size = 0;
+    }
+}
+
+void HashIndex::initialize() {
+    unmap();
+    if (fd < 0 || ftruncate(fd, 0) != 0 || !map(3)) {
+        cout << "Unable to write file - " << path << endl;
+        return;
+    }
+    memset(data, 0, size);
+    
+    IndexHeader * header = getHeader();
+    strncpy(header->magic, HASH_INDEX_MAGIC, sizeof(header->magic));
+    header->global_depth = 0;
+    header->number_of_pages = 3;
+    header->number_of_keys = 0;
+    header->directory_page = 2;
+    getDirectory()[0] = 1;
+}
+
+long long HashIndex::allocatePages(long long number_of_pages) {
+    long long first_page = getHeader()->number_of_pages;
+    long long used_pages = first_page + number_of_pages;
+    
+    // The file grows by doubling, so the map is rarely remapped
+    if (used_pages * PAGE_SIZE > size && !map(max(used_pages, (long long) (2 * size / PAGE_SIZE)))) {
+        return -1;
+    }
+    getHeader()->number_of_pages = used_pages;
+    return first_page;
+}
+
+HashIndex::IndexHeader * HashIndex::getHeader() {
+    return reinterpret_cast<IndexHeader *> (data);
+}
+
+long long * HashIndex::getDirectory() {
+    return reinterpret_cast<long long *> (data + getHeader()->directory_page * PAGE_SIZE);
+}
+
+HashIndex::Bucket * HashIndex::getBucket(long long page) {
+    return reinterpret_cast<Bucket *> (data + page * PAGE_SIZE);
+}
+
+long long HashIndex::findBucketPage(unsigned long long key_hash) {
+    unsigned long long mask = (1ULL << getHeader()->global_depth) - 1;
+    return getDirectory()[key_hash & mask];
+}
+
+bool HashIndex::doubleDirectory() {
+    int global_depth = getHeader()->global_depth;
+    if (global_depth >= MAX_DEPTH) {
+        return false;
+    }
+    
+    long long directory_size = 1LL << global_depth;
+    long long pages = (2 * directory_size * sizeof(long long) + PAGE_SIZE - 1) / PAGE_SIZE;
+    long long new_directory_page = allocatePages(pages);
+    if (new_directory_page < 0) {
+        return false;
+    }
+    
+    // The new half addresses the same buckets, they differ on the new bit only
+    long long * old_directory = getDirectory();
+    long long * new_directory = reinterpret_cast<long long *> (data + new_directory_page * PAGE_SIZE);
+    memcpy(new_directory, old_directory, directory_size * sizeof(long long));
+    memcpy(new_directory + directory_size, old_directory, directory_size * sizeof(long long));
+    
+    getHeader()->directory_page = new_directory_page;
+    getHeader()->global_depth ++;
+    return true;
+}
+
+bool HashIndex::splitBucket(long long page, unsigned long long key_hash) {
+    if (getBucket(page)->local_depth == getHeader()->global_depth && !doubleDirectory()) {
+        return false;
+    }
+    long long new_page = allocatePages(1);
+    if (new_page < 0) {
+        return false;
+    }
+    
+    Bucket * bucket = getBucket(page);
+    Bucket * new_bucket = getBucket(new_page);
+    int local_depth = bucket->local_depth;
+    unsigned long long split_bit = 1ULL << local_depth;
+    
+    int kept_entries = 0;
+    new_bucket->number_of_entries = 0;
+    for (int i = 0; i < bucket->number_of_entries; i++) {
+        if (hash(bucket->entries[i].key) & split_bit) {
+            new_bucket->entries[new_bucket->number_of_entries ++] = bucket->entries[i];
+        } else {
+            bucket->entries[kept_entries ++] = bucket->entries[i];
+        }
+    }
+    bucket->number_of_entries = kept_entries;
+    bucket->local_depth = local_depth + 1;
+    new_bucket->local_depth = local_depth + 1;
+    
+    // The directory entries of the bucket share its last local_depth bits,
+    // the ones with the split bit set address the new bucket
+    long long * directory = getDirectory();
+    long long directory_size = 1LL << getHeader()->global_depth;
+    for (long long i = (key_hash & (split_bit - 1)) | split_bit; i < directory_size; i += 2 * split_bit) {
+        directory[i] = new_page;
+    }
+    return true;
+}
+
+bool HashIndex::insert(long long key, long long value) {
+    if (data == NULL) {
+        return false;
+    }
+    unsigned long long key_hash = hash(key);
+    
+    while (true) {
+        long long page = findBucketPage(key_hash);
+        Bucket * bucket = getBucket(page);
+        for (int i = 0; i < bucket->number_of_entries; i++) {
+            if (bucket->entries[i].key == key) {
+                bucket->entries[i].value = value;
+                return true;
+            }
+        }
+    
+        if (bucket->number_of_entries < BUCKET_CAPACITY) {
+            bucket->entries[bucket->number_of_entries].key = key;
+            bucket->entries[bucket->number_of_entries].value = value;
+            bucket->number_of_entries ++;
+            getHeader()->number_of_keys ++;
+            return true;
+        }
+    
+        if (!splitBucket(page, key_hash)) {
+            return false;
+        }
+    }
+}
+
+bool HashIndex::find(long long key, long long * value) {
+    if (data == NULL) {
+        return false;
+    }
+    Bucket * bucket = getBucket(findBucketPage(hash(key)));
+    for (int i = 0; i < bucket->number_of_entries; i++) {
+        if (bucket->entries[i].key == key) {
+            *value = bucket->entries[i].value;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HashIndex::remove(long long key) {
+    if (data == NULL) {
+        return false;
+    }
+    Bucket * bucket = getBucket(findBucketPage(hash(key)));
+    for (int i = 0; i < bucket->number_of_entries; i++) {
+        if (bucket->entries[i].key == key) {
+            bucket->entries[i] = bucket->entries[bucket->number_of_entries - 1];
+            bucket->number_of_entries --;
+            getHeader()->number_of_keys --;
+            return true;
+        }
+    }
+    return false;
+}
+
+long long HashIndex::getNumberOfKeys() {
+    return data == NULL ? 0 : getHeader()->number_of_keys;
+}
+
+long long HashIndex::getNumberOfBuckets() {
+    if (data == NULL) {
+        return 0;
+    }
+    
+    // The buckets are the pages that are not the header or a directory
+    long long directory_pages = 0;
+    for (int depth = 0; depth <= getHeader()->global_depth; depth++) {
+        directory_pages += ((1LL << depth) * sizeof(long long) + PAGE_SIZE - 1) / PAGE_SIZE;
+    }
+    return getHeader()->number_of_pages - 1 - directory_pages;
+}
+
+int HashIndex::getGlobalDepth() {
+    return data == NULL ? 0 : getHeader()->global_depth;
+}
+
+long long HashIndex::getSize() {
+    return data == NULL ? 0 : getHeader()->number_of_pages * PAGE_SIZE;
+}
+
+string HashIndex::getPath() {
+    return path;
+}
+
+void HashIndex::clear() {
+    initialize();
+}
+
+void HashIndex::sync() {
+    if (data != NULL) {
+        msync(data, size, MS_SYNC);
+    }
+}
+
+void HashIndex::drop() {
+    unmap();
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    ::remove(path.c_str());
+}
+
+#endif //HASHINDEX_H
@@ -5,6 +5,8 @@
 #include "schema.h"
 #include "cursor.h"
 #include "queryable.h"
+#include "numericcodec.h"
+#include <unordered_map>
 
 //Possible types of join
 enum JoinType { NESTED_LOOP, NESTED, MERGE, HASH };
@@ -16,10 +18,31 @@ private:
     vector<vector<long long>> * join_result; // this structure will hold all registries' positions matched from all tables involved.
 
     /**
-     * Performs the Nested Index Join. This method is called inside the constructor
+     * Performs the Nested Loop Join. This method is called inside the constructor.
+     * If the other column has an index that compares the values as the string
+     * comparison does, the inner loop is an index lookup
      */
     void nestedLoopJoin(Queryable *this_table, int this_column_position, Queryable* other_table, int other_column_position);
     
+    /**
+     * Performs the Nested Index Join: the rows of the outer table are looked up
+     * on the index of the inner column. The index of the other column is used,
+     * otherwise the index of this column. Without any index, the Hash Join is
+     * performed instead
+     */
+    void nestedIndexJoin(Queryable *this_table, int this_column_position, Queryable* other_table, int other_column_position);
+    
+    /**
+     * Performs the Nested Index Join comparing the column values as KeyType.
+     * The rows found on the index are read to check their values
+     * @param inner_index the index of the inner column, its keys must have the KeyType
+     * @param outer_first true if the outer registry position comes first on
+     *        the join result
+     */
+    template <typename KeyType>
+    void indexJoinOn(Queryable *outer_table, int outer_column_position, Queryable* inner_table, int inner_column_position,
+        SecondaryIndex * inner_index, bool outer_first);
+    
     /**
      * Performs a merge between this table and a table passed as argument
      * @param other_table an object that represents the other table
@@ -35,6 +58,52 @@ private:
       * Performs the Hash Join algorithm
       */
      void hashJoin(Queryable *this_table, int this_column_position, Queryable* other_table, int other_column_position);
+     
+     /**
+      * Performs the Hash Join algorithm comparing the column values as KeyType.
+      * The values are read from the RowView, without the string conversion
+      * @param bloom_filter the filter of the build column, if its values are
+      *        hashed as KeyType. The probe values it rejects skip the hash table
+      */
+     template <typename KeyType>
+     void hashJoinOn(Queryable *build_table, int build_table_column_position, Queryable* probe_table, int probe_table_column_position,
+         ColumnBloomFilter * bloom_filter);
+     
+     /**
+      * Performs the Hash Join when the build column is dictionary encoded. The
+      * codes are small and dense, so the hash table is a vector indexed by the
+      * code, and the probe values are converted to build codes instead of
+      * comparing strings. A dictionary encoded probe column is converted once
+      * per distinct value
+      */
+     void hashJoinOnCodes(Queryable *build_table, int build_table_column_position, Queryable* probe_table, int probe_table_column_position);
+     
+     /**
+      * Performs the merge comparing the column values as KeyType
+      * @see Join::mergeJoin
+      */
+     template <typename KeyType>
+     void mergeJoinOn(Queryable *this_table, int this_column_position, Queryable* other_table, int other_column_position);
+     
+     /**
+      * Gets a column as "column value" and "registry position" tuples, reading the
+      * values as KeyType
+      */
+     template <typename KeyType>
+     vector<pair<KeyType, long long> > * getKeyColumn(Queryable *table, int column_position);
+     
+     /**
+      * Read a column value from the row as the key type
+      */
+     static void readKey(RowView & row, int column_position, long long * key);
+     static void readKey(RowView & row, int column_position, double * key);
+     static void readKey(RowView & row, int column_position, string * key);
+     
+     /**
+      * Get the type used to compare two columns: 0 for integers, 1 for reals and
+      * 2 for strings. Columns of different types are compared as strings
+      */
+     static int getKeyCategory(Queryable *this_table, int this_column_position, Queryable* other_table, int other_column_position);
     
 public:
 
@@ -68,78 +137,322 @@ public:
      *        all the file wil be printed
      */
     void print(int number_of_values = -1);
+    
+    /**
+     * @return the number of matched rows
+     */
+    int getNumberOfRows();
 };
 
 void Join::nestedLoopJoin(Queryable *this_table, int this_column_position, Queryable* other_table, int other_column_position) {
+    // The reals are formatted before the comparison, so -0 and 0 are different
+    // values, but not on the index
+    SecondaryIndex * other_index = other_table->getIndex(other_column_position);
+    int key_category = getKeyCategory(this_table, this_column_position, other_table, other_column_position);
+    if (other_index != NULL && key_category != 1 &&
+        SecondaryIndex::getKeyCategory(other_table->getSchema().getCols()->at(other_column_position)) == key_category) {
+        if (key_category == 0) {
+            indexJoinOn<long long>(this_table, this_column_position, other_table, other_column_position, other_index, true);
+        } else {
+            indexJoinOn<string>(this_table, this_column_position, other_table, other_column_position, other_index, true);
+        }
+        return;
+    }
+    
     int counter = 0;
 
-    while (counter != this_table->getHeader()->size()) { // Iterate over all of this table
+    while (counter != this_table->getNumberOfRows()) { // Iterate over all of this table
         
-        vector<string> this_row = this_table->getRow(this_table->getHeader()->at(counter).second);
+        vector<string> this_row = this_table->getRow(this_table->getRegistryPosition(counter));
+        if (this_row.empty()) { // removed row
+            counter ++;
+            continue;
+        }
 
         // for each Row in this table, search for all matches in the other table
-        for(int i=0; i < other_table->getHeader()->size(); i++){
-            vector<string> other_row = other_table->getRow(other_table->getHeader()->at(i).second);
+        for(int i=0; i < other_table->getNumberOfRows(); i++){
+            vector<string> other_row = other_table->getRow(other_table->getRegistryPosition(i));
+            if (other_row.empty()) {
+                continue;
+            }
         
             if(this_row.at(this_column_position) == other_row.at(other_column_position)){
                 //When matched, insert the registries position into the vector to be returned
                 vector<long long> join_row;
 
                 //get both registries positions
-                join_row.push_back(this_table->getHeader()->at(counter).second);
-                join_row.push_back(other_table->getHeader()->at(i).second);
+                join_row.push_back(this_table->getRegistryPosition(counter));
+                join_row.push_back(other_table->getRegistryPosition(i));
                 this->join_result->push_back(join_row);
 
-                // cout << "insterted " << this_table->getHeader()->at(counter).second << " and " << other_table->getHeader()->at(i).second << endl;
-                //For debugging purpose, cout << "insterted "<< this_table->getHeader()->at(counter).second<< " and " << other_table->getHeader()->at(i).second << endl;
+                // cout << "insterted " << this_table->getRegistryPosition(counter) << " and " << other_table->getRegistryPosition(i) << endl;
+                //For debugging purpose, cout << "insterted "<< this_table->getRegistryPosition(counter)<< " and " << other_table->getRegistryPosition(i) << endl;
             }
         }
         counter ++;
     }
 }
 
-void Join::hashJoin(Queryable *build_table, int build_table_column_position, Queryable* probe_table, int probe_table_column_position) {
+template <typename KeyType>
+void Join::indexJoinOn(Queryable *outer_table, int outer_column_position, Queryable* inner_table, int inner_column_position,
+        SecondaryIndex * inner_index, bool outer_first) {
+    KeyType outer_value;
+    KeyType inner_value;
+    
+    long long outer_rows = outer_table->getNumberOfRows();
+    for (long long index = 0; index < outer_rows; index++) {
+        long long outer_position = outer_table->getRegistryPosition(index);
+        RowView outer_row = outer_table->getRowView(outer_position);
+        if (!outer_row.isValid()) {
+            continue;
+        }
+        readKey(outer_row, outer_column_position, &outer_value);
+        
+        vector<long long> * inner_positions = inner_index->find(outer_value);
+        for (vector<long long>::iterator it = inner_positions->begin(); it != inner_positions->end(); it++) {
+            // The index may have removed rows, old values and string prefixes
+            RowView inner_row = inner_table->getRowView(*it);
+            if (!inner_row.isValid()) {
+                continue;
+            }
+            readKey(inner_row, inner_column_position, &inner_value);
+            if (inner_value != outer_value) {
+                continue;
+            }
+            
+            if (outer_first) {
+                this->join_result->push_back({outer_position, *it});
+            } else {
+                this->join_result->push_back({*it, outer_position});
+            }
+        }
+        delete inner_positions;
+    }
+}
+
+void Join::nestedIndexJoin(Queryable *this_table, int this_column_position, Queryable* other_table, int other_column_position) {
+    int key_category = getKeyCategory(this_table, this_column_position, other_table, other_column_position);
+    
+    // The index keys have the type of their column, so they can't be used
+    // when the values are compared as another type
+    Queryable * outer_table = this_table;
+    int outer_column_position = this_column_position;
+    Queryable * inner_table = other_table;
+    int inner_column_position = other_column_position;
+    bool outer_first = true;
+    
+    SecondaryIndex * inner_index = other_table->getIndex(other_column_position);
+    if (inner_index == NULL ||
+        SecondaryIndex::getKeyCategory(other_table->getSchema().getCols()->at(other_column_position)) != key_category) {
+        inner_index = this_table->getIndex(this_column_position);
+        if (inner_index == NULL ||
+            SecondaryIndex::getKeyCategory(this_table->getSchema().getCols()->at(this_column_position)) != key_category) {
+            hashJoin(this_table, this_column_position, other_table, other_column_position);
+            return;
+        }
+        outer_table = other_table;
+        outer_column_position = other_column_position;
+        inner_table = this_table;
+        inner_column_position = this_column_position;
+        outer_first = false;
+    }
+    
+    switch (key_category) {
+        case 0: indexJoinOn<long long>(outer_table, outer_column_position, inner_table, inner_column_position, inner_index, outer_first); break;
+        case 1: indexJoinOn<double>(outer_table, outer_column_position, inner_table, inner_column_position, inner_index, outer_first); break;
+        default: indexJoinOn<string>(outer_table, outer_column_position, inner_table, inner_column_position, inner_index, outer_first); break;
+    }
+}
+
+void Join::readKey(RowView & row, int column_position, long long * key) {
+    *key = row.getInteger(column_position);
+}
+
+void Join::readKey(RowView & row, int column_position, double * key) {
+    *key = row.getReal(column_position);
+}
+
+void Join::readKey(RowView & row, int column_position, string * key) {
+    SchemaCol & schema_col = row.getSchema()->getCols()->at(column_position);
+    if (schema_col.isString()) {
+        key->assign(row.getChars(column_position), row.getCharsLength(column_position));
+    } else if (schema_col.isInteger()) {
+        char number[NumericCodec::MAX_LENGTH];
+        key->assign(number, NumericCodec::formatInteger(row.getInteger(column_position), number));
+    } else {
+        char number[NumericCodec::MAX_LENGTH];
+        key->assign(number, NumericCodec::formatReal(row.getReal(column_position), number));
+    }
+}
+
+int Join::getKeyCategory(Queryable *this_table, int this_column_position, Queryable* other_table, int other_column_position) {
+    SchemaCol this_col = this_table->getSchema().getCols()->at(this_column_position);
+    SchemaCol other_col = other_table->getSchema().getCols()->at(other_column_position);
+    
+    if (this_col.isInteger() && other_col.isInteger()) {
+        return 0;
+    } else if (this_col.isReal() && other_col.isReal()) {
+        return 1;
+    }
+    return 2;
+}
+
+template <typename KeyType>
+void Join::hashJoinOn(Queryable *build_table, int build_table_column_position, Queryable* probe_table, int probe_table_column_position,
+        ColumnBloomFilter * bloom_filter) {
     // Key: column, value: header registry position
-    map<string, long long> hash_table;
+    unordered_map<KeyType, long long> hash_table;
+    KeyType column_value;
     
     //Fill the hash table
-    header_t* hash_header = build_table->getHeader();
+    long long build_rows = build_table->getNumberOfRows();
+    hash_table.reserve(build_rows);
     
-    for (header_t::iterator it = hash_header->begin(); it != hash_header->end(); it++) {
-        string column_value = build_table->getValue(it->first, build_table_column_position);
-        long long registry_position = it->second;
+    for (long long index = 0; index < build_rows; index++) {
+        long long registry_position = build_table->getRegistryPosition(index);
+        RowView row = build_table->getRowView(registry_position);
+        if (!row.isValid()) {
+            continue;
+        }
+        readKey(row, build_table_column_position, &column_value);
         
-        hash_table.insert(pair<string, long long>(column_value, registry_position));
+        hash_table.insert(pair<KeyType, long long>(column_value, registry_position));
     }
     
     // Iterate over the probe table
-    header_t* probe_header = probe_table->getHeader();
+    long long probe_rows = probe_table->getNumberOfRows();
     
-    for (header_t::iterator it = probe_header->begin(); it != probe_header->end(); it++) {
-        string column_value = probe_table->getValue(it->first, probe_table_column_position);
+    for (long long index = 0; index < probe_rows; index++) {
+        long long registry_position = probe_table->getRegistryPosition(index);
+        RowView row = probe_table->getRowView(registry_position);
+        if (!row.isValid()) {
+            continue;
+        }
+        readKey(row, probe_table_column_position, &column_value);
+        
+        if (bloom_filter != NULL && !bloom_filter->mayContain(ColumnBloomFilter::hashKey(column_value))) {
+            continue;
+        }
         
-        map<string, long long>:: iterator hash_it = hash_table.find(column_value);
+        typename unordered_map<KeyType, long long>::iterator hash_it = hash_table.find(column_value);
         if (hash_it != hash_table.end()) {
             // Found it
             // cout << "Found " << column_value << endl;
-            this->join_result->push_back({hash_it->second, it->second});
+            this->join_result->push_back({hash_it->second, registry_position});
+        } else if (bloom_filter != NULL) {
+            bloom_filter->recordFalsePositive();
         }
     }
 }
 
-void Join::mergeJoin(Queryable *this_table, int this_column_position, Queryable* other_table, int other_column_position) {
+void Join::hashJoinOnCodes(Queryable *build_table, int build_table_column_position, Queryable* probe_table, int probe_table_column_position) {
+    Dictionary * build_dictionary = build_table->getDictionary(build_table_column_position);
+    Dictionary * probe_dictionary = probe_table->getDictionary(probe_table_column_position);
+    
+    // Key: build code, value: registry position or -1 if no row has the code
+    vector<long long> hash_table(build_dictionary->getSize(), -1);
+    
+    //Fill the hash table
+    long long build_rows = build_table->getNumberOfRows();
+    for (long long index = 0; index < build_rows; index++) {
+        long long registry_position = build_table->getRegistryPosition(index);
+        RowView row = build_table->getRowView(registry_position);
+        if (!row.isValid()) {
+            continue;
+        }
+        
+        int code = row.getCode(build_table_column_position);
+        if (code >= 0 && code < (int) hash_table.size() && hash_table[code] == -1) {
+            hash_table[code] = registry_position;
+        }
+    }
+    
+    // Probe code -> build code, or -1 if the value is not on the build dictionary
+    vector<int> code_translation;
+    if (probe_dictionary != NULL) {
+        code_translation.resize(probe_dictionary->getSize());
+        for (int code = 0; code < (int) code_translation.size(); code++) {
+            code_translation[code] = build_dictionary->lookup(probe_dictionary->decode(code));
+        }
+    }
+    
+    // Iterate over the probe table
+    string column_value;
+    long long probe_rows = probe_table->getNumberOfRows();
+    
+    for (long long index = 0; index < probe_rows; index++) {
+        long long registry_position = probe_table->getRegistryPosition(index);
+        RowView row = probe_table->getRowView(registry_position);
+        if (!row.isValid()) {
+            continue;
+        }
+        
+        int build_code = -1;
+        if (probe_dictionary != NULL) {
+            int probe_code = row.getCode(probe_table_column_position);
+            if (probe_code >= 0 && probe_code < (int) code_translation.size()) {
+                build_code = code_translation[probe_code];
+            }
+        } else {
+            readKey(row, probe_table_column_position, &column_value);
+            build_code = build_dictionary->lookup(column_value);
+        }
+        
+        if (build_code >= 0 && hash_table[build_code] != -1) {
+            this->join_result->push_back({hash_table[build_code], registry_position});
+        }
+    }
+}
+
+void Join::hashJoin(Queryable *build_table, int build_table_column_position, Queryable* probe_table, int probe_table_column_position) {
+    if (build_table->getDictionary(build_table_column_position) != NULL) {
+        hashJoinOnCodes(build_table, build_table_column_position, probe_table, probe_table_column_position);
+        return;
+    }
+    
+    int key_category = getKeyCategory(build_table, build_table_column_position, probe_table, probe_table_column_position);
+    
+    // The filter hashes the values by the build column type, so it can't be
+    // used when the keys are compared as another type
+    ColumnBloomFilter * bloom_filter = NULL;
+    if (getKeyCategory(build_table, build_table_column_position, build_table, build_table_column_position) == key_category) {
+        bloom_filter = build_table->getBloomFilter(build_table_column_position);
+    }
+    
+    switch (key_category) {
+        case 0: hashJoinOn<long long>(build_table, build_table_column_position, probe_table, probe_table_column_position, bloom_filter); break;
+        case 1: hashJoinOn<double>(build_table, build_table_column_position, probe_table, probe_table_column_position, bloom_filter); break;
+        default: hashJoinOn<string>(build_table, build_table_column_position, probe_table, probe_table_column_position, bloom_filter); break;
+    }
+}
+
+template <typename KeyType>
+vector<pair<KeyType, long long> > * Join::getKeyColumn(Queryable *table, int column_position) {
+    vector<pair<KeyType, long long> > * column = new vector<pair<KeyType, long long> >;
+    long long number_of_rows = table->getNumberOfRows();
+    column->reserve(number_of_rows);
+    
+    KeyType column_value;
+    for (long long index = 0; index < number_of_rows; index++) {
+        long long registry_position = table->getRegistryPosition(index);
+        RowView row = table->getRowView(registry_position);
+        if (row.isValid()) {
+            readKey(row, column_position, &column_value);
+            column->push_back(make_pair(column_value, registry_position));
+        }
+    }
+    
+    return column;
+}
+
+template <typename KeyType>
+void Join::mergeJoinOn(Queryable *this_table, int this_column_position, Queryable* other_table, int other_column_position) {
     // cout << "Start merge join" << endl;
-    vector<pair<string, long long>> *table_a = this_table->getColumn(this_column_position);
-    vector<pair<string, long long>> *table_b = other_table->getColumn(other_column_position);
+    vector<pair<KeyType, long long>> *table_a = getKeyColumn<KeyType>(this_table, this_column_position);
+    vector<pair<KeyType, long long>> *table_b = getKeyColumn<KeyType>(other_table, other_column_position);
     // cout << "Start sort on merge join" << endl;
-    sort(table_a->begin(), table_a->end(),
-        [](const pair<string, long long> &left, const pair<string, long long> &right){
-            return left.first.compare(right.first) <= 0;
-        });
-    sort(table_b->begin(), table_b->end(),
-        [](const pair<string, long long> &left, const pair<string, long long> &right){
-            return left.first.compare(right.first) <= 0;
-        });
+    sort(table_a->begin(), table_a->end());
+    sort(table_b->begin(), table_b->end());
     // cout << "End sort on merge join" << endl;
 
     int n = table_a->size();
@@ -150,16 +463,16 @@ void Join::mergeJoin(Queryable *this_table, int this_column_position, Queryable*
 
     // cout << "Start loop on merge join" << endl;
     while(i < n and j < m){ 
-        if(table_a->at(i).first.compare(table_b->at(j).first) > 0) {
+        if(table_b->at(j).first < table_a->at(i).first) {
             j++;
-        } else if(table_a->at(i).first.compare(table_b->at(j).first) < 0) {
+        } else if(table_a->at(i).first < table_b->at(j).first) {
             i++;
         } else {
             l = i;
 
-            while(l < n and table_a->at(l).first.compare(table_a->at(i).first) == 0) {
+            while(l < n and table_a->at(l).first == table_a->at(i).first) {
                 k = j;
-                while(k < m and table_b->at(k).first.compare(table_b->at(j).first) == 0) {
+                while(k < m and table_b->at(k).first == table_b->at(j).first) {
                     this->join_result->push_back({table_a->at(l).second, table_b->at(k).second});
                     k++;
                 }   
@@ -178,6 +491,14 @@ void Join::mergeJoin(Queryable *this_table, int this_column_position, Queryable*
     // cout << "End merge join" << endl;
 }
 
+void Join::mergeJoin(Queryable *this_table, int this_column_position, Queryable* other_table, int other_column_position) {
+    switch (getKeyCategory(this_table, this_column_position, other_table, other_column_position)) {
+        case 0: mergeJoinOn<long long>(this_table, this_column_position, other_table, other_column_position); break;
+        case 1: mergeJoinOn<double>(this_table, this_column_position, other_table, other_column_position); break;
+        default: mergeJoinOn<string>(this_table, this_column_position, other_table, other_column_position); break;
+    }
+}
+
 Join::Join(Queryable *this_table, string this_column_name, Queryable* other_table, string other_column_name, JoinType join_type) {
     this->join_result = new vector<vector<long long>>;
 
@@ -191,23 +512,33 @@ Join::Join(Queryable *this_table, string this_column_name, Queryable* other_tabl
     
     switch(join_type) {
         case NESTED_LOOP  : nestedLoopJoin(this_table, this_column_position, other_table, other_column_position); break;
-        case NESTED  : break; // TODO
+        case NESTED  : nestedIndexJoin(this_table, this_column_position, other_table, other_column_position); break;
         case HASH  : hashJoin(this_table, this_column_position, other_table, other_column_position); break;
         case MERGE  : mergeJoin(this_table, this_column_position, other_table, other_column_position); break;
     }
 }
 
 void Join::print(int number_of_values) {
+    int number_of_lines = join_result->size();
+    if (number_of_values >= 0 && number_of_values < number_of_lines) {
+        number_of_lines = number_of_values;
+    }
     
-    for(int line=0; line < join_result->size(); line++){ //iterate over the whole matcheds registries postions
-        if(line==number_of_values) break;
-
+    // Fetch the rows of each table at once
+    vector<vector<vector<string> > > table_rows;
+    for (int table_order = 0; table_order < (int) tables.size(); table_order++) {
+        vector<long long> registry_positions(number_of_lines);
+        for (int line = 0; line < number_of_lines; line++) {
+            registry_positions[line] = join_result->at(line).at(table_order);
+        }
+        table_rows.push_back(tables.at(table_order)->getRows(registry_positions));
+    }
+    
+    for(int line=0; line < number_of_lines; line++){ //iterate over the whole matcheds registries postions
         for(int table_order=0; table_order<tables.size(); table_order++) { // iterate over the tables involved in the join
-            long long registry_position = join_result->at(line).at(table_order);
-            Queryable* table = tables.at(table_order);
-            vector<string> row_partial = table->getRow(registry_position);
-
-            for(int column=0; column < table->getSchema().getCols()->size(); column++) { // iterate over the columns of one of the Tables
+            vector<string> & row_partial = table_rows.at(table_order).at(line);
+            
+            for(size_t column=0; column < row_partial.size(); column++) { // iterate over the columns of one of the Tables
                 cout<<row_partial.at(column) << " | ";
             }
      
@@ -216,6 +547,10 @@ void Join::print(int number_of_values) {
     }
 }
 
+int Join::getNumberOfRows() {
+    return join_result->size();
+}
+
 Join::~Join() {
     delete this->join_result;
 }
@@ -80,23 +80,23 @@ void JoinBenchmark::nestedLoopJoin() {
     timer.start();
     
     // Load all the rows
-    for (int i = 0; i < this_table->getHeader()->size(); i++) {
-        this_rows.push_back(this_table->getRow(this_table->getHeader()->at(counter).second));
+    for (int i = 0; i < this_table->getNumberOfRows(); i++) {
+        this_rows.push_back(this_table->getRow(this_table->getRegistryPosition(counter)));
     }
-    for (int i = 0; i < other_table->getHeader()->size(); i++) {
-        other_rows.push_back(other_table->getRow(other_table->getHeader()->at(counter).second));
+    for (int i = 0; i < other_table->getNumberOfRows(); i++) {
+        other_rows.push_back(other_table->getRow(other_table->getRegistryPosition(counter)));
     }
     
     cout << "\tTime to load: " << timer.getElapsedTime() << " s" << endl;
     
     timer.start();
 
-    while (counter != this_table->getHeader()->size()) { // Iterate over all of this table
+    while (counter != this_table->getNumberOfRows()) { // Iterate over all of this table
         
         vector<string> this_row = this_rows.at(counter);
 
         // for each Row in this table, search for all matches in the other table
-        for(int i=0; i < other_table->getHeader()->size(); i++){
+        for(int i=0; i < other_table->getNumberOfRows(); i++){
             vector<string> other_row = other_rows.at(i);
         
             if(this_row.at(this_column_position) == other_row.at(other_column_position)){
@@ -104,12 +104,12 @@ void JoinBenchmark::nestedLoopJoin() {
                 vector<long long> join_row;
 
                 //get both registries positions
-                join_row.push_back(this_table->getHeader()->at(counter).second);
-                join_row.push_back(other_table->getHeader()->at(i).second);
+                join_row.push_back(this_table->getRegistryPosition(counter));
+                join_row.push_back(other_table->getRegistryPosition(i));
                 join_result->push_back(join_row);
 
-                // cout << "insterted " << this_table->getHeader()->at(counter).second << " and " << other_table->getHeader()->at(i).second << endl;
-                //For debugging purpose, cout << "insterted "<< this_table->getHeader()->at(counter).second<< " and " << other_table->getHeader()->at(i).second << endl;
+                // cout << "insterted " << this_table->getRegistryPosition(counter) << " and " << other_table->getRegistryPosition(i) << endl;
+                //For debugging purpose, cout << "insterted "<< this_table->getRegistryPosition(counter)<< " and " << other_table->getRegistryPosition(i) << endl;
             }
         }
         counter ++;
@@ -0,0 +1,119 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+/**
+ * A read-only memory map of a whole file. The map can be grown when the
+ * file is appended, remapping it with the new file size
+ */
+class MappedFile {
+private:
+    string path;
+    char * data;
+    size_t size;
+    
+    MappedFile(const MappedFile &);
+    MappedFile & operator=(const MappedFile &);
+    
+public:
+    /**
+     * @constructor
+     */
+    MappedFile(const string & path = "");
+    
+    /**
+     * Unmaps the file
+     * @destructor
+     */
+    ~MappedFile();
+    
+    void setPath(const string & path);
+    
+    /**
+     * Map the file, remapping it if the current map is smaller than the
+     * minimum size
+     * @return false if the file is smaller than the minimum size
+     */
+    bool map(size_t minimum_size);
+    
+    void unmap();
+    
+    /**
+     * @return the mapped bytes or NULL if the file is not mapped
+     */
+    const char * getData();
+    
+    /**
+     * @return the number of mapped bytes
+     */
+    size_t getSize();
+};
+
+MappedFile::MappedFile(const string & path) {
+    this->path = path;
+    this->data = NULL;
+    this->size = 0;
+}
+
+MappedFile::~MappedFile() {
+    unmap();
+}
+
+void MappedFile::setPath(const string & path) {
+    unmap();
+    this->path = path;
+}
+
+bool MappedFile::map(size_t minimum_size) {
+    if (data != NULL && size >= minimum_size) {
+        return true;
+    }
+    unmap();
+    
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || (size_t) file_stat.st_size < minimum_size || file_stat.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    
+    void * mapped_data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping is kept valid after the file descriptor is closed
+    close(fd);
+    if (mapped_data == MAP_FAILED) {
+        return false;
+    }
+    
+    data = static_cast<char *> (mapped_data);
+    size = file_stat.st_size;
+    return true;
+}
+
+void MappedFile::unmap() {
+    if (data != NULL) {
+        munmap(data, size);
+        data = NULL;
+        size = 0;
+    }
+}
+
+const char * MappedFile::getData() {
+    return data;
+}
+
+size_t MappedFile::getSize() {
+    return size;
+}
+
+#endif //MAPPEDFILE_H
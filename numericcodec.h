@@ -0,0 +1,387 @@
+#ifndef NUMERICCODEC_H
+#define NUMERICCODEC_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <locale.h>
+#include <string>
+#include <limits>
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * Converts the numeric values between text and binary without streams or the
+ * locale. The values are parsed from character ranges and formatted into
+ * buffers given by the caller, so no memory is allocated.
+ * The formatting is the same as the default ostream formatting: the reals use
+ * 6 significant digits and the shortest of the fixed and scientific notations.
+ * e.g.:
+ * char buffer[NumericCodec::MAX_LENGTH];
+ * size_t length = NumericCodec::formatInteger(-1234, buffer); // "-1234", 5
+ * long long value;
+ * NumericCodec::parseInteger(buffer, buffer + length, &value); // -1234
+ */
+class NumericCodec {
+private:
+    static const char DIGIT_PAIRS[201];
+    static const double POWERS_OF_TEN[23];
+    
+    /**
+     * @return value * 10^power using long doubles, with the exact powers of ten
+     *         from the table when possible
+     */
+    static long double scale(double value, int power);
+    
+    /**
+     * Write the digits of the value, which can't be zero, at the end of the buffer
+     * @return the position of the first digit
+     */
+    static char * writeDigits(unsigned long long value, char * buffer_end);
+    
+    /**
+     * Round the value, which must be positive, to its significant digits
+     * using its exact decimal value, as printf does
+     * @param exponent the power of ten of the first digit
+     * @return the digits
+     */
+    static unsigned long long roundExactly(double value, int precision, int * exponent);
+    
+    /**
+     * @return the "C" locale, so strtod always reads a point as the decimal separator
+     */
+    static locale_t getCLocale();
+
+public:
+    static const size_t MAX_LENGTH = 32; // enough for any formatted value
+    
+    /**
+     * Parse an integer, skipping the leading spaces, like atoi. The digits
+     * after the end are not read. The values out of the long long range are
+     * clamped to it, like strtoll
+     * @return false if there are no digits or the value is out of the range
+     */
+    static bool parseInteger(const char * begin, const char * end, long long * value);
+    
+    /**
+     * Parse a real number in the decimal notation, with an optional exponent.
+     * The values that can't be parsed exactly using doubles (more than 15
+     * significant digits or large exponents) and the special values (inf,
+     * nan, hexadecimal) are parsed by strtod, on the "C" locale
+     * @return false if there are no digits
+     */
+    static bool parseReal(const char * begin, const char * end, double * value);
+    
+    /**
+     * Format the integer into the buffer, which must have MAX_LENGTH bytes.
+     * The buffer is not null terminated
+     * @return the number of characters written
+     */
+    static size_t formatInteger(long long value, char * buffer);
+    
+    /**
+     * Format the real number into the buffer, which must have MAX_LENGTH bytes,
+     * using 6 significant digits. The buffer is not null terminated
+     * e.g.: 3.14159265 -> "3.14159", 1500000 -> "1.5e+06", 0.0001 -> "0.0001"
+     * @return the number of characters written
+     */
+    static size_t formatReal(double value, char * buffer);
+};
+
+const char NumericCodec::DIGIT_PAIRS[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+const double NumericCodec::POWERS_OF_TEN[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+long double NumericCodec::scale(double value, int power) {
+    if (power >= 0 && power <= 22) {
+        return value * (long double) POWERS_OF_TEN[power];
+    } else if (power < 0 && power >= -22) {
+        return value / (long double) POWERS_OF_TEN[-power];
+    }
+    return value * powl(10.0L, power);
+}
+
+char * NumericCodec::writeDigits(unsigned long long value, char * buffer_end) {
+    char * position = buffer_end;
+    
+    // Two digits at once
+    while (value >= 100) {
+        unsigned pair = (value % 100) * 2;
+        value /= 100;
+        position -= 2;
+        position[0] = DIGIT_PAIRS[pair];
+        position[1] = DIGIT_PAIRS[pair + 1];
+    }
+    if (value >= 10) {
+        position -= 2;
+        position[0] = DIGIT_PAIRS[value * 2];
+        position[1] = DIGIT_PAIRS[value * 2 + 1];
+    } else {
+        *--position = '0' + value;
+    }
+    return position;
+}
+
+unsigned long long NumericCodec::roundExactly(double value, int precision, int * exponent) {
+    // d.ddddde+XX, the decimal separator may depend on the locale
+    char printed[MAX_LENGTH + 16];
+    snprintf(printed, sizeof(printed), "%.*e", precision - 1, value);
+    
+    unsigned long long digits = 0;
+    const char * position = printed;
+    for (; *position != 'e' && *position != '\0'; position++) {
+        if ((unsigned) (*position - '0') < 10) {
+            digits = digits * 10 + (*position - '0');
+        }
+    }
+    if (*position == 'e') {
+        long long printed_exponent;
+        parseInteger(position + 1, printed + strlen(printed), &printed_exponent);
+        *exponent = (int) printed_exponent;
+    }
+    return digits;
+}
+
+locale_t NumericCodec::getCLocale() {
+    static locale_t c_locale = newlocale(LC_ALL_MASK, "C", (locale_t) 0);
+    return c_locale;
+}
+
+bool NumericCodec::parseInteger(const char * begin, const char * end, long long * value) {
+    while (begin < end && (*begin == ' ' || *begin == '\t')) {
+        begin++;
+    }
+    
+    bool negative = false;
+    if (begin < end && (*begin == '-' || *begin == '+')) {
+        negative = *begin == '-';
+        begin++;
+    }
+    
+    const char * digits = begin;
+    unsigned long long limit = negative ? 0 - (unsigned long long) numeric_limits<long long>::min() :
+        (unsigned long long) numeric_limits<long long>::max();
+    unsigned long long result = 0;
+    bool overflow = false;
+    while (begin < end && (unsigned) (*begin - '0') < 10) {
+        unsigned digit = *begin - '0';
+        if (result > (limit - digit) / 10) {
+            overflow = true;
+            result = limit;
+        } else if (!overflow) {
+            result = result * 10 + digit;
+        }
+        begin++;
+    }
+    
+    *value = negative ? 0 - result : result;
+    return begin != digits && !overflow;
+}
+
+bool NumericCodec::parseReal(const char * begin, const char * end, double * value) {
+    const char * start = begin;
+    while (begin < end && (*begin == ' ' || *begin == '\t')) {
+        begin++;
+    }
+    
+    bool negative = false;
+    if (begin < end && (*begin == '-' || *begin == '+')) {
+        negative = *begin == '-';
+        begin++;
+    }
+    
+    // The significant digits are accumulated as an integer
+    unsigned long long mantissa = 0;
+    int number_of_digits = 0;
+    int exponent = 0;
+    bool has_digits = false;
+    
+    while (begin < end && (unsigned) (*begin - '0') < 10) {
+        if (mantissa != 0 || *begin != '0') {
+            mantissa = mantissa * 10 + (*begin - '0');
+            number_of_digits++;
+        }
+        has_digits = true;
+        begin++;
+    }
+    if (begin < end && *begin == '.') {
+        begin++;
+        while (begin < end && (unsigned) (*begin - '0') < 10) {
+            if (mantissa != 0 || *begin != '0') {
+                mantissa = mantissa * 10 + (*begin - '0');
+                number_of_digits++;
+            }
+            exponent--;
+            has_digits = true;
+            begin++;
+        }
+    }
+    
+    if (has_digits && begin < end && (*begin == 'e' || *begin == 'E')) {
+        long long exponent_value;
+        if (parseInteger(begin + 1, end, &exponent_value) && exponent_value > -1000 && exponent_value < 1000) {
+            exponent += exponent_value;
+            begin++;
+            while (begin < end && (*begin == '+' || *begin == '-' || (unsigned) (*begin - '0') < 10)) {
+                begin++;
+            }
+        }
+    }
+    
+    bool special = begin < end && (*begin == 'x' || *begin == 'X' || *begin == 'n' || *begin == 'N' ||
+        *begin == 'i' || *begin == 'I' || *begin == 'p' || *begin == 'P');
+    if (!has_digits || special || number_of_digits > 15 || exponent < -22 || exponent > 22) {
+        // Not exact using doubles, strtod needs a null terminated string. The
+        // long values are rare, they are copied to the heap
+        char buffer[64];
+        string long_value;
+        char * text = buffer;
+        size_t length = end - start;
+        if (length < sizeof(buffer)) {
+            memcpy(buffer, start, length);
+            buffer[length] = '\0';
+        } else {
+            long_value.assign(start, length);
+            text = &long_value[0];
+        }
+        char * parse_end;
+        *value = strtod_l(text, &parse_end, getCLocale());
+        return parse_end != text;
+    }
+    
+    // Both the mantissa and the power of ten are exact, so one operation
+    // gives the correctly rounded value
+    double result = (double) mantissa;
+    if (exponent < 0) {
+        result /= POWERS_OF_TEN[-exponent];
+    } else {
+        result *= POWERS_OF_TEN[exponent];
+    }
+    *value = negative ? -result : result;
+    return true;
+}
+
+size_t NumericCodec::formatInteger(long long value, char * buffer) {
+    char digits[MAX_LENGTH];
+    char * digits_end = digits + MAX_LENGTH;
+    
+    unsigned long long absolute = value < 0 ? 0 - (unsigned long long) value : value;
+    char * position = writeDigits(absolute, digits_end);
+    if (value < 0) {
+        *--position = '-';
+    }
+    
+    size_t length = digits_end - position;
+    memcpy(buffer, position, length);
+    return length;
+}
+
+size_t NumericCodec::formatReal(double value, char * buffer) {
+    const int PRECISION = 6;
+    char * position = buffer;
+    
+    if (value != value) {
+        memcpy(buffer, "nan", 3);
+        return 3;
+    }
+    if (signbit(value)) {
+        *position++ = '-';
+        value = -value;
+    }
+    if (value == numeric_limits<double>::infinity()) {
+        memcpy(position, "inf", 3);
+        return position + 3 - buffer;
+    }
+    if (value == 0) {
+        *position++ = '0';
+        return position - buffer;
+    }
+    
+    // Round to the significant digits. The long double scaling is not exact,
+    // so the values close to a tie are rounded on their exact decimal value
+    int exponent = (int) floor(log10(value));
+    long double scaled = scale(value, PRECISION - 1 - exponent);
+    if (rintl(scaled) >= 1000000.0L) {
+        exponent++;
+        scaled = scale(value, PRECISION - 1 - exponent);
+    } else if (rintl(scaled) < 100000.0L) {
+        exponent--;
+        scaled = scale(value, PRECISION - 1 - exponent);
+    }
+    unsigned long long digits;
+    if (fabsl(scaled - floorl(scaled) - 0.5L) < 1e-6L) {
+        digits = roundExactly(value, PRECISION, &exponent);
+    } else {
+        digits = (unsigned long long) rintl(scaled);
+    }
+    
+    // The trailing zeros are not shown
+    int number_of_digits = PRECISION;
+    while (number_of_digits > 1 && digits % 10 == 0) {
+        digits /= 10;
+        number_of_digits--;
+    }
+    char digit_buffer[MAX_LENGTH];
+    char * digits_end = digit_buffer + MAX_LENGTH;
+    char * first_digit = writeDigits(digits, digits_end);
+    
+    if (exponent < -4 || exponent >= PRECISION) {
+        // Scientific notation: d.ddddde+XX
+        *position++ = first_digit[0];
+        if (number_of_digits > 1) {
+            *position++ = '.';
+            memcpy(position, first_digit + 1, number_of_digits - 1);
+            position += number_of_digits - 1;
+        }
+        *position++ = 'e';
+        *position++ = exponent < 0 ? '-' : '+';
+        int absolute_exponent = exponent < 0 ? -exponent : exponent;
+        if (absolute_exponent < 10) {
+            *position++ = '0';
+        }
+        char exponent_buffer[MAX_LENGTH];
+        char * exponent_end = exponent_buffer + MAX_LENGTH;
+        char * exponent_start = writeDigits(absolute_exponent, exponent_end);
+        memcpy(position, exponent_start, exponent_end - exponent_start);
+        position += exponent_end - exponent_start;
+    } else if (exponent < 0) {
+        // 0.000ddd
+        *position++ = '0';
+        *position++ = '.';
+        for (int i = -1; i > exponent; i--) {
+            *position++ = '0';
+        }
+        memcpy(position, first_digit, number_of_digits);
+        position += number_of_digits;
+    } else {
+        // ddd.ddd
+        int integer_digits = exponent + 1;
+        for (int i = 0; i < integer_digits; i++) {
+            *position++ = i < number_of_digits ? first_digit[i] : '0';
+        }
+        if (number_of_digits > integer_digits) {
+            *position++ = '.';
+            memcpy(position, first_digit + integer_digits, number_of_digits - integer_digits);
+            position += number_of_digits - integer_digits;
+        }
+    }
+    
+    return position - buffer;
+}
+
+#endif //NUMERICCODEC_H
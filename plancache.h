@@ -0,0 +1,159 @@
+#ifndef PLANCACHE_H
+#define PLANCACHE_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include "queryparser.h"
+#include "queryplanner.h"
+
+using namespace std;
+
+/**
+ * A query parsed and resolved against the schema of a table: the selected
+ * columns are positions and every column of the WHERE clause exists. The
+ * values of the parameters are given on each execution.
+ * @see Table::prepare
+ */
+struct QueryPlan {
+    QueryStatement statement;
+    vector<int> select_positions; // the position of each selected column on the schema
+    vector<string> columns; // the names of the selected columns
+    long long schema_version; // the version of the schema the columns were resolved on
+    bool reuse_path; // false if the values of the parameters can change the chosen path
+    mutable shared_ptr<ChosenPath> chosen_path; // NULL until executed, shared by the threads by atomic_load/atomic_store
+};
+
+/**
+ * Keeps the plans of the last queries, by their normalized text, so the
+ * repeated queries are not parsed nor resolved again. When the cache is
+ * full, the plan used least recently is removed.
+ * e.g.:
+ * shared_ptr<QueryPlan> plan = cache.get("SELECT * WHERE _id = ?");
+ * if (plan == NULL) {
+ *     plan = makePlan(...);
+ *     cache.put("SELECT * WHERE _id = ?", plan);
+ * }
+ * @see QueryParser::normalize
+ */
+class PlanCache {
+public:
+    static const size_t DEFAULT_CAPACITY = 128;
+    
+private:
+    typedef list<pair<string, shared_ptr<QueryPlan> > > PlanList;
+    
+    size_t capacity;
+    PlanList plans; // the most recently used first
+    unordered_map<string, PlanList::iterator> positions; // query text -> plan
+    long long hits;
+    long long misses;
+    
+    /**
+     * Remove the least recently used plans until the size is the capacity
+     */
+    void evict();
+    
+public:
+    /**
+     * @param capacity the maximum number of plans
+     * @constructor
+     */
+    PlanCache(size_t capacity = DEFAULT_CAPACITY);
+    
+    /**
+     * Get the plan of a query and mark it as the most recently used
+     * @return the plan or NULL if it's not on the cache
+     */
+    shared_ptr<QueryPlan> get(const string & text);
+    
+    /**
+     * Add the plan of a query, replacing the previous one
+     */
+    void put(const string & text, shared_ptr<QueryPlan> plan);
+    
+    /**
+     * Remove all the plans, e.g. when the schema changes
+     */
+    void clear();
+    
+    size_t size();
+    size_t getCapacity();
+    void setCapacity(size_t capacity);
+    
+    /**
+     * @return the number of calls of get that found or didn't find the plan
+     */
+    long long getHits();
+    long long getMisses();
+};
+
+const size_t PlanCache::DEFAULT_CAPACITY;
+
+PlanCache::PlanCache(size_t capacity) {
+    this->capacity = capacity;
+    this->hits = 0;
+    this->misses = 0;
+}
+
+shared_ptr<QueryPlan> PlanCache::get(const string & text) {
+    unordered_map<string, PlanList::iterator>::iterator it = positions.find(text);
+    if (it == positions.end()) {
+        misses++;
+        return shared_ptr<QueryPlan>();
+    }
+    
+    hits++;
+    plans.splice(plans.begin(), plans, it->second);
+    return it->second->second;
+}
+
+void PlanCache::put(const string & text, shared_ptr<QueryPlan> plan) {
+    unordered_map<string, PlanList::iterator>::iterator it = positions.find(text);
+    if (it != positions.end()) {
+        it->second->second = plan;
+        plans.splice(plans.begin(), plans, it->second);
+        return;
+    }
+    
+    plans.push_front(make_pair(text, plan));
+    positions[text] = plans.begin();
+    evict();
+}
+
+void PlanCache::evict() {
+    while (plans.size() > capacity) {
+        positions.erase(plans.back().first);
+        plans.pop_back();
+    }
+}
+
+void PlanCache::clear() {
+    plans.clear();
+    positions.clear();
+}
+
+size_t PlanCache::size() {
+    return plans.size();
+}
+
+size_t PlanCache::getCapacity() {
+    return capacity;
+}
+
+void PlanCache::setCapacity(size_t capacity) {
+    this->capacity = capacity;
+    evict();
+}
+
+long long PlanCache::getHits() {
+    return hits;
+}
+
+long long PlanCache::getMisses() {
+    return misses;
+}
+
+#endif //PLANCACHE_H
@@ -0,0 +1,300 @@
+#ifndef PREDICATE_H
+#define PREDICATE_H
+
+#include <string>
+#include <vector>
+#include <limits>
+#include <string.h>
+#include "schema.h"
+#include "rowview.h"
+#include "dictionary.h"
+#include "numericcodec.h"
+#include "zonemap.h"
+
+using namespace std;
+
+//Possible comparators of a WHERE condition
+enum Comparator { EQUAL, NOT_EQUAL, LESS, GREATER, LESS_EQUAL, GREATER_EQUAL };
+
+/**
+ * A WHERE condition compiled for a column: the value is converted once to
+ * the type of the column and the rows are compared on their binary values,
+ * without converting them to strings.
+ * The integer columns are compared as long long (or as double, when the
+ * value is not an integer), the real columns as double, the strings by
+ * their bytes and the dictionary encoded columns by their codes: the
+ * condition is evaluated once for every value of the dictionary.
+ * e.g.: Predicate predicate(schema, schema.getColPosition("age"), GREATER, "10");
+ *       predicate.evaluate(row_view);
+ */
+class Predicate {
+private:
+    enum ValueType { INTEGER_VALUE, REAL_VALUE, STRING_VALUE, CODE_VALUE };
+    
+    int column_position;
+    Comparator comparator;
+    ValueType value_type;
+    bool integer_column;
+    
+    long long integer_value;
+    double real_value;
+    string string_value;
+    vector<bool> code_matches; // code -> the dictionary value matches (CODE_VALUE only)
+    
+    /**
+     * @return the comparison of the value with the constant
+     */
+    template <typename T>
+    static bool compare(const T & value, const T & constant, Comparator comparator);
+    
+    /**
+     * Compare the characters with the string, as std::string::compare does
+     */
+    static int compareChars(const char * value, size_t length, const string & constant);
+    
+public:
+    /**
+     * Compile the condition
+     * @param value the value on the text format, as written on the CSV files
+     * @param dictionary the dictionary of the column, if it's dictionary encoded
+     * @constructor
+     */
+    Predicate(Schema & schema, int column_position, Comparator comparator, const string & value, Dictionary * dictionary = NULL);
+    
+    /**
+     * Parse a comparator: =, ==, !=, <>, <, >, <= or >=
+     * @return false if the text is not a comparator
+     */
+    static bool parseComparator(const string & text, Comparator * comparator);
+    
+    /**
+     * @return true if the row satisfies the condition
+     */
+    bool evaluate(RowView & row) const;
+    
+    /**
+     * Get the range of the numeric values that may satisfy the condition, to
+     * skip the blocks by the zone map
+     * @return false if the condition has no range (e.g. !=) or it's not numeric
+     */
+    bool getRange(double * min, double * max) const;
+    
+    int getColumnPosition() const;
+    Comparator getComparator() const;
+};
+
+/**
+ * Predicates joined by AND or OR, and the nested trees of the other
+ * operator. An empty AND is true and an empty OR is false.
+ * e.g.: age > 10 AND (city = 'Rio' OR city = 'Natal')
+ *       -> AND { age > 10 } children: OR { city = 'Rio', city = 'Natal' }
+ */
+class PredicateTree {
+private:
+    bool disjunction; // OR instead of AND
+    vector<Predicate> predicates;
+    vector<PredicateTree> children;
+    
+public:
+    /**
+     * @param disjunction true for OR, false for AND
+     * @constructor
+     */
+    PredicateTree(bool disjunction = false);
+    
+    void add(const Predicate & predicate);
+    void add(const PredicateTree & child);
+    
+    /**
+     * @return true if the row satisfies the tree
+     */
+    bool evaluate(RowView & row) const;
+    
+    /**
+     * @return false if no row of the block can satisfy the tree, by the ranges
+     *         of the numeric predicates
+     */
+    bool mayMatch(ZoneMap & zone_map, long long block) const;
+    
+    /**
+     * @return true if there are no conditions
+     */
+    bool empty() const;
+};
+
+Predicate::Predicate(Schema & schema, int column_position, Comparator comparator, const string & value, Dictionary * dictionary) {
+    this->column_position = column_position;
+    this->comparator = comparator;
+    this->integer_value = 0;
+    this->real_value = 0;
+    
+    SchemaCol & schema_col = schema.getCols()->at(column_position);
+    const char * begin = value.c_str();
+    const char * end = begin + value.size();
+    integer_column = schema_col.isInteger();
+    
+    if (schema_col.isInteger() && value.find_first_of(".eEnNiI") == string::npos) {
+        value_type = INTEGER_VALUE;
+        if (!NumericCodec::parseInteger(begin, end, &integer_value)) {
+            // Not a number, no row is equal to it
+            value_type = REAL_VALUE;
+            real_value = numeric_limits<double>::quiet_NaN();
+        }
+    } else if (schema_col.isInteger() || schema_col.isReal()) {
+        value_type = REAL_VALUE;
+        if (!NumericCodec::parseReal(begin, end, &real_value)) {
+            real_value = numeric_limits<double>::quiet_NaN();
+        }
+    } else if (dictionary != NULL) {
+        // The codes have no order, the condition is evaluated on each value
+        value_type = CODE_VALUE;
+        string_value = value.substr(0, schema_col.array_size);
+        code_matches.resize(dictionary->getSize());
+        for (int code = 0; code < (int) code_matches.size(); code++) {
+            const string & dictionary_value = dictionary->decode(code);
+            code_matches[code] = compare(compareChars(dictionary_value.data(), dictionary_value.size(), string_value), 0, comparator);
+        }
+    } else {
+        // CHAR and VARCHAR are stored cut to the size of the column
+        value_type = STRING_VALUE;
+        string_value = value.substr(0, schema_col.array_size);
+    }
+}
+
+bool Predicate::parseComparator(const string & text, Comparator * comparator) {
+    if (text == "=" || text == "==") {
+        *comparator = EQUAL;
+    } else if (text == "!=" || text == "<>") {
+        *comparator = NOT_EQUAL;
+    } else if (text == "<") {
+        *comparator = LESS;
+    } else if (text == ">") {
+        *comparator = GREATER;
+    } else if (text == "<=") {
+        *comparator = LESS_EQUAL;
+    } else if (text == ">=") {
+        *comparator = GREATER_EQUAL;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+template <typename T>
+bool Predicate::compare(const T & value, const T & constant, Comparator comparator) {
+    switch (comparator) {
+        case EQUAL: return value == constant;
+        case NOT_EQUAL: return value != constant;
+        case LESS: return value < constant;
+        case GREATER: return value > constant;
+        case LESS_EQUAL: return value <= constant;
+        default: return value >= constant;
+    }
+}
+
+int Predicate::compareChars(const char * value, size_t length, const string & constant) {
+    int result = memcmp(value, constant.data(), min(length, constant.size()));
+    if (result != 0) {
+        return result;
+    }
+    return length < constant.size() ? -1 : (length > constant.size() ? 1 : 0);
+}
+
+bool Predicate::evaluate(RowView & row) const {
+    switch (value_type) {
+        case INTEGER_VALUE:
+            return compare(row.getInteger(column_position), integer_value, comparator);
+        case REAL_VALUE:
+            if (integer_column) {
+                return compare((double) row.getInteger(column_position), real_value, comparator);
+            }
+            return compare(row.getReal(column_position), real_value, comparator);
+        case CODE_VALUE: {
+            int code = row.getCode(column_position);
+            return code >= 0 && code < (int) code_matches.size() && code_matches[code];
+        }
+        default:
+            return compare(compareChars(row.getChars(column_position), row.getCharsLength(column_position), string_value),
+                0, comparator);
+    }
+}
+
+bool Predicate::getRange(double * min, double * max) const {
+    if (value_type != INTEGER_VALUE && value_type != REAL_VALUE) {
+        return false;
+    }
+    
+    double value = value_type == INTEGER_VALUE ? (double) integer_value : real_value;
+    if (value != value) {
+        // NaN, no value is in the range
+        *min = numeric_limits<double>::infinity();
+        *max = -numeric_limits<double>::infinity();
+        return comparator != NOT_EQUAL;
+    }
+    
+    // The zones are stored as double, so the bounds are not strict
+    *min = -numeric_limits<double>::infinity();
+    *max = numeric_limits<double>::infinity();
+    switch (comparator) {
+        case EQUAL: *min = value; *max = value; return true;
+        case LESS: case LESS_EQUAL: *max = value; return true;
+        case GREATER: case GREATER_EQUAL: *min = value; return true;
+        default: return false;
+    }
+}
+
+int Predicate::getColumnPosition() const {
+    return column_position;
+}
+
+Comparator Predicate::getComparator() const {
+    return comparator;
+}
+
+PredicateTree::PredicateTree(bool disjunction) {
+    this->disjunction = disjunction;
+}
+
+void PredicateTree::add(const Predicate & predicate) {
+    predicates.push_back(predicate);
+}
+
+void PredicateTree::add(const PredicateTree & child) {
+    children.push_back(child);
+}
+
+bool PredicateTree::evaluate(RowView & row) const {
+    for (vector<Predicate>::const_iterator it = predicates.begin(); it != predicates.end(); it++) {
+        if (it->evaluate(row) == disjunction) {
+            return disjunction;
+        }
+    }
+    for (vector<PredicateTree>::const_iterator it = children.begin(); it != children.end(); it++) {
+        if (it->evaluate(row) == disjunction) {
+            return disjunction;
+        }
+    }
+    return !disjunction;
+}
+
+bool PredicateTree::mayMatch(ZoneMap & zone_map, long long block) const {
+    for (vector<Predicate>::const_iterator it = predicates.begin(); it != predicates.end(); it++) {
+        double min, max;
+        bool may_match = !it->getRange(&min, &max) || zone_map.mayMatch(block, it->getColumnPosition(), min, max);
+        if (may_match == disjunction) {
+            return disjunction;
+        }
+    }
+    for (vector<PredicateTree>::const_iterator it = children.begin(); it != children.end(); it++) {
+        if (it->mayMatch(zone_map, block) == disjunction) {
+            return disjunction;
+        }
+    }
+    return !disjunction;
+}
+
+bool PredicateTree::empty() const {
+    return predicates.empty() && children.empty();
+}
+
+#endif //PREDICATE_H
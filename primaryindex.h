@@ -0,0 +1,477 @@
+#ifndef PRIMARYINDEX_H
+#define PRIMARYINDEX_H
+
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+/**
+ * The in-memory index of a table, the (_id, registry position) pairs sorted
+ * by the _id. The _ids and the positions are stored on separate arrays, with
+ * the smallest representation that holds all of them:
+ * - the _ids are a sequence (first_id + index), 32 bits offsets from the
+ *   first _id or the full 64 bits values
+ * - the positions are equally spaced (first_position + index * stride, the
+ *   registries are contiguous), 32 bits slots of stride bytes or the full
+ *   64 bits values
+ * A table without removed rows needs no memory per row, a compacted one 4
+ * bytes instead of 16.
+ * The _ids are found by an interpolation search, which is exact for the
+ * dense sequences with a few gaps. Otherwise the search goes through a
+ * sample of every SAMPLE_RATE-th _id, stored on the Eytzinger (breadth first)
+ * order so the first levels of the search share the cache lines, and ends
+ * scanning the SAMPLE_RATE _ids of one block. The entries appended after the
+ * last sample are binary searched until they are sampled.
+ * It keeps the interface of a vector of pairs, so the values are returned
+ * by copy and can't be modified in place
+ */
+class PrimaryIndex {
+public:
+    typedef pair<long long, long long> value_type;
+    
+    static const long long SAMPLE_RATE = 16; // 16 * 4 bytes, one cache line of 32 bits _ids
+    static const long long INTERPOLATION_WINDOW = 8;
+    
+    /**
+     * Random access to the pairs, which are built on every access
+     */
+    class const_iterator {
+    private:
+        const PrimaryIndex * index;
+        long long position;
+    
+    public:
+        typedef random_access_iterator_tag iterator_category;
+        typedef PrimaryIndex::value_type value_type;
+        typedef long long difference_type;
+        typedef const value_type * pointer;
+        typedef value_type reference;
+    
+        /**
+         * Keeps the pair alive while its members are accessed by the -> operator
+         */
+        struct ArrowProxy {
+            value_type value;
+            const value_type * operator->() const { return &value; }
+        };
+    
+        const_iterator(const PrimaryIndex * index = NULL, long long position = 0) : index(index), position(position) {}
+    
+        value_type operator*() const { return index->at(position); }
+        ArrowProxy operator->() const { ArrowProxy proxy = {index->at(position)}; return proxy; }
+        value_type operator[](difference_type n) const { return index->at(position + n); }
+    
+        const_iterator & operator++() { position ++; return *this; }
+        const_iterator & operator--() { position --; return *this; }
+        const_iterator operator++(int) { const_iterator it = *this; position ++; return it; }
+        const_iterator operator--(int) { const_iterator it = *this; position --; return it; }
+        const_iterator & operator+=(difference_type n) { position += n; return *this; }
+        const_iterator & operator-=(difference_type n) { position -= n; return *this; }
+        const_iterator operator+(difference_type n) const { return const_iterator(index, position + n); }
+        const_iterator operator-(difference_type n) const { return const_iterator(index, position - n); }
+        difference_type operator-(const const_iterator & other) const { return position - other.position; }
+    
+        bool operator==(const const_iterator & other) const { return position == other.position; }
+        bool operator!=(const const_iterator & other) const { return position != other.position; }
+        bool operator<(const const_iterator & other) const { return position < other.position; }
+        bool operator>(const const_iterator & other) const { return position > other.position; }
+        bool operator<=(const const_iterator & other) const { return position <= other.position; }
+        bool operator>=(const const_iterator & other) const { return position >= other.position; }
+    };
+    typedef const_iterator iterator;
+    
+private:
+    enum IdMode { DENSE_IDS, OFFSET_IDS, FULL_IDS };
+    enum PositionMode { STRIDED_POSITIONS, SLOT_POSITIONS, FULL_POSITIONS };
+    
+    long long number_of_entries;
+    long long reserved_entries; // the capacity of the arrays, when they are needed
+    
+    IdMode id_mode;
+    long long first_id;
+    vector<unsigned> id_offsets; // _id - first_id (OFFSET_IDS only)
+    vector<long long> ids; // FULL_IDS only
+    
+    PositionMode position_mode;
+    long long first_position;
+    long long position_stride; // the distance of the first two positions
+    vector<unsigned> position_slots; // (position - first_position) / position_stride (SLOT_POSITIONS only)
+    vector<long long> positions; // FULL_POSITIONS only
+    
+    // The _id of the first entry of each block, in the Eytzinger order from 1
+    vector<long long> sample_ids;
+    vector<long long> sample_blocks; // the block of each sample
+    long long sampled_entries; // the entries covered by the samples
+    
+    /**
+     * Change the _ids and the positions to the representation that holds the
+     * new entry, copying the current values
+     */
+    void widenIds(long long _id);
+    void widenPositions(long long registry_position);
+    
+    /**
+     * Build the samples of the complete blocks
+     */
+    void buildSamples();
+    
+    /**
+     * Fill the samples of the subtree of node k with the blocks from the next one on
+     */
+    long long fillSamples(long long k, long long next_block);
+    
+    /**
+     * @return the index of the first _id not less than the _id between first and last
+     */
+    long long lowerBound(long long _id, long long first, long long last) const;
+    
+public:
+    /**
+     * @constructor
+     */
+    PrimaryIndex();
+    
+    long long getId(long long index) const;
+    long long getPosition(long long index) const;
+    
+    /**
+     * @return the index of the _id or -1 if it's not on the index
+     */
+    long long find(long long _id) const;
+    
+    /**
+     * @return the index of the first _id not less than the _id, or size()
+     */
+    long long lowerBound(long long _id) const;
+    
+    /**
+     * Append an entry. The _id must be greater than the last one
+     */
+    void push_back(const value_type & entry);
+    
+    value_type at(long long index) const;
+    value_type back() const;
+    size_t size() const;
+    bool empty() const;
+    void clear();
+    void reserve(size_t number_of_entries);
+    
+    /**
+     * Keep only the first entries
+     */
+    void resize(size_t number_of_entries);
+    
+    const_iterator begin() const;
+    const_iterator end() const;
+    
+    /**
+     * @return the bytes used by the entries and the samples
+     */
+    size_t getMemorySize() const;
+};
+
+const long long PrimaryIndex::SAMPLE_RATE;
+const long long PrimaryIndex::INTERPOLATION_WINDOW;
+
+PrimaryIndex::PrimaryIndex() {
+    clear();
+}
+
+long long PrimaryIndex::getId(long long index) const {
+    switch (id_mode) {
+        case DENSE_IDS: return first_id + index;
+        case OFFSET_IDS: return first_id + id_offsets[index];
+        default: return ids[index];
+    }
+}
+
+long long PrimaryIndex::getPosition(long long index) const {
+    switch (position_mode) {
+        case STRIDED_POSITIONS: return first_position + index * position_stride;
+        case SLOT_POSITIONS: return first_position + position_slots[index] * position_stride;
+        default: return positions[index];
+    }
+}
+
+void PrimaryIndex::widenIds(long long _id) {
+    if (id_mode == DENSE_IDS && _id == first_id + number_of_entries) {
+        return;
+    }
+    if (id_mode != FULL_IDS && _id >= first_id && _id - first_id <= 0xffffffffLL) {
+        if (id_mode == DENSE_IDS) {
+            id_offsets.reserve(max(reserved_entries, number_of_entries + 1));
+            for (long long i = 0; i < number_of_entries; i++) {
+                id_offsets.push_back(i);
+            }
+            id_mode = OFFSET_IDS;
+        }
+        return;
+    }
+    if (id_mode != FULL_IDS) {
+        ids.reserve(max(reserved_entries, number_of_entries + 1));
+        for (long long i = 0; i < number_of_entries; i++) {
+            ids.push_back(getId(i));
+        }
+        vector<unsigned>().swap(id_offsets);
+        id_mode = FULL_IDS;
+    }
+}
+
+void PrimaryIndex::widenPositions(long long registry_position) {
+    if (position_mode == STRIDED_POSITIONS && number_of_entries == 1 && registry_position > first_position) {
+        position_stride = registry_position - first_position;
+    }
+    if (position_mode == STRIDED_POSITIONS && registry_position == first_position + number_of_entries * position_stride) {
+        return;
+    }
+    
+    long long offset = registry_position - first_position;
+    if (position_mode != FULL_POSITIONS && position_stride > 0 && offset >= 0 &&
+        offset % position_stride == 0 && offset / position_stride <= 0xffffffffLL) {
+        if (position_mode == STRIDED_POSITIONS) {
+            position_slots.reserve(max(reserved_entries, number_of_entries + 1));
+            for (long long i = 0; i < number_of_entries; i++) {
+                position_slots.push_back(i);
+            }
+            position_mode = SLOT_POSITIONS;
+        }
+        return;
+    }
+    if (position_mode != FULL_POSITIONS) {
+        positions.reserve(max(reserved_entries, number_of_entries + 1));
+        for (long long i = 0; i < number_of_entries; i++) {
+            positions.push_back(getPosition(i));
+        }
+        vector<unsigned>().swap(position_slots);
+        position_mode = FULL_POSITIONS;
+    }
+}
+
+void PrimaryIndex::push_back(const value_type & entry) {
+    if (number_of_entries == 0) {
+        first_id = entry.first;
+        first_position = entry.second;
+    }
+    widenIds(entry.first);
+    widenPositions(entry.second);
+    
+    if (id_mode == OFFSET_IDS) {
+        id_offsets.push_back(entry.first - first_id);
+    } else if (id_mode == FULL_IDS) {
+        ids.push_back(entry.first);
+    }
+    if (position_mode == SLOT_POSITIONS) {
+        position_slots.push_back((entry.second - first_position) / position_stride);
+    } else if (position_mode == FULL_POSITIONS) {
+        positions.push_back(entry.second);
+    }
+    number_of_entries ++;
+    
+    // The unsampled entries are binary searched, they are sampled when they
+    // are an eighth of the index
+    long long unsampled_entries = number_of_entries - sampled_entries;
+    if (id_mode != DENSE_IDS && unsampled_entries > max(64 * SAMPLE_RATE, number_of_entries / 8)) {
+        buildSamples();
+    }
+}
+
+long long PrimaryIndex::fillSamples(long long k, long long next_block) {
+    if (k >= (long long) sample_ids.size()) {
+        return next_block;
+    }
+    next_block = fillSamples(2 * k, next_block);
+    sample_ids[k] = getId(next_block * SAMPLE_RATE);
+    sample_blocks[k] = next_block;
+    return fillSamples(2 * k + 1, next_block + 1);
+}
+
+void PrimaryIndex::buildSamples() {
+    long long number_of_blocks = number_of_entries / SAMPLE_RATE;
+    sample_ids.assign(number_of_blocks + 1, 0);
+    sample_blocks.assign(number_of_blocks + 1, 0);
+    fillSamples(1, 0);
+    sampled_entries = number_of_blocks * SAMPLE_RATE;
+}
+
+long long PrimaryIndex::lowerBound(long long _id, long long first, long long last) const {
+    while (first < last) {
+        long long middle = first + (last - first) / 2;
+        if (getId(middle) < _id) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return first;
+}
+
+long long PrimaryIndex::lowerBound(long long _id) const {
+    if (number_of_entries == 0 || _id <= first_id) {
+        return 0;
+    }
+    if (id_mode == DENSE_IDS) {
+        return min(_id - first_id, number_of_entries);
+    }
+    
+    if (sampled_entries == 0 || _id > getId(sampled_entries - 1)) {
+        return lowerBound(_id, sampled_entries, number_of_entries);
+    }
+    
+    // Find the first sample greater than the _id: the path goes right on the
+    // samples not greater, the answer is the node where it last went left
+    long long number_of_samples = sample_ids.size() - 1;
+    long long k = 1;
+    while (k <= number_of_samples) {
+        k = 2 * k + (sample_ids[k] <= _id);
+    }
+    k >>= __builtin_ffsll(~k);
+    
+    // The _id is on the block before it. The first _id is smaller, so the
+    // first block is never after the _id
+    long long block = k == 0 ? number_of_samples - 1 : sample_blocks[k] - 1;
+    long long block_start = block * SAMPLE_RATE;
+    long long block_end = min(block_start + SAMPLE_RATE, sampled_entries);
+    for (long long index = block_start; index < block_end; index++) {
+        if (getId(index) >= _id) {
+            return index;
+        }
+    }
+    return block_end;
+}
+
+long long PrimaryIndex::find(long long _id) const {
+    if (number_of_entries == 0 || _id < first_id) {
+        return -1;
+    }
+    
+    long long last_id = getId(number_of_entries - 1);
+    if (_id > last_id) {
+        return -1;
+    }
+    
+    // Guess the index from the _id, as if the _ids were evenly spread
+    if (id_mode != DENSE_IDS && last_id > first_id) {
+        long long guess = (long long) ((double) (_id - first_id) / (last_id - first_id) * (number_of_entries - 1));
+        guess = max(0LL, min(guess, number_of_entries - 1));
+        for (long long step = 0; step < INTERPOLATION_WINDOW; step++) {
+            long long guess_id = getId(guess);
+            if (guess_id == _id) {
+                return guess;
+            } else if (guess_id < _id && guess + 1 < number_of_entries && getId(guess + 1) <= _id) {
+                guess ++;
+            } else if (guess_id > _id && guess > 0 && getId(guess - 1) >= _id) {
+                guess --;
+            } else {
+                // The _id would be between the guess and its neighbor
+                return -1;
+            }
+        }
+    }
+    
+    long long index = lowerBound(_id);
+    if (index < number_of_entries && getId(index) == _id) {
+        return index;
+    }
+    return -1;
+}
+
+PrimaryIndex::value_type PrimaryIndex::at(long long index) const {
+    if (index < 0 || index >= number_of_entries) {
+        throw out_of_range("PrimaryIndex::at");
+    }
+    return value_type(getId(index), getPosition(index));
+}
+
+PrimaryIndex::value_type PrimaryIndex::back() const {
+    return at(number_of_entries - 1);
+}
+
+size_t PrimaryIndex::size() const {
+    return number_of_entries;
+}
+
+bool PrimaryIndex::empty() const {
+    return number_of_entries == 0;
+}
+
+void PrimaryIndex::clear() {
+    number_of_entries = 0;
+    reserved_entries = 0;
+    id_mode = DENSE_IDS;
+    first_id = 0;
+    vector<unsigned>().swap(id_offsets);
+    vector<long long>().swap(ids);
+    position_mode = STRIDED_POSITIONS;
+    first_position = 0;
+    position_stride = 0;
+    vector<unsigned>().swap(position_slots);
+    vector<long long>().swap(positions);
+    vector<long long>().swap(sample_ids);
+    vector<long long>().swap(sample_blocks);
+    sampled_entries = 0;
+}
+
+void PrimaryIndex::reserve(size_t number_of_entries) {
+    // The sequences need no memory, the arrays get the capacity when they are built
+    reserved_entries = number_of_entries;
+    if (id_mode == OFFSET_IDS) {
+        id_offsets.reserve(number_of_entries);
+    } else if (id_mode == FULL_IDS) {
+        ids.reserve(number_of_entries);
+    }
+    if (position_mode == SLOT_POSITIONS) {
+        position_slots.reserve(number_of_entries);
+    } else if (position_mode == FULL_POSITIONS) {
+        positions.reserve(number_of_entries);
+    }
+}
+
+void PrimaryIndex::resize(size_t number_of_entries) {
+    if (number_of_entries >= (size_t) this->number_of_entries) {
+        return;
+    }
+    if (number_of_entries == 0) {
+        clear();
+        return;
+    }
+    
+    this->number_of_entries = number_of_entries;
+    if (id_mode == OFFSET_IDS) {
+        id_offsets.resize(number_of_entries);
+    } else if (id_mode == FULL_IDS) {
+        ids.resize(number_of_entries);
+    }
+    if (position_mode == SLOT_POSITIONS) {
+        position_slots.resize(number_of_entries);
+    } else if (position_mode == FULL_POSITIONS) {
+        positions.resize(number_of_entries);
+    }
+    if (number_of_entries == 1 && position_mode == STRIDED_POSITIONS) {
+        // The stride is taken again from the next entry
+        position_stride = 0;
+    }
+    
+    if (sampled_entries > (long long) number_of_entries) {
+        buildSamples();
+    }
+}
+
+PrimaryIndex::const_iterator PrimaryIndex::begin() const {
+    return const_iterator(this, 0);
+}
+
+PrimaryIndex::const_iterator PrimaryIndex::end() const {
+    return const_iterator(this, number_of_entries);
+}
+
+size_t PrimaryIndex::getMemorySize() const {
+    return id_offsets.capacity() * sizeof(unsigned) + ids.capacity() * sizeof(long long) +
+        position_slots.capacity() * sizeof(unsigned) + positions.capacity() * sizeof(long long) +
+        sample_ids.capacity() * sizeof(long long) + sample_blocks.capacity() * sizeof(long long);
+}
+
+#endif //PRIMARYINDEX_H
@@ -2,12 +2,49 @@
 #define QUERYABLE_H
 
 #include "schema.h"
+#include "rowview.h"
+#include "bloomfilter.h"
+#include "secondaryindex.h"
+#include "primaryindex.h"
+
+/**
+ * Identifies the data file layout. Files written before the TableFileHeader was
+ * introduced don't have the magic number and must be migrated
+ * @see Table::migrate
+ */
+#define TABLE_FILE_MAGIC "NAIVEDB"
+#define TABLE_FILE_VERSION 2
+
+/**
+ * Stores the header of a table data file. The header is saved only once, at the
+ * beginning of the file, and it's shared by all the registries
+ * e.g: | FILE_HEADER | HEADER | ROW_1_COL_1 | ROW_1_COL_2 | HEADER | ROW_2_COL1 | ROW_2_COL_2 |
+ */
+struct TableFileHeader {
+    char magic[8];
+    unsigned version;
+    char table_name[255];
+    unsigned long long schema_hash;
+    unsigned registry_size; // size of every registry, header included
+};
+
+// Registry flags
+#define REGISTRY_DELETED 0x1 // tombstone, the registry is skipped until the compaction
 
 /**
  * Stores the header of a registry. The header is saved for each registry
  * e.g: | HEADER | ROW_1_COL_1 | ROW_1_COL_2 | HEADER | ROW_2_COL1 | ROW_2_COL_2 | 
  */
 struct RegistryHeader {
+    unsigned flags;
+    time_t time_stamp;
+};
+
+/**
+ * Registry header used by the version 1 data files, where the table name and the
+ * registry size were repeated on every registry. It's only used by the migration
+ */
+struct LegacyRegistryHeader {
     char table_name[255];
     unsigned registry_size; // size of the registry, header included
     time_t time_stamp;
@@ -15,8 +52,9 @@ struct RegistryHeader {
 
 /**
  * Stores the position of every RegistryHeader of a table
- * e.g: for a database like | HEADER | 64_BITS_BODY | HEADER | 32_BITS_BODY | HEADER | ...
- *      the Header file will be like | ID_0 | 0 | ID_1 | 64 + HEADER_SIZE | ID_2 | 64 + 32 + 2 * HEADER_SIZE | ...
+ * e.g: for a database like | FILE_HEADER | HEADER | 64_BITS_BODY | HEADER | 64_BITS_BODY | HEADER | ...
+ *      the Header file will be like | ID_0 | F | ID_1 | F + 64 + HEADER_SIZE | ID_2 | F + 2 * (64 + HEADER_SIZE) | ...
+ *      where F is the FILE_HEADER size
  * Note that the header file contains registry_positions with FIXED size, so each position is
  * stored by the same amount of bits (in this case, long long (64 bits))
  */
@@ -26,11 +64,25 @@ struct HeaderFile {
     string path;
 };
 
-typedef vector<pair<decltype(HeaderFile::_id), decltype(HeaderFile::registry_position)> > header_t;
+typedef PrimaryIndex header_t;
 
 class Queryable {
 public:
   virtual vector<string> getRow(long long registry_position) =0;
+  
+  /**
+   * Get many rows at once, in the same order as the positions. The tables may
+   * sort and merge the reads, so this is faster than calling getRow for each position
+   */
+  virtual vector<vector<string> > getRows(const vector<long long> & registry_positions) {
+    vector<vector<string> > rows;
+    rows.reserve(registry_positions.size());
+    for (size_t i = 0; i < registry_positions.size(); i++) {
+      rows.push_back(getRow(registry_positions[i]));
+    }
+    return rows;
+  }
+  virtual RowView getRowView(long long registry_position) =0;
   virtual vector<string> getRowById(long long _id) =0;
   virtual Schema getSchema() =0;
   virtual header_t* getHeader() =0;
@@ -38,6 +90,28 @@ public:
   virtual vector<pair<string, long long>> *getColumn(int column_position) =0;
   virtual string getValue(long long _id, int column_position) =0;
   virtual int getNumberOfRows() =0;
+  
+  /**
+   * Get the registry position of a row without using the header, so the tables that
+   * don't keep the header on memory can be iterated
+   * @param index the row order, from 0 to getNumberOfRows() - 1
+   */
+  virtual long long getRegistryPosition(long long index) =0;
+  
+  /**
+   * @return the dictionary of the column or NULL if the column is not dictionary encoded
+   */
+  virtual Dictionary * getDictionary(int /* column_position */) { return NULL; }
+  
+  /**
+   * @return the Bloom filter of the column or NULL if the column has no filter
+   */
+  virtual ColumnBloomFilter * getBloomFilter(int /* column_position */) { return NULL; }
+  
+  /**
+   * @return the secondary index of the column or NULL if the column has no index
+   */
+  virtual SecondaryIndex * getIndex(int /* column_position */) { return NULL; }
 };
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,531 @@
+#ifndef QUERYPARSER_H
+#define QUERYPARSER_H
+
+#include <string>
+#include <vector>
+#include <ctype.h>
+#include <string.h>
+#include "predicate.h"
+
+using namespace std;
+
+// Types of the tokens of a query
+enum TokenType { IDENTIFIER_TOKEN, NUMBER_TOKEN, STRING_TOKEN, SYMBOL_TOKEN, END_TOKEN };
+
+/**
+ * A word of a query. The keywords are identifiers, the strings don't keep
+ * their quotes
+ */
+struct QueryToken {
+    TokenType type;
+    string text;
+    size_t position; // on the query, for the error messages
+};
+
+// Types of the nodes of a WHERE clause
+enum ConditionType { AND_CONDITION, OR_CONDITION, COMPARISON_CONDITION, IN_CONDITION, BETWEEN_CONDITION };
+
+/**
+ * A node of the syntax tree of a WHERE clause. AND and OR have children,
+ * the others are conditions on a column. The values may be bind parameters,
+ * which are numbered on the query order:
+ * e.g.: age > 10                  -> COMPARISON, values = { "10" }, parameters = { -1 }
+ *       city IN ('Natal', ?)      -> IN, values = { "Natal", "" }, parameters = { -1, 0 }
+ *       age BETWEEN 10 AND 20     -> BETWEEN, values = { "10", "20" }
+ */
+struct QueryCondition {
+    ConditionType type;
+    string column;
+    Comparator comparator; // COMPARISON only
+    vector<string> values;
+    vector<int> parameters; // the parameter of each value, -1 for the literals
+    vector<QueryCondition> children; // AND and OR only
+    
+    /**
+     * Creates an empty AND
+     * @constructor
+     */
+    QueryCondition();
+};
+
+/**
+ * A parsed query. The FROM clause is omitted, it's the table instance
+ */
+struct QueryStatement {
+    vector<string> select; // empty for *
+    bool has_where;
+    QueryCondition where;
+    long long limit; // -1 if there is no LIMIT
+    int number_of_parameters; // the ? on the WHERE clause
+    bool explain; // describe the plan instead of running the query
+    
+    /**
+     * Creates a SELECT * without conditions
+     * @constructor
+     */
+    QueryStatement();
+};
+
+/**
+ * Splits a query on tokens and builds its syntax tree, by recursive descent.
+ * The keywords are case insensitive, the column names and the strings are
+ * kept as written. The conditions separated by commas are joined by AND.
+ * Grammar:
+ *   query      := [EXPLAIN] SELECT select_list [WHERE or_expr] [LIMIT number]
+ *   select_list := * | column (, column)*
+ *   or_expr    := and_expr (OR and_expr)*
+ *   and_expr   := primary ((AND | ,) primary)*
+ *   primary    := ( or_expr ) | column comparator value
+ *                 | column IN ( value (, value)* ) | column BETWEEN value AND value
+ *   value      := number | -number | 'string' | word | ?
+ * e.g.: QueryParser::parse("SELECT name WHERE age > 10 AND (city = 'Rio' OR city = 'Natal') LIMIT 5",
+ *                          &statement, &error);
+ */
+class QueryParser {
+private:
+    vector<QueryToken> tokens;
+    size_t current;
+    string error;
+    int number_of_parameters;
+    
+    QueryParser(const vector<QueryToken> & tokens);
+    
+    const QueryToken & peek();
+    
+    /**
+     * @return true if the current token is the keyword (case insensitive)
+     */
+    bool isKeyword(const string & keyword);
+    
+    /**
+     * @return true if the current token is the symbol
+     */
+    bool isSymbol(const string & symbol);
+    
+    /**
+     * Move past the current token if it is the keyword or the symbol
+     * @return false if it's not
+     */
+    bool acceptKeyword(const string & keyword);
+    bool acceptSymbol(const string & symbol);
+    
+    /**
+     * Set the error message at the current token
+     * @return false
+     */
+    bool fail(const string & message);
+    
+    bool parseSelect(QueryStatement * statement);
+    bool parseOr(QueryCondition * condition);
+    bool parseAnd(QueryCondition * condition);
+    bool parsePrimary(QueryCondition * condition);
+    bool parseValue(QueryCondition * condition);
+    
+    /**
+     * @return true if the identifier is a reserved word
+     */
+    static bool isReserved(const string & identifier);
+    
+    /**
+     * @return the text on upper case
+     */
+    static string toUpper(const string & text);
+    
+public:
+    /**
+     * Split the query on tokens. The last token is END_TOKEN
+     * @param error the message of the invalid character or unclosed string
+     * @return false if the query has an invalid token
+     */
+    static bool tokenize(const string & query, vector<QueryToken> * tokens, string * error);
+    
+    /**
+     * Parse the query
+     * @param error the message of the syntax error, with its position
+     * @return false if the query is invalid
+     */
+    static bool parse(const string & query, QueryStatement * statement, string * error);
+    
+    /**
+     * Rewrite the query on a canonical text: the tokens are separated by one
+     * space and the keywords are on upper case, so the queries that differ
+     * only on the spacing and on the case of the keywords have the same text.
+     * If the literals are requested, the numbers and the strings of the WHERE
+     * clause are replaced by bind parameters, so the queries that differ only
+     * on their values have the same text too.
+     * e.g.: normalize("select name where age>10 and city='Rio'", &text, &literals, &error)
+     *       -> text = "SELECT name WHERE age > ? AND city = ?", literals = { "10", "Rio" }
+     * @param literals the values replaced, on the parameters order, or NULL to
+     *        keep the literals on the text
+     * @return false if the query has an invalid token
+     */
+    static bool normalize(const string & query, string * text, vector<string> * literals, string * error);
+};
+
+QueryCondition::QueryCondition() {
+    type = AND_CONDITION;
+    comparator = EQUAL;
+}
+
+QueryStatement::QueryStatement() {
+    has_where = false;
+    limit = -1;
+    number_of_parameters = 0;
+    explain = false;
+}
+
+QueryParser::QueryParser(const vector<QueryToken> & tokens) {
+    this->tokens = tokens;
+    this->current = 0;
+    this->number_of_parameters = 0;
+}
+
+string QueryParser::toUpper(const string & text) {
+    string upper = text;
+    for (size_t i = 0; i < upper.size(); i++) {
+        upper[i] = toupper(upper[i]);
+    }
+    return upper;
+}
+
+bool QueryParser::isReserved(const string & identifier) {
+    string upper = toUpper(identifier);
+    return upper == "SELECT" || upper == "WHERE" || upper == "AND" || upper == "OR" ||
+        upper == "IN" || upper == "BETWEEN" || upper == "LIMIT" || upper == "EXPLAIN";
+}
+
+bool QueryParser::tokenize(const string & query, vector<QueryToken> * tokens, string * error) {
+    tokens->clear();
+    size_t i = 0;
+    while (i < query.size()) {
+        char character = query[i];
+        QueryToken token;
+        token.position = i;
+    
+        if (isspace(character)) {
+            i++;
+            continue;
+        } else if (isalpha(character) || character == '_') {
+            size_t end = i;
+            while (end < query.size() && (isalnum(query[end]) || query[end] == '_')) {
+                end++;
+            }
+            token.type = IDENTIFIER_TOKEN;
+            token.text = query.substr(i, end - i);
+            i = end;
+        } else if (isdigit(character) || (character == '.' && i + 1 < query.size() && isdigit(query[i + 1]))) {
+            size_t end = i;
+            while (end < query.size() && (isdigit(query[end]) || query[end] == '.' ||
+                ((query[end] == 'e' || query[end] == 'E') && end + 1 < query.size()))) {
+                // The exponent may have a sign
+                if ((query[end] == 'e' || query[end] == 'E') && (query[end + 1] == '-' || query[end + 1] == '+')) {
+                    end++;
+                }
+                end++;
+            }
+            token.type = NUMBER_TOKEN;
+            token.text = query.substr(i, end - i);
+            i = end;
+        } else if (character == '\'') {
+            // Two quotes inside the string are a quote
+            token.type = STRING_TOKEN;
+            size_t end = i + 1;
+            while (true) {
+                if (end >= query.size()) {
+                    *error = "Unclosed string at " + to_string(i);
+                    return false;
+                }
+                if (query[end] == '\'') {
+                    if (end + 1 < query.size() && query[end + 1] == '\'') {
+                        token.text += '\'';
+                        end += 2;
+                        continue;
+                    }
+                    break;
+                }
+                token.text += query[end++];
+            }
+            i = end + 1;
+        } else {
+            token.type = SYMBOL_TOKEN;
+            string pair = query.substr(i, 2);
+            if (pair == "<=" || pair == ">=" || pair == "!=" || pair == "<>" || pair == "==") {
+                token.text = pair;
+            } else if (character != '\0' && strchr("=<>,()*-+?", character) != NULL) {
+                token.text = string(1, character);
+            } else {
+                *error = "Unexpected character '" + string(1, character) + "' at " + to_string(i);
+                return false;
+            }
+            i += token.text.size();
+        }
+        tokens->push_back(token);
+    }
+    
+    QueryToken end_token;
+    end_token.type = END_TOKEN;
+    end_token.position = query.size();
+    tokens->push_back(end_token);
+    return true;
+}
+
+bool QueryParser::parse(const string & query, QueryStatement * statement, string * error) {
+    vector<QueryToken> tokens;
+    if (!tokenize(query, &tokens, error)) {
+        return false;
+    }
+    
+    QueryParser parser(tokens);
+    statement->select.clear();
+    statement->has_where = false;
+    statement->where = QueryCondition();
+    statement->limit = -1;
+    statement->explain = parser.acceptKeyword("EXPLAIN");
+    
+    bool valid = parser.parseSelect(statement);
+    if (valid && parser.acceptKeyword("WHERE")) {
+        statement->has_where = true;
+        valid = parser.parseOr(&statement->where);
+    }
+    if (valid && parser.acceptKeyword("LIMIT")) {
+        long long limit;
+        const QueryToken & token = parser.peek();
+        if (token.type != NUMBER_TOKEN ||
+            !NumericCodec::parseInteger(token.text.c_str(), token.text.c_str() + token.text.size(), &limit) ||
+            token.text.find_first_of(".eE") != string::npos) {
+            valid = parser.fail("Expected the number of rows of the LIMIT");
+        } else {
+            statement->limit = limit;
+            parser.current++;
+        }
+    }
+    if (valid && parser.peek().type != END_TOKEN) {
+        valid = parser.fail("Unexpected '" + parser.peek().text + "'");
+    }
+    
+    statement->number_of_parameters = parser.number_of_parameters;
+    if (!valid) {
+        *error = parser.error;
+    }
+    return valid;
+}
+
+bool QueryParser::normalize(const string & query, string * text, vector<string> * literals, string * error) {
+    vector<QueryToken> tokens;
+    if (!tokenize(query, &tokens, error)) {
+        return false;
+    }
+    
+    text->clear();
+    if (literals != NULL) {
+        literals->clear();
+    }
+    bool on_where = false;
+    for (size_t i = 0; i + 1 < tokens.size(); i++) {
+        QueryToken & token = tokens[i];
+        string word = token.text;
+        
+        if (token.type == IDENTIFIER_TOKEN && isReserved(word)) {
+            word = toUpper(word);
+            if (word == "WHERE") {
+                on_where = true;
+            } else if (word == "LIMIT") {
+                on_where = false;
+            }
+        } else if (token.type == SYMBOL_TOKEN && (word == "-" || word == "+") && tokens[i + 1].type == NUMBER_TOKEN) {
+            // The sign is a part of the number
+            word = (word == "-" ? "-" : "") + tokens[++i].text;
+            if (on_where && literals != NULL) {
+                literals->push_back(word);
+                word = "?";
+            }
+        } else if (token.type == NUMBER_TOKEN || token.type == STRING_TOKEN) {
+            if (on_where && literals != NULL) {
+                literals->push_back(word);
+                word = "?";
+            } else if (token.type == STRING_TOKEN) {
+                // Escape the quotes again
+                word = "'";
+                for (size_t j = 0; j < token.text.size(); j++) {
+                    word += token.text[j] == '\'' ? "''" : string(1, token.text[j]);
+                }
+                word += "'";
+            }
+        }
+        
+        if (!text->empty()) {
+            *text += ' ';
+        }
+        *text += word;
+    }
+    return true;
+}
+
+const QueryToken & QueryParser::peek() {
+    return tokens[current];
+}
+
+bool QueryParser::isKeyword(const string & keyword) {
+    return peek().type == IDENTIFIER_TOKEN && toUpper(peek().text) == keyword;
+}
+
+bool QueryParser::isSymbol(const string & symbol) {
+    return peek().type == SYMBOL_TOKEN && peek().text == symbol;
+}
+
+bool QueryParser::acceptKeyword(const string & keyword) {
+    if (!isKeyword(keyword)) {
+        return false;
+    }
+    current++;
+    return true;
+}
+
+bool QueryParser::acceptSymbol(const string & symbol) {
+    if (!isSymbol(symbol)) {
+        return false;
+    }
+    current++;
+    return true;
+}
+
+bool QueryParser::fail(const string & message) {
+    error = message + " at " + to_string(peek().position);
+    return false;
+}
+
+bool QueryParser::parseSelect(QueryStatement * statement) {
+    if (!acceptKeyword("SELECT")) {
+        return fail("Expected SELECT");
+    }
+    if (acceptSymbol("*")) {
+        return true;
+    }
+    
+    do {
+        if (peek().type != IDENTIFIER_TOKEN || isReserved(peek().text)) {
+            return fail("Expected a column name");
+        }
+        statement->select.push_back(peek().text);
+        current++;
+    } while (acceptSymbol(","));
+    return true;
+}
+
+bool QueryParser::parseOr(QueryCondition * condition) {
+    if (!parseAnd(condition)) {
+        return false;
+    }
+    if (!isKeyword("OR")) {
+        return true;
+    }
+    
+    QueryCondition disjunction;
+    disjunction.type = OR_CONDITION;
+    disjunction.children.push_back(*condition);
+    while (acceptKeyword("OR")) {
+        disjunction.children.push_back(QueryCondition());
+        if (!parseAnd(&disjunction.children.back())) {
+            return false;
+        }
+    }
+    *condition = disjunction;
+    return true;
+}
+
+bool QueryParser::parseAnd(QueryCondition * condition) {
+    if (!parsePrimary(condition)) {
+        return false;
+    }
+    if (!isKeyword("AND") && !isSymbol(",")) {
+        return true;
+    }
+    
+    QueryCondition conjunction;
+    conjunction.type = AND_CONDITION;
+    conjunction.children.push_back(*condition);
+    while (acceptKeyword("AND") || acceptSymbol(",")) {
+        conjunction.children.push_back(QueryCondition());
+        if (!parsePrimary(&conjunction.children.back())) {
+            return false;
+        }
+    }
+    *condition = conjunction;
+    return true;
+}
+
+bool QueryParser::parsePrimary(QueryCondition * condition) {
+    if (acceptSymbol("(")) {
+        if (!parseOr(condition)) {
+            return false;
+        }
+        return acceptSymbol(")") || fail("Expected ')'");
+    }
+    
+    if (peek().type != IDENTIFIER_TOKEN || isReserved(peek().text)) {
+        return fail("Expected a column name");
+    }
+    condition->column = peek().text;
+    current++;
+    
+    if (acceptKeyword("IN")) {
+        condition->type = IN_CONDITION;
+        if (!acceptSymbol("(")) {
+            return fail("Expected '('");
+        }
+        do {
+            if (!parseValue(condition)) {
+                return false;
+            }
+        } while (acceptSymbol(","));
+        return acceptSymbol(")") || fail("Expected ')'");
+    }
+    
+    if (acceptKeyword("BETWEEN")) {
+        condition->type = BETWEEN_CONDITION;
+        if (!parseValue(condition)) {
+            return false;
+        }
+        if (!acceptKeyword("AND")) {
+            return fail("Expected AND");
+        }
+        return parseValue(condition);
+    }
+    
+    condition->type = COMPARISON_CONDITION;
+    if (peek().type != SYMBOL_TOKEN || !Predicate::parseComparator(peek().text, &condition->comparator)) {
+        return fail("Expected a comparator");
+    }
+    current++;
+    return parseValue(condition);
+}
+
+bool QueryParser::parseValue(QueryCondition * condition) {
+    if (acceptSymbol("?")) {
+        condition->values.push_back(string());
+        condition->parameters.push_back(number_of_parameters++);
+        return true;
+    }
+    
+    // The sign may be separated from the number
+    string sign;
+    if (isSymbol("-") || isSymbol("+")) {
+        sign = peek().text == "-" ? "-" : "";
+        current++;
+        if (peek().type != NUMBER_TOKEN) {
+            return fail("Expected a number");
+        }
+    }
+    
+    const QueryToken & token = peek();
+    if (token.type == NUMBER_TOKEN || token.type == STRING_TOKEN ||
+        (token.type == IDENTIFIER_TOKEN && !isReserved(token.text))) {
+        condition->values.push_back(sign + token.text);
+        condition->parameters.push_back(-1);
+        current++;
+        return true;
+    }
+    return fail("Expected a value");
+}
+
+#endif //QUERYPARSER_H
@@ -0,0 +1,183 @@
+#ifndef QUERYPLANNER_H
+#define QUERYPLANNER_H
+
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <unordered_map>
+
+using namespace std;
+
+/**
+ * The statistics of a table used to choose how a query reads its rows. The
+ * number of distinct values of each column is estimated from a sample of
+ * blocks, and the costs are measured on the table itself, so they follow
+ * the read mode, the buffer pool and the disk.
+ * @see Table::analyze
+ */
+struct TableStatistics {
+    static const int SAMPLE_BLOCKS = 4; // blocks of ZoneMap::ROWS_PER_BLOCK rows
+    static const int SAMPLE_READS = 32;
+
+    bool analyzed;
+    long long number_of_rows;
+    long long sampled_rows;
+    vector<double> distinct_values; // per column
+
+    // The measured costs, in seconds
+    double scan_cost; // per row read by a sequential scan
+    double random_read_cost; // per registry read alone
+    double header_search_cost; // per _id search on the header
+    double index_search_cost; // per search on a secondary index
+    double hash_search_cost; // per search on the hash index
+
+    /**
+     * @constructor
+     */
+    TableStatistics();
+
+    /**
+     * Estimate the number of distinct values of a column from a sample, by
+     * the Guaranteed-Error Estimator: sqrt(N / n) * f1 + sum(fj, j >= 2),
+     * where fj is the number of values seen j times on the sample
+     * @param counts the times each value was seen, by the value hash
+     * @param sampled_rows the size of the sample (n)
+     * @param number_of_rows the size of the table (N)
+     */
+    static double estimateDistinctValues(const unordered_map<unsigned long long, long long> & counts,
+        long long sampled_rows, long long number_of_rows);
+};
+
+// How a query reads the rows of a table
+enum AccessType { FULL_SCAN, HEADER_LOOKUP, HEADER_RANGE, HASH_LOOKUP, INDEX_LOOKUP, INDEX_RANGE };
+
+/**
+ * A way to read the rows of a query and its estimated cost. The other
+ * conditions of the query are checked on the rows read.
+ * e.g.: FULL_SCAN: all the blocks that the zone map doesn't skip
+ *       HEADER_LOOKUP: the _ids of an equality or an IN, found on the header
+ *       HEADER_RANGE: the rows of an _id range, found by binary search on the header
+ *       HASH_LOOKUP: the _ids of an equality or an IN, found on the hash index
+ *       INDEX_LOOKUP: the values of an equality or an IN, found on a secondary index
+ *       INDEX_RANGE: the values of a numeric range, found on a secondary index
+ * @see Table::explain
+ */
+struct AccessPath {
+    AccessType type;
+    int column_position; // -1 for the scans
+    int condition_index; // the condition of the path on the top AND of the WHERE clause, -1 for the scans
+    string column_name;
+    vector<string> values; // the values or the _ids searched
+    long long min_id; // HEADER_RANGE
+    long long max_id;
+    double min; // INDEX_RANGE
+    double max;
+    double estimated_rows; // the rows read from the data file
+    double cost; // in seconds
+
+    /**
+     * @constructor
+     */
+    AccessPath();
+
+    /**
+     * @return the name of the access type
+     */
+    static string getTypeName(AccessType type);
+
+    /**
+     * @return a line describing the path
+     *         e.g.: INDEX LOOKUP age (2 values): 200 rows, 35.2 us
+     */
+    string describe() const;
+};
+
+/**
+ * The access path chosen for a query plan. The next executions of the plan
+ * read their rows by the same path, with their own values, while the
+ * statistics of the table don't change
+ * @see Table::planExecution
+ */
+struct ChosenPath {
+    AccessType type;
+    int condition_index; // the condition of the path on the top AND of the WHERE clause, -1 for the scans
+    long long statistics_version; // the statistics the path was chosen on
+};
+
+const int TableStatistics::SAMPLE_BLOCKS;
+const int TableStatistics::SAMPLE_READS;
+
+TableStatistics::TableStatistics() {
+    analyzed = false;
+    number_of_rows = 0;
+    sampled_rows = 0;
+
+    // Used until the table is analyzed
+    scan_cost = 1e-7;
+    random_read_cost = 1e-5;
+    header_search_cost = 1e-7;
+    index_search_cost = 2e-5;
+    hash_search_cost = 1e-6;
+}
+
+double TableStatistics::estimateDistinctValues(const unordered_map<unsigned long long, long long> & counts,
+    long long sampled_rows, long long number_of_rows) {
+    if (sampled_rows <= 0) {
+        return 1;
+    }
+
+    double singletons = 0;
+    double repeated = 0;
+    for (unordered_map<unsigned long long, long long>::const_iterator it = counts.begin(); it != counts.end(); it++) {
+        if (it->second == 1) {
+            singletons++;
+        } else {
+            repeated++;
+        }
+    }
+    double estimate = sqrt((double) max(number_of_rows, sampled_rows) / sampled_rows) * singletons + repeated;
+    return std::max(1.0, std::min(estimate, (double) std::max(number_of_rows, 1LL)));
+}
+
+AccessPath::AccessPath() {
+    type = FULL_SCAN;
+    column_position = -1;
+    condition_index = -1;
+    min_id = 0;
+    max_id = 0;
+    min = 0;
+    max = 0;
+    estimated_rows = 0;
+    cost = 0;
+}
+
+string AccessPath::getTypeName(AccessType type) {
+    switch (type) {
+        case FULL_SCAN: return "FULL SCAN";
+        case HEADER_LOOKUP: return "HEADER LOOKUP";
+        case HEADER_RANGE: return "HEADER RANGE";
+        case HASH_LOOKUP: return "HASH LOOKUP";
+        case INDEX_LOOKUP: return "INDEX LOOKUP";
+        default: return "INDEX RANGE";
+    }
+}
+
+string AccessPath::describe() const {
+    string description = getTypeName(type);
+    if (type == HEADER_RANGE) {
+        description += " _id [" + to_string(min_id) + ", " + to_string(max_id) + "]";
+    } else if (type == INDEX_RANGE) {
+        char range[64];
+        snprintf(range, sizeof(range), " [%g, %g]", min, max);
+        description += " " + column_name + range;
+    } else if (type != FULL_SCAN) {
+        description += " " + column_name + " (" + to_string(values.size()) + (values.size() == 1 ? " value)" : " values)");
+    }
+
+    char estimate[64];
+    snprintf(estimate, sizeof(estimate), ": %.0f rows, %.1f us", estimated_rows, cost * 1e6);
+    return description + estimate;
+}
+
+#endif //QUERYPLANNER_H
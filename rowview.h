@@ -0,0 +1,228 @@
+#ifndef ROWVIEW_H
+#define ROWVIEW_H
+
+#include <string.h>
+#include "schema.h"
+#include "varcharheap.h"
+#include "dictionary.h"
+
+/**
+ * Typed read-only access to the values of a row stored on the binary format.
+ * The view doesn't copy nor convert the row, it only points to the bytes owned
+ * by the table (a read buffer or the memory mapped file), so it's valid until
+ * the next read on the same table.
+ * e.g.: for the schema | _id:int64 | name:char:255 | age:int32 |
+ * RowView row = table.getRowView(registry_position);
+ * row.getInt64(0) -> the _id
+ * row.getChars(1) -> the name, null terminated
+ * row.getInt32(2) -> the age
+ *
+ * Tables that store each column on its own file (@see ColumnTable) create the view
+ * with one pointer per column, so only the columns that are read are touched.
+ */
+class RowView {
+private:
+    Schema * schema;
+    const char * data; // the row values, the registry header is not included
+    const char * const * columns; // one pointer per column value, used instead of data
+    VarcharHeap * varchar_heap; // the long VARCHAR values
+    Dictionary * const * dictionaries; // one per column, NULL if not dictionary encoded
+    
+public:
+    /**
+     * Creates an invalid view
+     * @constructor
+     */
+    RowView();
+    
+    /**
+     * @param data the row bytes, laid out as described by the schema
+     * @constructor
+     */
+    RowView(Schema * schema, const char * data, VarcharHeap * varchar_heap = NULL,
+        Dictionary * const * dictionaries = NULL);
+    
+    /**
+     * @param columns the value of each column, in the schema order
+     * @constructor
+     */
+    RowView(Schema * schema, const char * const * columns, VarcharHeap * varchar_heap = NULL,
+        Dictionary * const * dictionaries = NULL);
+    
+    /**
+     * @return false if the row could not be read
+     */
+    bool isValid();
+    
+    int getInt32(int column_position);
+    long long getInt64(int column_position);
+    float getFloat(int column_position);
+    double getDouble(int column_position);
+    
+    /**
+     * @return the null terminated string stored on a CHAR or VARCHAR column
+     */
+    const char * getChars(int column_position);
+    
+    /**
+     * @return the length of the string stored on a CHAR or VARCHAR column
+     */
+    unsigned getCharsLength(int column_position);
+    
+    /**
+     * @return the Dictionary code stored on a dictionary encoded column
+     */
+    int getCode(int column_position);
+    
+    /**
+     * @return the dictionary of the column or NULL if it's not dictionary encoded
+     */
+    Dictionary * getDictionary(int column_position);
+    
+    /**
+     * Get the value of any INT32, INT64 or FOREIGN_KEY column
+     * @see SchemaCol::isInteger
+     */
+    long long getInteger(int column_position);
+    
+    /**
+     * Get the value of any FLOAT or DOUBLE column
+     * @see SchemaCol::isReal
+     */
+    double getReal(int column_position);
+    
+    /**
+     * @return the raw bytes of a column
+     */
+    const char * getBytes(int column_position);
+    
+    Schema * getSchema();
+};
+
+RowView::RowView() {
+    this->schema = NULL;
+    this->data = NULL;
+    this->columns = NULL;
+    this->varchar_heap = NULL;
+    this->dictionaries = NULL;
+}
+
+RowView::RowView(Schema * schema, const char * data, VarcharHeap * varchar_heap, Dictionary * const * dictionaries) {
+    this->schema = schema;
+    this->data = data;
+    this->columns = NULL;
+    this->varchar_heap = varchar_heap;
+    this->dictionaries = dictionaries;
+}
+
+RowView::RowView(Schema * schema, const char * const * columns, VarcharHeap * varchar_heap, Dictionary * const * dictionaries) {
+    this->schema = schema;
+    this->data = NULL;
+    this->columns = columns;
+    this->varchar_heap = varchar_heap;
+    this->dictionaries = dictionaries;
+}
+
+bool RowView::isValid() {
+    return data != NULL || columns != NULL;
+}
+
+const char * RowView::getBytes(int column_position) {
+    if (columns != NULL) {
+        return columns[column_position];
+    }
+    return data + schema->getColOffset(column_position);
+}
+
+int RowView::getInt32(int column_position) {
+    int value;
+    memcpy(&value, getBytes(column_position), sizeof(value));
+    return value;
+}
+
+long long RowView::getInt64(int column_position) {
+    long long value;
+    memcpy(&value, getBytes(column_position), sizeof(value));
+    return value;
+}
+
+float RowView::getFloat(int column_position) {
+    float value;
+    memcpy(&value, getBytes(column_position), sizeof(value));
+    return value;
+}
+
+double RowView::getDouble(int column_position) {
+    double value;
+    memcpy(&value, getBytes(column_position), sizeof(value));
+    return value;
+}
+
+const char * RowView::getChars(int column_position) {
+    Dictionary * dictionary = getDictionary(column_position);
+    if (dictionary != NULL) {
+        return dictionary->decode(getCode(column_position)).c_str();
+    }
+    
+    const char * value = getBytes(column_position);
+    if (schema->getCols()->at(column_position).type != VARCHAR) {
+        return value;
+    }
+    
+    unsigned length;
+    memcpy(&length, value, sizeof(length));
+    if (length <= VARCHAR_INLINE_SIZE || varchar_heap == NULL) {
+        return value + sizeof(length);
+    }
+    
+    long long offset;
+    memcpy(&offset, value + sizeof(length), sizeof(offset));
+    const char * heap_value = varchar_heap->get(offset);
+    return heap_value != NULL ? heap_value : "";
+}
+
+unsigned RowView::getCharsLength(int column_position) {
+    Dictionary * dictionary = getDictionary(column_position);
+    if (dictionary != NULL) {
+        return dictionary->decode(getCode(column_position)).size();
+    }
+    
+    if (schema->getCols()->at(column_position).type != VARCHAR) {
+        return strnlen(getBytes(column_position), schema->getCols()->at(column_position).getSize());
+    }
+    
+    unsigned length;
+    memcpy(&length, getBytes(column_position), sizeof(length));
+    return length;
+}
+
+int RowView::getCode(int column_position) {
+    return getInt32(column_position);
+}
+
+Dictionary * RowView::getDictionary(int column_position) {
+    if (dictionaries == NULL) {
+        return NULL;
+    }
+    return dictionaries[column_position];
+}
+
+long long RowView::getInteger(int column_position) {
+    if (schema->getCols()->at(column_position).type == INT32) {
+        return getInt32(column_position);
+    }
+    return getInt64(column_position);
+}
+
+double RowView::getReal(int column_position) {
+    if (schema->getCols()->at(column_position).type == FLOAT) {
+        return getFloat(column_position);
+    }
+    return getDouble(column_position);
+}
+
+Schema * RowView::getSchema() {
+    return schema;
+}
+
+#endif //ROWVIEW_H
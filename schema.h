@@ -9,13 +9,24 @@
 
 using namespace std;
 
+/**
+ * A VARCHAR column is stored on a fixed size slot inside the registry. The slot
+ * starts with the string length. Strings with up to VARCHAR_INLINE_SIZE characters
+ * are stored inside the slot, the longer ones are stored on the VarcharHeap and
+ * the slot keeps their offset
+ * e.g.: | LENGTH | CHARS... \0 |  or  | LENGTH | HEAP_OFFSET | 
+ */
+#define VARCHAR_SLOT_SIZE 16
+#define VARCHAR_INLINE_SIZE (VARCHAR_SLOT_SIZE - sizeof(unsigned) - 1)
+
 enum SchemaType {
     INT32,
     INT64,
     CHAR,
     FLOAT,
     DOUBLE,
-    FOREIGN_KEY
+    FOREIGN_KEY,
+    VARCHAR
     // BOOLEAN
 };
 
@@ -23,8 +34,12 @@ struct SchemaCol {
     string key;
     SchemaType type;
     unsigned array_size;
+    bool dictionary; // stores a Dictionary code instead of the value
     
     unsigned getSize() {
+        if (dictionary) {
+            return sizeof(int);
+        }
         switch (type) {
             case INT32:
             case FLOAT:
@@ -37,10 +52,33 @@ struct SchemaCol {
             //     return sizeof(bool) * (array_size + 1);
             case CHAR:
                 return sizeof(char) * (array_size + 1);
+            case VARCHAR:
+                return VARCHAR_SLOT_SIZE;
             default:
                 return 0;
         }
     }
+    
+    /**
+     * @return true if the column stores an INT32, INT64 or FOREIGN_KEY
+     */
+    bool isInteger() {
+        return type == INT32 || type == INT64 || type == FOREIGN_KEY;
+    }
+    
+    /**
+     * @return true if the column stores a FLOAT or DOUBLE
+     */
+    bool isReal() {
+        return type == FLOAT || type == DOUBLE;
+    }
+    
+    /**
+     * @return true if the column stores a CHAR or VARCHAR
+     */
+    bool isString() {
+        return type == CHAR || type == VARCHAR;
+    }
 };
 
 /**
@@ -48,6 +86,11 @@ struct SchemaCol {
  * it's used as the primary key
  * e.g.:
  * | _id:int64 (primary key) | name:char:255 | lastname:char:255 | age:int32 |
+ *
+ * A varchar stores strings up to the array size without using the whole size
+ * on every registry. @see VARCHAR_SLOT_SIZE
+ * e.g.:
+ * | _id:int64 (primary key) | name:varchar:255 |
  * 
  * When using a foreign key, the first attribute is the name of the table
  * e.g.:
@@ -72,6 +115,7 @@ struct SchemaCol {
 class Schema {
 private:
     vector<SchemaCol> cols;
+    vector<unsigned> offsets; // offset of each column inside the row
     unsigned size;
     
 public:
@@ -81,10 +125,11 @@ public:
     Schema();
     
     /**
-    * Import a schema file, where each line is defined by <key>:<type>:<optional_array_size>
+    * Import a schema file, where each line is defined by <key>:<type>:<optional_array_size>:<optional_dict>
     * e.g.:
     * name:char:255 is a char *[255]
     * name:int32 is an int
+    * city:char:255:dict is a char *[255] stored as a Dictionary code
     */
     void import(const string & path);
     
@@ -110,7 +155,7 @@ public:
       * Add a column
       */
      void addCol(string key, SchemaType type);
-     void addCol(string key, SchemaType type, unsigned array_size);
+     void addCol(string key, SchemaType type, unsigned array_size, bool dictionary = false);
       
      /**
       * @return the number of columns on the schema
@@ -123,6 +168,20 @@ public:
       * @return the total size of the schema
       */
       unsigned getSize();
+      
+      /**
+       * e.g.: If there are two columns, a char [255] and a float, the
+       * offset of the float is sizeof(char) * 255
+       * @return the position of the column inside the row, in bytes
+       */
+      unsigned getColOffset(int column_position);
+      
+      /**
+       * Hash of the column keys, types and array sizes. Two schemas with the
+       * same hash describe the same registry layout
+       * @return the FNV-1a hash of the schema
+       */
+      unsigned long long getHash();
 };
 
 Schema::Schema() {
@@ -131,6 +190,7 @@ Schema::Schema() {
     _id.key = "_id";
     _id.type = INT64;
     _id.array_size = 0;
+    _id.dictionary = false;
     
     cols.push_back(_id);
 }
@@ -158,6 +218,8 @@ void Schema::import(const string & path) {
                     col.type = INT32;
                 } else if (type == "char") {
                     col.type = CHAR;
+                } else if (type == "varchar") {
+                    col.type = VARCHAR;
                 } else if (type == "float") {
                     col.type = FLOAT;
                 } else if (type == "double") {
@@ -170,15 +232,19 @@ void Schema::import(const string & path) {
                 // }
                 
                 //Array size
-                if (size == 3) {
+                if (size >= 3) {
                     col.array_size = atoi(words.at(2).c_str());
                 } else {
                     col.array_size = 0;
                 }
                 
+                //Dictionary encoding, only for strings
+                col.dictionary = size == 4 && words.at(3) == "dict" && col.isString();
+                
                 //Push the column to the cols vector
                 cout << col.key << " " << col.type << " " << col.array_size << endl;
                 cols.push_back(col);
+                this->size = -1;
             }
         }
         file.close();
@@ -210,19 +276,23 @@ void Schema::addCol(string key, SchemaType type) {
     addCol(key, type, 0);
 }
 
-void Schema::addCol(string key, SchemaType type, unsigned array_size) {
+void Schema::addCol(string key, SchemaType type, unsigned array_size, bool dictionary) {
     SchemaCol col;
     col.key = key;
     col.type = type;
     col.array_size = array_size;
+    col.dictionary = dictionary && col.isString();
     cols.push_back(col);
+    size = -1;
 }
 
 unsigned Schema::getSize() {
     if (size == -1) {
         // Get the size for the first time
         size = 0;
+        offsets.clear();
         for (vector<SchemaCol>::iterator it = cols.begin(); it != cols.end(); it++) {
+            offsets.push_back(size);
             size += (*it).getSize();
         }
     }
@@ -230,6 +300,26 @@ unsigned Schema::getSize() {
     return size;
 }
 
+unsigned Schema::getColOffset(int column_position) {
+    getSize();
+    return offsets.at(column_position);
+}
+
+unsigned long long Schema::getHash() {
+    unsigned long long hash = 14695981039346656037ULL;
+    
+    for (vector<SchemaCol>::iterator it = cols.begin(); it != cols.end(); it++) {
+        string description = (*it).key + ":" + to_string((*it).type) + ":" + to_string((*it).array_size) +
+            ((*it).dictionary ? ":dict;" : ";");
+        for (string::iterator c = description.begin(); c != description.end(); c++) {
+            hash ^= (unsigned char) (*c);
+            hash *= 1099511628211ULL;
+        }
+    }
+    
+    return hash;
+}
+
 int Schema::getNumberOfCols() {
     return cols.size();
 }
@@ -0,0 +1,366 @@
+#ifndef SECONDARYINDEX_H
+#define SECONDARYINDEX_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <limits.h>
+#include <string.h>
+#include <stdio.h>
+#include "schema.h"
+#include "rowview.h"
+#include "BPlusTree/bpt.h"
+
+using namespace std;
+
+/**
+ * A B+ tree on a table column, mapping the column values to the registry
+ * positions of their rows, so the lookups by value don't scan the data file.
+ * The key is the value followed by the _id of the row, so the repeated values
+ * have different keys and a value is found by a range search:
+ * e.g.: | VALUE (24 bytes) | _ID (8 bytes) |
+ * Both parts are stored so the byte order is the value order: the integers
+ * and the reals are big endian with the sign bit flipped (the negative reals
+ * have all the bits flipped) and the strings keep their first 24 characters.
+ * The entries are never removed: the removed and updated rows keep their old
+ * entries until the table is compacted, so the rows found must be checked.
+ * The index is persisted next to the table:
+ * e.g.: for the table person, the index of the column city is person_city_i.dat
+ * Every write is flushed to the file, but the tree keeps its meta on memory,
+ * so only one instance may write to an index file at a time
+ * @see bpt::bplus_tree
+ */
+class SecondaryIndex {
+public:
+    static const size_t VALUE_SIZE = 24;
+    
+private:
+    string path;
+    bpt::bplus_tree * tree; // NULL after the index is dropped
+    
+    /**
+     * Write the number on the buffer, most significant byte first
+     */
+    static void writeBigEndian(unsigned long long value, char * buffer);
+    
+    /**
+     * @return the tree, opening or creating the file if needed
+     */
+    bpt::bplus_tree * getTree();
+    
+    /**
+     * @return the registry positions of the keys between left and right
+     */
+    vector<long long> * findRange(bpt::key_t left, const bpt::key_t & right);
+    
+public:
+    /**
+     * Opens the index file, creating it if it doesn't exist
+     * @constructor
+     */
+    SecondaryIndex(const string & path);
+    
+    /**
+     * @destructor
+     */
+    ~SecondaryIndex();
+    
+    /**
+     * Get the type of the index keys: 0 for integers, 1 for reals and 2 for strings
+     * @see Join::getKeyCategory
+     */
+    static int getKeyCategory(SchemaCol & schema_col);
+    
+    /**
+     * Make the key of a value of the row
+     */
+    static bpt::key_t makeKey(long long value, long long _id);
+    static bpt::key_t makeKey(double value, long long _id);
+    static bpt::key_t makeKey(const char * value, size_t length, long long _id);
+    static bpt::key_t makeKey(const string & value, long long _id);
+    
+    /**
+     * Make the key of a column of the row. The _id is the first column
+     */
+    static bpt::key_t makeKey(RowView & row, int column_position);
+    
+    /**
+     * Add the key of a row, or move it to the new registry position
+     */
+    void insert(const bpt::key_t & key, long long registry_position);
+    
+    /**
+     * @return true if the key is on the index with the registry position
+     */
+    bool contains(const bpt::key_t & key, long long registry_position);
+    
+    /**
+     * Get the registry positions of the rows that may have the value, in the
+     * order of the rows _ids. The positions must be checked, they may belong
+     * to rows that were removed or updated or have other strings with the same
+     * prefix
+     */
+    vector<long long> * find(long long value);
+    vector<long long> * find(double value);
+    vector<long long> * find(const string & value);
+    
+    /**
+     * Find a value stored on the binary format
+     * @see ColumnBloomFilter::hashValue
+     */
+    vector<long long> * find(const char * value_ptr, SchemaCol & schema_col);
+    
+    /**
+     * Get the registry positions of the rows that may have a value between min
+     * and max, included, in the order of the values. The positions must be checked
+     */
+    vector<long long> * findBetween(long long min, long long max);
+    vector<long long> * findBetween(double min, double max);
+    
+    /**
+     * Remove all the keys
+     */
+    void clear();
+    
+    string getPath();
+    
+    /**
+     * Delete the index file and the keys
+     */
+    void drop();
+    
+    /**
+     * Open the index of each column of the table that has an index file. The
+     * other columns get NULL
+     */
+    static void openAll(const string & table_name, Schema & schema, vector<SecondaryIndex *> & indexes);
+    
+    /**
+     * Close and delete the indexes
+     */
+    static void closeAll(vector<SecondaryIndex *> & indexes);
+    
+    /**
+     * Remove all the keys of the indexes that are not NULL
+     */
+    static void clearAll(vector<SecondaryIndex *> & indexes);
+    
+    /**
+     * Delete the files of the indexes that are not NULL
+     */
+    static void dropAll(vector<SecondaryIndex *> & indexes);
+};
+
+const size_t SecondaryIndex::VALUE_SIZE;
+
+SecondaryIndex::SecondaryIndex(const string & path) {
+    this->path = path;
+    this->tree = NULL;
+    getTree();
+}
+
+SecondaryIndex::~SecondaryIndex() {
+    delete tree;
+}
+
+bpt::bplus_tree * SecondaryIndex::getTree() {
+    if (tree == NULL) {
+        ifstream file;
+        file.open(path.c_str(), ios::binary);
+        bool exists = file.is_open();
+        file.close();
+        tree = new bpt::bplus_tree(path.c_str(), !exists);
+    }
+    return tree;
+}
+
+void SecondaryIndex::writeBigEndian(unsigned long long value, char * buffer) {
+    for (int i = 7; i >= 0; i--) {
+        buffer[i] = (char) (value & 0xff);
+        value >>= 8;
+    }
+}
+
+int SecondaryIndex::getKeyCategory(SchemaCol & schema_col) {
+    if (schema_col.isInteger()) {
+        return 0;
+    } else if (schema_col.isReal()) {
+        return 1;
+    }
+    return 2;
+}
+
+bpt::key_t SecondaryIndex::makeKey(long long value, long long _id) {
+    bpt::key_t key;
+    writeBigEndian((unsigned long long) value ^ 0x8000000000000000ULL, key.k);
+    writeBigEndian((unsigned long long) _id ^ 0x8000000000000000ULL, key.k + VALUE_SIZE);
+    return key;
+}
+
+bpt::key_t SecondaryIndex::makeKey(double value, long long _id) {
+    // -0.0 and 0.0 are the same key
+    if (value == 0) {
+        value = 0;
+    }
+    unsigned long long bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bits = (bits & 0x8000000000000000ULL) ? ~bits : bits ^ 0x8000000000000000ULL;
+    
+    bpt::key_t key;
+    writeBigEndian(bits, key.k);
+    writeBigEndian((unsigned long long) _id ^ 0x8000000000000000ULL, key.k + VALUE_SIZE);
+    return key;
+}
+
+bpt::key_t SecondaryIndex::makeKey(const char * value, size_t length, long long _id) {
+    bpt::key_t key;
+    memcpy(key.k, value, min(length, VALUE_SIZE));
+    writeBigEndian((unsigned long long) _id ^ 0x8000000000000000ULL, key.k + VALUE_SIZE);
+    return key;
+}
+
+bpt::key_t SecondaryIndex::makeKey(const string & value, long long _id) {
+    return makeKey(value.data(), value.size(), _id);
+}
+
+bpt::key_t SecondaryIndex::makeKey(RowView & row, int column_position) {
+    long long _id = row.getInteger(0);
+    switch (getKeyCategory(row.getSchema()->getCols()->at(column_position))) {
+        case 0: return makeKey(row.getInteger(column_position), _id);
+        case 1: return makeKey(row.getReal(column_position), _id);
+        default: return makeKey(row.getChars(column_position), row.getCharsLength(column_position), _id);
+    }
+}
+
+void SecondaryIndex::insert(const bpt::key_t & key, long long registry_position) {
+    if (getTree()->insert(key, registry_position) != 0) {
+        // The row was indexed already
+        tree->update(key, registry_position);
+    }
+}
+
+bool SecondaryIndex::contains(const bpt::key_t & key, long long registry_position) {
+    bpt::value_t value;
+    return getTree()->search(key, &value) == 0 && value == registry_position;
+}
+
+vector<long long> * SecondaryIndex::findRange(bpt::key_t left, const bpt::key_t & right) {
+    // The search stops when the values are full, so it is repeated with
+    // more room until all of them fit
+    vector<bpt::value_t> values(64);
+    int number_of_values;
+    while ((number_of_values = getTree()->search_range(&left, right, &values[0], values.size())) == (int) values.size()) {
+        values.resize(values.size() * 2);
+    }
+    
+    vector<long long> * positions = new vector<long long>;
+    if (number_of_values > 0) {
+        positions->assign(values.begin(), values.begin() + number_of_values);
+    }
+    return positions;
+}
+
+vector<long long> * SecondaryIndex::find(long long value) {
+    return findRange(makeKey(value, LLONG_MIN), makeKey(value, LLONG_MAX));
+}
+
+vector<long long> * SecondaryIndex::find(double value) {
+    return findRange(makeKey(value, LLONG_MIN), makeKey(value, LLONG_MAX));
+}
+
+vector<long long> * SecondaryIndex::find(const string & value) {
+    return findRange(makeKey(value, LLONG_MIN), makeKey(value, LLONG_MAX));
+}
+
+vector<long long> * SecondaryIndex::find(const char * value_ptr, SchemaCol & schema_col) {
+    if (schema_col.type == INT32) {
+        int value;
+        memcpy(&value, value_ptr, sizeof(value));
+        return find((long long) value);
+    } else if (schema_col.isInteger()) {
+        long long value;
+        memcpy(&value, value_ptr, sizeof(value));
+        return find(value);
+    } else if (schema_col.type == FLOAT) {
+        float value;
+        memcpy(&value, value_ptr, sizeof(value));
+        return find((double) value);
+    } else if (schema_col.type == DOUBLE) {
+        double value;
+        memcpy(&value, value_ptr, sizeof(value));
+        return find(value);
+    }
+    return find(string(value_ptr, strnlen(value_ptr, schema_col.getSize())));
+}
+
+vector<long long> * SecondaryIndex::findBetween(long long min, long long max) {
+    if (min > max) {
+        return new vector<long long>;
+    }
+    return findRange(makeKey(min, LLONG_MIN), makeKey(max, LLONG_MAX));
+}
+
+vector<long long> * SecondaryIndex::findBetween(double min, double max) {
+    if (!(min <= max)) {
+        return new vector<long long>;
+    }
+    return findRange(makeKey(min, LLONG_MIN), makeKey(max, LLONG_MAX));
+}
+
+void SecondaryIndex::clear() {
+    delete tree;
+    tree = new bpt::bplus_tree(path.c_str(), true);
+}
+
+string SecondaryIndex::getPath() {
+    return path;
+}
+
+void SecondaryIndex::drop() {
+    delete tree;
+    tree = NULL;
+    remove(path.c_str());
+}
+
+void SecondaryIndex::openAll(const string & table_name, Schema & schema, vector<SecondaryIndex *> & indexes) {
+    closeAll(indexes);
+    
+    vector<SchemaCol> * schema_cols = schema.getCols();
+    for (vector<SchemaCol>::iterator it = schema_cols->begin(); it != schema_cols->end(); it++) {
+        string path = table_name + "_" + (*it).key + "_i.dat";
+        ifstream file;
+        file.open(path.c_str(), ios::binary);
+        if (file.is_open()) {
+            file.close();
+            indexes.push_back(new SecondaryIndex(path));
+        } else {
+            indexes.push_back(NULL);
+        }
+    }
+}
+
+void SecondaryIndex::closeAll(vector<SecondaryIndex *> & indexes) {
+    for (vector<SecondaryIndex *>::iterator it = indexes.begin(); it != indexes.end(); it++) {
+        delete *it;
+    }
+    indexes.clear();
+}
+
+void SecondaryIndex::clearAll(vector<SecondaryIndex *> & indexes) {
+    for (vector<SecondaryIndex *>::iterator it = indexes.begin(); it != indexes.end(); it++) {
+        if (*it != NULL) {
+            (*it)->clear();
+        }
+    }
+}
+
+void SecondaryIndex::dropAll(vector<SecondaryIndex *> & indexes) {
+    for (vector<SecondaryIndex *>::iterator it = indexes.begin(); it != indexes.end(); it++) {
+        if (*it != NULL) {
+            (*it)->drop();
+        }
+    }
+}
+
+#endif //SECONDARYINDEX_H
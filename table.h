@@ -4,54 +4,466 @@
 #include "util.h"
 #include "schema.h"
 #include "cursor.h"
+#include "predicate.h"
+#include "queryparser.h"
+#include "plancache.h"
+#include "queryplanner.h"
+#include "hashindex.h"
 #include "queryable.h"
 #include "join.h"
+#include "mappedfile.h"
+#include "bufferpool.h"
+#include "varcharheap.h"
+#include "dictionary.h"
+#include "writeaheadlog.h"
+#include "numericcodec.h"
+#include "csvtokenizer.h"
+#include "zonemap.h"
+#include "timer.h"
 #include <fstream>
 #include <time.h>
 #include <string.h>
 #include <algorithm>
 #include <utility> //std::pair
+#include <limits>
+#include <thread>
 #include <stdio.h>
 
+class BulkWriter;
+class TableScan;
+class PreparedStatement;
+
+/**
+ * How the registries are read from the data file.
+ * STREAM_READ opens the file and reads the registry on every call.
+ * MMAP_READ maps the data file on memory, so reading a registry is a pointer
+ * arithmetic. The mapping grows when registries are appended to the file
+ */
+enum ReadMode { STREAM_READ, MMAP_READ };
+
+/**
+ * How the registry positions are found.
+ * HEADER_FILE stores the (_id, registry_position) pairs on the header file and
+ * loads them on memory when the table is created.
+ * POSITIONAL computes the position from the _id, since all the registries have
+ * the same size and the _ids are sequential:
+ * registry_position = FILE_HEADER_SIZE + _id * registry_size
+ * No header file is written, so a table created on POSITIONAL mode must always
+ * be loaded on this mode
+ */
+enum HeaderMode { HEADER_FILE, POSITIONAL };
 
 class Table : public Queryable{
+public:
+    static const long long WAL_CHECKPOINT_SIZE = 64 * 1024 * 1024;
+    static const size_t CSV_CHUNK_SIZE = 4 * 1024 * 1024;
+    static const size_t MAX_COALESCED_READ = 1024 * 1024;
+    
 private:
     unsigned HEADER_SIZE;
+    unsigned FILE_HEADER_SIZE;
 
     Schema schema;
     string name;
     string path;
     string header_file_path;
     header_t * header; // _id, registry_position
+    HeaderMode header_mode;
+    long long number_of_rows; // the number of registries (POSITIONAL only)
+    
+    ReadMode read_mode;
+    MappedFile mapped_file; // the data file mapped on memory (MMAP_READ only)
+    vector<char> registry_buffer; // the last registry read (STREAM_READ only)
+    
+    VarcharHeap varchar_heap; // the VARCHAR values that don't fit on the registry
+    vector<Dictionary *> dictionaries; // one per column, NULL if not dictionary encoded
+    ZoneMap zone_map; // the min/max of the numeric columns for every block of rows
+    PlanCache plan_cache; // the plans of the last queries, by their normalized text
+    long long schema_version; // incremented when the schema changes, the older plans are resolved again
+    vector<ColumnBloomFilter *> bloom_filters; // one per column, NULL if the column has no filter
+    vector<SecondaryIndex *> indexes; // one per column, NULL if the column has no index
+    HashIndex * hash_index; // _id -> registry_position, NULL if the table has no hash index
+    TableStatistics statistics; // used by the planner, measured by analyze
+    long long statistics_version; // incremented by each analyze, the plans choose their paths again
+    
+    BufferPool * buffer_pool; // the pages cache used by the reads and writes, if any
+    int data_file_id; // the files ids on the buffer pool
+    int header_file_id;
+    
+    WriteAheadLog * wal; // the log of the inserts, if enabled
+    recursive_mutex write_mutex; // serializes the writers and the checkpoints, the log sync is shared
     
     friend class TableBenchmark;
+    friend class BulkWriter;
+    friend class TableScan;
+    friend class PreparedStatement;
     
     /**
-     * Save a value to the file using the correct type and size. The file
-     * will not be opened nor closed inside this method
+     * The registries of a CSV chunk, encoded by an import worker. The values
+     * stored on the heap or on a dictionary must be encoded in the row order,
+     * so the workers keep them as strings
      */
-    void convertAndSave(ofstream *file, string * value, SchemaCol * schema_col);
-     
+    struct EncodedChunk {
+        struct DeferredValue {
+            long long row_index;
+            int column_position;
+            string value;
+        };
+        
+        vector<char> registries;
+        long long number_of_rows;
+        vector<DeferredValue> deferred_values;
+    };
+    
+    /**
+     * Encode a whole registry (header and row) into the buffer. The buffer must
+     * have at least HEADER_SIZE + schema.getSize() bytes available
+     * @param row - the table row (primary key not included)
+     * @param _id - the primary key to be stored on the first column
+     * @param chunk - if set, the heap and dictionary values are not encoded
+     *                but deferred to the chunk, so the method is thread safe
+     */
+    void encodeRow(vector<string> & row, long long _id, char * buffer, EncodedChunk * chunk = NULL);
+    
+    /**
+     * Encode the CSV lines of the buffer (import worker)
+     * @param registry_size computed by the caller, the schema caches its size
+     *        and offsets on the first call, which is not thread safe
+     */
+    void encodeChunk(const string * buffer, size_t registry_size, EncodedChunk * chunk);
+    
+    /**
+     * Encode the deferred values of the chunk and append its registries
+     */
+    void appendChunk(BulkWriter & writer, EncodedChunk & chunk);
+    
+    /**
+     * Encode the table file header into the buffer. The buffer must have at
+     * least FILE_HEADER_SIZE bytes available
+     */
+    void encodeFileHeader(char * buffer);
+    
+    /**
+     * Read the file header from the data file
+     * @return false if the file doesn't exist or was written using
+     *         the legacy layout
+     */
+    bool readFileHeader(TableFileHeader * file_header);
+    
+    /**
+     * Check if the data file, if any, matches the current schema. A message
+     * is shown when the file must be migrated or was created by another schema
+     */
+    void checkFileHeader();
+    
+    /**
+     * Get the bytes of a registry, header included. The pointer is valid until
+     * the next read or until the table is modified
+     * @return the registry or NULL if it's not on the file
+     */
+    const char * readRegistry(long long registry_position);
+    
     /**
-     * Inserts the registry_position on the header file. The insertion will
-     * append the new registry_position to the end of the header file and will
-     * update the header variable
+     * Get the bytes of many contiguous registries at once
+     * @see Table::readRegistry
      */
-    bool insertOnHeaderFile(HeaderFile * header_file);
+    const char * readRegistries(long long registry_position, long long number_of_registries);
+    
+    /**
+     * Open the data and header files on the buffer pool, if they are not open
+     */
+    void openPoolFiles();
+    
+    /**
+     * Flush and close the data and header files on the buffer pool
+     */
+    void closePoolFiles();
+    
+    /**
+     * Convert the registry values to strings
+     * @return a vector containing the _id and the row content
+     */
+    vector<string> decodeRow(const char * registry);
      
     /**
-     * Load the table header from the memory
+     * Load the table header from the memory. On POSITIONAL mode, only the number
+     * of rows is loaded
      */
     void loadHeader();
     
+    /**
+     * @return the size of the registries, header included
+     */
+    unsigned getRegistrySize();
+    
+    /**
+     * @return the registry position of the _id or -1 if it's not on the table
+     */
+    long long findRegistryPosition(long long _id);
+    
+    /**
+     * @return the _id of the next inserted row. The _ids of the removed rows
+     *         are not reused
+     */
+    long long getNextId();
+    
+    /**
+     * Write the bytes at the position of the data file, through the buffer
+     * pool if any
+     */
+    bool writeRegistry(long long registry_position, const char * data, size_t size);
+    
+    /**
+     * Write the VARCHAR heap and the new dictionary values, so the registries
+     * written after it never point to missing values
+     */
+    void saveValues();
+    
+    /**
+     * @return true if the registry has the tombstone flag
+     */
+    static bool isDeleted(const char * registry);
+    
+    /**
+     * Encode the _id and the row values as a log record
+     * e.g.: | _id | NUMBER_OF_VALUES | LENGTH_1 | VALUE_1 | LENGTH_2 | VALUE_2 | ...
+     */
+    static string encodeLogRecord(long long _id, vector<string> & row);
+    static void decodeLogRecord(const string & record, long long * _id, vector<string> * row);
+    
+    /**
+     * Wait until the inserts up to the log sequence are durable
+     * @return false if the log could not be written
+     */
+    bool syncLog(unsigned long long log_sequence);
+    
+    /**
+     * Drop the rows with _id equal or greater than the first_id from the header
+     * and from the files, including the registries that were not completely written
+     */
+    void truncateRows(long long first_id);
+    
+    /**
+     * Load the zone map (<name>_z.dat), rebuilding it if it doesn't have
+     * all the rows of the data file
+     */
+    void loadZoneMap();
+    
+    /**
+     * Scan the data file and build the zone map again
+     */
+    void rebuildZoneMap();
+    
+    /**
+     * Add the values of a row to the Bloom filters of its columns
+     * @param row_data the row values, without the registry header
+     * @param row_index the row order on the table
+     */
+    void addFilterValues(const char * row_data, long long row_index);
+    
+    /**
+     * Rebuild the Bloom filters that don't have all the rows of the data file
+     */
+    void loadBloomFilters();
+    
+    /**
+     * Scan the data file and build the Bloom filter of the column again
+     */
+    void rebuildBloomFilter(int column_position);
+    
+    /**
+     * Add the values of a row to the indexes of its columns
+     * @param row_data the row values, without the registry header
+     */
+    void addIndexKeys(const char * row_data, long long registry_position);
+    
+    /**
+     * Add the last rows that are not on the indexes, e.g. the rows appended
+     * by another program that didn't open the indexes
+     */
+    void loadIndexes();
+    
+    /**
+     * Open the hash index of the _ids (<name>_x.dat), if it was created, and
+     * add the last rows that are not on it
+     */
+    void loadHashIndex();
+    
+    /**
+     * Scan the data file and build the hash index again
+     */
+    void rebuildHashIndex();
+    
+    /**
+     * Get the registry positions where the column may have the value, from
+     * its secondary index. The positions must be checked
+     */
+    vector<long long> * findIndexCandidates(int column_position, const string & value);
+    
+    /**
+     * Scan the data file and build the index of the column again
+     */
+    void rebuildIndex(int column_position);
+    
+    /**
+     * @return true if the registry is not removed and its column has the value
+     * @param expected_value the value on the binary format, unused for the
+     *        VARCHAR columns that are not dictionary encoded
+     */
+    bool isEqual(const char * registry, int column_position, const string & value, const vector<char> & expected_value);
+    
+    /**
+     * Resolve the selected columns of a query and check its conditions
+     * @return false if a column is not on the schema
+     */
+    bool makePlan(const QueryStatement & statement, QueryPlan * plan);
+    
+    /**
+     * @return false if a column of the condition is not on the schema
+     */
+    bool checkColumns(const QueryCondition & condition);
+    
+    /**
+     * Get the plan of a normalized query from the cache, parsing the query
+     * and adding its plan if it's not there
+     * @return the plan or NULL if the query is invalid
+     */
+    shared_ptr<QueryPlan> getPlan(const string & text);
+    
+    /**
+     * Run a plan with the values of its parameters
+     * @return the cursor associated with the query, empty if a parameter is missing
+     */
+    Cursor execute(const QueryPlan & plan, const vector<string> & parameters);
+    
+    /**
+     * Replace the parameters of the condition by their values
+     */
+    static void bindParameters(QueryCondition * condition, const vector<string> & parameters);
+    
+    /**
+     * @return true if a parameter of the condition is the bound of a range, so
+     *         its value changes the estimated rows of the access paths
+     */
+    static bool hasRangeParameter(const QueryCondition & condition);
+    
+    /**
+     * Compile a condition of a query to predicates on the types of its columns
+     * @return false if a column is not on the schema
+     */
+    bool compileCondition(const QueryCondition & condition, PredicateTree * tree);
+    
+    /**
+     * Compile the conditions of a plan with the values of its parameters and
+     * choose how its rows are read. The path chosen by a previous execution is
+     * reused while the statistics don't change, unless the values of the
+     * parameters can change the choice. The range paths are always costed
+     * again, their rows depend on the values
+     * @param paths the access paths that may be used, the cheapest first. Only
+     *        the chosen one if it was reused
+     * @param reuse_chosen_path false to cost all the paths again, e.g. to explain them
+     * @return false if a parameter is missing or a column is not on the schema
+     */
+    bool planExecution(const QueryPlan & plan, const vector<string> & parameters, PredicateTree * predicates,
+        vector<AccessPath> * paths, bool reuse_chosen_path);
+    
+    /**
+     * Build the access path chosen before with the values of a new execution
+     * @param where the bound conditions, NULL if the query has no WHERE clause
+     */
+    AccessPath makeChosenPath(const QueryCondition * where, const ChosenPath & chosen);
+    
+    /**
+     * Estimate the cost of every way to read the rows of a query: a scan of
+     * the blocks that the zone map doesn't skip, the header for the _id
+     * equalities and ranges, the hash index for the _id equalities and the
+     * secondary indexes for the equalities and the numeric ranges of the
+     * indexed columns. Only the conditions joined by AND at the top of the
+     * WHERE clause choose a path, the others are checked on the rows read
+     * @param where the conditions, NULL if the query has no WHERE clause
+     * @param limit the LIMIT of the query, -1 if there is none
+     * @param paths the paths, the cheapest first
+     */
+    void planAccess(const QueryCondition * where, const PredicateTree & predicates, long long limit,
+        vector<AccessPath> * paths);
+    
+    /**
+     * Analyze the table if it was never analyzed or its number of rows
+     * doubled or halved since. Called by the writes and when the schema is set
+     */
+    void refreshStatistics();
+    
+    /**
+     * @return the estimated fraction of the rows that satisfy the condition
+     */
+    double estimateSelectivity(const QueryCondition & condition);
+    
+    /**
+     * Estimate the rows with min <= value <= max from the zones of a numeric
+     * column, assuming that the values are uniform inside each block
+     * @return the number of rows or -1 if the column has no zones
+     */
+    double estimateRangeRows(int column_position, double min, double max);
+    
+    /**
+     * @return the rows of the blocks that the zone map doesn't skip, between
+     *         the first row and the end one (-1 for all the rows)
+     */
+    long long countScanRows(const PredicateTree & predicates, long long first_index, long long end_index);
+    
+    /**
+     * Read the candidates of an access path
+     * @param first_index the first row to scan, if there are no candidates
+     * @param end_index the row after the last one to scan, -1 for all the rows
+     * @return the registry positions of the candidates in the rows order or
+     *         NULL if the rows must be scanned
+     */
+    vector<long long> * readAccessPath(const AccessPath & path, long long * first_index, long long * end_index);
+    
+    /**
+     * @return the lines of the EXPLAIN of a plan: the chosen path and the others
+     */
+    string explain(const QueryPlan & plan, const vector<string> & parameters);
+    
+    /**
+     * Parse an _id value, the _ids are always integers
+     * @return false if the value is not an integer
+     */
+    static bool parseId(const string & value, long long * _id);
+    
+    /**
+     * Get the rows where min_id <= _id <= max_id
+     * @param first_index the first row of the range
+     * @param end_index the row after the last one of the range or -1 if the
+     *        range has no upper bound
+     */
+    void findIdRange(long long min_id, long long max_id, long long * first_index, long long * end_index);
+    
 public:
 
+    /**
+     * Save a value to the buffer using the correct type and size. The buffer
+     * must have at least schema_col->getSize() bytes available
+     * @param varchar_heap the heap used by the long VARCHAR values
+     * @param dictionary the dictionary of a dictionary encoded column
+     */
+    static void convertAndSave(char *buffer, string * value, SchemaCol * schema_col,
+        VarcharHeap * varchar_heap = NULL, Dictionary * dictionary = NULL);
+    
+    /**
+     * Convert a value stored on the binary format to string
+     * @see Table::convertAndSave
+     */
+    static string convertToString(const char * buffer, SchemaCol * schema_col,
+        VarcharHeap * varchar_heap = NULL, Dictionary * dictionary = NULL);
+
     /**
      * The constructor loads the table header from the memory, if any
+     * @param header_mode how the registry positions are found
      * @constructor
      * @see Table::loadHeader
      */
-    Table(string name);
+    Table(string name, HeaderMode header_mode = HEADER_FILE);
     
     /**
      * @destructor
@@ -70,7 +482,54 @@ public:
     void setSchema(Schema schema);
 
     Schema getSchema();
+    
+    /**
+     * Get the (_id, registry_position) pairs. On POSITIONAL mode the header
+     * is built on the first call
+     */
     header_t * getHeader();
+    HeaderMode getHeaderMode();
+    
+    /**
+     * Set how the registries are read
+     * @see ReadMode
+     */
+    void setReadMode(ReadMode read_mode);
+    ReadMode getReadMode();
+    
+    /**
+     * Set the buffer pool used by the reads and writes of the data and header
+     * files. The shared pool can be used by many tables
+     * @see BufferPool::getShared
+     * @param buffer_pool the pool or NULL to access the files directly
+     */
+    void setBufferPool(BufferPool * buffer_pool);
+    BufferPool * getBufferPool();
+    
+    /**
+     * Write the pages modified on the buffer pool to the files
+     */
+    void flush();
+    
+    /**
+     * Log the inserts on the write-ahead log (<name>_w.dat), so an insert is durable
+     * when it returns. The concurrent inserts share the same sync (group commit).
+     * If the table was not checkpointed, the rows inserted after the last
+     * checkpoint are dropped from the files and replayed from the log. The
+     * schema must be set before calling this method
+     * @see WriteAheadLog
+     * @return false if the log could not be opened
+     */
+    bool enableWriteAheadLog();
+    WriteAheadLog * getWriteAheadLog();
+    
+    /**
+     * Write the table files to the disk and truncate the write-ahead log.
+     * Made when the log grows over WAL_CHECKPOINT_SIZE and when the table is closed.
+     * The writers wait for it, so no appended record is discarded before it's
+     * on the data files
+     */
+    void checkpoint();
     
     /*****************************************
      ************* QUERY METHODS *************
@@ -83,16 +542,75 @@ public:
      * @param row - the table row (primary key not included). Note that
      *              the order of elements is important and it's expected
      *              to be the same as the order on the schema
-     * @return the _id of the inserted item (used as primary key)
+     * @return the _id of the inserted item (used as primary key) or -1 if
+     *         the write-ahead log could not make it durable
      */
     long long insert(vector<string> row);
     
+    /**
+     * Insert many rows at the end of the table. The data and header files are
+     * opened only once and the rows are written in large blocks
+     * @see BulkWriter
+     * @return the _id of the first inserted item or -1 if the write-ahead log
+     *         could not make the items durable. The other items have
+     *         consecutive _ids
+     */
+    long long insertBatch(vector<vector<string> > & rows);
+    
+    /**
+     * Overwrite the row of the _id in place. The registries have a fixed width,
+     * so only the bytes of that registry are written
+     * @param row - the new row content (primary key not included)
+     * @return false if the _id is not on the table or was removed
+     */
+    bool update(long long _id, vector<string> row);
+    
+    /**
+     * Mark the row of the _id as removed, setting the tombstone flag on its
+     * registry header. The registry stays on the file until the compaction
+     * @return false if the _id is not on the table or was already removed
+     */
+    bool remove(long long _id);
+    
+    /**
+     * Rewrite the data and header files without the removed rows, in one
+     * sequential pass. The new files are written next to the current ones and
+     * replace them at the end.
+     * The compaction is offline: the writers wait for it, but the reads are
+     * not synchronized and the filters and indexes are empty until the pass
+     * ends, so no query, lookup, cursor or join may use the table meanwhile.
+     * The cursors and the joins opened before the compaction must not be
+     * used after it either, they keep the old registry positions.
+     * The _ids are kept, so the POSITIONAL tables can't be compacted. The
+     * last registry is kept even if removed, so its _id is never reused
+     * @return the number of registries removed from the files
+     */
+    long long compact();
+    
     /**
      * Get a line from the file, given the registry position.
-     * @return a vector containing the _id and the row content
+     * @return a vector containing the _id and the row content or an empty
+     *         vector if the row was removed
      */
     vector<string> getRow(long long registry_position);
     
+    /**
+     * Get many rows, given the registry positions. The positions are sorted
+     * and the registries that are next to each other on the file are read at
+     * once, using reads of up to MAX_COALESCED_READ bytes
+     * @return the rows in the same order as the positions. The removed rows
+     *         are empty vectors
+     */
+    vector<vector<string> > getRows(const vector<long long> & registry_positions);
+    
+    /**
+     * Get a typed view of a row, given the registry position. The values are
+     * not converted to strings and the view is valid until the next read.
+     * The view is invalid if the row was removed
+     * @see RowView
+     */
+    RowView getRowView(long long registry_position);
+    
     /**
      * Get a row from the file, given the specified _id. This
      * method uses the binary search algorithm
@@ -105,24 +623,53 @@ public:
      * Deletes the table and all its associated files
      */
     void drop();
+    
+    /**
+     * Convert a data file written with the legacy layout, where every registry
+     * stores the table name, to the current layout. The header file is rebuilt
+     * and the in-memory header is reloaded. The schema must be set before
+     * calling this method
+     * @return true if the file was migrated
+     */
+    bool migrate();
      
     /**
-     * Perform a query. Note that the string is case insensitive and the FROM clause is omitted
-     * because the FROM is for the table instance.
-     * Supported arguments: SELECT, *, WHERE, =, <, >, <=, >=, !=
+     * Perform a query. The keywords are case insensitive, the column names and
+     * the strings are not. The FROM clause is omitted because the FROM is for
+     * the table instance.
+     * Supported arguments: SELECT, *, WHERE, AND, OR, parentheses, IN, BETWEEN,
+     * LIMIT, =, !=, <>, <, >, <=, >=. The conditions separated by commas are
+     * joined by AND
      * e.g.: query("SELECT * WHERE _id=123") -> returns the only row where the _id is equals to 123
      * e.g.2: query("select name, age where age > 10 and name='bruno'") -> returns the name and age where
-     *        the age > 10 and the name is equal to bruno (case insensitive)
-     * e.g.3: query("SELECT *") -> returns all the columns
+     *        the age > 10 and the name is equal to bruno
+     * e.g.3: query("SELECT name WHERE city IN ('Rio', 'Natal') OR age BETWEEN 10 AND 20 LIMIT 5")
+     * e.g.4: query("SELECT *") -> returns all the columns
+     * The literals of the WHERE clause are replaced by parameters and the plan
+     * is kept on the cache, so the queries that differ only on their values
+     * are parsed once
+     * @see QueryParser
+     * @see Table::prepare
      * @param q - the query on a raw string format
-     * @return the cursor associated with the query
+     * @return the cursor associated with the query, empty if the query is invalid
      */
     Cursor query(string q);
      
     /**
-     * Perform a query
+     * Perform a query. The conditions are compiled to the types of their columns
+     * and evaluated on the binary values, and only the selected columns are
+     * converted to strings. An equality on the _id or on an indexed column
+     * reads only the rows found, the other queries skip the blocks out of the
+     * zones of their numeric conditions. The rows are read as the cursor moves,
+     * so the table must outlive the cursor
+     * @see TableScan
      * @see Table::query(string)
-     * @return the cursor associated with the query
+     * @see Predicate
+     * @param select the selected columns, all of them if it's empty or "*"
+     * @param where_args the columns of the conditions, which are joined by AND
+     * @param where_comparators =, !=, <, >, <= or >=
+     * @param where_values the values on the text format
+     * @return the cursor associated with the query, empty if the query is invalid
      */
     Cursor query(
             vector<string> & select,
@@ -130,14 +677,76 @@ public:
             vector<string> & where_comparators,
             vector<string> & where_values);
      
+    /**
+     * Perform a parsed query. The rows are read by the cheapest access path:
+     * a scan, the header, the hash index or a secondary index
+     * @see Table::explain
+     * @see Table::query(string)
+     * @return the cursor associated with the query, empty if the query is invalid
+     */
+    Cursor query(const QueryStatement & statement);
+     
+    /**
+     * Prepare a query to run many times. The values marked by ? are bound
+     * before each execution, the query is parsed and resolved only once.
+     * The plans are shared by the queries with the same normalized text
+     * e.g.: PreparedStatement statement = table.prepare("SELECT name WHERE _id = ?");
+     *       statement.bindInteger(0, 123);
+     *       Cursor cursor = statement.execute();
+     * @see PlanCache
+     * @return the statement, invalid if the query is invalid
+     */
+    PreparedStatement prepare(string sql);
+     
+    /**
+     * @return the cache of the query plans
+     */
+    PlanCache * getPlanCache();
+     
+    /**
+     * Describe how a query would read its rows, without running it: the
+     * access path chosen by the planner, its estimated rows and cost, and
+     * the other paths it considered. A query starting with EXPLAIN prints
+     * the same text and returns an empty cursor
+     * e.g.: table.explain("SELECT name WHERE age = 30 AND city = 'Recife'")
+     *       -> PLAN: INDEX LOOKUP age (1 value): 120 rows, 1.3 us
+     *          ALTERNATIVE: FULL SCAN: 12000 rows, 1.2 ms
+     * @see AccessPath
+     * @return the explanation or an empty string if the query is invalid
+     */
+    string explain(string sql);
+     
+    /**
+     * Measure the statistics used by the planner: the number of distinct
+     * values of each column, from a sample of blocks, and the cost of a
+     * scan, of a random read, of a header search and of the index searches.
+     * The writes analyze the table when its number of rows doubled or halved
+     * since, so the queries never wait for it
+     * @see TableStatistics
+     */
+    void analyze();
+     
+    /**
+     * @return the statistics of the last analyze
+     */
+    TableStatistics * getStatistics();
+     
     /*****************************************
      ********** CONVENIENCE METHODS **********
      *****************************************/
      
     /**
-     * Read a CSV file, convert and export it to a binary file
+     * Read a CSV file, convert and export it to a binary file. The file is read
+     * in newline aligned chunks, which are parsed and encoded by many threads and
+     * appended in the file order. If the write-ahead log is enabled, the rows are
+     * not logged, the table is checkpointed at the end instead.
+     * Quoted values may contain commas, newlines and "" quotes. The empty lines
+     * are skipped, they are not imported as rows
+     * @see CSVTokenizer
+     * @param number_of_threads the number of workers, 0 for one per core
+     * @param chunk_size the amount of bytes read for each worker
      */
-    void convertFromCSV(const string & path);
+    void convertFromCSV(const string & path, unsigned number_of_threads = 0, size_t chunk_size = CSV_CHUNK_SIZE);
     
     /**
      * Print the table binary file (for debugging only)
@@ -167,49 +776,437 @@ public:
     string getValue(long long _id, int column_position);    
     
     /**
-     * @return the number of rows
+     * @return the number of registries, the removed ones included until the compaction
      */
     int getNumberOfRows();
-};
-
-
-Table::Table(string name) {
-    this->name = name;
-    this->path = name + ".dat";
-    this->header_file_path = name + "_h.dat";
-    this->header = new header_t();
-    loadHeader();
     
-    RegistryHeader reg_header;
-    Table::HEADER_SIZE = sizeof(reg_header.table_name) + sizeof(reg_header.registry_size) + sizeof(reg_header.time_stamp);
-    // cout << "HEADER_SIZE = " << HEADER_SIZE << endl;
+    /**
+     * @return the registry position of the row at the index
+     */
+    long long getRegistryPosition(long long index);
     
-}
-
-Table::~Table() {
-    delete this->header;
-}
-
-void Table::importSchema(const string & path) {
-    schema.import(path);
-}
-
-void Table::setSchema(Schema schema) {
-    this->schema = schema;
-}
-
-Schema Table::getSchema(){
-    return this->schema;
-}
-
-
-header_t * Table::getHeader(){
+    /**
+     * @return the dictionary of the column or NULL if the column is not
+     *         dictionary encoded
+     */
+    Dictionary * getDictionary(int column_position);
+    
+    /**
+     * Get the registry positions of the rows where the column is equal to the value.
+     * The values are compared on the binary format. On a dictionary encoded column,
+     * the value is converted to its code once and only the codes are compared.
+     * The blocks that can't have the value, by the zone map or by the Bloom
+     * filter of the column, are not read. If the column has an index, only
+     * the rows found on the index are read
+     */
+    vector<long long> * findEqual(string column_name, string value);
+    
+    /**
+     * Get the registry positions of the rows where min <= value <= max. The
+     * blocks whose zone can't have such values are not read
+     * @see ZoneMap
+     * @param column_name the name of an INT32, INT64, FOREIGN_KEY, FLOAT or DOUBLE column
+     */
+    vector<long long> * filterRange(string column_name, double min, double max);
+    vector<long long> * filterRange(int column_position, double min, double max);
+    
+    /**
+     * @return the zone map of the numeric columns
+     */
+    ZoneMap * getZoneMap();
+    
+    /**
+     * Create a Bloom filter for the column (<name>_<column>_b.dat), which is
+     * kept up to date by the inserts. The filter is consulted by findEqual and
+     * by the probes of the hash joins where this table is the build side, so
+     * the absent values are answered without reading the data file
+     * @see ColumnBloomFilter
+     * @return false if the column is not on the schema
+     */
+    bool createBloomFilter(string column_name);
+    
+    /**
+     * @return the Bloom filter of the column or NULL if the column has no filter
+     */
+    ColumnBloomFilter * getBloomFilter(int column_position);
+    
+    /**
+     * Create a secondary index for the column (<name>_<column>_i.dat), which
+     * is kept up to date by the inserts and the updates. The index is used by
+     * findEqual and by the joins, instead of scanning the column
+     * @see SecondaryIndex
+     * @return false if the column is not on the schema
+     */
+    bool createIndex(string column_name);
+    
+    /**
+     * @return the secondary index of the column or NULL if the column has no index
+     */
+    SecondaryIndex * getIndex(int column_position);
+    
+    /**
+     * Create a hash index of the _ids (<name>_x.dat), which is kept up to date
+     * by the inserts and the updates. The planner uses it for the _id
+     * equalities when a hash search is cheaper than a header search
+     * @see HashIndex
+     */
+    void createHashIndex();
+    
+    /**
+     * @return the hash index of the _ids or NULL if the table has no hash index
+     */
+    HashIndex * getHashIndex();
+};
+
+/**
+ * Appends many rows to a table keeping the data and header files open. The
+ * encoded rows and the header entries are kept on memory buffers and written
+ * in large blocks, avoiding the open/seek/close cost of Table::insert for
+ * every row.
+ * e.g.:
+ * BulkWriter writer(&table);
+ * writer.insert(row_1);
+ * writer.insert(row_2);
+ * writer.close();
+ */
+class BulkWriter {
+private:
+    Table * table;
+    ofstream data_file;
+    ofstream header_file;
+    
+    // Encoded registries and header entries waiting to be written
+    vector<char> data_buffer;
+    vector<char> header_buffer;
+    size_t buffer_size;
+    
+    // Position of the next registry on the data file
+    long long registry_position;
+    
+    // Position of the buffered bytes on the files (buffer pool only)
+    long long data_file_position;
+    long long header_file_position;
+    long long number_of_rows;
+    bool closed;
+    Timer timer;
+    unsigned long long log_sequence; // the log sequence of the last insert
+    
+    /**
+     * Add the header entry of the registry at the end of the buffer
+     * @return the _id
+     */
+    long long appendRegistry(long long _id);
+    
+public:
+    static const size_t DEFAULT_BUFFER_SIZE = 4 * 1024 * 1024;
+    
+    /**
+     * Opens the table data and header files for appending
+     * @param buffer_size the amount of bytes buffered before writing
+     *        to the data file
+     * @constructor
+     */
+    BulkWriter(Table * table, size_t buffer_size = DEFAULT_BUFFER_SIZE);
+    
+    /**
+     * Closes the writer if it was not closed yet
+     * @destructor
+     */
+    ~BulkWriter();
+    
+    /**
+     * Append a row to the buffer, flushing it if full
+     * @see Table::insert
+     * @return the _id of the inserted item
+     */
+    long long insert(vector<string> & row);
+    
+    /**
+     * Append a row using the given _id, which must be greater than the _ids
+     * on the table (used by the log replay)
+     */
+    long long insert(vector<string> & row, long long _id);
+    
+    /**
+     * Append an encoded registry, setting its _id. The registry is not logged
+     * @see Table::convertFromCSV
+     * @return the _id of the inserted item
+     */
+    long long insertRegistry(char * registry);
+    
+    /**
+     * Write the buffered registries and header entries to the files
+     */
+    void flush();
+    
+    /**
+     * Flush the buffers and close the files
+     */
+    void close();
+    
+    /**
+     * @return the number of rows inserted by this writer
+     */
+    long long getNumberOfRows();
+    
+    /**
+     * @return the insertion rate since the writer was created
+     */
+    double getRowsPerSecond();
+    
+    /**
+     * @return the write-ahead log sequence of the last insert or 0 if nothing
+     *         was logged. The inserts are durable after Table::syncLog
+     */
+    unsigned long long getLogSequence();
+};
+
+/**
+ * A query parsed once and run many times with different values. The values
+ * are bound to the parameters (?) by their order on the query, from 0, and
+ * they are kept between the executions.
+ * e.g.:
+ * PreparedStatement statement = table.prepare("SELECT * WHERE age > ? AND city = ?");
+ * statement.bindInteger(0, 10);
+ * statement.bind(1, "Natal");
+ * Cursor cursor = statement.execute();
+ * @see Table::prepare
+ */
+class PreparedStatement {
+private:
+    Table * table;
+    shared_ptr<QueryPlan> plan; // NULL if the query is invalid
+    vector<string> parameters;
+    vector<bool> bound;
+    
+public:
+    /**
+     * Creates an invalid statement
+     * @constructor
+     */
+    PreparedStatement();
+    
+    /**
+     * @constructor
+     */
+    PreparedStatement(Table * table, shared_ptr<QueryPlan> plan);
+    
+    /**
+     * @return false if the query is invalid
+     */
+    bool isValid();
+    
+    int getNumberOfParameters();
+    
+    /**
+     * Set the value of a parameter, on the text format
+     * @return false if there is no such parameter
+     */
+    bool bind(int index, const string & value);
+    bool bindInteger(int index, long long value);
+    bool bindReal(int index, double value);
+    
+    /**
+     * Unset the values of all the parameters
+     */
+    void clearBindings();
+    
+    /**
+     * Run the query with the values bound
+     * @return the cursor associated with the query, empty if the statement is
+     *         invalid or a parameter is not bound
+     */
+    Cursor execute();
+};
+
+/**
+ * The rows of a table that satisfy the predicates of a query, read one
+ * block at a time as the cursor moves. Only the current block is kept: it's
+ * copied from the table read buffer, so the other reads on the table don't
+ * change it. The blocks out of the zones of the numeric predicates are not
+ * read. When the candidates are given (e.g. by an index), only their
+ * registries are read. The scan stops at the limit of rows.
+ * @see Cursor
+ */
+class TableScan : public RowSource {
+private:
+    Table * table;
+    PredicateTree predicates;
+    vector<long long> candidates; // registry positions, used if has_candidates
+    bool has_candidates;
+    long long first_index; // the rows scanned, if there are no candidates
+    long long end_index; // -1 to read until the last row
+    long long limit; // -1 for all the rows
+    
+    vector<char> buffer; // the registries being read
+    long long buffered_rows;
+    long long current_row; // on the buffer
+    long long next_index; // the next row or candidate to read
+    long long number_of_rows; // the end of the scan, set when it starts
+    long long returned_rows;
+    bool closed;
+    RowView row;
+    
+    /**
+     * Read the next block that may have matching rows
+     * @return false if there are no more blocks
+     */
+    bool readBlock();
+    
+    /**
+     * @return true if the registry is not removed and satisfies the predicates
+     */
+    bool matches(const char * registry);
+    
+public:
+    /**
+     * Scan the rows from first_index to end_index - 1, or to the last row if
+     * end_index is -1
+     * @constructor
+     */
+    TableScan(Table * table, const PredicateTree & predicates, long long first_index, long long end_index,
+        long long limit = -1);
+    
+    /**
+     * Read only the registries of the candidates, on their order
+     * @constructor
+     */
+    TableScan(Table * table, const PredicateTree & predicates, const vector<long long> & candidates,
+        long long limit = -1);
+    
+    bool next();
+    void reset();
+    RowView & getRowView();
+    string getString(int column_position);
+    void close();
+};
+
+
+Table::Table(string name, HeaderMode header_mode) {
+    this->name = name;
+    this->path = name + ".dat";
+    this->header_file_path = name + "_h.dat";
+    this->varchar_heap.setPath(name + "_v.dat");
+    this->zone_map.setPath(name + "_z.dat");
+    this->header = new header_t();
+    this->header_mode = header_mode;
+    this->number_of_rows = 0;
+    this->read_mode = STREAM_READ;
+    this->mapped_file.setPath(path);
+    this->buffer_pool = NULL;
+    this->data_file_id = -1;
+    this->header_file_id = -1;
+    this->wal = NULL;
+    this->hash_index = NULL;
+    this->schema_version = 0;
+    this->statistics_version = 0;
+    
+    RegistryHeader reg_header;
+    Table::HEADER_SIZE = sizeof(reg_header.flags) + sizeof(reg_header.time_stamp);
+    // cout << "HEADER_SIZE = " << HEADER_SIZE << endl;
+    
+    TableFileHeader file_header;
+    Table::FILE_HEADER_SIZE = sizeof(file_header.magic) + sizeof(file_header.version) +
+        sizeof(file_header.table_name) + sizeof(file_header.schema_hash) + sizeof(file_header.registry_size);
+    
+    loadHeader();
+}
+
+Table::~Table() {
+    if (wal != NULL) {
+        checkpoint();
+        delete wal;
+    }
+    Dictionary::closeAll(dictionaries);
+    ColumnBloomFilter::closeAll(bloom_filters);
+    SecondaryIndex::closeAll(indexes);
+    delete hash_index;
+    closePoolFiles();
+    mapped_file.unmap();
+    delete this->header;
+}
+
+void Table::importSchema(const string & path) {
+    schema.import(path);
+    schema_version++;
+    plan_cache.clear();
+    statistics = TableStatistics();
+    Dictionary::openAll(name, schema, dictionaries);
+    ColumnBloomFilter::openAll(name, schema, bloom_filters);
+    SecondaryIndex::openAll(name, schema, indexes);
+    checkFileHeader();
+    loadZoneMap();
+    loadBloomFilters();
+    loadIndexes();
+    loadHashIndex();
+    refreshStatistics();
+}
+
+void Table::setSchema(Schema schema) {
+    this->schema = schema;
+    schema_version++;
+    plan_cache.clear();
+    statistics = TableStatistics();
+    Dictionary::openAll(name, this->schema, dictionaries);
+    ColumnBloomFilter::openAll(name, this->schema, bloom_filters);
+    SecondaryIndex::openAll(name, this->schema, indexes);
+    checkFileHeader();
+    loadZoneMap();
+    loadBloomFilters();
+    loadIndexes();
+    loadHashIndex();
+    refreshStatistics();
+}
+
+Schema Table::getSchema(){
+    return this->schema;
+}
+
+
+header_t * Table::getHeader(){
+    if (header_mode == POSITIONAL && header->size() != (size_t) number_of_rows) {
+        // The _id is the same as the row order
+        header->clear();
+        header->reserve(number_of_rows);
+        for (long long _id = 0; _id < number_of_rows; _id++) {
+            header->push_back(pair<long long, long long> (_id, getRegistryPosition(_id)));
+        }
+    }
     return this->header;
 }
 
+HeaderMode Table::getHeaderMode() {
+    return header_mode;
+}
+
+unsigned Table::getRegistrySize() {
+    return HEADER_SIZE + schema.getSize();
+}
+
 void Table::loadHeader() {
+    if (header_mode == POSITIONAL) {
+        // The registry size is taken from the file header, since the schema
+        // may not be set yet
+        TableFileHeader file_header;
+        number_of_rows = 0;
+        if (readFileHeader(&file_header) && file_header.registry_size > 0) {
+            ifstream data_file;
+            data_file.open(path.c_str(), ios::binary | ios::ate);
+            long long file_size = data_file.tellg();
+            number_of_rows = (file_size - FILE_HEADER_SIZE) / file_header.registry_size;
+        }
+        return;
+    }
+    
     ifstream file;
-    file.open(header_file_path.c_str(), ios::binary);
+    file.open(header_file_path.c_str(), ios::binary | ios::ate);
+    
+    // The index arrays are allocated once, if the _ids or the positions need them
+    long long file_size = file.tellg();
+    if (file_size > 0) {
+        this->header->reserve(file_size / (sizeof(HeaderFile::_id) + sizeof(HeaderFile::registry_position)));
+    }
+    file.seekg(0);
     
     while (!file.eof()) {
         HeaderFile header;
@@ -224,100 +1221,190 @@ void Table::loadHeader() {
     file.close();
 }
 
-void Table::convertAndSave(ofstream *file, string * string_value, SchemaCol *schema_col) {
-    if (schema_col->type == INT32) {
-        int value = atoi((*string_value).c_str());
-        file->write(reinterpret_cast<char *> (&value), schema_col->getSize());
-        // cout << "INT32 " << value << "(" << *string_value << ")" << " | ";
+void Table::convertAndSave(char *buffer, string * string_value, SchemaCol *schema_col, VarcharHeap * varchar_heap, Dictionary * dictionary) {
+    if (schema_col->dictionary && dictionary != NULL) {
+        // Only the code is stored on the registry
+        int code = dictionary->encode(string_value->substr(0, schema_col->array_size));
+        memcpy(buffer, &code, sizeof(code));
+    } else if (schema_col->type == INT32) {
+        long long parsed_value;
+        NumericCodec::parseInteger(string_value->data(), string_value->data() + string_value->size(), &parsed_value);
+        int value = parsed_value;
+        memcpy(buffer, &value, sizeof(value));
     } else if (schema_col->type == CHAR) {
-        char value[schema_col->getSize()];
-        strncpy(value, &string_value->c_str()[0], schema_col->getSize());
-        file->write(reinterpret_cast<char *> (&value), schema_col->getSize());
-        // cout << "CHAR " << value << "(" << *string_value << ")" << " | ";
+        // strncpy pads the remaining bytes with zeros. The last byte is always
+        // kept as the string terminator
+        strncpy(buffer, string_value->c_str(), schema_col->getSize());
+        buffer[schema_col->getSize() - 1] = '\0';
+    } else if (schema_col->type == VARCHAR) {
+        unsigned length = min((unsigned) string_value->size(), schema_col->array_size);
+        memset(buffer, 0, VARCHAR_SLOT_SIZE);
+        memcpy(buffer, &length, sizeof(length));
+        
+        if (length <= VARCHAR_INLINE_SIZE || varchar_heap == NULL) {
+            memcpy(buffer + sizeof(length), string_value->c_str(), min(length, (unsigned) VARCHAR_INLINE_SIZE));
+        } else {
+            long long offset = varchar_heap->append(string_value->c_str(), length);
+            memcpy(buffer + sizeof(length), &offset, sizeof(offset));
+        }
     } else if (schema_col->type == FLOAT) {
-        float value = atof((*string_value).c_str());
-        file->write(reinterpret_cast<char *> (&value), schema_col->getSize());
-        // cout << "FLOAT " << value << "(" << *string_value << ")" << " | ";
+        double parsed_value;
+        NumericCodec::parseReal(string_value->data(), string_value->data() + string_value->size(), &parsed_value);
+        float value = parsed_value;
+        memcpy(buffer, &value, sizeof(value));
     } else if (schema_col->type == DOUBLE) {
-        double value = atof((*string_value).c_str());
-        file->write(reinterpret_cast<char *> (&value), schema_col->getSize());
-        // cout << "DOUBLE " << value << "(" << *string_value << ")" << " | ";
+        double value;
+        NumericCodec::parseReal(string_value->data(), string_value->data() + string_value->size(), &value);
+        memcpy(buffer, &value, sizeof(value));
     } else if (schema_col->type == INT64 || schema_col->type == FOREIGN_KEY) {
-        long long value = std::stoll((*string_value).c_str());
-        file->write(reinterpret_cast<char *> (&value), schema_col->getSize());
-        // cout << "INT64 " << value << "(" << *string_value << ")" << " | ";
+        long long value;
+        NumericCodec::parseInteger(string_value->data(), string_value->data() + string_value->size(), &value);
+        memcpy(buffer, &value, sizeof(value));
     }
 }
 
-long long Table::insert(vector<string> row) {
-    //TODO: create a insert method that receives the file as parameter to improve the performance while adding many rows
-    //TODO: Handle exceptions and return 0 on failure
-    ofstream file;
-    file.open(path.c_str(), ios::binary | ios::app);
-    
-    //Save the header position on the header file
-    HeaderFile header_file;
-    header_file.path = this->header_file_path;
-    header_file._id = this->header->size();
-    header_file.registry_position = file.tellp(); // Get the current position on the file stream
-    insertOnHeaderFile(&header_file);
-    
+void Table::encodeRow(vector<string> & row, long long _id, char * buffer, EncodedChunk * chunk) {
     //Save the header
     RegistryHeader header;
-    strncpy(header.table_name, &name.c_str()[0], sizeof(header.table_name));
-    header.registry_size = HEADER_SIZE + schema.getSize();
+    header.flags = 0;
     time (& header.time_stamp);
     
-    file.write(header.table_name, sizeof(header.table_name));
-    file.write(reinterpret_cast<char *> (& header.registry_size), sizeof(header.registry_size));
-    file.write(reinterpret_cast<char *> (& header.time_stamp), sizeof(header.time_stamp));
-    
-    // cout << "  | " << header.table_name << " " << header.registry_size << " " << header.time_stamp << " | ";
-    
-    //Push the _id to the row
-    string _id_str;
+    memcpy(buffer, & header.flags, sizeof(header.flags));
+    buffer += sizeof(header.flags);
+    memcpy(buffer, & header.time_stamp, sizeof(header.time_stamp));
+    buffer += sizeof(header.time_stamp);
     
-    std::stringstream strstream;
-    strstream << header_file._id;
-    strstream >> _id_str;
-    
-    //Insert the _id on the first position so it matches the SchemaCol
-    row.insert(row.begin(), _id_str);
-    
-    //Export the table according to the schema
+    //Export the table according to the schema. The _id goes on the first
+    //position so it matches the SchemaCol
     vector<SchemaCol>* schema_cols = schema.getCols();
     
-    int schema_col_position = 0;
+    memcpy(buffer, &_id, sizeof(_id));
+    buffer += schema_cols->at(0).getSize();
     
-    for (vector<string>::iterator row_it = row.begin(); row_it != row.end(); row_it++) {
+    for (unsigned i = 0; i < row.size() && i + 1 < schema_cols->size(); i++) {
         //Iterate through the row and save the values
         //TODO: Consider the array size
-        convertAndSave(&file, &(*row_it), &schema_cols->at(schema_col_position));
-        schema_col_position ++;
+        SchemaCol * schema_col = &schema_cols->at(i + 1);
+        bool shared_value = getDictionary(i + 1) != NULL ||
+            (schema_col->type == VARCHAR && row.at(i).size() > VARCHAR_INLINE_SIZE && schema_col->array_size > VARCHAR_INLINE_SIZE);
+        
+        if (chunk != NULL && shared_value) {
+            EncodedChunk::DeferredValue deferred_value = {chunk->number_of_rows, (int) i + 1, row.at(i)};
+            chunk->deferred_values.push_back(deferred_value);
+        } else {
+            convertAndSave(buffer, &row.at(i), schema_col, &varchar_heap, getDictionary(i + 1));
+        }
+        buffer += schema_col->getSize();
+    }
+}
+
+void Table::encodeFileHeader(char * buffer) {
+    TableFileHeader file_header;
+    memset(&file_header, 0, sizeof(file_header));
+    strncpy(file_header.magic, TABLE_FILE_MAGIC, sizeof(file_header.magic));
+    file_header.version = TABLE_FILE_VERSION;
+    strncpy(file_header.table_name, name.c_str(), sizeof(file_header.table_name) - 1);
+    file_header.schema_hash = schema.getHash();
+    file_header.registry_size = HEADER_SIZE + schema.getSize();
+    
+    memcpy(buffer, file_header.magic, sizeof(file_header.magic));
+    buffer += sizeof(file_header.magic);
+    memcpy(buffer, & file_header.version, sizeof(file_header.version));
+    buffer += sizeof(file_header.version);
+    memcpy(buffer, file_header.table_name, sizeof(file_header.table_name));
+    buffer += sizeof(file_header.table_name);
+    memcpy(buffer, & file_header.schema_hash, sizeof(file_header.schema_hash));
+    buffer += sizeof(file_header.schema_hash);
+    memcpy(buffer, & file_header.registry_size, sizeof(file_header.registry_size));
+}
+
+bool Table::readFileHeader(TableFileHeader * file_header) {
+    flush();
+    
+    ifstream file;
+    file.open(path.c_str(), ios::binary);
+    
+    if (!file.read(file_header->magic, sizeof(file_header->magic)) ||
+        strncmp(file_header->magic, TABLE_FILE_MAGIC, sizeof(file_header->magic)) != 0) {
+        return false;
     }
-    // cout << endl;
+    file.read(reinterpret_cast<char *> (& file_header->version), sizeof(file_header->version));
+    file.read(file_header->table_name, sizeof(file_header->table_name));
+    file.read(reinterpret_cast<char *> (& file_header->schema_hash), sizeof(file_header->schema_hash));
+    file.read(reinterpret_cast<char *> (& file_header->registry_size), sizeof(file_header->registry_size));
     
+    return file.good();
+}
+
+void Table::checkFileHeader() {
+    ifstream file;
+    file.open(path.c_str(), ios::binary | ios::ate);
+    if (!file.is_open() || file.tellg() == 0) {
+        // There is no data yet
+        return;
+    }
     file.close();
     
-    return header_file._id;
+    TableFileHeader file_header;
+    if (!readFileHeader(&file_header)) {
+        cout << "Legacy data file, call Table::migrate - " << path << endl;
+    } else if (file_header.version != TABLE_FILE_VERSION) {
+        cout << "Unsupported data file version " << file_header.version << " - " << path << endl;
+    } else if (file_header.schema_hash != schema.getHash()) {
+        cout << "The data file was created using another schema - " << path << endl;
+    }
 }
 
-bool Table::insertOnHeaderFile(HeaderFile * header_file) {
-    ofstream file;
-    file.open(header_file->path.c_str(), ios::binary | ios::app);
-    file.write(reinterpret_cast<char *> (& header_file->_id), sizeof(header_file->_id));
-    file.write(reinterpret_cast<char *> (& header_file->registry_position), sizeof(header_file->registry_position));
+long long Table::insert(vector<string> row) {
+    //TODO: Handle exceptions and return 0 on failure
+    long long _id;
+    unsigned long long log_sequence;
+    {
+        lock_guard<recursive_mutex> lock(write_mutex);
+        BulkWriter writer(this, 0);
+        _id = writer.insert(row);
+        writer.close();
+        log_sequence = writer.getLogSequence();
+        
+        if (wal != NULL && wal->getSize() > WAL_CHECKPOINT_SIZE) {
+            checkpoint();
+        }
+        refreshStatistics();
+    }
     
-    header->push_back(
-        pair<decltype(header_file->_id), decltype(header_file->registry_position)> (
-            header_file->_id,
-            header_file->registry_position));
+    // The other writers may insert while this one waits for the sync
+    if (!syncLog(log_sequence)) {
+        return -1;
+    }
     
-    file.close();
+    return _id;
+}
+
+long long Table::insertBatch(vector<vector<string> > & rows) {
+    long long first_id;
+    unsigned long long log_sequence;
+    {
+        lock_guard<recursive_mutex> lock(write_mutex);
+        BulkWriter writer(this);
+        first_id = getNextId();
+        
+        for (vector<vector<string> >::iterator it = rows.begin(); it != rows.end(); it++) {
+            writer.insert(*it);
+        }
+        writer.close();
+        log_sequence = writer.getLogSequence();
+        refreshStatistics();
+    }
+    if (!syncLog(log_sequence)) {
+        return -1;
+    }
+    
+    return first_id;
 }
 
 void Table::printHeaderFile(int number_of_values) {
     cout << "Printing " << name << " header file" << endl;
+    flush();
     ifstream file;
     file.open(header_file_path.c_str(), ios::binary);
     int counter = 0;
@@ -341,11 +1428,14 @@ void Table::print(int number_of_values) {
     cout << "Printing " << name << " table" << endl;
     int counter = 0;
     while (counter != number_of_values) {
-        // cout << "headerSize= "<< header->size()<< endl;
-        if (counter == header->size()) {
+        if (counter == getNumberOfRows()) {
             break;
         }
-        vector<string> row = getRow(header->at(counter).second);
+        vector<string> row = getRow(getRegistryPosition(counter));
+        if (row.empty()) { // removed row
+            counter ++;
+            continue;
+        }
         
         //print the line
         for (vector<string>::iterator it = row.begin(); it != row.end(); it++) {
@@ -359,291 +1449,2169 @@ void Table::print(int number_of_values) {
 }
 
 Cursor Table::query(string q) {
-    //Transform the query to lower case
-    std::transform(q.begin(), q.end(), q.begin(), ::tolower);
+    // The queries with other values have the same text
+    string text;
+    string error;
+    vector<string> literals;
+    if (!QueryParser::normalize(q, &text, &literals, &error)) {
+        cout << "Invalid query - " << error << endl;
+        return Cursor();
+    }
     
-    //Store the select arguments.
-    //e.g.: SELECT arg1, arg2
-    vector<string> select;
+    shared_ptr<QueryPlan> plan = getPlan(text);
+    if (plan == NULL) {
+        return Cursor();
+    }
+    if (plan->statement.number_of_parameters != (int) literals.size()) {
+        cout << "Unbound parameter - use Table::prepare" << endl;
+        return Cursor();
+    }
+    return execute(*plan, literals);
+}
+
+PreparedStatement Table::prepare(string sql) {
+    string text;
+    string error;
+    if (!QueryParser::normalize(sql, &text, NULL, &error)) {
+        cout << "Invalid query - " << error << endl;
+        return PreparedStatement();
+    }
     
-    //Store the where arguments, values and comparators
-    //e.g.: WHERE arg1 = val1, arg2 > val2,
-    vector<string> where_args;
-    vector<string> where_comparators;
-    vector<string> where_vals;
+    shared_ptr<QueryPlan> plan = getPlan(text);
+    if (plan == NULL) {
+        return PreparedStatement();
+    }
+    return PreparedStatement(this, plan);
+}
+
+PlanCache * Table::getPlanCache() {
+    return &plan_cache;
+}
+
+shared_ptr<QueryPlan> Table::getPlan(const string & text) {
+    shared_ptr<QueryPlan> plan = plan_cache.get(text);
+    if (plan != NULL) {
+        return plan;
+    }
     
-    //Helper variables to store the parsing state
-    bool parsing_select = false;
-    bool parsing_where = false;
+    plan.reset(new QueryPlan());
+    string error;
+    if (!QueryParser::parse(text, &plan->statement, &error)) {
+        cout << "Invalid query - " << error << endl;
+        return shared_ptr<QueryPlan>();
+    }
+    if (!makePlan(plan->statement, plan.get())) {
+        return shared_ptr<QueryPlan>();
+    }
     
-    //Hold if a word is beeing parsed at the moment. If a space ' ' or a comma ',' is
-    //parsed, the variable is set false
-    bool parsing_word = false;
+    plan_cache.put(text, plan);
+    return plan;
+}
+
+Cursor Table::query(vector<string> & select, vector<string> & where_args, vector<string> & where_comparators, vector<string> & where_values) {
+    if (where_args.size() != where_comparators.size() || where_args.size() != where_values.size()) {
+        cout << "Invalid WHERE clause" << endl;
+        return Cursor();
+    }
     
-    bool parsing_where_arg = false;
-    bool parsing_where_comparator = false;
-    bool parsing_where_val = false;
+    QueryStatement statement;
+    statement.has_where = !where_args.empty();
+    if (!(select.size() == 1 && select[0] == "*")) {
+        statement.select = select;
+    }
     
-    string string_buffer;
+    for (size_t i = 0; i < where_args.size(); i++) {
+        QueryCondition condition;
+        condition.type = COMPARISON_CONDITION;
+        condition.column = where_args[i];
+        condition.values.push_back(where_values[i]);
+        if (!Predicate::parseComparator(where_comparators[i], &condition.comparator)) {
+            cout << "Unknown comparator - " << where_comparators[i] << endl;
+            return Cursor();
+        }
+        statement.where.children.push_back(condition);
+    }
     
-    bool ignore_space = false;
+    return query(statement);
+}
+
+Cursor Table::query(const QueryStatement & statement) {
+    QueryPlan plan;
+    if (!makePlan(statement, &plan)) {
+        return Cursor();
+    }
+    return execute(plan, vector<string>());
+}
+
+bool Table::makePlan(const QueryStatement & statement, QueryPlan * plan) {
+    vector<SchemaCol> * schema_cols = schema.getCols();
+    plan->statement = statement;
+    plan->schema_version = schema_version;
+    plan->select_positions.clear();
+    plan->columns.clear();
     
-    for (string::iterator it = q.begin(); it != q.end(); it++) {
-        char character = (*it);
-        
-        if (character == '\'') {
-            ignore_space = !ignore_space;
-            continue;
-            
-        } else if (character != ' ' || character != ',') {
-            parsing_word = true;
-            
-        } else {
-            if (character == ' ' && ignore_space) {
-                parsing_word = true;
-            } else {
-                parsing_word = false;
-            }
-        }
-        
-        // Check for the select word
-        if (!parsing_select && !parsing_where) {
-            if (character != ' ') {
-                string_buffer += character;
-            }
-            // cout << string_buffer << endl;
-            if (string_buffer == "select") {
-                parsing_select = true;
-                string_buffer.clear();
-            } else if (string_buffer == "where") {
-                cout << "Changing to WHERE" << endl;
-                parsing_where = true;
-                parsing_where_arg = true;
-                parsing_select = false;                
-                string_buffer.clear();
-            }
-        } else if (character != ' ' || ignore_space) {
-            if (parsing_select) {
-                //Ignore spaces
-                if (character == ',') {
-                    //Add the string_buffer to the where_args
-                    where_args.push_back(string_buffer);
-                    cout << string_buffer << endl;
-                    string_buffer.clear();
-                } else {
-                    //If a word is beeing parsed, add the character to the string buffer,
-                    //if not, there are two words separated by a space. In this case, the
-                    //select arguments are finished
-                    if (parsing_word) {
-                        string_buffer += character;
-                    } else {
-                        parsing_select = false;
-                        where_args.push_back(string_buffer);
-                        cout << string_buffer << endl;
-                        string_buffer.clear();
-                    }
-                }
-                
-            } else if (parsing_where) {
-                if (character == ',') {
-                    if (parsing_where_val) {
-                        where_vals.push_back(string_buffer);
-                        cout << "Where value = " << string_buffer << endl;
-                        string_buffer.clear();
-                    }
-                    parsing_where_arg = true;
-                    parsing_where_comparator = false;
-                    parsing_where_val = false;
-                } else if (parsing_word) {
-                    if (parsing_where_arg) {
-                        if (character == '=' || character == '<' || character == '>' || character == '!') {
-                            //The argument was parsed, move to the comparator
-                            parsing_where_arg = false;
-                            parsing_where_comparator = true;
-                            where_args.push_back(string_buffer);
-                            cout << "Where arg = " << string_buffer << endl;
-                            string_buffer.clear();
-                        }
-                    } else if (parsing_where_comparator) {
-                        if (character != '=' || character != '<' || character != '>' || character != '!') {
-                            //The comparator was parsed, move to the where value
-                            parsing_where_comparator = false;
-                            parsing_where_val = true;
-                            where_comparators.push_back(string_buffer);
-                            cout << "Where comparator = " << string_buffer << endl;
-                            string_buffer.clear();
-                        }
-                    }
-                    
-                    string_buffer += character;
-                }
-            }
-        } else if (character == ' ') {
-            if (!string_buffer.empty()) {
-                if (parsing_select) {
-                    select.push_back(string_buffer);
-                    cout << "F Select = " << string_buffer << endl;
-                    string_buffer.clear();
-                    parsing_select = false;
-                }
+    //Resolve the selected columns
+    if (statement.select.empty()) {
+        for (int i = 0; i < (int) schema_cols->size(); i++) {
+            plan->select_positions.push_back(i);
+        }
+    } else {
+        for (vector<string>::const_iterator it = statement.select.begin(); it != statement.select.end(); it++) {
+            int column_position = schema.getColPosition(*it);
+            if (column_position < 0) {
+                cout << "Unknown column - " << *it << endl;
+                return false;
             }
+            plan->select_positions.push_back(column_position);
         }
     }
-    if (parsing_select) {
-        select.push_back(string_buffer);
-        cout << "Final select = " << string_buffer << endl;
-        
-    } else if (parsing_where && parsing_where_val) {
-        where_vals.push_back(string_buffer);
-        cout << "Final where value = " << string_buffer << endl;
+    for (vector<int>::iterator it = plan->select_positions.begin(); it != plan->select_positions.end(); it++) {
+        plan->columns.push_back(schema_cols->at(*it).key);
     }
     
-    return query(select, where_args, where_comparators, where_vals);
+    plan->reuse_path = !statement.has_where || !hasRangeParameter(statement.where);
+    return !statement.has_where || checkColumns(statement.where);
 }
 
-Cursor Table::query(vector<string> & select, vector<string> & where_args, vector<string> & where_comparators, vector<string> & where_values) {
-    //Store the query result
-    vector<vector <string> > result;
+bool Table::checkColumns(const QueryCondition & condition) {
+    if (condition.type == AND_CONDITION || condition.type == OR_CONDITION) {
+        for (vector<QueryCondition>::const_iterator it = condition.children.begin(); it != condition.children.end(); it++) {
+            if (!checkColumns(*it)) {
+                return false;
+            }
+        }
+        return true;
+    }
     
-    //TODO: Make the query method
+    if (schema.getColPosition(condition.column) < 0) {
+        cout << "Unknown column - " << condition.column << endl;
+        return false;
+    }
+    return true;
+}
+
+void Table::bindParameters(QueryCondition * condition, const vector<string> & parameters) {
+    for (size_t i = 0; i < condition->parameters.size(); i++) {
+        if (condition->parameters[i] >= 0) {
+            condition->values[i] = parameters[condition->parameters[i]];
+        }
+    }
+    for (vector<QueryCondition>::iterator it = condition->children.begin(); it != condition->children.end(); it++) {
+        bindParameters(&(*it), parameters);
+    }
+}
+
+bool Table::hasRangeParameter(const QueryCondition & condition) {
+    bool range = condition.type == BETWEEN_CONDITION || (condition.type == COMPARISON_CONDITION &&
+        condition.comparator != EQUAL && condition.comparator != NOT_EQUAL);
+    for (size_t i = 0; i < condition.parameters.size(); i++) {
+        if (range && condition.parameters[i] >= 0) {
+            return true;
+        }
+    }
+    for (vector<QueryCondition>::const_iterator it = condition.children.begin(); it != condition.children.end(); it++) {
+        if (hasRangeParameter(*it)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Table::compileCondition(const QueryCondition & condition, PredicateTree * tree) {
+    if (condition.type == AND_CONDITION || condition.type == OR_CONDITION) {
+        *tree = PredicateTree(condition.type == OR_CONDITION);
+        for (vector<QueryCondition>::const_iterator it = condition.children.begin(); it != condition.children.end(); it++) {
+            PredicateTree child;
+            if (!compileCondition(*it, &child)) {
+                return false;
+            }
+            tree->add(child);
+        }
+        return true;
+    }
+    
+    int column_position = schema.getColPosition(condition.column);
+    if (column_position < 0) {
+        cout << "Unknown column - " << condition.column << endl;
+        return false;
+    }
+    Dictionary * dictionary = getDictionary(column_position);
+    
+    // IN is an OR of equalities and BETWEEN is an AND of two bounds
+    *tree = PredicateTree(condition.type == IN_CONDITION);
+    if (condition.type == COMPARISON_CONDITION) {
+        tree->add(Predicate(schema, column_position, condition.comparator, condition.values[0], dictionary));
+    } else if (condition.type == IN_CONDITION) {
+        for (vector<string>::const_iterator it = condition.values.begin(); it != condition.values.end(); it++) {
+            tree->add(Predicate(schema, column_position, EQUAL, *it, dictionary));
+        }
+    } else {
+        tree->add(Predicate(schema, column_position, GREATER_EQUAL, condition.values[0], dictionary));
+        tree->add(Predicate(schema, column_position, LESS_EQUAL, condition.values[1], dictionary));
+    }
+    return true;
+}
+
+Cursor Table::execute(const QueryPlan & plan, const vector<string> & parameters) {
+    if (plan.schema_version != schema_version) {
+        // A prepared statement keeps its plan after the schema changes
+        QueryPlan current_plan;
+        if (!makePlan(plan.statement, &current_plan)) {
+            return Cursor();
+        }
+        return execute(current_plan, parameters);
+    }
+    
+    const QueryStatement & statement = plan.statement;
+    if (statement.explain) {
+        string explanation = explain(plan, parameters);
+        if (!explanation.empty()) {
+            cout << explanation;
+        }
+        return Cursor();
+    }
+    
+    PredicateTree predicates;
+    vector<AccessPath> paths;
+    if (!planExecution(plan, parameters, &predicates, &paths, true)) {
+        return Cursor();
+    }
+    
+    long long first_index = 0;
+    long long end_index = -1;
+    vector<long long> * candidates = readAccessPath(paths[0], &first_index, &end_index);
+    if (candidates != NULL) {
+        TableScan * scan = new TableScan(this, predicates, *candidates, statement.limit);
+        delete candidates;
+        return Cursor(scan, plan.columns, plan.select_positions);
+    }
+    
+    return Cursor(new TableScan(this, predicates, first_index, end_index, statement.limit),
+        plan.columns, plan.select_positions);
+}
+
+bool Table::planExecution(const QueryPlan & plan, const vector<string> & parameters, PredicateTree * predicates,
+    vector<AccessPath> * paths, bool reuse_chosen_path) {
+    const QueryStatement & statement = plan.statement;
+    if ((int) parameters.size() < statement.number_of_parameters) {
+        cout << "Unbound parameter - " << parameters.size() << endl;
+        return false;
+    }
+    
+    // The plan is shared, the values are set on a copy of the conditions
+    QueryCondition bound_where;
+    const QueryCondition * where = &statement.where;
+    if (statement.number_of_parameters > 0) {
+        bound_where = statement.where;
+        bindParameters(&bound_where, parameters);
+        where = &bound_where;
+    }
+    
+    //Compile the conditions
+    if (statement.has_where && !compileCondition(*where, predicates)) {
+        return false;
+    }
+    
+    if (!statement.has_where) {
+        where = NULL;
+    }
+    
+    // The plan is shared by the threads, so the chosen path is replaced at once
+    shared_ptr<ChosenPath> chosen = atomic_load(&plan.chosen_path);
+    if (reuse_chosen_path && chosen != NULL && chosen->statistics_version == statistics_version) {
+        paths->assign(1, makeChosenPath(where, *chosen));
+        return true;
+    }
+    
+    planAccess(where, *predicates, statement.limit, paths);
+    AccessType type = paths->at(0).type;
+    if (plan.reuse_path && type != HEADER_RANGE && type != INDEX_RANGE) {
+        chosen.reset(new ChosenPath());
+        chosen->type = type;
+        chosen->condition_index = paths->at(0).condition_index;
+        chosen->statistics_version = statistics_version;
+        atomic_store(&plan.chosen_path, chosen);
+    }
+    return true;
+}
+
+AccessPath Table::makeChosenPath(const QueryCondition * where, const ChosenPath & chosen) {
+    AccessPath path;
+    path.type = chosen.type;
+    if (chosen.condition_index >= 0) {
+        const QueryCondition & condition = where->type == AND_CONDITION ? where->children.at(chosen.condition_index) : *where;
+        path.column_position = schema.getColPosition(condition.column);
+        path.column_name = condition.column;
+        path.values = condition.values;
+    }
+    return path;
+}
+
+string Table::explain(const QueryPlan & plan, const vector<string> & parameters) {
+    if (plan.schema_version != schema_version) {
+        QueryPlan current_plan;
+        if (!makePlan(plan.statement, &current_plan)) {
+            return "";
+        }
+        return explain(current_plan, parameters);
+    }
+    
+    PredicateTree predicates;
+    vector<AccessPath> paths;
+    if (!planExecution(plan, parameters, &predicates, &paths, false)) {
+        return "";
+    }
+    
+    string explanation = "PLAN: " + paths[0].describe() + "\n";
+    if (plan.statement.limit >= 0) {
+        explanation += "  LIMIT " + to_string(plan.statement.limit) + "\n";
+    }
+    for (size_t i = 1; i < paths.size(); i++) {
+        explanation += "  ALTERNATIVE: " + paths[i].describe() + "\n";
+    }
+    return explanation;
+}
+
+string Table::explain(string sql) {
+    string text;
+    string error;
+    vector<string> literals;
+    if (!QueryParser::normalize(sql, &text, &literals, &error)) {
+        cout << "Invalid query - " << error << endl;
+        return "";
+    }
+    
+    shared_ptr<QueryPlan> plan = getPlan(text);
+    if (plan == NULL) {
+        return "";
+    }
+    if (plan->statement.number_of_parameters != (int) literals.size()) {
+        cout << "Unbound parameter - use Table::prepare" << endl;
+        return "";
+    }
+    return explain(*plan, literals);
+}
+
+bool Table::parseId(const string & value, long long * _id) {
+    return value.find_first_of(".eEnNiI") == string::npos &&
+        NumericCodec::parseInteger(value.c_str(), value.c_str() + value.size(), _id);
+}
+
+void Table::planAccess(const QueryCondition * where, const PredicateTree & predicates, long long limit,
+    vector<AccessPath> * paths) {
+    long long number_of_rows = getNumberOfRows();
+    double result_rows = where == NULL ? number_of_rows : estimateSelectivity(*where) * number_of_rows;
+    
+    vector<QueryCondition> conditions;
+    if (where != NULL && where->type == AND_CONDITION) {
+        conditions = where->children;
+    } else if (where != NULL) {
+        conditions.push_back(*where);
+    }
+    
+    long long min_id = numeric_limits<long long>::min();
+    long long max_id = numeric_limits<long long>::max();
+    bool id_range = false;
+    paths->clear();
+    
+    for (vector<QueryCondition>::iterator it = conditions.begin(); it != conditions.end(); it++) {
+        int column_position = schema.getColPosition(it->column);
+        if (it->type == AND_CONDITION || it->type == OR_CONDITION || column_position < 0) {
+            continue;
+        }
+        bool equality = it->type == IN_CONDITION || (it->type == COMPARISON_CONDITION && it->comparator == EQUAL);
+        double number_of_values = it->values.size();
+        
+        AccessPath path;
+        path.column_position = column_position;
+        path.condition_index = it - conditions.begin();
+        path.column_name = it->column;
+        path.values = it->values;
+        
+        if (column_position == 0) {
+            // The _ids are always integers, the other values are left to the predicates
+            vector<long long> ids;
+            for (vector<string>::iterator value = it->values.begin(); value != it->values.end(); value++) {
+                long long _id;
+                if (parseId(*value, &_id)) {
+                    ids.push_back(_id);
+                }
+            }
+            if (ids.size() != it->values.size()) {
+                continue;
+            }
+            
+            if (equality) {
+                path.type = HEADER_LOOKUP;
+                path.estimated_rows = min(number_of_values, (double) number_of_rows);
+                path.cost = number_of_values * statistics.header_search_cost + path.estimated_rows * statistics.random_read_cost;
+                paths->push_back(path);
+                if (hash_index != NULL) {
+                    path.type = HASH_LOOKUP;
+                    path.cost = number_of_values * statistics.hash_search_cost + path.estimated_rows * statistics.random_read_cost;
+                    paths->push_back(path);
+                }
+                continue;
+            }
+            
+            // The ranges are joined into one range of rows, != is left to the predicates
+            if (it->type == COMPARISON_CONDITION && it->comparator == NOT_EQUAL) {
+                continue;
+            }
+            id_range = true;
+            if (it->type == BETWEEN_CONDITION) {
+                min_id = max(min_id, ids[0]);
+                max_id = min(max_id, ids[1]);
+            } else if (it->comparator == LESS || it->comparator == LESS_EQUAL) {
+                if (it->comparator == LESS && ids[0] == numeric_limits<long long>::min()) {
+                    min_id = 1;
+                    max_id = 0;
+                } else {
+                    max_id = min(max_id, it->comparator == LESS ? ids[0] - 1 : ids[0]);
+                }
+            } else if (it->comparator == GREATER || it->comparator == GREATER_EQUAL) {
+                if (it->comparator == GREATER && ids[0] == numeric_limits<long long>::max()) {
+                    min_id = 1;
+                    max_id = 0;
+                } else {
+                    min_id = max(min_id, it->comparator == GREATER ? ids[0] + 1 : ids[0]);
+                }
+            }
+            continue;
+        }
+        
+        if (getIndex(column_position) == NULL) {
+            continue;
+        }
+        SchemaCol & schema_col = schema.getCols()->at(column_position);
+        double distinct_values = column_position < (int) statistics.distinct_values.size() ?
+            statistics.distinct_values[column_position] : 1;
+        
+        if (equality) {
+            path.type = INDEX_LOOKUP;
+            path.estimated_rows = min(number_of_values * number_of_rows / distinct_values, (double) number_of_rows);
+            path.cost = number_of_values * statistics.index_search_cost + path.estimated_rows * statistics.random_read_cost;
+            paths->push_back(path);
+        } else if ((it->type == BETWEEN_CONDITION || it->comparator != NOT_EQUAL) &&
+            (schema_col.isInteger() || schema_col.isReal())) {
+            // The ranges of the strings don't follow the order of the index keys
+            double min, max;
+            if (it->type == BETWEEN_CONDITION) {
+                double ignored;
+                Predicate(schema, column_position, GREATER_EQUAL, it->values[0]).getRange(&min, &ignored);
+                Predicate(schema, column_position, LESS_EQUAL, it->values[1]).getRange(&ignored, &max);
+            } else {
+                Predicate(schema, column_position, it->comparator, it->values[0]).getRange(&min, &max);
+            }
+            if (schema_col.isInteger()) {
+                min = ceil(min);
+                max = floor(max);
+            }
+            
+            path.type = INDEX_RANGE;
+            path.values.clear();
+            path.min = min;
+            path.max = max;
+            path.estimated_rows = estimateRangeRows(column_position, min, max);
+            if (path.estimated_rows < 0) {
+                path.estimated_rows = number_of_rows / 3.0;
+            }
+            path.cost = statistics.index_search_cost +
+                path.estimated_rows * (statistics.random_read_cost + statistics.scan_cost);
+            paths->push_back(path);
+        }
+    }
+    
+    // The scan reads the blocks that the zone map doesn't skip, a full scan
+    // reads them all, as readAccessPath does
+    AccessPath scan;
+    long long first_index = 0;
+    long long end_index = -1;
+    if (id_range) {
+        findIdRange(min_id, max_id, &first_index, &end_index);
+    }
+    scan.type = id_range ? HEADER_RANGE : FULL_SCAN;
+    scan.min_id = min_id;
+    scan.max_id = max_id;
+    scan.estimated_rows = countScanRows(predicates, first_index, end_index);
+    scan.cost = scan.estimated_rows * statistics.scan_cost + (id_range ? 2 * statistics.header_search_cost : 0);
+    paths->push_back(scan);
+    
+    // With a LIMIT, each path stops when enough of its rows matched
+    if (limit >= 0) {
+        for (vector<AccessPath>::iterator it = paths->begin(); it != paths->end(); it++) {
+            double matches = min(result_rows, it->estimated_rows);
+            if (it->estimated_rows <= 0 || matches <= limit) {
+                continue;
+            }
+            double read_fraction = max(limit, 1LL) / matches;
+            
+            // The searches are done before the first row is read
+            double search_cost = 0;
+            switch (it->type) {
+                case HEADER_LOOKUP: search_cost = it->values.size() * statistics.header_search_cost; break;
+                case HASH_LOOKUP: search_cost = it->values.size() * statistics.hash_search_cost; break;
+                case INDEX_LOOKUP: search_cost = it->values.size() * statistics.index_search_cost; break;
+                case INDEX_RANGE: search_cost = statistics.index_search_cost; break;
+                case HEADER_RANGE: search_cost = 2 * statistics.header_search_cost; break;
+                default: break;
+            }
+            it->cost = search_cost + (it->cost - search_cost) * read_fraction;
+            it->estimated_rows *= read_fraction;
+        }
+    }
+    
+    // The scan is the last one of the paths with the same cost
+    stable_sort(paths->begin(), paths->end(), [](const AccessPath & a, const AccessPath & b) {
+        return a.cost < b.cost;
+    });
+}
+
+double Table::estimateSelectivity(const QueryCondition & condition) {
+    if (condition.type == AND_CONDITION || condition.type == OR_CONDITION) {
+        // The conditions are assumed to be independent
+        double selectivity = 1;
+        for (vector<QueryCondition>::const_iterator it = condition.children.begin(); it != condition.children.end(); it++) {
+            double child_selectivity = estimateSelectivity(*it);
+            selectivity *= condition.type == AND_CONDITION ? child_selectivity : 1 - child_selectivity;
+        }
+        return condition.type == AND_CONDITION ? selectivity : 1 - selectivity;
+    }
+    
+    int column_position = schema.getColPosition(condition.column);
+    long long number_of_rows = getNumberOfRows();
+    if (column_position < 0 || number_of_rows == 0) {
+        return 1;
+    }
+    SchemaCol & schema_col = schema.getCols()->at(column_position);
+    double distinct_values = column_position < (int) statistics.distinct_values.size() ?
+        statistics.distinct_values[column_position] : 1;
+    
+    if (condition.type == IN_CONDITION) {
+        return min(1.0, condition.values.size() / distinct_values);
+    } else if (condition.type == COMPARISON_CONDITION && condition.comparator == EQUAL) {
+        return 1 / distinct_values;
+    } else if (condition.type == COMPARISON_CONDITION && condition.comparator == NOT_EQUAL) {
+        return 1 - 1 / distinct_values;
+    }
+    
+    // The ranges of the numeric columns are estimated by the zones
+    double min, max;
+    if (condition.type == BETWEEN_CONDITION) {
+        double ignored;
+        Predicate(schema, column_position, GREATER_EQUAL, condition.values[0]).getRange(&min, &ignored);
+        Predicate(schema, column_position, LESS_EQUAL, condition.values[1]).getRange(&ignored, &max);
+    } else {
+        Predicate(schema, column_position, condition.comparator, condition.values[0]).getRange(&min, &max);
+    }
+    if (schema_col.isInteger() || schema_col.isReal()) {
+        if (schema_col.isInteger()) {
+            min = ceil(min);
+            max = floor(max);
+        }
+        double rows = estimateRangeRows(column_position, min, max);
+        if (rows >= 0) {
+            return rows / number_of_rows;
+        }
+    }
+    return condition.type == BETWEEN_CONDITION ? 0.25 : 1 / 3.0;
+}
+
+double Table::estimateRangeRows(int column_position, double min, double max) {
+    long long number_of_rows = getNumberOfRows();
+    if (number_of_rows == 0) {
+        return 0;
+    }
+    if (zone_map.getZone(0, column_position) == NULL) {
+        return -1;
+    }
+    bool integer_column = schema.getCols()->at(column_position).isInteger();
+    
+    double rows = 0;
+    long long number_of_blocks = std::min(zone_map.getNumberOfBlocks(),
+        (number_of_rows + ZoneMap::ROWS_PER_BLOCK - 1) / ZoneMap::ROWS_PER_BLOCK);
+    for (long long block = 0; block < number_of_blocks; block++) {
+        ZoneMap::Zone * zone = zone_map.getZone(block, column_position);
+        long long block_rows = std::min(ZoneMap::ROWS_PER_BLOCK, number_of_rows - block * ZoneMap::ROWS_PER_BLOCK);
+        if (zone == NULL || !(zone->min <= zone->max) || zone->max < min || zone->min > max) {
+            continue;
+        }
+        if (min <= zone->min && max >= zone->max) {
+            rows += block_rows;
+            continue;
+        }
+        
+        // The integers are counted, so [10, 19] covers 10 of the 100 values of [0, 99]
+        double width = zone->max - zone->min + (integer_column ? 1 : 0);
+        double overlap = std::min(max, zone->max) - std::max(min, zone->min) + (integer_column ? 1 : 0);
+        rows += block_rows * std::max(overlap / width, 1.0 / block_rows);
+    }
+    return rows;
+}
+
+long long Table::countScanRows(const PredicateTree & predicates, long long first_index, long long end_index) {
+    long long number_of_rows = getNumberOfRows();
+    if (end_index < 0 || end_index > number_of_rows) {
+        end_index = number_of_rows;
+    }
+    
+    long long rows = 0;
+    for (long long row_index = first_index; row_index < end_index; ) {
+        long long block = row_index / ZoneMap::ROWS_PER_BLOCK;
+        long long block_end = min(end_index, (block + 1) * ZoneMap::ROWS_PER_BLOCK);
+        if (predicates.mayMatch(zone_map, block)) {
+            rows += block_end - row_index;
+        }
+        row_index = block_end;
+    }
+    return rows;
+}
+
+vector<long long> * Table::readAccessPath(const AccessPath & path, long long * first_index, long long * end_index) {
+    *first_index = 0;
+    *end_index = -1;
+    if (path.type == FULL_SCAN) {
+        return NULL;
+    } else if (path.type == HEADER_RANGE) {
+        findIdRange(path.min_id, path.max_id, first_index, end_index);
+        return NULL;
+    }
+    
+    vector<long long> * candidates = new vector<long long>;
+    if (path.type == HEADER_LOOKUP || path.type == HASH_LOOKUP) {
+        for (vector<string>::const_iterator value = path.values.begin(); value != path.values.end(); value++) {
+            long long _id;
+            long long registry_position = -1;
+            if (!parseId(*value, &_id)) {
+                continue;
+            }
+            if (path.type == HEADER_LOOKUP) {
+                registry_position = findRegistryPosition(_id);
+            } else if (!hash_index->find(_id, &registry_position)) {
+                registry_position = -1;
+            }
+            if (registry_position >= 0) {
+                candidates->push_back(registry_position);
+            }
+        }
+    } else if (path.type == INDEX_LOOKUP) {
+        for (vector<string>::const_iterator value = path.values.begin(); value != path.values.end(); value++) {
+            vector<long long> * positions = findIndexCandidates(path.column_position, *value);
+            candidates->insert(candidates->end(), positions->begin(), positions->end());
+            delete positions;
+        }
+    } else {
+        SecondaryIndex * index = getIndex(path.column_position);
+        vector<long long> * positions;
+        if (schema.getCols()->at(path.column_position).isInteger()) {
+            // The bounds out of the long long range are the ends of the range
+            long long min = path.min <= (double) numeric_limits<long long>::min() ? numeric_limits<long long>::min() :
+                (path.min >= (double) numeric_limits<long long>::max() ? numeric_limits<long long>::max() : (long long) path.min);
+            long long max = path.max >= (double) numeric_limits<long long>::max() ? numeric_limits<long long>::max() :
+                (path.max <= (double) numeric_limits<long long>::min() ? numeric_limits<long long>::min() : (long long) path.max);
+            positions = path.min <= path.max ? index->findBetween(min, max) : new vector<long long>;
+        } else {
+            positions = index->findBetween(path.min, path.max);
+        }
+        candidates->insert(candidates->end(), positions->begin(), positions->end());
+        delete positions;
+    }
+    
+    // The rows are read in their order, the predicates check the old keys
+    sort(candidates->begin(), candidates->end());
+    candidates->erase(unique(candidates->begin(), candidates->end()), candidates->end());
+    long long end_position = FILE_HEADER_SIZE + getNumberOfRows() * (long long) getRegistrySize();
+    candidates->erase(lower_bound(candidates->begin(), candidates->end(), end_position), candidates->end());
+    return candidates;
+}
+
+void Table::findIdRange(long long min_id, long long max_id, long long * first_index, long long * end_index) {
+    long long number_of_rows = getNumberOfRows();
+    if (min_id > max_id) {
+        *first_index = 0;
+        *end_index = 0;
+    } else if (header_mode == POSITIONAL) {
+        // The _id is the row
+        *first_index = min(number_of_rows, max(0LL, min_id));
+        *end_index = max_id >= number_of_rows ? number_of_rows : max(0LL, max_id + 1);
+    } else {
+        *first_index = header->lowerBound(min_id);
+        *end_index = max_id == numeric_limits<long long>::max() ? number_of_rows : header->lowerBound(max_id + 1);
+    }
+    *end_index = max(*first_index, min(*end_index, number_of_rows));
     
-    Cursor cursor(schema, result);
-    return cursor;
+    // The scans without an upper bound also read the rows inserted later
+    if (max_id == numeric_limits<long long>::max()) {
+        *end_index = -1;
+    }
 }
 
-void Table::convertFromCSV(const string & path) {
+void Table::convertFromCSV(const string & path, unsigned number_of_threads, size_t chunk_size) {
     string line;
     
     ifstream file;
-    file.open(path.c_str());
+    file.open(path.c_str(), ios::binary);
     
     if (file.is_open()) {
         //Header
         getline(file, line);
         
+        if (number_of_threads == 0) {
+            number_of_threads = max(1u, thread::hardware_concurrency());
+        }
+        
+        lock_guard<recursive_mutex> lock(write_mutex);
+        BulkWriter writer(this);
+        size_t registry_size = getRegistrySize();
+        vector<string> buffers(number_of_threads);
+        vector<EncodedChunk> chunks(number_of_threads);
+        string partial_line; // the incomplete record of the last chunk, read again by the next one
+        
         //Lines
-        while (getline(file, line)) {
-            vector<string> words = split(line, ',');
+        while (file) {
+            // Read a chunk for each worker, cutting it after the last newline
+            unsigned number_of_chunks = 0;
+            while (number_of_chunks < number_of_threads && file) {
+                string & buffer = buffers.at(number_of_chunks);
+                buffer.swap(partial_line);
+                partial_line.clear();
+                
+                size_t read_position = buffer.size();
+                buffer.resize(read_position + chunk_size);
+                file.read(&buffer[read_position], chunk_size);
+                buffer.resize(read_position + file.gcount());
+                
+                if (file) {
+                    // The newlines inside the quoted values don't end the record
+                    size_t record_end = CSVTokenizer::findLastRecordEnd(buffer.data(), buffer.size());
+                    if (record_end == string::npos) {
+                        // The record is longer than the chunk
+                        partial_line.swap(buffer);
+                        continue;
+                    }
+                    partial_line.assign(buffer, record_end, string::npos);
+                    buffer.resize(record_end);
+                }
+                number_of_chunks ++;
+            }
             
-            // Insert the line on the database
-            insert(words);
+            // Parse and encode
+            vector<thread> workers;
+            for (unsigned i = 0; i < number_of_chunks; i++) {
+                workers.push_back(thread(&Table::encodeChunk, this, &buffers.at(i), registry_size, &chunks.at(i)));
+            }
+            for (unsigned i = 0; i < workers.size(); i++) {
+                workers.at(i).join();
+            }
+            
+            // Append in the file order
+            for (unsigned i = 0; i < number_of_chunks; i++) {
+                appendChunk(writer, chunks.at(i));
+            }
         }
+        writer.close();
         file.close();
+        
+        // The rows were not logged
+        checkpoint();
+        refreshStatistics();
+        
+        cout << "Imported " << writer.getNumberOfRows() << " rows into " << name
+             << " (" << writer.getRowsPerSecond() << " rows/s, " << number_of_threads << " threads)" << endl;
     } else {
         cout << "Unable to open file - " << path << endl;
     }
 }
 
-vector<string> Table::getRow(long long registry_position) {
+void Table::encodeChunk(const string * buffer, size_t registry_size, EncodedChunk * chunk) {
+    chunk->registries.clear();
+    chunk->deferred_values.clear();
+    chunk->number_of_rows = 0;
+    
+    // The fields and the row strings are reused by all the records
+    CSVTokenizer tokenizer(buffer->data(), buffer->size());
+    vector<FieldSpan> fields;
+    vector<string> words;
+    
+    while (tokenizer.nextRecord(fields)) {
+        if (fields.size() == 1 && fields.at(0).length == 0) {
+            // Empty line
+            continue;
+        }
+        
+        words.resize(fields.size());
+        for (size_t i = 0; i < fields.size(); i++) {
+            fields.at(i).copyTo(&words.at(i));
+        }
+        
+        // The _id is set when the chunk is appended
+        chunk->registries.resize(chunk->registries.size() + registry_size);
+        encodeRow(words, 0, &chunk->registries[chunk->number_of_rows * registry_size], chunk);
+        chunk->number_of_rows ++;
+    }
+}
+
+void Table::appendChunk(BulkWriter & writer, EncodedChunk & chunk) {
+    size_t registry_size = getRegistrySize();
+    vector<SchemaCol> * schema_cols = schema.getCols();
+    
+    for (vector<EncodedChunk::DeferredValue>::iterator it = chunk.deferred_values.begin(); it != chunk.deferred_values.end(); it++) {
+        char * buffer = &chunk.registries[it->row_index * registry_size] + HEADER_SIZE + schema.getColOffset(it->column_position);
+        convertAndSave(buffer, &it->value, &schema_cols->at(it->column_position), &varchar_heap, getDictionary(it->column_position));
+    }
+    
+    for (long long i = 0; i < chunk.number_of_rows; i++) {
+        writer.insertRegistry(&chunk.registries[i * registry_size]);
+    }
+}
+
+const char * Table::readRegistry(long long registry_position) {
+    return readRegistries(registry_position, 1);
+}
+
+const char * Table::readRegistries(long long registry_position, long long number_of_registries) {
+    size_t size = number_of_registries * (HEADER_SIZE + schema.getSize());
+    
+    if (read_mode == MMAP_READ) {
+        // Grow the mapping if the registry was appended after the last map
+        if (buffer_pool != NULL && mapped_file.getSize() < registry_position + size) {
+            flush();
+        }
+        if (!mapped_file.map(registry_position + size)) {
+            return NULL;
+        }
+        return mapped_file.getData() + registry_position;
+    }
+    
+    registry_buffer.resize(size);
+    
+    if (buffer_pool != NULL) {
+        openPoolFiles();
+        if (!buffer_pool->read(data_file_id, registry_position, &registry_buffer[0], size)) {
+            return NULL;
+        }
+        return &registry_buffer[0];
+    }
+    
     ifstream file;
     file.open(path.c_str(), ios::binary);
     
     // Set the file position
     file.seekg(registry_position);
     
+    if (!file.read(&registry_buffer[0], size)) {
+        return NULL;
+    }
+    file.close();
+    
+    return &registry_buffer[0];
+}
+
+string Table::convertToString(const char * buffer, SchemaCol * schema_col, VarcharHeap * varchar_heap, Dictionary * dictionary) {
+    // The numbers are formatted without streams
+    char number[NumericCodec::MAX_LENGTH];
+    
+    if (schema_col->dictionary && dictionary != NULL) {
+        int code;
+        memcpy(&code, buffer, sizeof(code));
+        return dictionary->decode(code);
+    } else if (schema_col->type == INT32) {
+        int value;
+        memcpy(&value, buffer, sizeof(value));
+        return string(number, NumericCodec::formatInteger(value, number));
+    } else if (schema_col->type == CHAR) {
+        return string(buffer, strnlen(buffer, schema_col->getSize()));
+    } else if (schema_col->type == VARCHAR) {
+        unsigned length;
+        memcpy(&length, buffer, sizeof(length));
+        
+        if (length <= VARCHAR_INLINE_SIZE) {
+            return string(buffer + sizeof(length), length);
+        } else if (varchar_heap != NULL) {
+            long long offset;
+            memcpy(&offset, buffer + sizeof(length), sizeof(offset));
+            const char * value = varchar_heap->get(offset);
+            if (value != NULL) {
+                return string(value, length);
+            }
+        }
+    } else if (schema_col->type == FLOAT) {
+        float value;
+        memcpy(&value, buffer, sizeof(value));
+        return string(number, NumericCodec::formatReal(value, number));
+    } else if (schema_col->type == DOUBLE) {
+        double value;
+        memcpy(&value, buffer, sizeof(value));
+        return string(number, NumericCodec::formatReal(value, number));
+    }  else if (schema_col->type == INT64 || schema_col->type == FOREIGN_KEY) {
+        long long value;
+        memcpy(&value, buffer, sizeof(value));
+        return string(number, NumericCodec::formatInteger(value, number));
+    }
+    
+    return "";
+}
+
+vector<string> Table::decodeRow(const char * registry) {
     vector<SchemaCol>* schema_cols = schema.getCols();
     vector<string> row;
     
-    //Import the header
-    RegistryHeader header;
-    file.read(header.table_name, sizeof(header.table_name));
-    file.read(reinterpret_cast<char *> (& header.registry_size), sizeof(header.registry_size));
-    file.read(reinterpret_cast<char *> (& header.time_stamp), sizeof(header.time_stamp));
-    
-    // cout << "  | " << header.table_name << " " << header.registry_size << " " << header.time_stamp << " | ";
-
-    //Read and convert the values from the file
-    for (vector<SchemaCol>::iterator it = schema_cols->begin(); it != schema_cols->end(); it++) {
-        SchemaCol & schema_col = *it;
-        ostringstream stream;
-        
-        if (schema_col.type == INT32) {
-            int value;
-            file.read(reinterpret_cast<char *> (&value), schema_col.getSize());
-            // cout << "INT32 " << value << " | ";
-            stream << value;
-        } else if (schema_col.type == CHAR) {
-            char value[schema_col.getSize()];
-            file.read(reinterpret_cast<char *> (&value), schema_col.getSize());
-            // cout << "CHAR " << value << " | ";
-            stream << value;
-        } else if (schema_col.type == FLOAT) {
-            float value;
-            file.read(reinterpret_cast<char *> (&value), schema_col.getSize());
-            // cout << "FLOAT " << value << " | ";
-            stream << value;
-        } else if (schema_col.type == DOUBLE) {
-            double value;
-            file.read(reinterpret_cast<char *> (&value), schema_col.getSize());
-            // cout << "DOUBLE " << value << " | ";
-            stream << value;
-        }  else if (schema_col.type == INT64 || schema_col.type == FOREIGN_KEY) {
-            long long value;
-            file.read(reinterpret_cast<char *> (&value), schema_col.getSize());
-            // cout << "INT64 " << value << " | ";
-            stream << value;
-        }
-        
-        string string_value;
-        string_value = stream.str();
+    //Skip the header
+    const char * value_ptr = registry + HEADER_SIZE;
+
+    //Convert the values from the registry
+    for (int column_position = 0; column_position < (int) schema_cols->size(); column_position++) {
+        SchemaCol * schema_col = &schema_cols->at(column_position);
         
         // Push the value to the line vector
-        row.push_back(string_value);
+        row.push_back(convertToString(value_ptr, schema_col, &varchar_heap, getDictionary(column_position)));
+        value_ptr += schema_col->getSize();
     }
-    // cout << endl;
-    file.close();
     
     return row;
 }
 
-vector<string> Table::getRowById(long long _id) {
+vector<string> Table::getRow(long long registry_position) {
     vector<string> row;
-    //Iterate through the Table::header
-    //The pair is defined like: (first value = _id, second value = registry_position)
-    int idx = distance(header->begin(), lower_bound(header->begin(), header->end(), 
-       make_pair(_id, numeric_limits<long long>::min())));
     
-    // If the found index is equals to the desired index, the _id was found
-    auto pair = header->at(idx);
-    if (pair.first == _id) {
-        row = getRow(pair.second);
-        // print(&row);
+    const char * registry = readRegistry(registry_position);
+    if (registry != NULL && !isDeleted(registry)) {
+        row = decodeRow(registry);
     }
+    
     return row;
 }
 
-void Table::drop() {
-    remove(this->path.c_str());
-    remove(this->header_file_path.c_str());
-    this->header->clear();
+vector<vector<string> > Table::getRows(const vector<long long> & registry_positions) {
+    vector<vector<string> > rows(registry_positions.size());
+    size_t registry_size = getRegistrySize();
+    
+    if (read_mode == MMAP_READ) {
+        // The registries are already on the memory
+        for (size_t i = 0; i < registry_positions.size(); i++) {
+            rows[i] = getRow(registry_positions[i]);
+        }
+        return rows;
+    }
+    
+    // The indexes of the positions, sorted by position
+    vector<size_t> order(registry_positions.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    sort(order.begin(), order.end(), [&registry_positions](size_t a, size_t b) {
+        return registry_positions[a] < registry_positions[b];
+    });
+    
+    ifstream file;
+    if (buffer_pool != NULL) {
+        openPoolFiles();
+    } else {
+        file.open(path.c_str(), ios::binary);
+    }
+    
+    auto readBytes = [&](long long position, char * data, size_t size) {
+        if (buffer_pool != NULL) {
+            return buffer_pool->read(data_file_id, position, data, size);
+        }
+        file.clear();
+        file.seekg(position);
+        return (bool) file.read(data, size);
+    };
+    
+    vector<char> buffer;
+    size_t first = 0;
+    while (first < order.size()) {
+        // Merge the next registries while they are contiguous (or repeated)
+        long long read_start = registry_positions[order[first]];
+        long long read_end = read_start + registry_size;
+        size_t last = first + 1;
+        while (last < order.size()) {
+            long long position = registry_positions[order[last]];
+            if (position > read_end || position + registry_size - read_start > MAX_COALESCED_READ) {
+                break;
+            }
+            read_end = max(read_end, (long long) (position + registry_size));
+            last++;
+        }
+        
+        // One read for all of them
+        buffer.resize(read_end - read_start);
+        bool read = readBytes(read_start, &buffer[0], buffer.size());
+        
+        for (size_t i = first; i < last; i++) {
+            char * registry = &buffer[registry_positions[order[i]] - read_start];
+            
+            // A registry out of the file fails the whole read, so the others
+            // are read alone, as getRow would do
+            bool registry_read = read || (last - first > 1 && readBytes(registry_positions[order[i]], registry, registry_size));
+            if (registry_read && !isDeleted(registry)) {
+                rows[order[i]] = decodeRow(registry);
+            }
+        }
+        first = last;
+    }
+    
+    return rows;
 }
 
-Join Table::join(string this_column_name, Table* other_table, string other_column_name, JoinType join_type) {
-    return Join(this, this_column_name, other_table, other_column_name, join_type);
+RowView Table::getRowView(long long registry_position) {
+    const char * registry = readRegistry(registry_position);
+    if (registry == NULL || isDeleted(registry)) {
+        return RowView();
+    }
+    
+    return RowView(&schema, registry + HEADER_SIZE, &varchar_heap, dictionaries.empty() ? NULL : &dictionaries[0]);
+}
+
+void Table::setReadMode(ReadMode read_mode) {
+    if (read_mode == STREAM_READ) {
+        mapped_file.unmap();
+    }
+    this->read_mode = read_mode;
+}
+
+ReadMode Table::getReadMode() {
+    return read_mode;
+}
+
+void Table::setBufferPool(BufferPool * buffer_pool) {
+    closePoolFiles();
+    this->buffer_pool = buffer_pool;
+}
+
+BufferPool * Table::getBufferPool() {
+    return buffer_pool;
+}
+
+void Table::openPoolFiles() {
+    if (data_file_id < 0) {
+        data_file_id = buffer_pool->openFile(path);
+    }
+    if (header_file_id < 0 && header_mode == HEADER_FILE) {
+        header_file_id = buffer_pool->openFile(header_file_path);
+    }
+}
+
+void Table::closePoolFiles() {
+    if (buffer_pool != NULL) {
+        buffer_pool->closeFile(data_file_id);
+        buffer_pool->closeFile(header_file_id);
+    }
+    data_file_id = -1;
+    header_file_id = -1;
+}
+
+void Table::flush() {
+    if (buffer_pool != NULL) {
+        buffer_pool->flush(data_file_id);
+        buffer_pool->flush(header_file_id);
+    }
+}
+
+vector<string> Table::getRowById(long long _id) {
+    vector<string> row;
+    
+    long long registry_position = findRegistryPosition(_id);
+    if (registry_position >= 0) {
+        row = getRow(registry_position);
+    }
+    return row;
+}
+
+long long Table::findRegistryPosition(long long _id) {
+    if (header_mode == POSITIONAL) {
+        // The position is computed from the _id
+        if (_id >= 0 && _id < number_of_rows) {
+            return getRegistryPosition(_id);
+        }
+        return -1;
+    }
+    
+    long long idx = header->find(_id);
+    if (idx >= 0) {
+        return header->getPosition(idx);
+    }
+    return -1;
+}
+
+long long Table::getNextId() {
+    if (header_mode == POSITIONAL || header->empty()) {
+        return getNumberOfRows();
+    }
+    return header->getId(header->size() - 1) + 1;
+}
+
+bool Table::writeRegistry(long long registry_position, const char * data, size_t size) {
+    if (buffer_pool != NULL) {
+        openPoolFiles();
+        if (!buffer_pool->write(data_file_id, registry_position, data, size)) {
+            return false;
+        }
+        // The memory map reads the file, so it must see the new bytes
+        if (read_mode == MMAP_READ) {
+            buffer_pool->flush(data_file_id);
+        }
+        return true;
+    }
+    
+    fstream file;
+    file.open(path.c_str(), ios::binary | ios::in | ios::out);
+    if (!file.is_open()) {
+        cout << "Unable to open file - " << path << endl;
+        return false;
+    }
+    
+    // Positioned write, the rest of the file is not touched
+    file.seekp(registry_position);
+    file.write(data, size);
+    bool written = file.good();
+    file.close();
+    
+    return written;
+}
+
+void Table::saveValues() {
+    varchar_heap.flush();
+    for (vector<Dictionary *>::iterator it = dictionaries.begin(); it != dictionaries.end(); it++) {
+        if (*it != NULL) {
+            (*it)->save();
+        }
+    }
+}
+
+bool Table::isDeleted(const char * registry) {
+    unsigned flags;
+    memcpy(&flags, registry, sizeof(flags));
+    return (flags & REGISTRY_DELETED) != 0;
+}
+
+string Table::encodeLogRecord(long long _id, vector<string> & row) {
+    string record;
+    unsigned number_of_values = row.size();
+    record.append(reinterpret_cast<const char *> (&_id), sizeof(_id));
+    record.append(reinterpret_cast<const char *> (&number_of_values), sizeof(number_of_values));
+    
+    for (vector<string>::iterator it = row.begin(); it != row.end(); it++) {
+        unsigned length = (*it).size();
+        record.append(reinterpret_cast<const char *> (&length), sizeof(length));
+        record.append(*it);
+    }
+    return record;
+}
+
+void Table::decodeLogRecord(const string & record, long long * _id, vector<string> * row) {
+    const char * data = record.data();
+    unsigned number_of_values;
+    memcpy(_id, data, sizeof(*_id));
+    data += sizeof(*_id);
+    memcpy(&number_of_values, data, sizeof(number_of_values));
+    data += sizeof(number_of_values);
+    
+    row->clear();
+    for (unsigned i = 0; i < number_of_values; i++) {
+        unsigned length;
+        memcpy(&length, data, sizeof(length));
+        data += sizeof(length);
+        row->push_back(string(data, length));
+        data += length;
+    }
+}
+
+bool Table::syncLog(unsigned long long log_sequence) {
+    if (wal != NULL && log_sequence > 0 && !wal->sync(log_sequence)) {
+        cout << "Unable to write file - " << name << "_w.dat" << endl;
+        return false;
+    }
+    return true;
+}
+
+bool Table::enableWriteAheadLog() {
+    lock_guard<recursive_mutex> lock(write_mutex);
+    if (wal != NULL) {
+        return true;
+    }
+    
+    WriteAheadLog * log = new WriteAheadLog(name + "_w.dat");
+    if (!log->isOpen()) {
+        cout << "Unable to open file - " << name << "_w.dat" << endl;
+        delete log;
+        return false;
+    }
+    
+    long long checkpoint_id;
+    vector<string> records;
+    log->read(&checkpoint_id, records);
+    
+    if (checkpoint_id >= 0) {
+        // The files are only trusted up to the last checkpoint
+        truncateRows(checkpoint_id);
+        
+        BulkWriter writer(this);
+        long long _id;
+        vector<string> row;
+        for (vector<string>::iterator it = records.begin(); it != records.end(); it++) {
+            decodeLogRecord(*it, &_id, &row);
+            if (_id >= getNextId()) {
+                writer.insert(row, _id);
+            }
+        }
+        writer.close();
+        
+        if (writer.getNumberOfRows() > 0) {
+            cout << "Replayed " << writer.getNumberOfRows() << " rows into " << name << endl;
+        }
+    }
+    
+    this->wal = log;
+    checkpoint();
+    return true;
+}
+
+WriteAheadLog * Table::getWriteAheadLog() {
+    return wal;
+}
+
+void Table::checkpoint() {
+    lock_guard<recursive_mutex> lock(write_mutex);
+    if (wal == NULL) {
+        return;
+    }
+    
+    flush();
+    saveValues();
+    WriteAheadLog::syncFile(path);
+    WriteAheadLog::syncFile(header_file_path);
+    WriteAheadLog::syncFile(varchar_heap.getPath());
+    for (vector<Dictionary *>::iterator it = dictionaries.begin(); it != dictionaries.end(); it++) {
+        if (*it != NULL) {
+            WriteAheadLog::syncFile((*it)->getPath());
+        }
+    }
+    
+    wal->truncate(getNextId());
+    
+    // The filters are rebuilt if they miss rows, so they are not synced
+    ColumnBloomFilter::saveAll(bloom_filters);
+}
+
+void Table::truncateRows(long long first_id) {
+    // The files are modified without the pool and the map
+    closePoolFiles();
+    mapped_file.unmap();
+    
+    long long data_size;
+    if (header_mode == POSITIONAL) {
+        number_of_rows = max(0LL, min(number_of_rows, first_id));
+        header->clear();
+        data_size = FILE_HEADER_SIZE + number_of_rows * getRegistrySize();
+    } else {
+        size_t idx = header->lowerBound(first_id);
+        
+        if (idx < header->size()) {
+            data_size = header->at(idx).second;
+        } else if (!header->empty()) {
+            data_size = header->back().second + getRegistrySize();
+        } else {
+            data_size = FILE_HEADER_SIZE;
+        }
+        header->resize(idx);
+        
+        // Also drops the incomplete header entry, if any
+        HeaderFile header_entry;
+        long long header_file_size = idx * (sizeof(header_entry._id) + sizeof(header_entry.registry_position));
+        struct stat file_stat;
+        if (stat(header_file_path.c_str(), &file_stat) == 0 && file_stat.st_size > header_file_size) {
+            ::truncate(header_file_path.c_str(), header_file_size);
+        }
+    }
+    
+    struct stat file_stat;
+    if (stat(path.c_str(), &file_stat) == 0) {
+        if (file_stat.st_size < FILE_HEADER_SIZE) {
+            // Not even the file header was written, it's written again by the next insert
+            ::truncate(path.c_str(), 0);
+        } else if (file_stat.st_size > data_size) {
+            ::truncate(path.c_str(), data_size);
+        }
+    }
+    
+    zone_map.truncate(getNumberOfRows());
+    zone_map.save();
+    for (vector<ColumnBloomFilter *>::iterator it = bloom_filters.begin(); it != bloom_filters.end(); it++) {
+        if (*it != NULL) {
+            (*it)->truncate(getNumberOfRows());
+        }
+    }
+}
+
+void Table::loadZoneMap() {
+    if (zone_map.load(schema) && zone_map.getNumberOfRows() == getNumberOfRows()) {
+        return;
+    }
+    rebuildZoneMap();
+}
+
+void Table::rebuildZoneMap() {
+    zone_map.reset(schema);
+    
+    // One read for each block of rows, the registries of a block are contiguous
+    size_t registry_size = getRegistrySize();
+    long long number_of_rows = getNumberOfRows();
+    for (long long index = 0; index < number_of_rows; index += ZoneMap::ROWS_PER_BLOCK) {
+        long long block_rows = min(ZoneMap::ROWS_PER_BLOCK, number_of_rows - index);
+        const char * registries = readRegistries(getRegistryPosition(index), block_rows);
+        if (registries == NULL) {
+            break;
+        }
+        for (long long i = 0; i < block_rows; i++) {
+            zone_map.add(registries + i * registry_size + HEADER_SIZE, schema);
+        }
+    }
+    
+    zone_map.save();
+}
+
+void Table::addFilterValues(const char * row_data, long long row_index) {
+    RowView row(&schema, row_data, &varchar_heap, dictionaries.empty() ? NULL : &dictionaries[0]);
+    for (int i = 0; i < (int) bloom_filters.size(); i++) {
+        if (bloom_filters[i] != NULL) {
+            bloom_filters[i]->add(row_index, ColumnBloomFilter::hashValue(row, i));
+        }
+    }
+}
+
+void Table::loadBloomFilters() {
+    for (int i = 0; i < (int) bloom_filters.size(); i++) {
+        if (bloom_filters[i] != NULL && bloom_filters[i]->getNumberOfRows() != getNumberOfRows()) {
+            rebuildBloomFilter(i);
+        }
+    }
+}
+
+void Table::rebuildBloomFilter(int column_position) {
+    ColumnBloomFilter * bloom_filter = bloom_filters.at(column_position);
+    bloom_filter->clear();
+    
+    size_t registry_size = getRegistrySize();
+    long long number_of_rows = getNumberOfRows();
+    for (long long index = 0; index < number_of_rows; index += ZoneMap::ROWS_PER_BLOCK) {
+        long long block_rows = min(ZoneMap::ROWS_PER_BLOCK, number_of_rows - index);
+        const char * registries = readRegistries(getRegistryPosition(index), block_rows);
+        if (registries == NULL) {
+            break;
+        }
+        for (long long i = 0; i < block_rows; i++) {
+            RowView row(&schema, registries + i * registry_size + HEADER_SIZE, &varchar_heap,
+                dictionaries.empty() ? NULL : &dictionaries[0]);
+            bloom_filter->add(index + i, ColumnBloomFilter::hashValue(row, column_position));
+        }
+    }
+    
+    bloom_filter->save();
+}
+
+void Table::addIndexKeys(const char * row_data, long long registry_position) {
+    RowView row(&schema, row_data, &varchar_heap, dictionaries.empty() ? NULL : &dictionaries[0]);
+    for (int i = 0; i < (int) indexes.size(); i++) {
+        if (indexes[i] != NULL) {
+            indexes[i]->insert(SecondaryIndex::makeKey(row, i), registry_position);
+        }
+    }
+    if (hash_index != NULL) {
+        hash_index->insert(row.getInteger(0), registry_position);
+    }
+}
+
+void Table::loadIndexes() {
+    // Every insert writes its keys, so only the last rows may be missing
+    for (int i = 0; i < (int) indexes.size(); i++) {
+        if (indexes[i] == NULL) {
+            continue;
+        }
+        for (long long index = getNumberOfRows() - 1; index >= 0; index--) {
+            long long registry_position = getRegistryPosition(index);
+            const char * registry = readRegistry(registry_position);
+            if (registry == NULL) {
+                break;
+            }
+            
+            RowView row(&schema, registry + HEADER_SIZE, &varchar_heap, dictionaries.empty() ? NULL : &dictionaries[0]);
+            bpt::key_t key = SecondaryIndex::makeKey(row, i);
+            if (indexes[i]->contains(key, registry_position)) {
+                break;
+            }
+            indexes[i]->insert(key, registry_position);
+        }
+    }
+}
+
+void Table::rebuildIndex(int column_position) {
+    SecondaryIndex * index = indexes.at(column_position);
+    index->clear();
+    
+    size_t registry_size = getRegistrySize();
+    long long number_of_rows = getNumberOfRows();
+    for (long long row_index = 0; row_index < number_of_rows; row_index += ZoneMap::ROWS_PER_BLOCK) {
+        long long block_rows = min(ZoneMap::ROWS_PER_BLOCK, number_of_rows - row_index);
+        long long block_position = getRegistryPosition(row_index);
+        const char * registries = readRegistries(block_position, block_rows);
+        if (registries == NULL) {
+            break;
+        }
+        for (long long i = 0; i < block_rows; i++) {
+            RowView row(&schema, registries + i * registry_size + HEADER_SIZE, &varchar_heap,
+                dictionaries.empty() ? NULL : &dictionaries[0]);
+            index->insert(SecondaryIndex::makeKey(row, column_position), block_position + i * registry_size);
+        }
+    }
+}
+
+void Table::loadHashIndex() {
+    if (hash_index == NULL) {
+        string hash_index_path = name + "_x.dat";
+        ifstream file(hash_index_path.c_str(), ios::binary);
+        if (!file.is_open()) {
+            return;
+        }
+        file.close();
+        hash_index = new HashIndex(hash_index_path);
+    }
+    
+    // Every insert writes its _id, so only the last rows may be missing
+    for (long long index = getNumberOfRows() - 1; index >= 0; index--) {
+        long long registry_position = getRegistryPosition(index);
+        const char * registry = readRegistry(registry_position);
+        if (registry == NULL) {
+            break;
+        }
+        
+        RowView row(&schema, registry + HEADER_SIZE, &varchar_heap, dictionaries.empty() ? NULL : &dictionaries[0]);
+        long long indexed_position;
+        if (hash_index->find(row.getInteger(0), &indexed_position) && indexed_position == registry_position) {
+            break;
+        }
+        hash_index->insert(row.getInteger(0), registry_position);
+    }
+}
+
+void Table::rebuildHashIndex() {
+    hash_index->clear();
+    
+    size_t registry_size = getRegistrySize();
+    long long number_of_rows = getNumberOfRows();
+    for (long long row_index = 0; row_index < number_of_rows; row_index += ZoneMap::ROWS_PER_BLOCK) {
+        long long block_rows = min(ZoneMap::ROWS_PER_BLOCK, number_of_rows - row_index);
+        long long block_position = getRegistryPosition(row_index);
+        const char * registries = readRegistries(block_position, block_rows);
+        if (registries == NULL) {
+            break;
+        }
+        for (long long i = 0; i < block_rows; i++) {
+            RowView row(&schema, registries + i * registry_size + HEADER_SIZE, &varchar_heap,
+                dictionaries.empty() ? NULL : &dictionaries[0]);
+            hash_index->insert(row.getInteger(0), block_position + i * registry_size);
+        }
+    }
+}
+
+bool Table::update(long long _id, vector<string> row) {
+    lock_guard<recursive_mutex> lock(write_mutex);
+    long long registry_position = findRegistryPosition(_id);
+    if (registry_position < 0) {
+        return false;
+    }
+    
+    const char * registry = readRegistry(registry_position);
+    if (registry == NULL || isDeleted(registry)) {
+        return false;
+    }
+    
+    // The log only replays inserts, so it must not have this row anymore
+    if (wal != NULL) {
+        checkpoint();
+    }
+    
+    vector<char> buffer(getRegistrySize());
+    encodeRow(row, _id, &buffer[0]);
+    saveValues();
+    
+    // The registries are contiguous, so the row order comes from the position
+    long long row_index = (registry_position - FILE_HEADER_SIZE) / buffer.size();
+    
+    // The old value stays on the filters. The new one is saved before the
+    // registry, so a crash between them can't hide the row from a lookup
+    addFilterValues(&buffer[HEADER_SIZE], row_index);
+    ColumnBloomFilter::saveAll(bloom_filters);
+    
+    if (!writeRegistry(registry_position, &buffer[0], buffer.size())) {
+        return false;
+    }
+    
+    zone_map.update(row_index, &buffer[HEADER_SIZE], schema);
+    zone_map.save();
+    
+    // The old keys stay on the indexes, findEqual skips them
+    addIndexKeys(&buffer[HEADER_SIZE], registry_position);
+    return true;
+}
+
+bool Table::remove(long long _id) {
+    lock_guard<recursive_mutex> lock(write_mutex);
+    long long registry_position = findRegistryPosition(_id);
+    if (registry_position < 0) {
+        return false;
+    }
+    
+    const char * registry = readRegistry(registry_position);
+    if (registry == NULL || isDeleted(registry)) {
+        return false;
+    }
+    
+    if (wal != NULL) {
+        checkpoint();
+    }
+    
+    // Only the flags are written
+    unsigned flags;
+    memcpy(&flags, registry, sizeof(flags));
+    flags |= REGISTRY_DELETED;
+    
+    return writeRegistry(registry_position, reinterpret_cast<const char *> (&flags), sizeof(flags));
+}
+
+long long Table::compact() {
+    lock_guard<recursive_mutex> lock(write_mutex);
+    if (header_mode == POSITIONAL) {
+        cout << "The positional table " << name << " can't be compacted, the positions are computed from the _ids" << endl;
+        return 0;
+    }
+    
+    // The pool pages must be on the file before it's read
+    flush();
+    
+    TableFileHeader file_header;
+    if (!readFileHeader(&file_header)) {
+        return 0;
+    }
+    
+    string compacted_path = path + ".compact";
+    string compacted_header_file_path = header_file_path + ".compact";
+    
+    ifstream data_file;
+    data_file.open(path.c_str(), ios::binary);
+    
+    ofstream compacted_file, compacted_header_file;
+    compacted_file.open(compacted_path.c_str(), ios::binary | ios::trunc);
+    compacted_header_file.open(compacted_header_file_path.c_str(), ios::binary | ios::trunc);
+    if (!data_file.is_open() || !compacted_file.is_open() || !compacted_header_file.is_open()) {
+        cout << "Unable to open file - " << path << endl;
+        return 0;
+    }
+    
+    // The file header is the same
+    vector<char> buffer(FILE_HEADER_SIZE);
+    data_file.read(&buffer[0], FILE_HEADER_SIZE);
+    compacted_file.write(&buffer[0], FILE_HEADER_SIZE);
+    
+    // The registries are appended in the _id order, so the data file is read
+    // sequentially, in blocks of many registries
+    size_t registry_size = file_header.registry_size;
+    size_t registries_per_block = max((size_t) 1, BulkWriter::DEFAULT_BUFFER_SIZE / registry_size);
+    buffer.resize(registries_per_block * registry_size);
+    
+    header_t * compacted_header = new header_t();
+    compacted_header->reserve(header->size());
+    long long compacted_position = FILE_HEADER_SIZE;
+    long long removed_rows = 0;
+    
+    // The zones, the filters and the indexes are built again for the new row order
+    zone_map.reset(schema);
+    ColumnBloomFilter::clearAll(bloom_filters);
+    SecondaryIndex::clearAll(indexes);
+    if (hash_index != NULL) {
+        hash_index->clear();
+    }
+    
+    for (size_t block_start = 0; block_start < header->size(); block_start += registries_per_block) {
+        size_t block_rows = min(registries_per_block, header->size() - block_start);
+        
+        data_file.seekg(header->getPosition(block_start));
+        if (!data_file.read(&buffer[0], block_rows * registry_size)) {
+            cout << "Unable to read file - " << path << endl;
+            break;
+        }
+        
+        for (size_t i = 0; i < block_rows; i++) {
+            const char * registry = &buffer[i * registry_size];
+            
+            // The last registry is kept, so its _id is never reused
+            bool last_registry = block_start + i == header->size() - 1;
+            if (isDeleted(registry) && !last_registry) {
+                removed_rows ++;
+                continue;
+            }
+            
+            long long _id = header->getId(block_start + i);
+            compacted_file.write(registry, registry_size);
+            compacted_header_file.write(reinterpret_cast<const char *> (&_id), sizeof(_id));
+            compacted_header_file.write(reinterpret_cast<const char *> (&compacted_position), sizeof(compacted_position));
+            
+            compacted_header->push_back(pair<long long, long long> (_id, compacted_position));
+            zone_map.add(registry + HEADER_SIZE, schema);
+            addFilterValues(registry + HEADER_SIZE, compacted_header->size() - 1);
+            addIndexKeys(registry + HEADER_SIZE, compacted_position);
+            compacted_position += registry_size;
+        }
+    }
+    
+    data_file.close();
+    compacted_file.close();
+    compacted_header_file.close();
+    
+    // Replace the files and the header at once
+    closePoolFiles();
+    mapped_file.unmap();
+    rename(compacted_path.c_str(), path.c_str());
+    rename(compacted_header_file_path.c_str(), header_file_path.c_str());
+    
+    delete this->header;
+    this->header = compacted_header;
+    zone_map.save();
+    ColumnBloomFilter::saveAll(bloom_filters);
+    
+    // The registry positions changed, so the log restarts from the new files
+    if (wal != NULL) {
+        checkpoint();
+    }
+    refreshStatistics();
+    
+    return removed_rows;
+}
+
+void Table::drop() {
+    closePoolFiles();
+    mapped_file.unmap();
+    ::remove(this->path.c_str());
+    ::remove(this->header_file_path.c_str());
+    varchar_heap.drop();
+    zone_map.drop();
+    for (vector<Dictionary *>::iterator it = dictionaries.begin(); it != dictionaries.end(); it++) {
+        if (*it != NULL) {
+            (*it)->drop();
+        }
+    }
+    ColumnBloomFilter::dropAll(bloom_filters);
+    SecondaryIndex::dropAll(indexes);
+    if (hash_index != NULL) {
+        hash_index->drop();
+        delete hash_index;
+        hash_index = NULL;
+    }
+    if (wal != NULL) {
+        wal->drop();
+        delete wal;
+        wal = NULL;
+    }
+    this->header->clear();
+    this->number_of_rows = 0;
+    refreshStatistics();
+}
+
+bool Table::migrate() {
+    TableFileHeader file_header;
+    if (readFileHeader(&file_header)) {
+        // Already using the current layout
+        return false;
+    }
+    
+    ifstream legacy_file;
+    legacy_file.open(path.c_str(), ios::binary);
+    if (!legacy_file.is_open()) {
+        cout << "Unable to open file - " << path << endl;
+        return false;
+    }
+    
+    string migrated_path = path + ".migrating";
+    string migrated_header_file_path = header_file_path + ".migrating";
+    ofstream migrated_file;
+    ofstream migrated_header_file;
+    migrated_file.open(migrated_path.c_str(), ios::binary | ios::trunc);
+    migrated_header_file.open(migrated_header_file_path.c_str(), ios::binary | ios::trunc);
+    
+    vector<char> buffer(FILE_HEADER_SIZE);
+    encodeFileHeader(&buffer[0]);
+    migrated_file.write(&buffer[0], FILE_HEADER_SIZE);
+    
+    long long registry_position = FILE_HEADER_SIZE;
+    unsigned body_size = schema.getSize();
+    buffer.resize(body_size);
+    
+    while (true) {
+        //Import the legacy header
+        LegacyRegistryHeader legacy_header;
+        if (!legacy_file.read(legacy_header.table_name, sizeof(legacy_header.table_name)) ||
+            !legacy_file.read(reinterpret_cast<char *> (& legacy_header.registry_size), sizeof(legacy_header.registry_size)) ||
+            !legacy_file.read(reinterpret_cast<char *> (& legacy_header.time_stamp), sizeof(legacy_header.time_stamp)) ||
+            !legacy_file.read(&buffer[0], body_size)) {
+            break;
+        }
+        
+        //Export the registry using the slim header
+        RegistryHeader header;
+        header.flags = 0;
+        header.time_stamp = legacy_header.time_stamp;
+        migrated_file.write(reinterpret_cast<char *> (& header.flags), sizeof(header.flags));
+        migrated_file.write(reinterpret_cast<char *> (& header.time_stamp), sizeof(header.time_stamp));
+        migrated_file.write(&buffer[0], body_size);
+        
+        //The _id is the first column of the body
+        long long _id;
+        memcpy(&_id, &buffer[0], sizeof(_id));
+        migrated_header_file.write(reinterpret_cast<char *> (& _id), sizeof(_id));
+        migrated_header_file.write(reinterpret_cast<char *> (& registry_position), sizeof(registry_position));
+        registry_position += HEADER_SIZE + body_size;
+        
+        // Skip any padding left by a registry bigger than the schema
+        legacy_file.seekg(legacy_header.registry_size - sizeof(legacy_header.table_name) -
+            sizeof(legacy_header.registry_size) - sizeof(legacy_header.time_stamp) - body_size, ios::cur);
+    }
+    
+    legacy_file.close();
+    migrated_file.close();
+    migrated_header_file.close();
+    
+    closePoolFiles();
+    mapped_file.unmap();
+    rename(migrated_path.c_str(), path.c_str());
+    rename(migrated_header_file_path.c_str(), header_file_path.c_str());
+    
+    header->clear();
+    loadHeader();
+    rebuildZoneMap();
+    for (int i = 0; i < (int) bloom_filters.size(); i++) {
+        if (bloom_filters[i] != NULL) {
+            rebuildBloomFilter(i);
+        }
+    }
+    for (int i = 0; i < (int) indexes.size(); i++) {
+        if (indexes[i] != NULL) {
+            rebuildIndex(i);
+        }
+    }
+    if (hash_index != NULL) {
+        rebuildHashIndex();
+    }
+    
+    return true;
+}
+
+Join Table::join(string this_column_name, Table* other_table, string other_column_name, JoinType join_type) {
+    return Join(this, this_column_name, other_table, other_column_name, join_type);
 }
 
 vector<pair<string, long long>> *Table::getColumn(string column_name) {
     int column_position = schema.getColPosition(column_name);
-    return getColumn(column_position);
+    return getColumn(column_position);
+}
+
+vector<pair<string, long long>> *Table::getColumn(int column_position) {
+    //TODO: Get the column without retrieving the entire row
+    if (column_position < 0) return NULL;
+    
+    vector<pair<string, long long>> *table = new vector<pair<string, long long>>;
+
+    for (long long index = 0; index < getNumberOfRows(); index++) {
+        long long registry_position = getRegistryPosition(index);
+        vector<string> row = getRow(registry_position);
+        if (row.empty()) { // removed row
+            continue;
+        }
+        table->push_back(make_pair(row.at(column_position), registry_position));
+    }
+
+    return table;
+}
+
+int Table::getNumberOfRows() {
+    if (header_mode == POSITIONAL) {
+        return number_of_rows;
+    }
+    return header->size();
+}
+
+Dictionary * Table::getDictionary(int column_position) {
+    if (column_position < 0 || column_position >= (int) dictionaries.size()) {
+        return NULL;
+    }
+    return dictionaries.at(column_position);
+}
+
+vector<long long> * Table::findIndexCandidates(int column_position, const string & value) {
+    SchemaCol * schema_col = &schema.getCols()->at(column_position);
+    SecondaryIndex * index = getIndex(column_position);
+    if (getDictionary(column_position) != NULL || schema_col->type == VARCHAR) {
+        return index->find(value.substr(0, schema_col->array_size));
+    }
+    
+    string converted_value = value;
+    vector<char> expected_value(schema_col->getSize());
+    convertAndSave(&expected_value[0], &converted_value, schema_col);
+    return index->find(&expected_value[0], *schema_col);
+}
+
+vector<long long> * Table::findEqual(string column_name, string value) {
+    vector<long long> * positions = new vector<long long>;
+    int column_position = schema.getColPosition(column_name);
+    if (column_position < 0) {
+        return positions;
+    }
+    
+    SchemaCol * schema_col = &schema.getCols()->at(column_position);
+    Dictionary * dictionary = getDictionary(column_position);
+    
+    // The VARCHAR values are stored cut to the size of the column, like CHAR
+    if (dictionary == NULL && schema_col->type == VARCHAR) {
+        value = value.substr(0, schema_col->array_size);
+    }
+    
+    //Convert the value to the binary format once
+    vector<char> expected_value(schema_col->getSize());
+    if (dictionary != NULL) {
+        int code = dictionary->lookup(value.substr(0, schema_col->array_size));
+        if (code < 0) {
+            // The value is not on the dictionary, so no row has it
+            return positions;
+        }
+        memcpy(&expected_value[0], &code, sizeof(code));
+    } else if (schema_col->type != VARCHAR) {
+        convertAndSave(&expected_value[0], &value, schema_col);
+    }
+    
+    // The filter answers most of the absent values without reading the file
+    ColumnBloomFilter * bloom_filter = getBloomFilter(column_position);
+    unsigned long long hash = 0;
+    if (bloom_filter != NULL) {
+        if (dictionary != NULL) {
+            hash = ColumnBloomFilter::hashKey(value.substr(0, schema_col->array_size));
+        } else if (schema_col->type == VARCHAR) {
+            hash = ColumnBloomFilter::hashKey(value);
+        } else {
+            hash = ColumnBloomFilter::hashValue(&expected_value[0], *schema_col);
+        }
+        if (!bloom_filter->mayContain(hash)) {
+            return positions;
+        }
+    }
+    
+    // The index finds the rows without scanning, its old keys are checked
+    SecondaryIndex * index = getIndex(column_position);
+    if (index != NULL) {
+        vector<long long> * candidates = findIndexCandidates(column_position, value);
+        sort(candidates->begin(), candidates->end());
+        candidates->erase(unique(candidates->begin(), candidates->end()), candidates->end());
+        
+        long long end_position = FILE_HEADER_SIZE + getNumberOfRows() * (long long) getRegistrySize();
+        for (vector<long long>::iterator it = candidates->begin(); it != candidates->end(); it++) {
+            if (*it >= end_position) {
+                break;
+            }
+            const char * registry = readRegistry(*it);
+            if (registry != NULL && isEqual(registry, column_position, value, expected_value)) {
+                positions->push_back(*it);
+            }
+        }
+        delete candidates;
+        
+        if (bloom_filter != NULL && positions->empty()) {
+            bloom_filter->recordFalsePositive();
+        }
+        return positions;
+    }
+    
+    // The numeric values also skip the blocks out of their zones
+    bool numeric = dictionary == NULL && (schema_col->isInteger() || schema_col->isReal());
+    double number = numeric ? ZoneMap::readValue(&expected_value[0], *schema_col) : 0;
+    
+    size_t registry_size = getRegistrySize();
+    long long number_of_rows = getNumberOfRows();
+    for (long long index = 0; index < number_of_rows; index += ZoneMap::ROWS_PER_BLOCK) {
+        long long block = index / ZoneMap::ROWS_PER_BLOCK;
+        if ((numeric && number == number && !zone_map.mayMatch(block, column_position, number, number)) ||
+            (bloom_filter != NULL && !bloom_filter->mayContainInBlock(block, hash))) {
+            continue;
+        }
+        
+        long long block_rows = min(ZoneMap::ROWS_PER_BLOCK, number_of_rows - index);
+        long long block_position = getRegistryPosition(index);
+        const char * registries = readRegistries(block_position, block_rows);
+        if (registries == NULL) {
+            break;
+        }
+        
+        for (long long i = 0; i < block_rows; i++) {
+            if (isEqual(registries + i * registry_size, column_position, value, expected_value)) {
+                positions->push_back(block_position + i * registry_size);
+            }
+        }
+    }
+    
+    if (bloom_filter != NULL && positions->empty()) {
+        bloom_filter->recordFalsePositive();
+    }
+    
+    return positions;
 }
 
-vector<pair<string, long long>> *Table::getColumn(int column_position) {
-    //TODO: Get the column without retrieving the entire row
+bool Table::isEqual(const char * registry, int column_position, const string & value, const vector<char> & expected_value) {
+    if (isDeleted(registry)) {
+        return false;
+    }
+    
+    SchemaCol & schema_col = schema.getCols()->at(column_position);
+    if (schema_col.type == VARCHAR && getDictionary(column_position) == NULL) {
+        RowView row(&schema, registry + HEADER_SIZE, &varchar_heap);
+        return row.getCharsLength(column_position) == value.size() &&
+            memcmp(row.getChars(column_position), value.c_str(), value.size()) == 0;
+    }
+    return memcmp(registry + HEADER_SIZE + schema.getColOffset(column_position), &expected_value[0], schema_col.getSize()) == 0;
+}
+
+vector<long long> * Table::filterRange(string column_name, double min, double max) {
+    return filterRange(schema.getColPosition(column_name), min, max);
+}
+
+vector<long long> * Table::filterRange(int column_position, double min, double max) {
     if (column_position < 0) return NULL;
     
-    vector<pair<string, long long>> *table = new vector<pair<string, long long>>;
+    vector<long long> * positions = new vector<long long>;
+    SchemaCol & schema_col = schema.getCols()->at(column_position);
+    size_t registry_size = getRegistrySize();
+    unsigned value_offset = HEADER_SIZE + schema.getColOffset(column_position);
+    
+    long long number_of_rows = getNumberOfRows();
+    for (long long index = 0; index < number_of_rows; index += ZoneMap::ROWS_PER_BLOCK) {
+        // Skip the blocks where all the values are out of the range
+        if (!zone_map.mayMatch(index / ZoneMap::ROWS_PER_BLOCK, column_position, min, max)) {
+            continue;
+        }
+        
+        long long block_rows = std::min(ZoneMap::ROWS_PER_BLOCK, number_of_rows - index);
+        long long block_position = getRegistryPosition(index);
+        const char * registries = readRegistries(block_position, block_rows);
+        if (registries == NULL) {
+            break;
+        }
+        
+        for (long long i = 0; i < block_rows; i++) {
+            const char * registry = registries + i * registry_size;
+            if (isDeleted(registry)) {
+                continue;
+            }
+            double value = ZoneMap::readValue(registry + value_offset, schema_col);
+            if (value >= min && value <= max) {
+                positions->push_back(block_position + i * registry_size);
+            }
+        }
+    }
+    
+    return positions;
+}
+
+ZoneMap * Table::getZoneMap() {
+    return &zone_map;
+}
 
-    string stub;
-    for(header_t::iterator i = header->begin(); i != header->end(); i++){
-        stub = getRow(i->second).at(column_position);
-        table->push_back(make_pair(stub, i->second));
+bool Table::createBloomFilter(string column_name) {
+    int column_position = schema.getColPosition(column_name);
+    if (column_position < 0) {
+        return false;
+    }
+    
+    if (bloom_filters.at(column_position) == NULL) {
+        bloom_filters.at(column_position) = new ColumnBloomFilter(name + "_" + column_name + "_b.dat");
     }
+    rebuildBloomFilter(column_position);
+    return true;
+}
 
-    return table;
+ColumnBloomFilter * Table::getBloomFilter(int column_position) {
+    if (column_position < 0 || column_position >= (int) bloom_filters.size()) {
+        return NULL;
+    }
+    return bloom_filters.at(column_position);
 }
 
-int Table::getNumberOfRows() {
-    return header->size();
+bool Table::createIndex(string column_name) {
+    int column_position = schema.getColPosition(column_name);
+    if (column_position < 0) {
+        return false;
+    }
+    
+    if (indexes.at(column_position) == NULL) {
+        indexes.at(column_position) = new SecondaryIndex(name + "_" + column_name + "_i.dat");
+    }
+    rebuildIndex(column_position);
+    analyze();
+    return true;
+}
+
+SecondaryIndex * Table::getIndex(int column_position) {
+    if (column_position < 0 || column_position >= (int) indexes.size()) {
+        return NULL;
+    }
+    return indexes.at(column_position);
+}
+
+void Table::createHashIndex() {
+    if (hash_index == NULL) {
+        hash_index = new HashIndex(name + "_x.dat");
+    }
+    rebuildHashIndex();
+    analyze();
+}
+
+HashIndex * Table::getHashIndex() {
+    return hash_index;
+}
+
+void Table::refreshStatistics() {
+    long long number_of_rows = getNumberOfRows();
+    if (!statistics.analyzed || number_of_rows > 2 * statistics.number_of_rows ||
+        number_of_rows < statistics.number_of_rows / 2) {
+        analyze();
+    }
+}
+
+void Table::analyze() {
+    statistics_version++;
+    vector<SchemaCol> * schema_cols = schema.getCols();
+    long long number_of_rows = getNumberOfRows();
+    size_t registry_size = getRegistrySize();
+    Timer timer;
+    
+    TableStatistics analyzed_statistics;
+    analyzed_statistics.analyzed = true;
+    analyzed_statistics.number_of_rows = number_of_rows;
+    analyzed_statistics.distinct_values.assign(schema_cols->size(), 1);
+    if (number_of_rows == 0) {
+        statistics = analyzed_statistics;
+        return;
+    }
+    
+    // The blocks of the sample are spread over the table
+    long long number_of_blocks = (number_of_rows + ZoneMap::ROWS_PER_BLOCK - 1) / ZoneMap::ROWS_PER_BLOCK;
+    long long sample_blocks = min((long long) TableStatistics::SAMPLE_BLOCKS, number_of_blocks);
+    vector<unordered_map<unsigned long long, long long> > counts(schema_cols->size());
+    double scan_time = 0;
+    for (long long i = 0; i < sample_blocks; i++) {
+        long long row_index = (i * number_of_blocks / sample_blocks) * ZoneMap::ROWS_PER_BLOCK;
+        long long block_rows = min(ZoneMap::ROWS_PER_BLOCK, number_of_rows - row_index);
+        
+        timer.start();
+        const char * registries = readRegistries(getRegistryPosition(row_index), block_rows);
+        if (registries == NULL) {
+            break;
+        }
+        long long live_rows = 0;
+        for (long long j = 0; j < block_rows; j++) {
+            if (!isDeleted(registries + j * registry_size)) {
+                live_rows++;
+            }
+        }
+        scan_time += timer.getElapsedTime();
+        
+        for (long long j = 0; j < block_rows; j++) {
+            if (isDeleted(registries + j * registry_size)) {
+                continue;
+            }
+            RowView row(&schema, registries + j * registry_size + HEADER_SIZE, &varchar_heap,
+                dictionaries.empty() ? NULL : &dictionaries[0]);
+            for (int c = 1; c < (int) counts.size(); c++) {
+                if (getDictionary(c) == NULL) {
+                    counts[c][ColumnBloomFilter::hashValue(row, c)]++;
+                }
+            }
+        }
+        analyzed_statistics.sampled_rows += live_rows;
+    }
+    
+    // The _ids are unique and the dictionaries know their values
+    analyzed_statistics.distinct_values[0] = max(1LL, number_of_rows);
+    for (int c = 1; c < (int) counts.size(); c++) {
+        Dictionary * dictionary = getDictionary(c);
+        analyzed_statistics.distinct_values[c] = dictionary != NULL ? max(1, dictionary->getSize()) :
+            TableStatistics::estimateDistinctValues(counts[c], analyzed_statistics.sampled_rows, number_of_rows);
+    }
+    if (analyzed_statistics.sampled_rows > 0) {
+        analyzed_statistics.scan_cost = scan_time / analyzed_statistics.sampled_rows;
+    }
+    
+    // The rows of the random reads are spread over the table
+    vector<long long> ids;
+    timer.start();
+    for (int i = 0; i < TableStatistics::SAMPLE_READS; i++) {
+        long long index = i * number_of_rows / TableStatistics::SAMPLE_READS;
+        if (readRegistry(getRegistryPosition(index)) != NULL) {
+            ids.push_back(header_mode == POSITIONAL ? index : header->getId(index));
+        }
+    }
+    if (!ids.empty()) {
+        analyzed_statistics.random_read_cost = timer.getElapsedTime() / ids.size();
+    }
+    
+    // The header searches are too fast to be timed one by one
+    const int HEADER_SEARCHES = 8;
+    timer.start();
+    for (int repetition = 0; repetition < HEADER_SEARCHES; repetition++) {
+        for (vector<long long>::iterator it = ids.begin(); it != ids.end(); it++) {
+            findRegistryPosition(*it);
+        }
+    }
+    if (!ids.empty()) {
+        analyzed_statistics.header_search_cost = timer.getElapsedTime() / (HEADER_SEARCHES * ids.size());
+    }
+    
+    if (hash_index != NULL && !ids.empty()) {
+        timer.start();
+        for (vector<long long>::iterator it = ids.begin(); it != ids.end(); it++) {
+            long long registry_position;
+            hash_index->find(*it, &registry_position);
+        }
+        analyzed_statistics.hash_search_cost = timer.getElapsedTime() / ids.size();
+    }
+    
+    // The cost of a search is about the same on every secondary index
+    analyzed_statistics.index_search_cost = 2 * analyzed_statistics.random_read_cost;
+    for (int c = 0; c < (int) indexes.size(); c++) {
+        if (indexes[c] == NULL || ids.empty()) {
+            continue;
+        }
+        vector<string> values;
+        for (vector<long long>::iterator it = ids.begin(); it != ids.end(); it++) {
+            values.push_back(getValue(*it, c));
+        }
+        
+        timer.start();
+        for (vector<string>::iterator it = values.begin(); it != values.end(); it++) {
+            delete findIndexCandidates(c, *it);
+        }
+        analyzed_statistics.index_search_cost = timer.getElapsedTime() / values.size();
+        break;
+    }
+    
+    statistics = analyzed_statistics;
+}
+
+TableStatistics * Table::getStatistics() {
+    return &statistics;
+}
+
+long long Table::getRegistryPosition(long long index) {
+    if (header_mode == POSITIONAL) {
+        return FILE_HEADER_SIZE + index * getRegistrySize();
+    }
+    return header->getPosition(index);
 }
 
 string Table::getValue(long long _id, int column_position) {
@@ -655,4 +3623,345 @@ string Table::getValue(long long _id, int column_position) {
     }
     return value;
 }
+
+BulkWriter::BulkWriter(Table * table, size_t buffer_size) {
+    this->table = table;
+    this->buffer_size = buffer_size;
+    this->number_of_rows = 0;
+    this->closed = false;
+    this->log_sequence = 0;
+    
+    if (table->buffer_pool != NULL) {
+        // The writes are made on the buffer pool pages
+        table->openPoolFiles();
+        data_file_position = table->buffer_pool->getFileSize(table->data_file_id);
+        header_file_position = table->buffer_pool->getFileSize(table->header_file_id);
+        registry_position = data_file_position;
+    } else {
+        data_file.open(table->path.c_str(), ios::binary | ios::app);
+        if (table->header_mode == HEADER_FILE) {
+            header_file.open(table->header_file_path.c_str(), ios::binary | ios::app);
+        }
+        
+        // Appended data always goes to the end of the file
+        data_file.seekp(0, ios::end);
+        registry_position = data_file.tellp();
+    }
+    
+    data_buffer.reserve(buffer_size);
+    
+    if (registry_position == 0) {
+        // New file, the registries start after the file header
+        data_buffer.resize(table->FILE_HEADER_SIZE);
+        table->encodeFileHeader(&data_buffer[0]);
+        registry_position = table->FILE_HEADER_SIZE;
+    }
+    timer.start();
+}
+
+BulkWriter::~BulkWriter() {
+    close();
+}
+
+long long BulkWriter::insert(vector<string> & row) {
+    return insert(row, table->getNextId());
+}
+
+long long BulkWriter::insert(vector<string> & row, long long _id) {
+    size_t registry_size = table->HEADER_SIZE + table->schema.getSize();
+    
+    // The log is written before the data files are trusted
+    if (table->wal != NULL) {
+        log_sequence = table->wal->append(Table::encodeLogRecord(_id, row));
+    }
+    
+    //Encode the registry at the end of the buffer
+    size_t offset = data_buffer.size();
+    data_buffer.resize(offset + registry_size);
+    table->encodeRow(row, _id, &data_buffer[offset]);
+    
+    return appendRegistry(_id);
+}
+
+long long BulkWriter::insertRegistry(char * registry) {
+    size_t registry_size = table->HEADER_SIZE + table->schema.getSize();
+    long long _id = table->getNextId();
+    
+    memcpy(registry + table->HEADER_SIZE, &_id, sizeof(_id));
+    data_buffer.insert(data_buffer.end(), registry, registry + registry_size);
+    
+    return appendRegistry(_id);
+}
+
+long long BulkWriter::appendRegistry(long long _id) {
+    size_t registry_size = table->HEADER_SIZE + table->schema.getSize();
+    
+    // The registry is at the end of the buffer
+    const char * row_data = &data_buffer[data_buffer.size() - registry_size] + table->HEADER_SIZE;
+    table->addFilterValues(row_data, table->getNumberOfRows());
+    table->zone_map.add(row_data, table->schema);
+    table->addIndexKeys(row_data, registry_position);
+    
+    if (table->header_mode == POSITIONAL) {
+        // The position is computed from the _id, there is no header entry
+        table->number_of_rows ++;
+    } else {
+        //Save the header entry
+        HeaderFile header_entry;
+        header_entry._id = _id;
+        header_entry.registry_position = registry_position;
+        
+        const char * entry_id = reinterpret_cast<const char *> (& header_entry._id);
+        const char * entry_position = reinterpret_cast<const char *> (& header_entry.registry_position);
+        header_buffer.insert(header_buffer.end(), entry_id, entry_id + sizeof(header_entry._id));
+        header_buffer.insert(header_buffer.end(), entry_position, entry_position + sizeof(header_entry.registry_position));
+        
+        table->header->push_back(
+            pair<decltype(header_entry._id), decltype(header_entry.registry_position)> (
+                header_entry._id,
+                header_entry.registry_position));
+    }
+    
+    registry_position += registry_size;
+    number_of_rows ++;
+    
+    if (data_buffer.size() >= buffer_size) {
+        flush();
+    }
+    
+    return _id;
+}
+
+void BulkWriter::flush() {
+    BufferPool * buffer_pool = table->buffer_pool;
+    
+    // The heap and the dictionaries are written first
+    table->saveValues();
+    
+    if (!data_buffer.empty()) {
+        if (buffer_pool != NULL) {
+            buffer_pool->write(table->data_file_id, data_file_position, &data_buffer[0], data_buffer.size());
+            data_file_position += data_buffer.size();
+        } else {
+            data_file.write(&data_buffer[0], data_buffer.size());
+        }
+        data_buffer.clear();
+        
+        // The zones are written after the registries they describe
+        table->zone_map.save();
+    }
+    if (!header_buffer.empty()) {
+        if (buffer_pool != NULL) {
+            buffer_pool->write(table->header_file_id, header_file_position, &header_buffer[0], header_buffer.size());
+            header_file_position += header_buffer.size();
+        } else {
+            header_file.write(&header_buffer[0], header_buffer.size());
+        }
+        header_buffer.clear();
+    }
+}
+
+void BulkWriter::close() {
+    if (closed) {
+        return;
+    }
+    flush();
+    data_file.close();
+    header_file.close();
+    closed = true;
+}
+
+long long BulkWriter::getNumberOfRows() {
+    return number_of_rows;
+}
+
+unsigned long long BulkWriter::getLogSequence() {
+    return log_sequence;
+}
+
+double BulkWriter::getRowsPerSecond() {
+    double elapsed_time = timer.getElapsedTime();
+    if (elapsed_time <= 0) {
+        return 0;
+    }
+    return number_of_rows / elapsed_time;
+}
+
+PreparedStatement::PreparedStatement() {
+    this->table = NULL;
+}
+
+PreparedStatement::PreparedStatement(Table * table, shared_ptr<QueryPlan> plan) {
+    this->table = table;
+    this->plan = plan;
+    this->parameters.resize(plan->statement.number_of_parameters);
+    this->bound.resize(plan->statement.number_of_parameters, false);
+}
+
+bool PreparedStatement::isValid() {
+    return plan != NULL;
+}
+
+int PreparedStatement::getNumberOfParameters() {
+    return parameters.size();
+}
+
+bool PreparedStatement::bind(int index, const string & value) {
+    if (index < 0 || index >= (int) parameters.size()) {
+        return false;
+    }
+    parameters[index] = value;
+    bound[index] = true;
+    return true;
+}
+
+bool PreparedStatement::bindInteger(int index, long long value) {
+    char number[NumericCodec::MAX_LENGTH];
+    return bind(index, string(number, NumericCodec::formatInteger(value, number)));
+}
+
+bool PreparedStatement::bindReal(int index, double value) {
+    char number[NumericCodec::MAX_LENGTH];
+    return bind(index, string(number, NumericCodec::formatReal(value, number)));
+}
+
+void PreparedStatement::clearBindings() {
+    bound.assign(bound.size(), false);
+}
+
+Cursor PreparedStatement::execute() {
+    if (plan == NULL) {
+        return Cursor();
+    }
+    for (int i = 0; i < (int) bound.size(); i++) {
+        if (!bound[i]) {
+            cout << "Unbound parameter - " << i << endl;
+            return Cursor();
+        }
+    }
+    return table->execute(*plan, parameters);
+}
+
+TableScan::TableScan(Table * table, const PredicateTree & predicates, long long first_index, long long end_index,
+    long long limit) {
+    this->table = table;
+    this->predicates = predicates;
+    this->has_candidates = false;
+    this->first_index = first_index;
+    this->end_index = end_index;
+    this->limit = limit;
+    this->closed = false;
+    reset();
+}
+
+TableScan::TableScan(Table * table, const PredicateTree & predicates, const vector<long long> & candidates,
+    long long limit) {
+    this->table = table;
+    this->predicates = predicates;
+    this->candidates = candidates;
+    this->has_candidates = true;
+    this->first_index = 0;
+    this->end_index = 0;
+    this->limit = limit;
+    this->closed = false;
+    reset();
+}
+
+void TableScan::reset() {
+    buffered_rows = 0;
+    current_row = -1;
+    next_index = has_candidates ? 0 : first_index;
+    number_of_rows = table->getNumberOfRows();
+    if (end_index >= 0) {
+        number_of_rows = min(number_of_rows, end_index);
+    }
+    returned_rows = 0;
+    row = RowView();
+}
+
+bool TableScan::readBlock() {
+    size_t registry_size = table->getRegistrySize();
+    
+    if (has_candidates) {
+        if (next_index >= (long long) candidates.size()) {
+            return false;
+        }
+        const char * registry = table->readRegistry(candidates[next_index++]);
+        buffered_rows = registry == NULL ? 0 : 1;
+        if (registry != NULL) {
+            buffer.assign(registry, registry + registry_size);
+        }
+        current_row = -1;
+        return true;
+    }
+    
+    // The first block may start after its beginning
+    for (; next_index < number_of_rows; next_index = (next_index / ZoneMap::ROWS_PER_BLOCK + 1) * ZoneMap::ROWS_PER_BLOCK) {
+        if (!predicates.mayMatch(table->zone_map, next_index / ZoneMap::ROWS_PER_BLOCK)) {
+            continue;
+        }
+        
+        long long block_end = (next_index / ZoneMap::ROWS_PER_BLOCK + 1) * ZoneMap::ROWS_PER_BLOCK;
+        long long block_rows = std::min(block_end, number_of_rows) - next_index;
+        const char * registries = table->readRegistries(table->getRegistryPosition(next_index), block_rows);
+        if (registries == NULL) {
+            return false;
+        }
+        buffer.assign(registries, registries + block_rows * registry_size);
+        buffered_rows = block_rows;
+        current_row = -1;
+        next_index += block_rows;
+        return true;
+    }
+    return false;
+}
+
+bool TableScan::matches(const char * registry) {
+    if (Table::isDeleted(registry)) {
+        return false;
+    }
+    
+    row = RowView(&table->schema, registry + table->HEADER_SIZE, &table->varchar_heap,
+        table->dictionaries.empty() ? NULL : &table->dictionaries[0]);
+    return predicates.evaluate(row);
+}
+
+bool TableScan::next() {
+    if (closed || (limit >= 0 && returned_rows >= limit)) {
+        row = RowView();
+        return false;
+    }
+    
+    size_t registry_size = table->getRegistrySize();
+    while (true) {
+        while (++current_row < buffered_rows) {
+            if (matches(&buffer[current_row * registry_size])) {
+                returned_rows++;
+                return true;
+            }
+        }
+        if (!readBlock()) {
+            row = RowView();
+            return false;
+        }
+    }
+}
+
+RowView & TableScan::getRowView() {
+    return row;
+}
+
+string TableScan::getString(int column_position) {
+    return Table::convertToString(row.getBytes(column_position), &table->schema.getCols()->at(column_position),
+        &table->varchar_heap, table->getDictionary(column_position));
+}
+
+void TableScan::close() {
+    closed = true;
+    buffered_rows = 0;
+    row = RowView();
+    vector<char>().swap(buffer);
+    vector<long long>().swap(candidates);
+}
+
 #endif //TABLE_H
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include "table.h"
 #include "BPlusTree/bpt.h"
+#include "hashindex.h"
 #include "timer.h"
 
 using bpt::bplus_tree;
@@ -15,6 +16,12 @@ public:
     
     TableBenchmark(Table * table);
     
+    /**
+     * Write the (_id, registry position) pairs of the table on a hash index file
+     * @see HashIndex
+     */
+    void fillHashIndex(const string & path);
+    
     /*****************************************
      *********** BENCHMARK METHODS ***********
      *****************************************/
@@ -57,7 +64,9 @@ public:
      
      /**
       * Perform a query where only the _id is compared to the value.
-      * The query is made by searching on the in-memory hash table
+      * The query is made by searching on the on-disk hash index, which is
+      * filled and reopened before the search, so only the lookup is timed
+      * @see HashIndex
       * @return the table rows with the selected ids
       */
      vector<string> hashTableQuery(string _id);
@@ -68,7 +77,8 @@ public:
      
      /**
       * Perform a query where min < _id < max
-      * The query is made by searching on the table file
+      * The query is made by scanning the table file, skipping the blocks whose
+      * zone has no _id on the range
       * @return the table rows with the selected ids
       */
      vector<vector<string> > sequentialFileRangeQuery(int min, int max);
@@ -96,7 +106,9 @@ public:
      
      /**
       * Perform a query where min < _id < max
-      * The query is made by searching on the in-memory hash table using binary search
+      * The query is made by looking up every _id of the range on the
+      * on-disk hash index, which has no order
+      * @see HashIndex
       * @return the table rows with the selected ids
       */
      vector<vector<string> > hashTableRangeQuery(int min, int max);
@@ -126,6 +138,8 @@ void TableBenchmark::runBenchmark() {
 
 vector<string> TableBenchmark::sequentialFileQuery(string _id) {
     cout << "Sequential file query" << endl;
+    // The file is read directly, so the buffered pages must be written
+    table->flush();
     Timer timer;
     timer.start();
     
@@ -137,16 +151,24 @@ vector<string> TableBenchmark::sequentialFileQuery(string _id) {
     
     vector<SchemaCol>* schema_cols = table->schema.getCols();
     
+    //All the registries have the same size, stored on the file header
+    TableFileHeader file_header;
+    if (!table->readFileHeader(&file_header)) {
+        return row;
+    }
+    file.seekg(table->FILE_HEADER_SIZE);
+    
     while (file.good()) {
         //Import the header
         RegistryHeader header;
-        file.read(header.table_name, sizeof(header.table_name));
-        file.read(reinterpret_cast<char *> (& header.registry_size), sizeof(header.registry_size));
+        file.read(reinterpret_cast<char *> (& header.flags), sizeof(header.flags));
         file.read(reinterpret_cast<char *> (& header.time_stamp), sizeof(header.time_stamp));
         
         //Read the id
         long long row_id;
-        file.read(reinterpret_cast<char *> (&row_id), schema_cols->begin()->getSize());        
+        if (!file.read(reinterpret_cast<char *> (&row_id), schema_cols->begin()->getSize())) {
+            break;
+        }
         
         if (row_id == _number_id) {
             row = table->getRow((long long) file.tellg() - table->HEADER_SIZE - sizeof(_number_id));
@@ -162,7 +184,7 @@ vector<string> TableBenchmark::sequentialFileQuery(string _id) {
             // | HEADER | ID | REST_OF_THE_BODY | HEADER |
             //               ^
             // Must set the position to the next header
-            file.seekg((long long) file.tellg() + header.registry_size - table->HEADER_SIZE - sizeof(_number_id));
+            file.seekg((long long) file.tellg() + file_header.registry_size - table->HEADER_SIZE - sizeof(_number_id));
         }
     }
     
@@ -179,7 +201,7 @@ vector<string> TableBenchmark::sequentialIndexQuery(string _id) {
     long long _id_number = std::stoll((_id).c_str());
     //Iterate through the Table::header
     //The pair is defined like: (first value = _id, second value = registry_position)
-    for (header_t::iterator it = table->header->begin(); it != table->header->end(); it++) {
+    for (header_t::iterator it = table->getHeader()->begin(); it != table->getHeader()->end(); it++) {
         // compare the _id
         // cout << it->second << endl;
         if (_id_number == it->first) {
@@ -204,11 +226,9 @@ vector<string> TableBenchmark::bPlusTreeQuery(string _id) {
     bplus_tree tree("test.db", true);
     
     //Fill the b+ tree
-    for (header_t::iterator it = table->header->begin(); it != table->header->end(); it++) {
-        std::ostringstream stream;
-        stream << it->first;
-        const char* key = stream.str().c_str();
-        tree.insert(key, it->second);
+    for (header_t::iterator it = table->getHeader()->begin(); it != table->getHeader()->end(); it++) {
+        // The keys are compared as bytes, so the _id is stored on the index key format
+        tree.insert(SecondaryIndex::makeKey((long long) it->first, 0), it->second);
     }
     cout << "Filled b+ tree" << endl;
     
@@ -217,8 +237,7 @@ vector<string> TableBenchmark::bPlusTreeQuery(string _id) {
     
     //Search the b+ tree
     bpt::value_t value;
-    tree.search(_id.c_str(), &value);
-    if (value != -1) {
+    if (tree.search(SecondaryIndex::makeKey(stoll(_id), 0), &value) == 0) {
         cout << "Found " << _id << endl;
         cout << "Time " << timer.getElapsedTime() << " s" << endl;
         row = table->getRow(value);
@@ -235,11 +254,11 @@ vector<string> TableBenchmark::binaryIndexQuery(string _id) {
     long long _id_number = stoll(_id.c_str());
     //Iterate through the Table::header
     //The pair is defined like: (first value = _id, second value = registry_position)
-    int idx = distance(table->header->begin(), lower_bound(table->header->begin(),table->header->end(), 
+    int idx = distance(table->getHeader()->begin(), lower_bound(table->getHeader()->begin(),table->getHeader()->end(), 
        make_pair(_id_number, numeric_limits<long long>::min())));
     
     // If the found index is equals to the desired index, the _id was found
-    auto pair = table->header->at(idx);
+    auto pair = table->getHeader()->at(idx);
     if (pair.first == _id_number) {
         cout << "Found " << _id << endl;
         cout << "Time " << timer.getElapsedTime() << " s" << endl;
@@ -255,6 +274,8 @@ vector<string> TableBenchmark::binaryIndexQuery(string _id) {
 
 vector<vector<string> > TableBenchmark::sequentialFileRangeQuery(int min, int max) {
     cout << "Sequential file range query" << endl;
+    // The file is read directly, so the buffered pages must be written
+    table->flush();
     Timer timer;
     timer.start();
     
@@ -267,16 +288,43 @@ vector<vector<string> > TableBenchmark::sequentialFileRangeQuery(int min, int ma
     
     bool found = false;
     
+    //All the registries have the same size, stored on the file header
+    TableFileHeader file_header;
+    if (!table->readFileHeader(&file_header)) {
+        return rows;
+    }
+    file.seekg(table->FILE_HEADER_SIZE);
+    
+    ZoneMap * zone_map = table->getZoneMap();
+    long long index = 0;
+    
     while (file.good()) {
+        if (index % ZoneMap::ROWS_PER_BLOCK == 0) {
+            // Skip the blocks where no _id is on the range
+            long long block = index / ZoneMap::ROWS_PER_BLOCK;
+            while (block < zone_map->getNumberOfBlocks() && !zone_map->mayMatch(block, 0, min, max)) {
+                block++;
+            }
+            if (block * ZoneMap::ROWS_PER_BLOCK >= table->getNumberOfRows()) {
+                break;
+            }
+            if (block * ZoneMap::ROWS_PER_BLOCK != index) {
+                index = block * ZoneMap::ROWS_PER_BLOCK;
+                file.seekg(table->getRegistryPosition(index));
+            }
+        }
+        index++;
+        
         //Import the header
         RegistryHeader header;
-        file.read(header.table_name, sizeof(header.table_name));
-        file.read(reinterpret_cast<char *> (& header.registry_size), sizeof(header.registry_size));
+        file.read(reinterpret_cast<char *> (& header.flags), sizeof(header.flags));
         file.read(reinterpret_cast<char *> (& header.time_stamp), sizeof(header.time_stamp));
         
         //Read the id
         long long row_id;
-        file.read(reinterpret_cast<char *> (&row_id), schema_cols->begin()->getSize());        
+        if (!file.read(reinterpret_cast<char *> (&row_id), schema_cols->begin()->getSize())) {
+            break;
+        }
         
         if (row_id >= min) {
             found = true;
@@ -293,7 +341,7 @@ vector<vector<string> > TableBenchmark::sequentialFileRangeQuery(int min, int ma
         // | HEADER | ID | REST_OF_THE_BODY | HEADER |
         //               ^
         // Must set the position to the next header
-        file.seekg((long long) file.tellg() + header.registry_size - table->HEADER_SIZE - sizeof(row_id));
+        file.seekg((long long) file.tellg() + file_header.registry_size - table->HEADER_SIZE - sizeof(row_id));
     
     }
     
@@ -314,7 +362,7 @@ vector<vector<string> > TableBenchmark::sequentialIndexRangeQuery(int min, int m
     
     vector<vector<string> > rows;
     bool found = false;
-    for (header_t::iterator it = table->header->begin(); it != table->header->end(); it++) {
+    for (header_t::iterator it = table->getHeader()->begin(); it != table->getHeader()->end(); it++) {
         // compare the _id
         // cout << it->second << endl;
         if (it->first >= min) {
@@ -345,11 +393,9 @@ vector<vector<string> > TableBenchmark::bPlusTreeRangeQuery(int min, int max) {
     bplus_tree tree("test.db", true);
     
     //Fill the b+ tree
-    for (header_t::iterator it = table->header->begin(); it != table->header->end(); it++) {
-        std::ostringstream stream;
-        stream << it->first;
-        const char* key = stream.str().c_str();
-        tree.insert(key, it->second);
+    for (header_t::iterator it = table->getHeader()->begin(); it != table->getHeader()->end(); it++) {
+        // The keys are compared as bytes, so the _id is stored on the index key format
+        tree.insert(SecondaryIndex::makeKey((long long) it->first, 0), it->second);
     }
     cout << "Filled b+ tree" << endl;
     
@@ -367,27 +413,21 @@ vector<vector<string> > TableBenchmark::bPlusTreeRangeQuery(int min, int max) {
         values[i] = -1;
     }
     
-    //Convert the min to key_1
-    ostringstream stream;
-    stream << min;
-    key_1 = stream.str().c_str();
-    
-    //Clear the stream
-    stream.str("");
-    
-    //Convert the max to key_2
-    stream << max;
-    key_2 = stream.str().c_str();
+    //Convert the min and the max to keys
+    key_1 = SecondaryIndex::makeKey((long long) min, 0);
+    key_2 = SecondaryIndex::makeKey((long long) max, 0);
     
     //Search the b+ tree
     tree.search_range(&key_1, key_2, values, size);
     
+    vector<long long> registry_positions;
     for (int i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
         if (values[i] == -1) {
             break;
         }
-        rows.push_back(table->getRow(values[i]));
+        registry_positions.push_back(values[i]);
     }
+    rows = table->getRows(registry_positions);
 
     if (rows.size() > 0) {
         cout << "Found" << endl;
@@ -407,21 +447,19 @@ vector<vector<string> > TableBenchmark::binaryIndexRangeQuery(int min, int max)
     
     //Iterate through the Table::header
     //The pair is defined like: (first value = _id, second value = registry_position)
-    int idx = distance(table->header->begin(), lower_bound(table->header->begin(),table->header->end(), 
+    int idx = distance(table->getHeader()->begin(), lower_bound(table->getHeader()->begin(),table->getHeader()->end(), 
        make_pair((long long) min, numeric_limits<long long>::min())));
     bool found = false;
     
     // If the found index is equals to the desired index, the _id was found
-    auto pair = table->header->at(idx);
-    if (pair.first == min) {
+    if (idx < (int) table->getHeader()->size() && table->getHeader()->at(idx).first == min) {
         found = true;
-        while (pair.first >= min && pair.first <= max) {
-            rows.push_back(table->getRow(pair.second));
-            if (idx < table->header->size()) {
-                idx++;
-                pair = table->header->at(idx);
-            }
+        vector<long long> registry_positions;
+        while (idx < (int) table->getHeader()->size() && table->getHeader()->at(idx).first <= max) {
+            registry_positions.push_back(table->getHeader()->at(idx).second);
+            idx++;
         }
+        rows = table->getRows(registry_positions);
     }
     
     if (found) {
@@ -432,28 +470,42 @@ vector<vector<string> > TableBenchmark::binaryIndexRangeQuery(int min, int max)
     return rows;
 }
 
+void TableBenchmark::fillHashIndex(const string & path) {
+    HashIndex hash_index(path);
+    hash_index.clear();
+    for (long long index = 0; index < table->getNumberOfRows(); index++) {
+        long long registry_position = table->getRegistryPosition(index);
+        RowView row = table->getRowView(registry_position);
+        if (row.isValid()) {
+            hash_index.insert(row.getInteger(0), registry_position);
+        }
+    }
+    cout << "Filled hash index, " << hash_index.getNumberOfBuckets() << " buckets" << endl;
+}
+
 vector<string> TableBenchmark::hashTableQuery(string _id) {
     cout << "Hash table query" << endl;
     
     vector<string> row;
-    map<long long, long long> hashtable;
-    long long _id_number = atoi(_id.c_str());
-    
-    
-    //Fill the map
-    hashtable.insert(table->header->begin(), table->header->end());
+    long long _id_number = stoll(_id.c_str());
+    fillHashIndex("test_hash.db");
     
     Timer timer;
     timer.start();
     
-    //Search on the map
-    row = table->getRow(hashtable.find(_id_number)->second);
-
+    // The index is mapped, not read, when it is opened
+    HashIndex hash_index("test_hash.db");
+    long long registry_position;
+    if (hash_index.find(_id_number, &registry_position)) {
+        row = table->getRow(registry_position);
+    }
+    
     if (row.size() > 0) {
         cout << "Found" << endl;
         cout << "Time " << timer.getElapsedTime() << " s" << endl;
         // print(&row);
     }
+    hash_index.drop();
     
     return row;
 }
@@ -462,33 +514,27 @@ vector<vector<string> > TableBenchmark::hashTableRangeQuery(int min, int max) {
     cout << "Hash table range query" << endl;
     
     vector<vector<string> > rows;
-    int current_id = min;
-    map<long long, long long> hashtable;
-    
-    //Fill the map
-    hashtable.insert(table->header->begin(), table->header->end());
+    fillHashIndex("test_hash.db");
     
     Timer timer;
     timer.start();
     
-    //Search on the map
-    for (map<long long, long long>::iterator it = hashtable.begin(); it != hashtable.end(); it++) {
-        if (current_id > max) {
-            break;
-        }
- 
-        vector<string> row = table->getRow(hashtable.find(current_id)->second);       
-        if (row.size() > 0) {
-            rows.push_back(row);
+    HashIndex hash_index("test_hash.db");
+    vector<long long> registry_positions;
+    for (long long current_id = min; current_id <= max; current_id++) {
+        long long registry_position;
+        if (hash_index.find(current_id, &registry_position)) {
+            registry_positions.push_back(registry_position);
         }
-        current_id ++;
     }
+    rows = table->getRows(registry_positions);
     
     if (rows.size() > 0) {
         cout << "Found" << endl;
         cout << "Time " << timer.getElapsedTime() << " s" << endl;
         // print(&rows);
     }
+    hash_index.drop();
     
     return rows;
 }
@@ -1,5 +1,10 @@
 #include "catch.hpp"
 #include "../table.h"
+#include "../columntable.h"
+#include "../hashindex.h"
+#include "../queryparser.h"
+#include <thread>
+#include <random>
 
 TEST_CASE("A table should have a one-to-one relation") {
     GIVEN("Two related tables") {
@@ -52,4 +57,1660 @@ TEST_CASE("A table should have a one-to-one relation") {
             }
         }
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("A table should insert many rows at once") {
+    GIVEN("A table with a schema") {
+        Schema schema;
+        schema.addCol("name", CHAR, 31);
+        schema.addCol("age", INT32);
+        
+        Table table("batch");
+        table.setSchema(schema);
+        
+        WHEN("The rows are inserted in a batch") {
+            vector<vector<string> > rows;
+            for (int i = 0; i < 100; i++) {
+                vector<string> row;
+                row.push_back("Person " + std::to_string(i));
+                row.push_back(std::to_string(i * 2));
+                rows.push_back(row);
+            }
+            long long first_id = table.insertBatch(rows);
+            
+            THEN("Every row must be retrieved by its _id") {
+                REQUIRE(first_id == 0);
+                REQUIRE(table.getNumberOfRows() == 100);
+                
+                for (int i = 0; i < 100; i++) {
+                    vector<string> retrieved_row = table.getRowById(i);
+                    
+                    REQUIRE(retrieved_row.at(0) == std::to_string(i));
+                    REQUIRE(retrieved_row.at(1) == rows.at(i).at(0));
+                    REQUIRE(retrieved_row.at(2) == rows.at(i).at(1));
+                }
+                
+                table.drop();
+            }
+        }
+    }
+}
+
+
+TEST_CASE("A table should read rows from the memory mapped file") {
+    GIVEN("A table using the memory mapped read mode") {
+        Schema schema;
+        schema.addCol("name", CHAR, 31);
+        schema.addCol("points", DOUBLE);
+        
+        Table table("mapped");
+        table.setSchema(schema);
+        table.setReadMode(MMAP_READ);
+        
+        vector<string> row;
+        row.push_back("First");
+        row.push_back("1.5");
+        table.insert(row);
+        
+        REQUIRE(table.getRowById(0).at(1) == "First");
+        
+        WHEN("Rows are appended after the file was mapped") {
+            row.at(0) = "Second";
+            row.at(1) = "-2.25";
+            long long _id = table.insert(row);
+            
+            THEN("The new rows must be read from the grown mapping") {
+                vector<string> retrieved_row = table.getRowById(_id);
+                
+                REQUIRE(retrieved_row.at(1) == "Second");
+                REQUIRE(retrieved_row.at(2) == "-2.25");
+                REQUIRE(table.getRowById(0).at(1) == "First");
+                
+                table.drop();
+            }
+        }
+    }
+}
+
+
+TEST_CASE("A row view should read the typed values without conversion") {
+    Schema schema;
+    schema.addCol("name", CHAR, 31);
+    schema.addCol("age", INT32);
+    schema.addCol("points", DOUBLE);
+    schema.addCol("company", FOREIGN_KEY);
+    
+    Table table("view");
+    table.setSchema(schema);
+    
+    vector<string> row;
+    row.push_back("Person");
+    row.push_back("42");
+    row.push_back("3.5");
+    row.push_back("7");
+    long long _id = table.insert(row);
+    
+    RowView view = table.getRowView(table.getHeader()->at(_id).second);
+    
+    REQUIRE(view.isValid());
+    REQUIRE(view.getInt64(0) == _id);
+    REQUIRE(string(view.getChars(1)) == "Person");
+    REQUIRE(view.getInt32(2) == 42);
+    REQUIRE(view.getDouble(3) == 3.5);
+    REQUIRE(view.getInteger(4) == 7);
+    
+    table.drop();
+}
+
+
+TEST_CASE("A column table should read only the columns involved") {
+    GIVEN("A column table and a row table") {
+        Schema person_schema;
+        person_schema.addCol("name", CHAR, 31);
+        person_schema.addCol("age", INT32);
+        
+        ColumnTable person_table("column_person");
+        person_table.setSchema(person_schema);
+        
+        Schema contact_schema;
+        contact_schema.addCol("number", INT64);
+        contact_schema.addCol("person", FOREIGN_KEY);
+        
+        Table contact_table("column_contact");
+        contact_table.setSchema(contact_schema);
+        
+        vector<vector<string> > person_rows;
+        for (int i = 0; i < 10; i++) {
+            vector<string> row;
+            row.push_back("Person " + std::to_string(i));
+            row.push_back(std::to_string(20 + i));
+            person_rows.push_back(row);
+        }
+        person_table.insertBatch(person_rows);
+        
+        vector<string> contact_row;
+        contact_row.push_back("123456");
+        contact_row.push_back("3");
+        contact_table.insert(contact_row);
+        
+        THEN("The rows and columns must be read from the column files") {
+            REQUIRE(person_table.getNumberOfRows() == 10);
+            REQUIRE(person_table.getRowById(4).at(1) == "Person 4");
+            REQUIRE(person_table.getValue(7, 2) == "27");
+            
+            vector<pair<string, long long>> * ages = person_table.getColumn("age");
+            REQUIRE(ages->size() == 10);
+            REQUIRE(ages->at(9).first == "29");
+            delete ages;
+            
+            vector<long long> * positions = person_table.filterRange("age", 22, 24);
+            REQUIRE(positions->size() == 3);
+            REQUIRE(positions->at(0) == 2);
+            delete positions;
+            
+            RowView view = person_table.getRowView(5);
+            REQUIRE(string(view.getChars(1)) == "Person 5");
+            REQUIRE(view.getInt32(2) == 25);
+        }
+        
+        THEN("The column table must be joined with a row table") {
+            Join merge_join = person_table.join("_id", &contact_table, "person", MERGE);
+            Join hash_join = person_table.join("_id", &contact_table, "person", HASH);
+            
+            REQUIRE(merge_join.getNumberOfRows() == 1);
+            REQUIRE(hash_join.getNumberOfRows() == 1);
+        }
+        
+        person_table.drop();
+        contact_table.drop();
+    }
+}
+
+
+TEST_CASE("A table should read and write through the buffer pool") {
+    GIVEN("A table using a small buffer pool") {
+        Schema schema;
+        schema.addCol("name", CHAR, 63);
+        schema.addCol("age", INT32);
+        
+        BufferPool pool(4 * BufferPool::PAGE_BYTES);
+        
+        vector<vector<string> > rows;
+        for (int i = 0; i < 200; i++) {
+            vector<string> row;
+            row.push_back("Person " + std::to_string(i));
+            row.push_back(std::to_string(i));
+            rows.push_back(row);
+        }
+        
+        {
+            Table table("pooled");
+            table.setSchema(schema);
+            table.setBufferPool(&pool);
+            table.insertBatch(rows);
+            
+            REQUIRE(table.getRowById(150).at(1) == "Person 150");
+            
+            pool.resetStatistics();
+            table.getRowById(150);
+            REQUIRE(pool.getHits() > 0);
+            
+            // Reading every row needs more pages than the budget
+            for (int i = 0; i < 200; i++) {
+                REQUIRE(table.getRowById(i).at(2) == std::to_string(i));
+            }
+            REQUIRE(pool.getEvictions() > 0);
+        }
+        
+        WHEN("The table is loaded again without the pool") {
+            Table table("pooled");
+            table.setSchema(schema);
+            
+            THEN("The rows written by the pool must be on the files") {
+                REQUIRE(table.getNumberOfRows() == 200);
+                REQUIRE(table.getRowById(199).at(1) == "Person 199");
+                
+                table.drop();
+            }
+        }
+    }
+}
+
+
+TEST_CASE("A positional table should find the rows without the header file") {
+    Schema schema;
+    schema.addCol("name", CHAR, 31);
+    
+    vector<vector<string> > rows;
+    for (int i = 0; i < 50; i++) {
+        vector<string> row;
+        row.push_back("Person " + std::to_string(i));
+        rows.push_back(row);
+    }
+    
+    {
+        Table table("positional", POSITIONAL);
+        table.setSchema(schema);
+        table.insertBatch(rows);
+        table.insert(rows.at(0));
+        
+        REQUIRE(table.getNumberOfRows() == 51);
+        REQUIRE(table.getRowById(50).at(1) == "Person 0");
+        REQUIRE(table.getRowById(51).empty());
+    }
+    
+    Table table("positional", POSITIONAL);
+    table.setSchema(schema);
+    
+    REQUIRE(table.getNumberOfRows() == 51);
+    REQUIRE(table.getRowById(42).at(1) == "Person 42");
+    REQUIRE(table.getHeader()->at(42).first == 42);
+    
+    ifstream header_file("positional_h.dat");
+    REQUIRE(!header_file.is_open());
+    
+    table.drop();
+}
+
+
+TEST_CASE("A varchar column should store short strings inline and long ones on the heap") {
+    Schema schema;
+    schema.addCol("name", VARCHAR, 255);
+    schema.addCol("age", INT32);
+    
+    Table table("varchar");
+    table.setSchema(schema);
+    
+    REQUIRE(schema.getSize() == sizeof(long long) + VARCHAR_SLOT_SIZE + sizeof(float));
+    
+    string short_name = "Ana";
+    string long_name = "Maria Aparecida dos Santos Oliveira";
+    string empty_name = "";
+    
+    vector<string> row;
+    row.push_back(short_name);
+    row.push_back("30");
+    table.insert(row);
+    
+    row.at(0) = long_name;
+    table.insert(row);
+    
+    row.at(0) = empty_name;
+    table.insert(row);
+    
+    REQUIRE(table.getRowById(0).at(1) == short_name);
+    REQUIRE(table.getRowById(1).at(1) == long_name);
+    REQUIRE(table.getRowById(1).at(2) == "30");
+    REQUIRE(table.getRowById(2).at(1) == empty_name);
+    
+    RowView view = table.getRowView(table.getRegistryPosition(1));
+    REQUIRE(string(view.getChars(1)) == long_name);
+    REQUIRE(view.getCharsLength(1) == long_name.size());
+    
+    table.drop();
+}
+
+TEST_CASE("A varchar column should find the values cut to its size like a char column") {
+    Schema schema;
+    schema.addCol("c", CHAR, 10);
+    schema.addCol("v", VARCHAR, 10);
+    
+    Table table("varchar");
+    table.setSchema(schema);
+    table.insert(vector<string>(2, "abcdefghijKLM"));
+    
+    vector<long long> * positions = table.findEqual("c", "abcdefghijKLM");
+    REQUIRE(positions->size() == 1);
+    delete positions;
+    positions = table.findEqual("v", "abcdefghijKLM");
+    REQUIRE(positions->size() == 1);
+    delete positions;
+    REQUIRE(table.query("SELECT * WHERE v = 'abcdefghijKLM'").getCount() == 1);
+    
+    // The filter and the index have the stored value
+    REQUIRE(table.createBloomFilter("v"));
+    REQUIRE(table.createIndex("v"));
+    positions = table.findEqual("v", "abcdefghijXYZ");
+    REQUIRE(positions->size() == 1);
+    delete positions;
+    REQUIRE(table.query("SELECT * WHERE v = 'abcdefghijXYZ'").getCount() == 1);
+    
+    table.drop();
+}
+
+TEST_CASE("A dictionary column should store codes and join on them") {
+    Schema schema;
+    schema.addCol("city", CHAR, 255, true);
+    schema.addCol("age", INT32);
+    
+    REQUIRE(schema.getSize() == sizeof(long long) + sizeof(int) + sizeof(int));
+    
+    Table table("dictionary");
+    table.setSchema(schema);
+    
+    vector<string> row;
+    row.push_back("Curitiba");
+    row.push_back("30");
+    table.insert(row);
+    row.at(0) = "Recife";
+    table.insert(row);
+    row.at(0) = "Curitiba";
+    table.insert(row);
+    
+    REQUIRE(table.getDictionary(1)->getSize() == 2);
+    REQUIRE(table.getDictionary(2) == NULL);
+    REQUIRE(table.getRowById(1).at(1) == "Recife");
+    REQUIRE(table.getRowById(2).at(2) == "30");
+    
+    RowView view = table.getRowView(table.getRegistryPosition(2));
+    REQUIRE(view.getCode(1) == 0);
+    REQUIRE(string(view.getChars(1)) == "Curitiba");
+    
+    vector<long long> * positions = table.findEqual("city", "Curitiba");
+    REQUIRE(positions->size() == 2);
+    delete positions;
+    positions = table.findEqual("city", "Manaus");
+    REQUIRE(positions->empty());
+    delete positions;
+    
+    // The dictionary is loaded back from the file
+    {
+        Table reopened("dictionary");
+        reopened.setSchema(schema);
+        REQUIRE(reopened.getRowById(0).at(1) == "Curitiba");
+    }
+    
+    Schema other_schema;
+    other_schema.addCol("city", VARCHAR, 255);
+    Table other("dictionary_other");
+    other.setSchema(other_schema);
+    row.resize(1);
+    row.at(0) = "Recife";
+    other.insert(row);
+    row.at(0) = "Manaus";
+    other.insert(row);
+    
+    Join join(&table, "city", &other, "city", HASH);
+    REQUIRE(join.getNumberOfRows() == 1);
+    
+    table.drop();
+    other.drop();
+}
+
+TEST_CASE("A table should update and remove rows in place and compact the files") {
+    Schema schema;
+    schema.addCol("name", CHAR, 20);
+    schema.addCol("age", INT32);
+    
+    Table table("compaction");
+    table.setSchema(schema);
+    
+    vector<vector<string> > rows;
+    for (int i = 0; i < 5; i++) {
+        vector<string> row;
+        row.push_back("name" + to_string(i));
+        row.push_back(to_string(i));
+        rows.push_back(row);
+    }
+    table.insertBatch(rows);
+    
+    vector<string> row;
+    row.push_back("updated");
+    row.push_back("42");
+    REQUIRE(table.update(1, row));
+    REQUIRE(table.getRowById(1).at(1) == "updated");
+    REQUIRE(table.getRowById(1).at(2) == "42");
+    REQUIRE(table.getRowById(2).at(1) == "name2");
+    
+    REQUIRE(table.remove(3));
+    REQUIRE_FALSE(table.remove(3));
+    REQUIRE_FALSE(table.update(3, row));
+    REQUIRE(table.getRowById(3).empty());
+    REQUIRE_FALSE(table.getRowView(table.getRegistryPosition(3)).isValid());
+    
+    REQUIRE(table.compact() == 1);
+    REQUIRE(table.getNumberOfRows() == 4);
+    REQUIRE(table.getRowById(3).empty());
+    REQUIRE(table.getRowById(4).at(1) == "name4");
+    
+    // The _ids of the removed rows are not reused
+    REQUIRE(table.insert(row) == 5);
+    
+    {
+        Table reopened("compaction");
+        reopened.setSchema(schema);
+        REQUIRE(reopened.getNumberOfRows() == 5);
+        REQUIRE(reopened.getRowById(1).at(1) == "updated");
+        REQUIRE(reopened.getRowById(5).at(2) == "42");
+    }
+    
+    // The removed last row keeps its registry, so the next _id is not its _id
+    REQUIRE(table.remove(5));
+    REQUIRE(table.compact() == 0);
+    REQUIRE(table.getRowById(5).empty());
+    REQUIRE(table.insert(row) == 6);
+    REQUIRE(table.getRowById(6).at(1) == "updated");
+    
+    table.drop();
+}
+
+TEST_CASE("A table should not lose the rows inserted during a compaction") {
+    Schema schema;
+    schema.addCol("name", CHAR, 20);
+    schema.addCol("age", INT32);
+    
+    Table table("compaction");
+    table.setSchema(schema);
+    REQUIRE(table.enableWriteAheadLog());
+    
+    vector<vector<string> > rows(100, vector<string>(2, "1"));
+    table.insertBatch(rows);
+    
+    // The writers insert while the rows are removed and the files compacted
+    vector<vector<long long> > ids(4);
+    vector<thread> writers;
+    for (int t = 0; t < 4; t++) {
+        writers.push_back(thread([&table, &ids, t]() {
+            vector<string> row;
+            row.push_back("writer " + to_string(t));
+            row.push_back(to_string(t));
+            for (int i = 0; i < 100; i++) {
+                ids[t].push_back(table.insert(row));
+            }
+        }));
+    }
+    for (long long _id = 0; _id < 100; _id++) {
+        REQUIRE(table.remove(_id));
+        if (_id % 10 == 9) {
+            table.compact();
+        }
+    }
+    for (size_t t = 0; t < writers.size(); t++) {
+        writers.at(t).join();
+    }
+    table.compact();
+    
+    REQUIRE(table.getNumberOfRows() == 400);
+    for (size_t t = 0; t < ids.size(); t++) {
+        for (size_t i = 0; i < ids[t].size(); i++) {
+            REQUIRE(ids[t][i] >= 100);
+            REQUIRE(table.getRowById(ids[t][i]).at(1) == "writer " + to_string(t));
+        }
+    }
+    
+    table.drop();
+}
+
+TEST_CASE("A table should replay the write-ahead log after a crash") {
+    Schema schema;
+    schema.addCol("name", VARCHAR, 255);
+    schema.addCol("age", INT32);
+    
+    // The table is never closed, as if the process crashed
+    Table * crashed = new Table("wal");
+    crashed->setSchema(schema);
+    REQUIRE(crashed->enableWriteAheadLog());
+    
+    vector<thread> writers;
+    for (int t = 0; t < 4; t++) {
+        writers.push_back(thread([crashed, t]() {
+            for (int i = 0; i < 50; i++) {
+                vector<string> row;
+                row.push_back("writer number " + to_string(t));
+                row.push_back(to_string(i));
+                crashed->insert(row);
+            }
+        }));
+    }
+    for (size_t t = 0; t < writers.size(); t++) {
+        writers.at(t).join();
+    }
+    REQUIRE(crashed->getNumberOfRows() == 200);
+    REQUIRE(crashed->getWriteAheadLog()->getNumberOfSyncs() < 200);
+    
+    // Only the first row and part of the second reached the data file
+    struct stat file_stat;
+    stat("wal.dat", &file_stat);
+    long long registry_size = (file_stat.st_size - crashed->getRegistryPosition(0)) / 200;
+    truncate("wal.dat", crashed->getRegistryPosition(1) + registry_size / 2);
+    
+    Table table("wal");
+    table.setSchema(schema);
+    REQUIRE(table.enableWriteAheadLog());
+    REQUIRE(table.getNumberOfRows() == 200);
+    REQUIRE(table.getRowById(199).size() == 3);
+    REQUIRE(table.getRowById(199).at(1).find("writer number") == 0);
+    
+    table.drop();
+}
+
+TEST_CASE("The write-ahead log should group the syncs and report the failed ones") {
+    WriteAheadLog log("grouped_w.dat");
+    log.truncate(0);
+    unsigned long long first = log.append("first");
+    log.append("second");
+    unsigned long long third = log.append("third");
+    REQUIRE(log.sync(third));
+    REQUIRE(log.sync(first));
+    REQUIRE(log.getNumberOfSyncs() == 1);
+    log.drop();
+    
+    if (access("/dev/full", W_OK) != 0) {
+        return;
+    }
+    
+    // Every write fails on a full disk, so the records are never durable
+    WriteAheadLog full_log("/dev/full");
+    REQUIRE(full_log.isOpen());
+    unsigned long long sequence = full_log.append("lost");
+    REQUIRE_FALSE(full_log.sync(sequence));
+    REQUIRE_FALSE(full_log.sync(full_log.append("after the lost one")));
+    
+    // The inserts report that their rows are not durable
+    REQUIRE(symlink("/dev/full", "walfull_w.dat") == 0);
+    Schema schema;
+    schema.addCol("age", INT32);
+    Table table("walfull");
+    table.setSchema(schema);
+    REQUIRE(table.enableWriteAheadLog());
+    REQUIRE(table.insert(vector<string>(1, "1")) == -1);
+    vector<vector<string> > rows(3, vector<string>(1, "2"));
+    REQUIRE(table.insertBatch(rows) == -1);
+    table.drop();
+}
+
+TEST_CASE("A table should import a CSV file using many threads") {
+    ofstream csv("parallel.csv");
+    csv << "name,city,age" << endl;
+    for (int i = 0; i < 1000; i++) {
+        csv << "person with a long name " << i << ",city" << i % 7 << "," << i << endl;
+    }
+    csv.close();
+    
+    Schema schema;
+    schema.addCol("name", VARCHAR, 255);
+    schema.addCol("city", CHAR, 20, true);
+    schema.addCol("age", INT32);
+    
+    Table table("parallel");
+    table.setSchema(schema);
+    
+    // Small chunks, so the lines are cut between the chunks
+    table.convertFromCSV("parallel.csv", 3, 100);
+    
+    REQUIRE(table.getNumberOfRows() == 1000);
+    for (int i = 0; i < 1000; i += 37) {
+        vector<string> row = table.getRowById(i);
+        REQUIRE(row.at(1) == "person with a long name " + to_string(i));
+        REQUIRE(row.at(2) == "city" + to_string(i % 7));
+        REQUIRE(row.at(3) == to_string(i));
+    }
+    REQUIRE(table.getDictionary(2)->getSize() == 7);
+    
+    // A table reopened on the files computes the registry size before the workers start
+    Table reopened("parallel");
+    reopened.setSchema(schema);
+    reopened.convertFromCSV("parallel.csv", 4, 100);
+    REQUIRE(reopened.getNumberOfRows() == 2000);
+    for (int i = 0; i < 1000; i += 37) {
+        vector<string> row = reopened.getRowById(1000 + i);
+        REQUIRE(row.at(1) == "person with a long name " + to_string(i));
+        REQUIRE(row.at(2) == "city" + to_string(i % 7));
+        REQUIRE(row.at(3) == to_string(i));
+    }
+    
+    reopened.drop();
+    remove("parallel.csv");
+}
+
+TEST_CASE("The CSV tokenizer should split quoted fields") {
+    string csv = "1,\"Smith, John\",\"He said \"\"hi\"\"\"\r\n2,\"two\nlines\",\n3,plain,last";
+    CSVTokenizer tokenizer(csv.data(), csv.size());
+    vector<FieldSpan> fields;
+    string value;
+    
+    REQUIRE(tokenizer.nextRecord(fields));
+    REQUIRE(fields.size() == 3);
+    fields.at(1).copyTo(&value);
+    REQUIRE(value == "Smith, John");
+    fields.at(2).copyTo(&value);
+    REQUIRE(value == "He said \"hi\"");
+    
+    REQUIRE(tokenizer.nextRecord(fields));
+    REQUIRE(fields.size() == 3);
+    fields.at(1).copyTo(&value);
+    REQUIRE(value == "two\nlines");
+    REQUIRE(fields.at(2).length == 0);
+    
+    REQUIRE(tokenizer.nextRecord(fields));
+    fields.at(2).copyTo(&value);
+    REQUIRE(value == "last");
+    REQUIRE_FALSE(tokenizer.nextRecord(fields));
+    
+    // The newline inside the quotes doesn't end a record
+    REQUIRE(CSVTokenizer::findLastRecordEnd(csv.data(), csv.find("lines")) == csv.find("2,"));
+    
+    // split() doesn't parse quotes and drops the last empty value
+    vector<string> words = split("a,\"b,c\",,d,", ',');
+    REQUIRE(words.size() == 5);
+    REQUIRE(words.at(1) == "\"b");
+    REQUIRE(words.at(3) == "");
+}
+
+TEST_CASE("A table should import quoted values and skip the empty lines") {
+    ofstream csv("quoted.csv");
+    csv << "name,age" << endl;
+    csv << "\"Smith, John\",30" << endl;
+    csv << endl;
+    csv << "\"two\nlines \"\"quoted\"\"\",40" << endl;
+    csv << endl;
+    csv.close();
+    
+    Schema schema;
+    schema.addCol("name", VARCHAR, 255);
+    schema.addCol("age", INT32);
+    
+    Table table("quoted");
+    table.setSchema(schema);
+    table.convertFromCSV("quoted.csv", 1);
+    
+    REQUIRE(table.getNumberOfRows() == 2);
+    REQUIRE(table.getRowById(0).at(1) == "Smith, John");
+    REQUIRE(table.getRowById(1).at(1) == "two\nlines \"quoted\"");
+    REQUIRE(table.getRowById(1).at(2) == "40");
+    
+    table.drop();
+    remove("quoted.csv");
+}
+
+TEST_CASE("The numeric codec should parse and format like the standard library") {
+    char buffer[NumericCodec::MAX_LENGTH];
+    double reals[] = {0, -0.5, 3.14159265, 1500000, 0.0001, 0.00001234, 123456.5, 999999.5, 1e100, -2.5e-7};
+    for (int i = 0; i < 10; i++) {
+        ostringstream stream;
+        stream << reals[i];
+        REQUIRE(string(buffer, NumericCodec::formatReal(reals[i], buffer)) == stream.str());
+    }
+    
+    // The values close to a tie are rounded on their exact decimal value
+    double ties[] = {1.324295, 0.1004385, 1.014595e-10, 2.5, 0.125, 1234565, 4.0000005, 7.6543215e20};
+    for (int i = 0; i < 8; i++) {
+        ostringstream stream;
+        stream << ties[i];
+        REQUIRE(string(buffer, NumericCodec::formatReal(ties[i], buffer)) == stream.str());
+    }
+    REQUIRE(string(buffer, NumericCodec::formatReal(1.324295, buffer)) == "1.32429");
+    REQUIRE(string(buffer, NumericCodec::formatReal(0.1004385, buffer)) == "0.100439");
+    
+    mt19937_64 generator(42);
+    uniform_int_distribution<long long> mantissas(1000000, 9999999);
+    uniform_int_distribution<int> exponents(-30, 30);
+    int mismatches = 0;
+    for (int i = 0; i < 100000; i++) {
+        // 7 significant digits ending in 5 are the ties of the 6 digits rounding
+        double value = (mantissas(generator) / 10 * 10 + 5) * pow(10.0, exponents(generator));
+        ostringstream stream;
+        stream << value;
+        if (string(buffer, NumericCodec::formatReal(value, buffer)) != stream.str()) {
+            mismatches++;
+        }
+    }
+    REQUIRE(mismatches == 0);
+    
+    REQUIRE(string(buffer, NumericCodec::formatInteger(numeric_limits<long long>::min(), buffer)) == "-9223372036854775808");
+    
+    string text = " -12.75e2";
+    double real;
+    REQUIRE(NumericCodec::parseReal(text.data(), text.data() + text.size(), &real));
+    REQUIRE(real == -1275);
+    
+    long long integer;
+    text = "42abc";
+    REQUIRE(NumericCodec::parseInteger(text.data(), text.data() + text.size(), &integer));
+    REQUIRE(integer == 42);
+    REQUIRE_FALSE(NumericCodec::parseInteger(text.data() + 2, text.data() + text.size(), &integer));
+    
+    // The values out of the range are clamped and rejected
+    text = "-9223372036854775808";
+    REQUIRE(NumericCodec::parseInteger(text.data(), text.data() + text.size(), &integer));
+    REQUIRE(integer == numeric_limits<long long>::min());
+    text = "9223372036854775808";
+    REQUIRE_FALSE(NumericCodec::parseInteger(text.data(), text.data() + text.size(), &integer));
+    REQUIRE(integer == numeric_limits<long long>::max());
+    text = "-99999999999999999999";
+    REQUIRE_FALSE(NumericCodec::parseInteger(text.data(), text.data() + text.size(), &integer));
+    REQUIRE(integer == numeric_limits<long long>::min());
+    
+    // The long values are not cut and the locale doesn't change the decimal separator
+    text = "0." + string(80, '0') + "1";
+    REQUIRE(NumericCodec::parseReal(text.data(), text.data() + text.size(), &real));
+    REQUIRE(real == 1e-81);
+    text = "1.2345678901234567";
+    REQUIRE(NumericCodec::parseReal(text.data(), text.data() + text.size(), &real));
+    REQUIRE(real == 1.2345678901234567);
+}
+
+TEST_CASE("A table should fetch many rows with coalesced reads") {
+    Schema schema;
+    schema.addCol("value", INT32);
+    
+    Table table("getrows");
+    table.setSchema(schema);
+    
+    vector<vector<string> > rows;
+    for (int i = 0; i < 100; i++) {
+        rows.push_back(vector<string>(1, to_string(i * 10)));
+    }
+    table.insertBatch(rows);
+    table.remove(50);
+    
+    // Unsorted, repeated and removed positions
+    long long ids[] = {99, 3, 4, 5, 50, 3, 0};
+    vector<long long> positions;
+    for (int i = 0; i < 7; i++) {
+        positions.push_back(table.getRegistryPosition(ids[i]));
+    }
+    
+    vector<vector<string> > fetched = table.getRows(positions);
+    REQUIRE(fetched.size() == 7);
+    REQUIRE(fetched.at(0).at(1) == "990");
+    REQUIRE(fetched.at(1).at(1) == "30");
+    REQUIRE(fetched.at(3).at(0) == "5");
+    REQUIRE(fetched.at(4).empty());
+    REQUIRE(fetched.at(5).at(1) == "30");
+    REQUIRE(fetched.at(6).at(1) == "0");
+    
+    // A position past the end of the file doesn't hide the rows read with it
+    vector<long long> last_positions;
+    last_positions.push_back(table.getRegistryPosition(99));
+    last_positions.push_back(2 * table.getRegistryPosition(99) - table.getRegistryPosition(98));
+    fetched = table.getRows(last_positions);
+    REQUIRE(fetched.at(0) == table.getRow(last_positions.at(0)));
+    REQUIRE(fetched.at(1).empty());
+    
+    BufferPool pool;
+    table.setBufferPool(&pool);
+    REQUIRE(table.getRows(positions).at(0).at(1) == "990");
+    REQUIRE(table.getRows(last_positions).at(0).at(1) == "990");
+    table.setBufferPool(NULL);
+    
+    table.drop();
+}
+
+TEST_CASE("A zone map should skip the blocks out of a range") {
+    Schema schema;
+    schema.addCol("value", INT32);
+    schema.addCol("ratio", DOUBLE);
+    
+    Table table("zonemap");
+    table.setSchema(schema);
+    
+    // Three blocks, each one with its own range of values
+    vector<vector<string> > rows;
+    for (int i = 0; i < 3 * ZoneMap::ROWS_PER_BLOCK; i++) {
+        vector<string> row;
+        row.push_back(to_string(i));
+        row.push_back(to_string(i / 2.0));
+        rows.push_back(row);
+    }
+    table.insertBatch(rows);
+    
+    ZoneMap * zone_map = table.getZoneMap();
+    REQUIRE(zone_map->getNumberOfBlocks() == 3);
+    REQUIRE(zone_map->getZone(1, 1)->min == ZoneMap::ROWS_PER_BLOCK);
+    REQUIRE(zone_map->getZone(1, 1)->max == 2 * ZoneMap::ROWS_PER_BLOCK - 1);
+    REQUIRE(zone_map->getZone(0, 3) == NULL);
+    REQUIRE_FALSE(zone_map->mayMatch(0, 1, 5000, 6000));
+    REQUIRE(zone_map->mayMatch(1, 1, 5000, 6000));
+    
+    vector<long long> * positions = table.filterRange("value", 5000, 5002);
+    REQUIRE(positions->size() == 3);
+    REQUIRE(table.getRow(positions->at(0)).at(1) == "5000");
+    delete positions;
+    
+    positions = table.filterRange("ratio", 10, 11);
+    REQUIRE(positions->size() == 3);
+    delete positions;
+    
+    // The updated value widens the zone of its block
+    vector<string> row;
+    row.push_back("-7");
+    row.push_back("0");
+    table.update(100, row);
+    REQUIRE(zone_map->getZone(0, 1)->min == -7);
+    positions = table.filterRange(1, -10, -1);
+    REQUIRE(positions->size() == 1);
+    delete positions;
+    
+    // The zones are persisted next to the table
+    Table reopened("zonemap");
+    reopened.setSchema(schema);
+    REQUIRE(reopened.getZoneMap()->getNumberOfRows() == 3 * ZoneMap::ROWS_PER_BLOCK);
+    REQUIRE(reopened.getZoneMap()->getZone(2, 2)->max == (3 * ZoneMap::ROWS_PER_BLOCK - 1) / 2.0);
+    
+    // The compaction builds the zones again
+    table.remove(0);
+    table.compact();
+    REQUIRE(zone_map->getNumberOfRows() == 3 * ZoneMap::ROWS_PER_BLOCK - 1);
+    REQUIRE(zone_map->getZone(0, 0)->min == 1);
+    
+    table.drop();
+}
+
+TEST_CASE("A Bloom filter should reject the absent values of a column") {
+    Schema schema;
+    schema.addCol("person_id", INT64);
+    schema.addCol("city", CHAR, 20);
+    
+    Table table("bloomfilter");
+    table.setSchema(schema);
+    
+    vector<vector<string> > rows;
+    for (int i = 0; i < 10000; i++) {
+        vector<string> row;
+        row.push_back(to_string(i * 2));
+        row.push_back("city" + to_string(i % 100));
+        rows.push_back(row);
+    }
+    table.insertBatch(rows);
+    
+    REQUIRE(table.createBloomFilter("person_id"));
+    REQUIRE(table.createBloomFilter("city"));
+    REQUIRE_FALSE(table.createBloomFilter("missing"));
+    ColumnBloomFilter * bloom_filter = table.getBloomFilter(1);
+    REQUIRE(bloom_filter->getNumberOfRows() == 10000);
+    
+    // The rows inserted after the creation are added to the filter
+    vector<string> row;
+    row.push_back("777777");
+    row.push_back("lisbon");
+    table.insert(row);
+    
+    vector<long long> * positions = table.findEqual("person_id", "777777");
+    REQUIRE(positions->size() == 1);
+    delete positions;
+    positions = table.findEqual("city", "lisbon");
+    REQUIRE(positions->size() == 1);
+    delete positions;
+    
+    // The odd ids are absent, the filter rejects most of them
+    for (int i = 0; i < 1000; i++) {
+        positions = table.findEqual("person_id", to_string(i * 2 + 1));
+        REQUIRE(positions->empty());
+        delete positions;
+    }
+    REQUIRE(bloom_filter->getNumberOfProbes() == 1001);
+    REQUIRE(bloom_filter->getNumberOfNegatives() + bloom_filter->getNumberOfFalsePositives() == 1000);
+    REQUIRE(bloom_filter->getFalsePositiveRate() < 0.05);
+    REQUIRE(bloom_filter->getEstimatedFalsePositiveRate() < 0.05);
+    
+    // The hash join probes the build column filter first
+    Schema other_schema;
+    other_schema.addCol("person_id", INT64);
+    Table other("bloomfilter_other");
+    other.setSchema(other_schema);
+    vector<vector<string> > other_rows;
+    for (int i = 0; i < 2000; i++) {
+        other_rows.push_back(vector<string>(1, to_string(i)));
+    }
+    other.insertBatch(other_rows);
+    
+    Join join = table.join("person_id", &other, "person_id", HASH);
+    REQUIRE(join.getNumberOfRows() == 1000);
+    REQUIRE(bloom_filter->getNumberOfProbes() == 3001);
+    
+    // The filters are persisted next to the table
+    {
+        Table reopened("bloomfilter");
+        reopened.setSchema(schema);
+        REQUIRE(reopened.getBloomFilter(0) == NULL);
+        REQUIRE(reopened.getBloomFilter(1)->getNumberOfRows() == 10001);
+        REQUIRE(reopened.getBloomFilter(2)->getNumberOfRows() == 10001);
+    }
+    
+    other.drop();
+    table.drop();
+}
+
+TEST_CASE("A secondary index should find the rows by value and join on them") {
+    Schema schema;
+    schema.addCol("age", INT32);
+    schema.addCol("city", VARCHAR, 40);
+    schema.addCol("score", DOUBLE);
+    
+    Table table("secondaryindex");
+    table.setSchema(schema);
+    
+    vector<vector<string> > rows;
+    for (int i = 0; i < 5000; i++) {
+        vector<string> row;
+        row.push_back(to_string(i % 50 - 25));
+        row.push_back("a city with a very long name number " + to_string(i % 7));
+        row.push_back(to_string(i % 10 * 0.5 - 2));
+        rows.push_back(row);
+    }
+    table.insertBatch(rows);
+    
+    REQUIRE(table.createIndex("age"));
+    REQUIRE(table.createIndex("city"));
+    REQUIRE(table.createIndex("score"));
+    REQUIRE_FALSE(table.createIndex("missing"));
+    REQUIRE(table.getIndex(0) == NULL);
+    
+    vector<long long> * positions = table.findEqual("age", "-25");
+    REQUIRE(positions->size() == 100);
+    delete positions;
+    // The strings share the first 24 characters, the rows are checked
+    positions = table.findEqual("city", "a city with a very long name number 3");
+    REQUIRE(positions->size() == 714);
+    delete positions;
+    positions = table.findEqual("score", "-0.5");
+    REQUIRE(positions->size() == 500);
+    delete positions;
+    
+    // The inserts and the updates are indexed, the old values are not found
+    vector<string> row;
+    row.push_back("99");
+    row.push_back("lisbon");
+    row.push_back("1");
+    long long _id = table.insert(row);
+    positions = table.findEqual("age", "99");
+    REQUIRE(positions->size() == 1);
+    delete positions;
+    
+    row[0] = "100";
+    REQUIRE(table.update(_id, row));
+    positions = table.findEqual("age", "99");
+    REQUIRE(positions->empty());
+    delete positions;
+    positions = table.findEqual("age", "100");
+    REQUIRE(positions->size() == 1);
+    delete positions;
+    
+    REQUIRE(table.remove(_id));
+    positions = table.findEqual("city", "lisbon");
+    REQUIRE(positions->empty());
+    delete positions;
+    
+    // The compaction moves the rows, the index follows them
+    REQUIRE(table.remove(1));
+    table.compact();
+    positions = table.findEqual("age", "-24");
+    REQUIRE(positions->size() == 99);
+    delete positions;
+    
+    // The index is persisted next to the table
+    {
+        Table reopened("secondaryindex");
+        reopened.setSchema(schema);
+        REQUIRE(reopened.getIndex(1) != NULL);
+        positions = reopened.findEqual("age", "24");
+        REQUIRE(positions->size() == 100);
+        delete positions;
+        
+        // The writes of the table that owns the index are flushed to the file
+        vector<string> row;
+        row.push_back("1000");
+        row.push_back("a new city");
+        row.push_back("1");
+        table.insert(row);
+        positions = reopened.getIndex(1)->find(1000LL);
+        REQUIRE(positions->size() == 1);
+        delete positions;
+    }
+    
+    // The nested join looks up the indexed column instead of scanning it
+    Schema other_schema;
+    other_schema.addCol("age", INT64);
+    Table other("secondaryindex_other");
+    other.setSchema(other_schema);
+    vector<vector<string> > other_rows;
+    for (int i = 0; i < 10; i++) {
+        other_rows.push_back(vector<string>(1, to_string(i)));
+    }
+    other.insertBatch(other_rows);
+    
+    Join join = other.join("age", &table, "age", NESTED);
+    REQUIRE(join.getNumberOfRows() == 1000);
+    Join reversed_join = table.join("age", &other, "age", NESTED);
+    REQUIRE(reversed_join.getNumberOfRows() == 1000);
+    Join loop_join = other.join("age", &table, "age", NESTED_LOOP);
+    REQUIRE(loop_join.getNumberOfRows() == 1000);
+    
+    other.drop();
+    table.drop();
+}
+
+TEST_CASE("A hash index should find the keys after growing and reopening") {
+    ::remove("hashindex_test.dat");
+    {
+        HashIndex hash_index("hashindex_test.dat");
+        bool inserted = true;
+        for (long long key = 0; key < 100000; key++) {
+            inserted = hash_index.insert(key * 3, key) && inserted;
+        }
+        REQUIRE(inserted);
+        REQUIRE(hash_index.getNumberOfKeys() == 100000);
+        REQUIRE(hash_index.getGlobalDepth() > 0);
+        REQUIRE(hash_index.getNumberOfBuckets() > 100000 / 255);
+        
+        // The keys are replaced, not repeated
+        REQUIRE(hash_index.insert(3, 42));
+        REQUIRE(hash_index.getNumberOfKeys() == 100000);
+        REQUIRE(hash_index.remove(6));
+        REQUIRE_FALSE(hash_index.remove(6));
+    }
+    
+    // The file is mapped again, the keys are not inserted again
+    HashIndex hash_index("hashindex_test.dat");
+    REQUIRE(hash_index.getNumberOfKeys() == 99999);
+    long long value = -1;
+    REQUIRE(hash_index.find(3, &value));
+    REQUIRE(value == 42);
+    REQUIRE_FALSE(hash_index.find(6, &value));
+    REQUIRE_FALSE(hash_index.find(4, &value));
+    long long found_keys = 0;
+    for (long long key = 3; key < 100000; key++) {
+        if (hash_index.find(key * 3, &value) && value == key) {
+            found_keys ++;
+        }
+    }
+    REQUIRE(found_keys == 100000 - 3);
+    
+    hash_index.clear();
+    REQUIRE(hash_index.getNumberOfKeys() == 0);
+    REQUIRE_FALSE(hash_index.find(9, &value));
+    hash_index.drop();
+}
+
+TEST_CASE("A primary index should store the header on the smallest arrays") {
+    PrimaryIndex index;
+    for (long long _id = 0; _id < 100000; _id++) {
+        index.push_back(make_pair(_id, 279 + _id * 40));
+    }
+    
+    // A sequence of _ids on contiguous registries takes no memory
+    REQUIRE(index.getMemorySize() == 0);
+    REQUIRE(index.find(4242) == 4242);
+    REQUIRE(index.at(4242).second == 279 + 4242 * 40);
+    REQUIRE(index.find(100000) == -1);
+    
+    // The removed _ids leave gaps, the _ids are stored as 32 bits offsets
+    PrimaryIndex sparse_index;
+    sparse_index.reserve(100000);
+    vector<pair<long long, long long> > expected;
+    for (long long _id = 0; _id < 100000; _id++) {
+        if (_id % 7 != 3) {
+            expected.push_back(make_pair(_id, 279 + expected.size() * 40));
+            sparse_index.push_back(expected.back());
+        }
+    }
+    REQUIRE(sparse_index.size() == expected.size());
+    REQUIRE(sparse_index.getMemorySize() < expected.size() * 6);
+    
+    long long found = 0;
+    for (long long _id = 0; _id < 100000; _id++) {
+        long long idx = sparse_index.find(_id);
+        if (_id % 7 == 3) {
+            found += idx == -1;
+        } else {
+            found += idx >= 0 && sparse_index.at(idx) == expected[idx] && expected[idx].first == _id;
+        }
+    }
+    REQUIRE(found == 100000);
+    REQUIRE(sparse_index.lowerBound(10) == 9);
+    REQUIRE(distance(sparse_index.begin(), lower_bound(sparse_index.begin(), sparse_index.end(),
+        make_pair(10LL, numeric_limits<long long>::min()))) == 9);
+    
+    // The _ids that don't fit on 32 bits are stored whole
+    sparse_index.push_back(make_pair(1LL << 40, 1LL << 40));
+    REQUIRE(sparse_index.find(1LL << 40) == expected.size());
+    REQUIRE(sparse_index.getPosition(expected.size()) == 1LL << 40);
+    REQUIRE(sparse_index.find(99999) == expected.size() - 1);
+    
+    sparse_index.resize(10);
+    REQUIRE(sparse_index.size() == 10);
+    REQUIRE(sparse_index.back().first == 11);
+    REQUIRE(sparse_index.find(99999) == -1);
+}
+
+TEST_CASE("A query should evaluate the conditions on the binary values") {
+    Schema schema;
+    schema.addCol("age", INT32);
+    schema.addCol("name", CHAR, 20);
+    schema.addCol("city", CHAR, 255, true);
+    schema.addCol("score", DOUBLE);
+    schema.addCol("note", VARCHAR, 60);
+    
+    Table table("query");
+    table.setSchema(schema);
+    
+    const char * cities[] = { "Curitiba", "Recife", "Natal" };
+    vector<vector<string> > rows;
+    for (int i = 0; i < 10000; i++) {
+        vector<string> row;
+        row.push_back(to_string(i));
+        row.push_back("name " + to_string(i % 100));
+        row.push_back(cities[i % 3]);
+        row.push_back(to_string(i % 20 * 0.5 - 5));
+        row.push_back(i % 2 == 0 ? "short" : "a note long enough to be stored on the heap " + to_string(i % 5));
+        rows.push_back(row);
+    }
+    table.insertBatch(rows);
+    
+    vector<string> select, where_args, where_comparators, where_values;
+    Cursor cursor = table.query(select, where_args, where_comparators, where_values);
+    REQUIRE(cursor.getCount() == 10000);
+    REQUIRE(cursor.getColumnNames().size() == 6);
+    
+    // The projection keeps only the selected columns, in the SELECT order
+    select.push_back("score");
+    select.push_back("_id");
+    where_args.push_back("age");
+    where_comparators.push_back(">=");
+    where_values.push_back("9000");
+    where_args.push_back("age");
+    where_comparators.push_back("<");
+    where_values.push_back("9010");
+    cursor = table.query(select, where_args, where_comparators, where_values);
+    REQUIRE(cursor.getCount() == 10);
+    REQUIRE(cursor.moveToFirst());
+    REQUIRE(cursor.getRow().size() == 2);
+    REQUIRE(cursor.getString("_id") == "9000");
+    REQUIRE(cursor.getString(0) == "-5");
+    REQUIRE(cursor.getString("age") == "");
+    int count = 1;
+    while (cursor.moveToNext()) {
+        count++;
+    }
+    REQUIRE(count == 10);
+    REQUIRE(cursor.isAfterLast());
+    
+    // A real value on an integer column is compared as a real
+    where_values[1] = "9009.5";
+    REQUIRE(table.query(select, where_args, where_comparators, where_values).getCount() == 10);
+    
+    // The _id is found by the header
+    where_args.assign(1, "_id");
+    where_comparators.assign(1, "=");
+    where_values.assign(1, "1234");
+    cursor = table.query(select, where_args, where_comparators, where_values);
+    REQUIRE(cursor.getCount() == 1);
+    REQUIRE(cursor.moveToFirst());
+    REQUIRE(cursor.getString("_id") == "1234");
+    
+    select.clear();
+    select.push_back("*");
+    where_args.assign(1, "score");
+    where_comparators.assign(1, "<=");
+    where_values.assign(1, "-4.5");
+    REQUIRE(table.query(select, where_args, where_comparators, where_values).getCount() == 1000);
+    where_comparators[0] = "!=";
+    REQUIRE(table.query(select, where_args, where_comparators, where_values).getCount() == 9500);
+    
+    where_args.assign(1, "name");
+    where_comparators.assign(1, "=");
+    where_values.assign(1, "name 42");
+    REQUIRE(table.query(select, where_args, where_comparators, where_values).getCount() == 100);
+    where_comparators[0] = "<";
+    where_values[0] = "name 2";
+    REQUIRE(table.query(select, where_args, where_comparators, where_values).getCount() == 1200);
+    
+    // The dictionary values are compared once, then only the codes
+    where_args.assign(1, "city");
+    where_comparators.assign(1, "=");
+    where_values.assign(1, "Recife");
+    REQUIRE(table.query(select, where_args, where_comparators, where_values).getCount() == 3333);
+    where_comparators[0] = ">";
+    where_values[0] = "Natal";
+    REQUIRE(table.query(select, where_args, where_comparators, where_values).getCount() == 3333);
+    where_values[0] = "Lisbon";
+    where_comparators[0] = "=";
+    REQUIRE(table.query(select, where_args, where_comparators, where_values).getCount() == 0);
+    
+    where_args.assign(1, "note");
+    where_values.assign(1, "a note long enough to be stored on the heap 3");
+    REQUIRE(table.query(select, where_args, where_comparators, where_values).getCount() == 1000);
+    
+    // The index gives the candidates, the other conditions are checked
+    REQUIRE(table.createIndex("name"));
+    where_args.assign(1, "name");
+    where_values.assign(1, "name 42");
+    where_args.push_back("city");
+    where_comparators.push_back("=");
+    where_values.push_back("Natal");
+    REQUIRE(table.query(select, where_args, where_comparators, where_values).getCount() == 33);
+    
+    // The invalid queries are empty
+    where_args[0] = "missing";
+    REQUIRE(table.query(select, where_args, where_comparators, where_values).getCount() == 0);
+    where_args[0] = "name";
+    where_comparators[0] = "~";
+    REQUIRE(table.query(select, where_args, where_comparators, where_values).getCount() == 0);
+    where_comparators.pop_back();
+    REQUIRE(table.query(select, where_args, where_comparators, where_values).getCount() == 0);
+    
+    table.drop();
+}
+
+TEST_CASE("A cursor should read the rows as it moves") {
+    Schema schema;
+    schema.addCol("age", INT32);
+    schema.addCol("score", DOUBLE);
+    schema.addCol("note", VARCHAR, 60);
+    
+    Table table("cursor");
+    table.setSchema(schema);
+    
+    vector<vector<string> > rows;
+    for (int i = 0; i < 10000; i++) {
+        vector<string> row;
+        row.push_back(to_string(i % 100));
+        row.push_back(to_string(i * 0.5));
+        row.push_back("a note long enough to be stored on the heap " + to_string(i));
+        rows.push_back(row);
+    }
+    table.insertBatch(rows);
+    
+    vector<string> select, where_args, where_comparators, where_values;
+    select.push_back("note");
+    select.push_back("age");
+    select.push_back("score");
+    where_args.push_back("age");
+    where_comparators.push_back("=");
+    where_values.push_back("7");
+    
+    Cursor cursor = table.query(select, where_args, where_comparators, where_values);
+    REQUIRE_FALSE(cursor.isAfterLast());
+    REQUIRE(cursor.getString(0) == "");
+    
+    // The typed getters don't convert the values
+    REQUIRE(cursor.moveToNext());
+    REQUIRE(cursor.getInteger("age") == 7);
+    REQUIRE(cursor.getReal(2) == 3.5);
+    REQUIRE(cursor.getString("note") == "a note long enough to be stored on the heap 7");
+    REQUIRE(cursor.moveToNext());
+    REQUIRE(cursor.getRow().at(0) == "a note long enough to be stored on the heap 107");
+    
+    // The other reads on the table don't change the current row
+    REQUIRE(table.getRowById(5000).at(1) == "0");
+    REQUIRE(cursor.getInteger(1) == 7);
+    REQUIRE(cursor.getString("score") == "53.5");
+    
+    // The rows inserted after the query started are not read
+    vector<string> row;
+    row.push_back("7");
+    row.push_back("1");
+    row.push_back("new");
+    table.insert(row);
+    int count = 2;
+    while (cursor.moveToNext()) {
+        count++;
+    }
+    REQUIRE(count == 100);
+    REQUIRE(cursor.isAfterLast());
+    REQUIRE(cursor.getString(0) == "");
+    
+    // Moving to the first row runs the query again
+    REQUIRE(cursor.moveToFirst());
+    REQUIRE(cursor.getReal("score") == 3.5);
+    REQUIRE(cursor.getCount() == 101);
+    
+    // The closed cursor reads no more rows
+    REQUIRE(cursor.moveToNext());
+    cursor.close();
+    REQUIRE(cursor.isAfterLast());
+    REQUIRE_FALSE(cursor.moveToNext());
+    REQUIRE_FALSE(cursor.moveToFirst());
+    
+    Cursor empty;
+    REQUIRE_FALSE(empty.moveToNext());
+    REQUIRE(empty.getCount() == 0);
+    
+    table.drop();
+}
+
+TEST_CASE("A query should be parsed with AND, OR, IN, BETWEEN and LIMIT") {
+    vector<QueryToken> tokens;
+    string error;
+    REQUIRE(QueryParser::tokenize("select Name where x>=-1.5e-3 and y = 'it''s'", &tokens, &error));
+    REQUIRE(tokens.size() == 12);
+    REQUIRE(tokens[1].text == "Name");
+    REQUIRE(tokens[4].text == ">=");
+    REQUIRE(tokens[5].text == "-");
+    REQUIRE(tokens[6].type == NUMBER_TOKEN);
+    REQUIRE(tokens[6].text == "1.5e-3");
+    REQUIRE(tokens[10].type == STRING_TOKEN);
+    REQUIRE(tokens[10].text == "it's");
+    REQUIRE(tokens[11].type == END_TOKEN);
+    REQUIRE_FALSE(QueryParser::tokenize("SELECT * WHERE name = 'bruno", &tokens, &error));
+    REQUIRE_FALSE(QueryParser::tokenize("SELECT * WHERE a ; b", &tokens, &error));
+    
+    QueryStatement statement;
+    REQUIRE(QueryParser::parse("SELECT a, b WHERE a > 1 AND (b = 'X y' OR c IN (1, -2)) OR d BETWEEN 3 AND 4 LIMIT 7",
+        &statement, &error));
+    REQUIRE(statement.select.size() == 2);
+    REQUIRE(statement.limit == 7);
+    REQUIRE(statement.has_where);
+    REQUIRE(statement.where.type == OR_CONDITION);
+    REQUIRE(statement.where.children.size() == 2);
+    QueryCondition & conjunction = statement.where.children[0];
+    REQUIRE(conjunction.type == AND_CONDITION);
+    REQUIRE(conjunction.children[0].comparator == GREATER);
+    REQUIRE(conjunction.children[1].children[0].values[0] == "X y");
+    REQUIRE(conjunction.children[1].children[1].type == IN_CONDITION);
+    REQUIRE(conjunction.children[1].children[1].values[1] == "-2");
+    REQUIRE(statement.where.children[1].type == BETWEEN_CONDITION);
+    REQUIRE(statement.where.children[1].values[1] == "4");
+    
+    // The old syntax, with the conditions separated by commas
+    REQUIRE(QueryParser::parse("SELECT _id, name, points WHERE _id=123, name = 'bruno alves', points > - 50, points < 100",
+        &statement, &error));
+    REQUIRE(statement.where.children.size() == 4);
+    REQUIRE(statement.where.children[2].values[0] == "-50");
+    REQUIRE(statement.limit == -1);
+    
+    REQUIRE(QueryParser::parse("select *", &statement, &error));
+    REQUIRE(statement.select.empty());
+    REQUIRE_FALSE(statement.has_where);
+    REQUIRE_FALSE(QueryParser::parse("SELECT * WHERE", &statement, &error));
+    REQUIRE_FALSE(QueryParser::parse("SELECT * WHERE (a = 1", &statement, &error));
+    REQUIRE_FALSE(QueryParser::parse("SELECT * WHERE a BETWEEN 1 OR 2", &statement, &error));
+    REQUIRE_FALSE(QueryParser::parse("SELECT * LIMIT 1.5", &statement, &error));
+    REQUIRE_FALSE(QueryParser::parse("SELECT * WHERE a = 1 b", &statement, &error));
+    REQUIRE(error == "Unexpected 'b' at 21");
+    
+    Schema schema;
+    schema.addCol("age", INT32);
+    schema.addCol("city", CHAR, 255, true);
+    schema.addCol("score", DOUBLE);
+    
+    Table table("queryparser");
+    table.setSchema(schema);
+    
+    const char * cities[] = { "Curitiba", "Recife", "Natal", "natal" };
+    vector<vector<string> > rows;
+    for (int i = 0; i < 10000; i++) {
+        vector<string> row;
+        row.push_back(to_string(i % 100));
+        row.push_back(cities[i % 4]);
+        row.push_back(to_string(i));
+        rows.push_back(row);
+    }
+    table.insertBatch(rows);
+    
+    // The strings keep their case
+    REQUIRE(table.query("select city where city = 'Natal'").getCount() == 2500);
+    REQUIRE(table.query("SELECT * WHERE city IN ('Natal', 'natal', 'Lisbon')").getCount() == 5000);
+    REQUIRE(table.query("SELECT * WHERE age BETWEEN 10 AND 19 AND city = 'Recife'").getCount() == 200);
+    REQUIRE(table.query("SELECT * WHERE age < 5 OR (age >= 95 AND score > 5000)").getCount() == 750);
+    REQUIRE(table.query("SELECT * WHERE age = 1 OR age = 2 LIMIT 150").getCount() == 150);
+    REQUIRE(table.query("SELECT * LIMIT 0").getCount() == 0);
+    
+    // The _id ranges and lists only read their rows
+    Cursor cursor = table.query("SELECT _id, score WHERE _id BETWEEN 4090 AND 4100 AND _id != 4095");
+    REQUIRE(cursor.getCount() == 10);
+    REQUIRE(cursor.moveToFirst());
+    REQUIRE(cursor.getInteger(0) == 4090);
+    REQUIRE(table.query("SELECT * WHERE _id > 9995").getCount() == 4);
+    REQUIRE(table.query("SELECT * WHERE _id < 0").getCount() == 0);
+    REQUIRE(table.query("SELECT * WHERE _id >= 9999 AND _id <= 2").getCount() == 0);
+    REQUIRE(table.query("SELECT * WHERE _id <= 2.5").getCount() == 3);
+    cursor = table.query("SELECT _id WHERE _id IN (7, 3, 7, 123456) AND age > 4");
+    REQUIRE(cursor.getCount() == 1);
+    REQUIRE(cursor.moveToNext());
+    REQUIRE(cursor.getInteger("_id") == 7);
+    
+    // The indexed columns are found by the index
+    REQUIRE(table.createIndex("age"));
+    REQUIRE(table.query("SELECT * WHERE age IN (3, 4) AND city = 'natal'").getCount() == 100);
+    
+    // The invalid queries are empty
+    REQUIRE(table.query("SELECT missing").getCount() == 0);
+    REQUIRE(table.query("SELECT * WHERE missing = 1").getCount() == 0);
+    REQUIRE(table.query("SELECT * WHERE age = ").getCount() == 0);
+    
+    table.drop();
+}
+
+TEST_CASE("A prepared statement should reuse the cached plan") {
+    string text;
+    string error;
+    vector<string> literals;
+    REQUIRE(QueryParser::normalize("select  name where age>-10 and city='it''s' limit 3", &text, &literals, &error));
+    REQUIRE(text == "SELECT name WHERE age > ? AND city = ? LIMIT 3");
+    REQUIRE(literals.size() == 2);
+    REQUIRE(literals[0] == "-10");
+    REQUIRE(literals[1] == "it's");
+    REQUIRE(QueryParser::normalize("select name where city='it''s'", &text, NULL, &error));
+    REQUIRE(text == "SELECT name WHERE city = 'it''s'");
+    
+    QueryStatement statement;
+    REQUIRE(QueryParser::parse("SELECT * WHERE a = ? AND b IN (1, ?) OR c BETWEEN ? AND 5", &statement, &error));
+    REQUIRE(statement.number_of_parameters == 3);
+    REQUIRE(statement.where.children[0].children[1].parameters[1] == 1);
+    REQUIRE(statement.where.children[1].parameters[0] == 2);
+    REQUIRE(statement.where.children[1].parameters[1] == -1);
+    
+    PlanCache cache(2);
+    cache.put("a", shared_ptr<QueryPlan>(new QueryPlan()));
+    cache.put("b", shared_ptr<QueryPlan>(new QueryPlan()));
+    REQUIRE(cache.get("a").get() != NULL);
+    cache.put("c", shared_ptr<QueryPlan>(new QueryPlan()));
+    REQUIRE(cache.size() == 2);
+    REQUIRE(cache.get("b").get() == NULL);
+    REQUIRE(cache.get("a").get() != NULL);
+    REQUIRE(cache.getHits() == 2);
+    REQUIRE(cache.getMisses() == 1);
+    
+    Schema schema;
+    schema.addCol("age", INT32);
+    schema.addCol("city", CHAR, 255, true);
+    schema.addCol("score", DOUBLE);
+    
+    Table table("preparedstatement");
+    table.setSchema(schema);
+    
+    const char * cities[] = { "Curitiba", "Recife", "Natal" };
+    vector<vector<string> > rows;
+    for (int i = 0; i < 3000; i++) {
+        vector<string> row;
+        row.push_back(to_string(i % 100));
+        row.push_back(cities[i % 3]);
+        row.push_back(to_string(i * 0.25));
+        rows.push_back(row);
+    }
+    table.insertBatch(rows);
+    
+    PreparedStatement by_id = table.prepare("SELECT score, age WHERE _id = ?");
+    REQUIRE(by_id.isValid());
+    REQUIRE(by_id.getNumberOfParameters() == 1);
+    REQUIRE(by_id.execute().getCount() == 0);
+    for (long long _id = 0; _id < 3000; _id += 7) {
+        REQUIRE(by_id.bindInteger(0, _id));
+        Cursor cursor = by_id.execute();
+        REQUIRE(cursor.moveToNext());
+        REQUIRE(cursor.getReal("score") == _id * 0.25);
+        REQUIRE(cursor.getInteger(1) == _id % 100);
+        REQUIRE_FALSE(cursor.moveToNext());
+    }
+    REQUIRE_FALSE(by_id.bind(1, "1"));
+    by_id.clearBindings();
+    REQUIRE(by_id.execute().getCount() == 0);
+    
+    PreparedStatement by_city = table.prepare("select * where city = ? and score between ? and ? limit 5");
+    REQUIRE(by_city.getNumberOfParameters() == 3);
+    by_city.bind(0, "Natal");
+    by_city.bindReal(1, 10);
+    by_city.bindReal(2, 100.5);
+    REQUIRE(by_city.execute().getCount() == 5);
+    by_city.bindReal(1, 100);
+    REQUIRE(by_city.execute().getCount() == 1);
+    
+    // The queries with other values reuse the plan of the prepared statement
+    PlanCache * plan_cache = table.getPlanCache();
+    size_t number_of_plans = plan_cache->size();
+    long long hits = plan_cache->getHits();
+    for (int age = 0; age < 10; age++) {
+        REQUIRE(table.query("SELECT score, age  where _id=" + to_string(age)).getCount() == 1);
+    }
+    REQUIRE(plan_cache->size() == number_of_plans);
+    REQUIRE(plan_cache->getHits() == hits + 10);
+    REQUIRE(table.query("SELECT * WHERE city = 'Recife' AND age < 10").getCount() == 100);
+    REQUIRE(table.query("SELECT * WHERE city = 'Curitiba' AND age < 20").getCount() == 200);
+    REQUIRE(plan_cache->size() == number_of_plans + 1);
+    
+    // The invalid queries are not cached
+    REQUIRE_FALSE(table.prepare("SELECT missing WHERE _id = ?").isValid());
+    REQUIRE_FALSE(table.prepare("SELECT * WHERE _id = ").isValid());
+    REQUIRE(plan_cache->size() == number_of_plans + 1);
+    
+    // The parameters of the queries that are not prepared have no values
+    REQUIRE(table.query("SELECT * WHERE _id = ?").getCount() == 0);
+    
+    // The prepared statements resolve their columns again when the schema changes
+    PreparedStatement by_age = table.prepare("SELECT score WHERE age = ?");
+    by_age.bindInteger(0, 7);
+    REQUIRE(by_age.execute().getCount() == 30);
+    
+    // The executions reuse the path chosen by the first one, the ranges are costed again
+    shared_ptr<QueryPlan> id_plan = plan_cache->get("SELECT score , age WHERE _id = ?");
+    REQUIRE(id_plan->reuse_path);
+    REQUIRE(id_plan->chosen_path->type == HEADER_LOOKUP);
+    long long chosen_version = id_plan->chosen_path->statistics_version;
+    REQUIRE_FALSE(plan_cache->get("SELECT * WHERE city = ? AND age < ?")->reuse_path);
+    
+    // The queries don't analyze the table, the writes do when its size doubles
+    table.insertBatch(rows);
+    REQUIRE(table.getStatistics()->number_of_rows == 3000);
+    table.insert(rows[0]);
+    REQUIRE(table.getStatistics()->number_of_rows == 6001);
+    REQUIRE(by_id.bindInteger(0, 6000));
+    REQUIRE(by_id.execute().getCount() == 1);
+    REQUIRE(id_plan->chosen_path->statistics_version > chosen_version);
+    REQUIRE(table.getStatistics()->number_of_rows == 6001);
+    
+    table.drop();
+    Schema narrow_schema;
+    narrow_schema.addCol("age", INT32);
+    table.setSchema(narrow_schema);
+    REQUIRE(by_age.execute().getCount() == 0);
+    
+    table.drop();
+    Schema reordered_schema;
+    reordered_schema.addCol("score", DOUBLE);
+    reordered_schema.addCol("age", INT32);
+    table.setSchema(reordered_schema);
+    vector<string> row;
+    row.push_back("1.5");
+    row.push_back("7");
+    table.insert(row);
+    Cursor cursor = by_age.execute();
+    REQUIRE(cursor.moveToNext());
+    REQUIRE(cursor.getReal(0) == 1.5);
+    REQUIRE_FALSE(cursor.moveToNext());
+    
+    table.drop();
+}
+
+TEST_CASE("The planner should choose the cheapest access path") {
+    Schema schema;
+    schema.addCol("code", INT64);
+    schema.addCol("parity", INT32);
+    schema.addCol("score", DOUBLE);
+    schema.addCol("city", CHAR, 255, true);
+    
+    Table table("queryplanner");
+    table.setSchema(schema);
+    
+    const char * cities[] = { "Curitiba", "Recife", "Natal", "Manaus" };
+    vector<vector<string> > rows;
+    for (int i = 0; i < 20000; i++) {
+        vector<string> row;
+        row.push_back(to_string(i));
+        row.push_back(to_string(i % 2));
+        row.push_back(to_string(i * 0.5));
+        row.push_back(cities[i % 4]);
+        rows.push_back(row);
+    }
+    table.insertBatch(rows);
+    REQUIRE(table.createIndex("code"));
+    REQUIRE(table.createIndex("parity"));
+    REQUIRE(table.createIndex("score"));
+    table.createHashIndex();
+    
+    table.analyze();
+    TableStatistics * statistics = table.getStatistics();
+    REQUIRE(statistics->analyzed);
+    REQUIRE(statistics->number_of_rows == 20000);
+    REQUIRE(statistics->sampled_rows == 4 * ZoneMap::ROWS_PER_BLOCK);
+    REQUIRE(statistics->distinct_values[0] == 20000);
+    REQUIRE(statistics->distinct_values[1] > 15000);
+    REQUIRE(statistics->distinct_values[2] == 2);
+    REQUIRE(statistics->distinct_values[4] == 4);
+    REQUIRE(statistics->scan_cost > 0);
+    REQUIRE(statistics->random_read_cost > 0);
+    
+    // The measured costs vary, the plans are checked with fixed ones
+    statistics->scan_cost = 1e-7;
+    statistics->random_read_cost = 1e-5;
+    statistics->header_search_cost = 1e-7;
+    statistics->index_search_cost = 2e-5;
+    statistics->hash_search_cost = 1e-6;
+    
+    REQUIRE(table.explain("SELECT * WHERE _id = 5").find("PLAN: HEADER LOOKUP _id (1 value)") == 0);
+    REQUIRE(table.explain("SELECT * WHERE code = 123").find("PLAN: INDEX LOOKUP code (1 value)") == 0);
+    REQUIRE(table.explain("SELECT * WHERE parity = 1").find("PLAN: FULL SCAN: 20000 rows") == 0);
+    REQUIRE(table.explain("SELECT * WHERE score BETWEEN 100 AND 110").find("PLAN: INDEX RANGE score [100, 110]") == 0);
+    REQUIRE(table.explain("SELECT * WHERE code >= 19990 AND parity = 0").find("PLAN: INDEX RANGE code [19990, inf]") == 0);
+    REQUIRE(table.explain("SELECT * WHERE _id >= 100 AND _id < 200").find("PLAN: HEADER RANGE _id [100, 199]") == 0);
+    REQUIRE(table.explain("SELECT * WHERE _id BETWEEN 4090 AND 4100 AND _id != 4095").find("PLAN: HEADER RANGE _id [4090, 4100]") == 0);
+    REQUIRE(table.explain("SELECT * WHERE _id != 4095 AND _id BETWEEN 4090 AND 4100").find("PLAN: HEADER RANGE _id [4090, 4100]") == 0);
+    REQUIRE(table.query("SELECT * WHERE _id BETWEEN 4090 AND 4100 AND _id != 4095").getCount() == 10);
+    REQUIRE(table.explain("SELECT * WHERE _id != 4095").find("PLAN: FULL SCAN: 20000 rows") == 0);
+    REQUIRE(table.explain("SELECT * WHERE city = 'Natal'").find("PLAN: FULL SCAN") == 0);
+    
+    string explanation = table.explain("SELECT * WHERE code = 123 AND parity = 1 LIMIT 1");
+    REQUIRE(explanation.find("PLAN: INDEX LOOKUP code") == 0);
+    REQUIRE(explanation.find("  LIMIT 1\n") != string::npos);
+    REQUIRE(explanation.find("  ALTERNATIVE: INDEX LOOKUP parity") != string::npos);
+    REQUIRE(explanation.find("  ALTERNATIVE: FULL SCAN") != string::npos);
+    REQUIRE(table.explain("SELECT * WHERE missing = 1").empty());
+    
+    // The hash index is chosen when its search is cheaper than the header one
+    statistics->hash_search_cost = 1e-8;
+    REQUIRE(table.explain("SELECT * WHERE _id IN (1, 2, 99999)").find("PLAN: HASH LOOKUP _id (3 values)") == 0);
+    REQUIRE(table.query("SELECT * WHERE _id IN (1, 2, 99999)").getCount() == 2);
+    
+    // The results don't depend on the path
+    REQUIRE(table.query("SELECT * WHERE _id = 5").getCount() == 1);
+    REQUIRE(table.query("SELECT * WHERE code = 123").getCount() == 1);
+    REQUIRE(table.query("SELECT * WHERE parity = 1").getCount() == 10000);
+    REQUIRE(table.query("SELECT * WHERE score BETWEEN 100 AND 110").getCount() == 21);
+    REQUIRE(table.query("SELECT * WHERE code >= 19990 AND parity = 0").getCount() == 5);
+    REQUIRE(table.query("SELECT * WHERE code > 19990.5").getCount() == 9);
+    REQUIRE(table.query("SELECT * WHERE code = 123 AND parity = 1 LIMIT 1").getCount() == 1);
+    REQUIRE(table.query("EXPLAIN SELECT * WHERE code = 123").getCount() == 0);
+    
+    Cursor cursor = table.query("SELECT code, score WHERE score >= 9999 LIMIT 5");
+    REQUIRE(cursor.moveToNext());
+    REQUIRE(cursor.getInteger(0) == 19998);
+    REQUIRE(cursor.moveToNext());
+    REQUIRE(cursor.getReal("score") == 9999.5);
+    REQUIRE_FALSE(cursor.moveToNext());
+    
+    // The updated rows are found by their new values and _ids
+    vector<string> row;
+    row.push_back("-7");
+    row.push_back("1");
+    row.push_back("-3.5");
+    row.push_back("Recife");
+    REQUIRE(table.update(123, row));
+    REQUIRE(table.query("SELECT * WHERE code = 123").getCount() == 0);
+    REQUIRE(table.query("SELECT * WHERE code = -7").getCount() == 1);
+    REQUIRE(table.query("SELECT * WHERE score < 0").getCount() == 1);
+    REQUIRE(table.query("SELECT * WHERE _id IN (123)").getCount() == 1);
+    
+    table.drop();
+    REQUIRE(table.getHashIndex() == NULL);
+}
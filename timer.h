@@ -1,9 +1,9 @@
 #ifndef TIMER_H
 #define TIMER_H
-#include <ctime>
+#include <chrono>
 
 class Timer {
-    std::clock_t start_time;
+    std::chrono::steady_clock::time_point start_time;
 
 public:
     /**
@@ -12,17 +12,18 @@ public:
     void start();
     
     /**
-     * @return the elapsed time, in seconds
+     * @return the elapsed wall time, in seconds. The CPU time is not used
+     *         because it adds the time of all the threads
      */
     double getElapsedTime();
 };
 
 void Timer::start() {
-    start_time = std::clock();
+    start_time = std::chrono::steady_clock::now();
 }
 
 double Timer::getElapsedTime() {
-    return ( std::clock() - start_time ) / (double) CLOCKS_PER_SEC;
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
 }
 
 #endif //TIMER_H
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "../numericcodec.h"
+#include "../schema.h"
+#include "../timer.h"
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <random>
+
+using namespace std;
+
+/**
+ * Compare the NumericCodec with the conversions used before it (atoi, atof and
+ * stoll to parse, ostringstream to format) for each numeric SchemaType
+ * e.g.: ./codecbenchmark 1000000
+ */
+
+// Keeps the compiler from removing the conversions
+volatile double sink;
+
+void printResult(const string & type_name, const string & operation, double old_time, double codec_time, long long number_of_values) {
+    cout << left << setw(8) << type_name << setw(8) << operation
+         << right << setw(12) << fixed << setprecision(1) << number_of_values / old_time / 1e6 << " M/s"
+         << setw(12) << number_of_values / codec_time / 1e6 << " M/s"
+         << setw(10) << setprecision(2) << old_time / codec_time << "x" << endl;
+}
+
+void benchmarkType(SchemaType type, const string & type_name, vector<string> & values) {
+    Timer timer;
+    double total = 0;
+    
+    // Parse
+    timer.start();
+    for (size_t i = 0; i < values.size(); i++) {
+        if (type == INT32) {
+            total += atoi(values[i].c_str());
+        } else if (type == INT64) {
+            total += stoll(values[i].c_str());
+        } else {
+            total += atof(values[i].c_str());
+        }
+    }
+    double old_parse_time = timer.getElapsedTime();
+    
+    timer.start();
+    for (size_t i = 0; i < values.size(); i++) {
+        const char * begin = values[i].data();
+        const char * end = begin + values[i].size();
+        if (type == INT32 || type == INT64) {
+            long long value;
+            NumericCodec::parseInteger(begin, end, &value);
+            total += value;
+        } else {
+            double value;
+            NumericCodec::parseReal(begin, end, &value);
+            total += type == FLOAT ? (float) value : value;
+        }
+    }
+    double codec_parse_time = timer.getElapsedTime();
+    
+    // Format, the values are parsed before the timing
+    vector<double> reals(values.size());
+    vector<long long> integers(values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        reals[i] = type == FLOAT ? (float) atof(values[i].c_str()) : atof(values[i].c_str());
+        integers[i] = stoll(values[i].c_str());
+    }
+    
+    size_t length = 0;
+    timer.start();
+    for (size_t i = 0; i < values.size(); i++) {
+        ostringstream stream;
+        if (type == INT32 || type == INT64) {
+            stream << integers[i];
+        } else {
+            stream << reals[i];
+        }
+        length += stream.str().size();
+    }
+    double old_format_time = timer.getElapsedTime();
+    
+    timer.start();
+    char buffer[NumericCodec::MAX_LENGTH];
+    for (size_t i = 0; i < values.size(); i++) {
+        if (type == INT32 || type == INT64) {
+            length += NumericCodec::formatInteger(integers[i], buffer);
+        } else {
+            length += NumericCodec::formatReal(reals[i], buffer);
+        }
+    }
+    double codec_format_time = timer.getElapsedTime();
+    
+    sink = total + length;
+    printResult(type_name, "parse", old_parse_time, codec_parse_time, values.size());
+    printResult(type_name, "format", old_format_time, codec_format_time, values.size());
+}
+
+int main(int argc, char * argv[]) {
+    long long number_of_values = argc > 1 ? atoll(argv[1]) : 1000000;
+    mt19937_64 generator(42);
+    
+    cout << left << setw(8) << "type" << setw(8) << "op" << right << setw(16) << "old" << setw(16) << "codec" << setw(11) << "speedup" << endl;
+    
+    vector<string> values(number_of_values);
+    for (long long i = 0; i < number_of_values; i++) {
+        values[i] = to_string((int) generator());
+    }
+    benchmarkType(INT32, "int32", values);
+    
+    for (long long i = 0; i < number_of_values; i++) {
+        values[i] = to_string((long long) generator() >> 4);
+    }
+    benchmarkType(INT64, "int64", values);
+    
+    uniform_real_distribution<double> distribution(-100000, 100000);
+    for (long long i = 0; i < number_of_values; i++) {
+        ostringstream stream;
+        stream << setprecision(i % 8 + 1) << distribution(generator);
+        values[i] = stream.str();
+    }
+    benchmarkType(FLOAT, "float", values);
+    benchmarkType(DOUBLE, "double", values);
+    
+    return 0;
+}
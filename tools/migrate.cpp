@@ -0,0 +1,25 @@
+#include "../table.h"
+
+using namespace std;
+
+/**
+ * Convert the data file of a table from the legacy layout, where every registry
+ * stores the table name, to the current layout
+ * e.g.: ./migrate person person_schema.txt
+ */
+int main(int argc, char * argv[]) {
+    if (argc != 3) {
+        cout << "Usage: " << argv[0] << " <table_name> <schema_file>" << endl;
+        return 1;
+    }
+    
+    Table table(argv[1]);
+    table.importSchema(argv[2]);
+    
+    if (table.migrate()) {
+        cout << "Migrated " << table.getNumberOfRows() << " rows" << endl;
+    } else {
+        cout << "Nothing to migrate" << endl;
+    }
+    return 0;
+}
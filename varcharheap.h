@@ -0,0 +1,123 @@
+#ifndef VARCHARHEAP_H
+#define VARCHARHEAP_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdio.h>
+#include "mappedfile.h"
+
+using namespace std;
+
+/**
+ * Stores the VARCHAR values that don't fit inside the registry. The values are
+ * appended to the heap file, followed by a '\0', and the registry keeps
+ * their offset on the file.
+ * e.g.: | Maria Aparecida da Silva\0 | Bartholomew\0 | ...
+ *       ^ offset 0                     ^ offset 25
+ * @see SchemaCol
+ */
+class VarcharHeap {
+private:
+    string path;
+    MappedFile mapped_file;
+    vector<char> pending; // appended values not written to the file yet
+    long long file_size;
+    
+    VarcharHeap(const VarcharHeap &);
+    VarcharHeap & operator=(const VarcharHeap &);
+    
+public:
+    /**
+     * @constructor
+     */
+    VarcharHeap(const string & path = "");
+    
+    void setPath(const string & path);
+    string getPath();
+    
+    /**
+     * Append a value to the heap. The value is buffered until the next flush
+     * @return the offset of the value on the heap
+     */
+    long long append(const char * value, unsigned length);
+    
+    /**
+     * Write the buffered values to the heap file
+     */
+    void flush();
+    
+    /**
+     * @return the null terminated value stored at the offset or NULL if there
+     *         is no such offset. The pointer is valid until the heap grows
+     */
+    const char * get(long long offset);
+    
+    /**
+     * Delete the heap file
+     */
+    void drop();
+};
+
+VarcharHeap::VarcharHeap(const string & path) {
+    setPath(path);
+}
+
+void VarcharHeap::setPath(const string & path) {
+    this->path = path;
+    this->mapped_file.setPath(path);
+    this->pending.clear();
+    
+    ifstream file;
+    file.open(path.c_str(), ios::binary | ios::ate);
+    file_size = file.is_open() ? (long long) file.tellg() : 0;
+}
+
+string VarcharHeap::getPath() {
+    return path;
+}
+
+long long VarcharHeap::append(const char * value, unsigned length) {
+    long long offset = file_size + pending.size();
+    pending.insert(pending.end(), value, value + length);
+    pending.push_back('\0');
+    return offset;
+}
+
+void VarcharHeap::flush() {
+    if (pending.empty()) {
+        return;
+    }
+    
+    ofstream file;
+    file.open(path.c_str(), ios::binary | ios::app);
+    file.write(&pending[0], pending.size());
+    file.close();
+    
+    file_size += pending.size();
+    pending.clear();
+}
+
+const char * VarcharHeap::get(long long offset) {
+    if (offset < 0) {
+        return NULL;
+    }
+    if (offset >= file_size) {
+        flush();
+    }
+    
+    // Grow the mapping if the value was appended after the last map
+    if (!mapped_file.map(offset + 1)) {
+        return NULL;
+    }
+    return mapped_file.getData() + offset;
+}
+
+void VarcharHeap::drop() {
+    mapped_file.unmap();
+    pending.clear();
+    remove(path.c_str());
+    file_size = 0;
+}
+
+#endif //VARCHARHEAP_H
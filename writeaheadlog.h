@@ -0,0 +1,309 @@
+#ifndef WRITEAHEADLOG_H
+#define WRITEAHEADLOG_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <condition_variable>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+/**
+ * Logs the records of a table before they are trusted on the data files. The
+ * log starts with the _id of the last checkpoint, followed by the records:
+ * e.g.: | CHECKPOINT_ID | SIZE | CHECKSUM | RECORD | SIZE | CHECKSUM | RECORD | ...
+ *
+ * The records are buffered by append() and written by sync(). Many writers
+ * share the same sync (group commit): the first writer that calls sync()
+ * writes every pending record with a single fdatasync, while the other
+ * writers wait for it and return without syncing if their records were on
+ * that group.
+ * e.g.:
+ * unsigned long long sequence = log.append(record);
+ * ... write the record on the data files ...
+ * log.sync(sequence); // the record is durable
+ *
+ * When a group can't be written, its records and the ones appended after it
+ * are not durable: sync() returns false for them until the next truncate.
+ *
+ * After a checkpoint, when the data files are synced, the log is truncated.
+ * A record that was not completely written (a crash during the sync) fails the
+ * checksum, so the records are read only up to it.
+ */
+class WriteAheadLog {
+private:
+    string path;
+    int fd;
+    
+    mutex log_mutex;
+    condition_variable synced;
+    vector<char> pending; // records appended but not written yet
+    unsigned long long next_sequence; // the number of appended records
+    unsigned long long durable_sequence; // the number of records on the disk
+    bool syncing; // a writer is writing a group
+    bool failed; // a group was not written, the log is not trusted until truncated
+    long long log_size;
+    long long number_of_syncs;
+    
+    WriteAheadLog(const WriteAheadLog &);
+    WriteAheadLog & operator=(const WriteAheadLog &);
+    
+    /**
+     * @return the FNV-1a hash of the bytes
+     */
+    static unsigned getChecksum(const char * data, size_t size);
+    
+    /**
+     * Write all the bytes at the end of the log file
+     */
+    bool writeAll(const char * data, size_t size);
+
+public:
+    /**
+     * Opens the log file, creating it if needed
+     * @constructor
+     */
+    WriteAheadLog(const string & path);
+    
+    /**
+     * Closes the log file. The records not synced are lost
+     * @destructor
+     */
+    ~WriteAheadLog();
+    
+    bool isOpen();
+    
+    /**
+     * Append a record to the log. The record is not durable until it's synced
+     * @return the sequence number of the record, used by sync()
+     */
+    unsigned long long append(const string & record);
+    
+    /**
+     * Wait until the record of the sequence is on the disk, writing and
+     * syncing the pending records if no other writer is doing it
+     * @return false if the record could not be written or synced
+     */
+    bool sync(unsigned long long sequence);
+    
+    /**
+     * Read the log file
+     * @param checkpoint_id the _id of the last checkpoint or -1 if the log is empty
+     * @param records the complete records written after the checkpoint
+     */
+    void read(long long * checkpoint_id, vector<string> & records);
+    
+    /**
+     * Discard all the records, starting a new log. Must be called after the
+     * records were synced on the data files
+     * @param checkpoint_id the _id of the next inserted row
+     */
+    void truncate(long long checkpoint_id);
+    
+    /**
+     * Close and delete the log file
+     */
+    void drop();
+    
+    /**
+     * @return the size of the records on the log file
+     */
+    long long getSize();
+    
+    /**
+     * @return the number of fdatasync calls made by the log
+     */
+    long long getNumberOfSyncs();
+    
+    /**
+     * Write a file to the disk
+     * @return false if the file could not be opened
+     */
+    static bool syncFile(const string & path);
+};
+
+WriteAheadLog::WriteAheadLog(const string & path) {
+    this->path = path;
+    this->fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    this->next_sequence = 0;
+    this->durable_sequence = 0;
+    this->syncing = false;
+    this->failed = false;
+    this->log_size = 0;
+    this->number_of_syncs = 0;
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool WriteAheadLog::isOpen() {
+    return fd >= 0;
+}
+
+unsigned WriteAheadLog::getChecksum(const char * data, size_t size) {
+    unsigned hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char) data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool WriteAheadLog::writeAll(const char * data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+unsigned long long WriteAheadLog::append(const string & record) {
+    unsigned size = record.size();
+    unsigned checksum = getChecksum(record.data(), record.size());
+    
+    lock_guard<mutex> lock(log_mutex);
+    const char * size_ptr = reinterpret_cast<const char *> (&size);
+    const char * checksum_ptr = reinterpret_cast<const char *> (&checksum);
+    pending.insert(pending.end(), size_ptr, size_ptr + sizeof(size));
+    pending.insert(pending.end(), checksum_ptr, checksum_ptr + sizeof(checksum));
+    pending.insert(pending.end(), record.begin(), record.end());
+    
+    return ++next_sequence;
+}
+
+bool WriteAheadLog::sync(unsigned long long sequence) {
+    unique_lock<mutex> lock(log_mutex);
+    
+    while (durable_sequence < sequence) {
+        if (failed) {
+            // The records after a torn group can't be read back
+            return false;
+        }
+        if (syncing) {
+            // Another writer is syncing, the record may be on its group
+            synced.wait(lock);
+            continue;
+        }
+    
+        // Take every pending record, so the writers that wait are synced too
+        syncing = true;
+        vector<char> group;
+        group.swap(pending);
+        unsigned long long group_sequence = next_sequence;
+        lock.unlock();
+    
+        bool written = group.empty() || (writeAll(&group[0], group.size()) && fdatasync(fd) == 0);
+        if (!written) {
+            cout << "Unable to write file - " << path << endl;
+        }
+    
+        lock.lock();
+        if (written) {
+            log_size += group.size();
+            durable_sequence = group_sequence;
+        } else {
+            failed = true;
+        }
+        number_of_syncs ++;
+        syncing = false;
+        synced.notify_all();
+    }
+    return true;
+}
+
+void WriteAheadLog::read(long long * checkpoint_id, vector<string> & records) {
+    *checkpoint_id = -1;
+    records.clear();
+    
+    ifstream file;
+    file.open(path.c_str(), ios::binary);
+    if (!file.read(reinterpret_cast<char *> (checkpoint_id), sizeof(*checkpoint_id))) {
+        *checkpoint_id = -1;
+        return;
+    }
+    
+    unsigned size, checksum;
+    string record;
+    while (file.read(reinterpret_cast<char *> (&size), sizeof(size)) &&
+           file.read(reinterpret_cast<char *> (&checksum), sizeof(checksum))) {
+        record.resize(size);
+        if (size > 0 && !file.read(&record[0], size)) {
+            break;
+        }
+        if (getChecksum(record.data(), record.size()) != checksum) {
+            // Torn write, the next records were never synced
+            break;
+        }
+        records.push_back(record);
+    }
+    
+    file.close();
+}
+
+void WriteAheadLog::truncate(long long checkpoint_id) {
+    unique_lock<mutex> lock(log_mutex);
+    while (syncing) {
+        synced.wait(lock);
+    }
+    
+    // The pending records are on the synced data files
+    failed = ftruncate(fd, 0) != 0 ||
+        !writeAll(reinterpret_cast<const char *> (&checkpoint_id), sizeof(checkpoint_id)) ||
+        fdatasync(fd) != 0;
+    if (failed) {
+        cout << "Unable to write file - " << path << endl;
+    }
+    
+    pending.clear();
+    durable_sequence = next_sequence;
+    log_size = 0;
+    synced.notify_all();
+}
+
+void WriteAheadLog::drop() {
+    lock_guard<mutex> lock(log_mutex);
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    remove(path.c_str());
+    pending.clear();
+    durable_sequence = next_sequence;
+    log_size = 0;
+}
+
+long long WriteAheadLog::getSize() {
+    lock_guard<mutex> lock(log_mutex);
+    return log_size;
+}
+
+long long WriteAheadLog::getNumberOfSyncs() {
+    lock_guard<mutex> lock(log_mutex);
+    return number_of_syncs;
+}
+
+bool WriteAheadLog::syncFile(const string & path) {
+    int file_fd = open(path.c_str(), O_RDONLY);
+    if (file_fd < 0) {
+        return false;
+    }
+    fsync(file_fd);
+    close(file_fd);
+    return true;
+}
+
+#endif //WRITEAHEADLOG_H
@@ -0,0 +1,313 @@
+#ifndef ZONEMAP_H
+#define ZONEMAP_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <limits>
+#include <string.h>
+#include <stdio.h>
+#include "schema.h"
+
+using namespace std;
+
+/**
+ * Keeps the minimum and the maximum value of each numeric column for every
+ * block of ROWS_PER_BLOCK rows, so the scans can skip the blocks that can't
+ * match a range predicate. The blocks follow the row order of the table.
+ * The binary format has no NULL values, so the null count is the number of
+ * NaN reals, which never match a range.
+ * The zones are persisted next to the table:
+ * e.g.: | NUMBER_OF_ROWS | NUMBER_OF_COLUMNS | COLUMN_1 | COLUMN_2 | ...
+ *       | BLOCK_0_ZONE_1 | BLOCK_0_ZONE_2 | BLOCK_1_ZONE_1 | BLOCK_1_ZONE_2 | ...
+ * The zones are only widened when a row is updated, so they may be larger
+ * than the values, but never smaller.
+ */
+class ZoneMap {
+public:
+    static const long long ROWS_PER_BLOCK = 4096;
+    
+    struct Zone {
+        double min;
+        double max;
+        long long null_count;
+    };
+    
+    /**
+     * @return the value of a numeric column as a double
+     */
+    static double readValue(const char * value_ptr, SchemaCol & schema_col);
+    
+private:
+    string path;
+    vector<int> columns; // the positions of the numeric columns
+    vector<int> zone_indexes; // column position -> zone index or -1
+    vector<Zone> zones; // block-major, one zone per numeric column
+    long long number_of_rows;
+    long long first_modified_block; // the blocks from this one on are not saved
+    
+    /**
+     * Widen the zones of the block with the row values
+     */
+    void addValues(long long block, const char * row_data, Schema & schema);
+    
+    /**
+     * @return the size of the file before the zones
+     */
+    long long getFileHeaderSize();
+    
+public:
+    /**
+     * @constructor
+     */
+    ZoneMap(const string & path = "");
+    
+    void setPath(const string & path);
+    
+    /**
+     * Remove all the zones and choose the numeric columns of the schema
+     */
+    void reset(Schema & schema);
+    
+    /**
+     * Add the values of the next row
+     * @param row_data the row values, without the registry header
+     */
+    void add(const char * row_data, Schema & schema);
+    
+    /**
+     * Widen the zone of the row with its new values
+     * @param row_index the row order on the table
+     */
+    void update(long long row_index, const char * row_data, Schema & schema);
+    
+    /**
+     * Keep only the first rows. The zones of the last kept block are not
+     * narrowed, they are still larger than its values
+     */
+    void truncate(long long number_of_rows);
+    
+    /**
+     * @return false if no value of the column on the block can be between min
+     *         and max. Columns without zones always may match
+     */
+    bool mayMatch(long long block, int column_position, double min, double max);
+    
+    /**
+     * @return the zone of the column on the block or NULL if the column is not numeric
+     */
+    Zone * getZone(long long block, int column_position);
+    
+    long long getNumberOfBlocks();
+    long long getNumberOfRows();
+    
+    /**
+     * Load the zones from the file
+     * @return false if there is no file or it was made for other columns
+     */
+    bool load(Schema & schema);
+    
+    /**
+     * Write the blocks changed since the last save
+     */
+    void save();
+    
+    /**
+     * Delete the zones and the file
+     */
+    void drop();
+};
+
+const long long ZoneMap::ROWS_PER_BLOCK;
+
+ZoneMap::ZoneMap(const string & path) {
+    this->path = path;
+    this->number_of_rows = 0;
+    this->first_modified_block = 0;
+}
+
+void ZoneMap::setPath(const string & path) {
+    this->path = path;
+}
+
+double ZoneMap::readValue(const char * value_ptr, SchemaCol & schema_col) {
+    if (schema_col.type == INT32) {
+        int value;
+        memcpy(&value, value_ptr, sizeof(value));
+        return value;
+    } else if (schema_col.type == FLOAT) {
+        float value;
+        memcpy(&value, value_ptr, sizeof(value));
+        return value;
+    } else if (schema_col.type == DOUBLE) {
+        double value;
+        memcpy(&value, value_ptr, sizeof(value));
+        return value;
+    }
+    long long value;
+    memcpy(&value, value_ptr, sizeof(value));
+    return value;
+}
+
+void ZoneMap::reset(Schema & schema) {
+    columns.clear();
+    zone_indexes.assign(schema.getNumberOfCols(), -1);
+    zones.clear();
+    number_of_rows = 0;
+    first_modified_block = 0;
+    
+    vector<SchemaCol> * schema_cols = schema.getCols();
+    for (int i = 0; i < (int) schema_cols->size(); i++) {
+        SchemaCol & schema_col = schema_cols->at(i);
+        if (!schema_col.dictionary && (schema_col.isInteger() || schema_col.isReal())) {
+            zone_indexes[i] = columns.size();
+            columns.push_back(i);
+        }
+    }
+}
+
+void ZoneMap::addValues(long long block, const char * row_data, Schema & schema) {
+    for (size_t i = 0; i < columns.size(); i++) {
+        Zone & zone = zones[block * columns.size() + i];
+        double value = readValue(row_data + schema.getColOffset(columns[i]), schema.getCols()->at(columns[i]));
+    
+        if (value != value) {
+            zone.null_count ++;
+            continue;
+        }
+        zone.min = min(zone.min, value);
+        zone.max = max(zone.max, value);
+    }
+    first_modified_block = min(first_modified_block, block);
+}
+
+void ZoneMap::add(const char * row_data, Schema & schema) {
+    long long block = number_of_rows / ROWS_PER_BLOCK;
+    if (block >= getNumberOfBlocks()) {
+        // New block, no value yet
+        Zone empty_zone = {numeric_limits<double>::infinity(), -numeric_limits<double>::infinity(), 0};
+        zones.resize(zones.size() + columns.size(), empty_zone);
+    }
+    
+    addValues(block, row_data, schema);
+    number_of_rows ++;
+}
+
+void ZoneMap::update(long long row_index, const char * row_data, Schema & schema) {
+    if (row_index < 0 || row_index >= number_of_rows) {
+        return;
+    }
+    addValues(row_index / ROWS_PER_BLOCK, row_data, schema);
+}
+
+void ZoneMap::truncate(long long number_of_rows) {
+    if (number_of_rows >= this->number_of_rows) {
+        return;
+    }
+    long long number_of_blocks = (number_of_rows + ROWS_PER_BLOCK - 1) / ROWS_PER_BLOCK;
+    zones.resize(number_of_blocks * columns.size());
+    this->number_of_rows = number_of_rows;
+    first_modified_block = min(first_modified_block, max(0LL, number_of_blocks - 1));
+}
+
+bool ZoneMap::mayMatch(long long block, int column_position, double min, double max) {
+    Zone * zone = getZone(block, column_position);
+    if (zone == NULL) {
+        return true;
+    }
+    return zone->max >= min && zone->min <= max;
+}
+
+ZoneMap::Zone * ZoneMap::getZone(long long block, int column_position) {
+    if (block < 0 || block >= getNumberOfBlocks() || column_position < 0 ||
+        column_position >= (int) zone_indexes.size() || zone_indexes[column_position] < 0) {
+        return NULL;
+    }
+    return &zones[block * columns.size() + zone_indexes[column_position]];
+}
+
+long long ZoneMap::getNumberOfBlocks() {
+    return columns.empty() ? 0 : zones.size() / columns.size();
+}
+
+long long ZoneMap::getNumberOfRows() {
+    return number_of_rows;
+}
+
+long long ZoneMap::getFileHeaderSize() {
+    return sizeof(number_of_rows) + sizeof(int) + columns.size() * sizeof(int);
+}
+
+bool ZoneMap::load(Schema & schema) {
+    reset(schema);
+    
+    ifstream file;
+    file.open(path.c_str(), ios::binary);
+    
+    long long stored_rows;
+    int number_of_columns;
+    if (!file.read(reinterpret_cast<char *> (&stored_rows), sizeof(stored_rows)) ||
+        !file.read(reinterpret_cast<char *> (&number_of_columns), sizeof(number_of_columns)) ||
+        number_of_columns != (int) columns.size()) {
+        return false;
+    }
+    
+    for (int i = 0; i < number_of_columns; i++) {
+        int column_position;
+        if (!file.read(reinterpret_cast<char *> (&column_position), sizeof(column_position)) ||
+            column_position != columns[i]) {
+            return false;
+        }
+    }
+    
+    long long number_of_blocks = (stored_rows + ROWS_PER_BLOCK - 1) / ROWS_PER_BLOCK;
+    zones.resize(number_of_blocks * columns.size());
+    if (!zones.empty() && !file.read(reinterpret_cast<char *> (&zones[0]), zones.size() * sizeof(Zone))) {
+        reset(schema);
+        return false;
+    }
+    
+    number_of_rows = stored_rows;
+    first_modified_block = number_of_blocks;
+    file.close();
+    return true;
+}
+
+void ZoneMap::save() {
+    long long number_of_blocks = getNumberOfBlocks();
+    if (path.empty() || columns.empty()) {
+        return;
+    }
+    
+    // Rewrite the header and the changed blocks only
+    fstream file;
+    file.open(path.c_str(), ios::binary | ios::in | ios::out);
+    if (!file.is_open()) {
+        file.open(path.c_str(), ios::binary | ios::out | ios::trunc);
+        first_modified_block = 0;
+    }
+    
+    int number_of_columns = columns.size();
+    file.write(reinterpret_cast<const char *> (&number_of_rows), sizeof(number_of_rows));
+    file.write(reinterpret_cast<const char *> (&number_of_columns), sizeof(number_of_columns));
+    file.write(reinterpret_cast<const char *> (&columns[0]), columns.size() * sizeof(int));
+    
+    if (first_modified_block < number_of_blocks) {
+        file.seekp(getFileHeaderSize() + first_modified_block * columns.size() * sizeof(Zone));
+        file.write(reinterpret_cast<const char *> (&zones[first_modified_block * columns.size()]),
+            (number_of_blocks - first_modified_block) * columns.size() * sizeof(Zone));
+    }
+    file.close();
+    
+    // The last block is still growing
+    first_modified_block = max(0LL, number_of_blocks - 1);
+}
+
+void ZoneMap::drop() {
+    remove(path.c_str());
+    zones.clear();
+    number_of_rows = 0;
+    first_modified_block = 0;
+}
+
+#endif //ZONEMAP_H